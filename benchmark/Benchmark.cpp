@@ -0,0 +1,399 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AstInterpreter.h"
+#include "BytecodeCompiler.h"
+#include "ConstantFolder.h"
+#include "IncrementalParser.h"
+#include "IrBuilder.h"
+#include "IrPasses.h"
+#include "Jit.h"
+#include "Parser.h"
+#include "ProgramGenerator.h"
+#include "TypeChecker.h"
+#include "VirtualMachine.h"
+
+struct InputSize {
+	std::string_view name;
+	size_t bytes;
+};
+
+static constexpr InputSize INPUT_SIZES[] = {
+	{ "small", 16 * 1024 },
+	{ "medium", 1024 * 1024 },
+	{ "huge", 64 * 1024 * 1024 }
+};
+
+// toyc's default --ir-passes.
+static constexpr std::string_view IR_PASSES[] = { "dce", "gvn", "licm", "gvn", "dce" };
+
+struct Options {
+	GeneratorOptions generator;
+	std::vector<InputSize> sizes;
+	std::vector<std::filesystem::path> programs;
+	double min_time = 1.0;
+	bool emit = false;
+};
+
+static void print_usage() {
+	std::cout <<
+		"Usage: toyc-bench [options]\n"
+		"\n"
+		"Generates programs of each size and measures SourceBuffer, Tokenizer,\n"
+		"LineTable and Parser on them, the Parser also with pipelined and buffered\n"
+		"lexing, and IncrementalParser on an edit in the middle of the program. Each\n"
+		"stage runs until --min-time has passed, at least 3 times, and the fastest\n"
+		"run is reported. With --run, the programs are compiled and run instead.\n"
+		"\n"
+		"Options:\n"
+		"  --size=<name>             small (16 KB), medium (1 MB), huge (64 MB) or all (default)\n"
+		"  --seed=<n>                generator seed (default: 1)\n"
+		"  --depth=<n>               deepest block nesting in function bodies (default: 3)\n"
+		"  --expression-size=<n>     average binary operators per expression (default: 3)\n"
+		"  --comments=<ratio>        chance of a comment line before a statement (default: 0.1)\n"
+		"  --blank-lines=<ratio>     chance of a blank line after a statement (default: 0.1)\n"
+		"  --min-time=<seconds>      time spent on each stage (default: 1)\n"
+		"  --emit                    print the generated program instead, needs a single --size\n"
+		"  --run=<file>              time the top-level statements and main() of <file> on the\n"
+		"                            AST interpreter, the VM and the JIT instead; may be repeated\n"
+		"  -h, --help                print this message\n";
+}
+
+static bool parse_number(std::string_view value, double& number) {
+	std::string text(value);
+	char* end = nullptr;
+
+	number = std::strtod(text.c_str(), &end);
+
+	return !text.empty() && end == text.c_str() + text.size() && number >= 0;
+}
+
+static bool parse_options(int argc, char** argv, Options& options) {
+	bool ok = true;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+		std::string_view value = arg.substr(std::min(arg.find('=') + 1, arg.size()));
+		std::string_view name = arg.substr(0, arg.find('='));
+		double number = 0;
+
+		if (name == "-h" || name == "--help") {
+			print_usage();
+			std::exit(0);
+		} else if (name == "--emit")
+			options.emit = true;
+		else if (name == "--run" && !value.empty())
+			options.programs.emplace_back(value);
+		else if (name == "--size") {
+			bool found = false;
+
+			for (const InputSize& size : INPUT_SIZES) {
+				if (value == size.name || value == "all") {
+					options.sizes.push_back(size);
+					found = true;
+				}
+			}
+
+			if (!found) {
+				std::cerr << "error: unknown size '" << value << "'\n";
+				ok = false;
+			}
+		} else if (name == "--seed" || name == "--depth" || name == "--expression-size" || name == "--comments" ||
+			name == "--blank-lines" || name == "--min-time") {
+			if (!parse_number(value, number)) {
+				std::cerr << "error: '" << name << "' expects a non-negative number\n";
+				ok = false;
+			} else if (name == "--seed")
+				options.generator.seed = static_cast<uint64_t>(number);
+			else if (name == "--depth")
+				options.generator.max_depth = static_cast<int>(number);
+			else if (name == "--expression-size")
+				options.generator.expression_size = static_cast<int>(number);
+			else if (name == "--comments")
+				options.generator.comment_ratio = number;
+			else if (name == "--blank-lines")
+				options.generator.blank_line_ratio = number;
+			else
+				options.min_time = number;
+		} else {
+			std::cerr << "error: unknown option '" << arg << "'\n";
+			ok = false;
+		}
+	}
+
+	if (options.sizes.empty())
+		options.sizes.assign(std::begin(INPUT_SIZES), std::end(INPUT_SIZES));
+
+	if (options.emit && options.sizes.size() != 1) {
+		std::cerr << "error: '--emit' needs a single --size\n";
+		ok = false;
+	}
+
+	return ok;
+}
+
+// Runs the stage until min_time has passed and at least three times, and
+// returns the fastest run in seconds.
+template<typename Stage>
+static double measure(double min_time, Stage&& stage) {
+	double best = 1e300, total = 0;
+
+	for (int runs = 0; runs < 3 || total < min_time; runs++) {
+		auto start = std::chrono::steady_clock::now();
+		stage();
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		best = std::min(best, elapsed.count());
+		total += elapsed.count();
+	}
+
+	return best;
+}
+
+static void print_row(std::string_view input, size_t bytes, std::string_view stage, double seconds, size_t tokens, size_t nodes) {
+	auto rate = [&](size_t count) {
+		std::ostringstream out;
+		if (count)
+			out << std::fixed << std::setprecision(2) << count / seconds / 1e6;
+		else
+			out << '-';
+		return out.str();
+	};
+
+	std::cout << std::left << std::setw(8) << input << std::right << std::setw(10) << std::fixed << std::setprecision(2) << bytes / 1e6 << " MB  "
+		<< std::left << std::setw(14) << stage << std::right
+		<< std::setw(10) << rate(bytes) << std::setw(12) << rate(tokens) << std::setw(12) << rate(nodes)
+		<< std::setw(12) << std::setprecision(3) << seconds * 1e3 << '\n';
+}
+
+static bool run_benchmark(const InputSize& size, const Options& options) {
+	GeneratorOptions generator_options = options.generator;
+	generator_options.target_size = size.bytes;
+
+	std::string program = ProgramGenerator(generator_options).generate();
+
+	// SourceBuffer is measured on a real file, so that mapping it is included.
+	std::filesystem::path path = std::filesystem::temp_directory_path() /
+		("toyc-bench-" + std::to_string(options.generator.seed) + '-' + std::string(size.name) + ".program");
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file.write(program.data(), program.size())) {
+			std::cerr << "error: cannot write '" << path.string() << "'\n";
+			return false;
+		}
+	}
+
+	// Counting newlines touches every page, so mapping cannot get away with
+	// reading nothing.
+	volatile size_t newlines = 0;
+	double load_time = measure(options.min_time, [&] {
+		SourceBuffer source(path);
+		newlines = std::count(source.begin(), source.end(), '\n');
+	});
+
+	SourceBuffer source(path);
+	std::filesystem::remove(path);
+
+	size_t tokens = 0;
+	double tokenize_time = measure(options.min_time, [&] {
+		Tokenizer tokenizer(source);
+
+		tokens = 0;
+		while (tokenizer.current().kind() != TokenKind::EOS) {
+			tokenizer.next();
+			tokens++;
+		}
+	});
+
+	// Only built when a diagnostic needs a position, so not part of parsing.
+	double index_time = measure(options.min_time, [&] {
+		newlines = LineTable(source.text()).line_count();
+	});
+
+	size_t nodes = 0;
+	bool valid = true;
+	double parse_time = measure(options.min_time, [&] {
+		AstContext context;
+		Parser parser(source, context);
+
+		parser.parse();
+		nodes = context.node_count();
+		valid = parser.diagnostics().empty();
+	});
+
+	// The same, with the tokenizer on a thread of its own. It only pays off with
+	// a spare core and on inputs big enough to cover starting the thread.
+	double pipelined_parse_time = measure(options.min_time, [&] {
+		AstContext context;
+		Parser parser(source, context, Lexing::PIPELINED);
+
+		parser.parse();
+		valid &= parser.diagnostics().empty() && context.node_count() == nodes;
+	});
+
+	// And with every token scanned into a TokenBuffer first, which is included.
+	double buffered_parse_time = measure(options.min_time, [&] {
+		AstContext context;
+		Parser parser(source, context, Lexing::BUFFERED);
+
+		parser.parse();
+		valid &= parser.diagnostics().empty() && context.node_count() == nodes;
+	});
+	size_t buffer_bytes = TokenBuffer(source, source.range()).memory_usage();
+
+	// A space typed in the middle of the program and deleted again, in turns,
+	// so that every run has an edit to reparse.
+	IncrementalParser incremental(program);
+	size_t line_end = program.find('\n', program.size() / 2);
+	uint32_t middle = static_cast<uint32_t>(line_end == std::string::npos ? 0 : line_end + 1);
+	bool typed = false;
+	double edit_time = measure(options.min_time, [&] {
+		incremental.apply({ typed ? TextEdit{ middle, 1, {} } : TextEdit{ middle, 0, " " } });
+		typed = !typed;
+	});
+	valid &= incremental.diagnostics().empty();
+
+	if (!valid) {
+		std::cerr << "error: the generated " << size.name << " program does not parse, rerun with --emit to see it\n";
+		return false;
+	}
+
+	print_row(size.name, source.size(), "SourceBuffer", load_time, 0, 0);
+	print_row(size.name, source.size(), "Tokenizer", tokenize_time, tokens, 0);
+	print_row(size.name, source.size(), "LineTable", index_time, 0, 0);
+	print_row(size.name, source.size(), "Parser", parse_time, tokens, nodes);
+	print_row(size.name, source.size(), "Parser (piped)", pipelined_parse_time, tokens, nodes);
+	print_row(size.name, source.size(), "Parser (SoA)", buffered_parse_time, tokens, nodes);
+	print_row(size.name, source.size(), "Parser (edit)", edit_time, 0, 0);
+	std::cout << std::left << std::setw(8) << size.name << std::right << "  TokenBuffer takes " << std::setprecision(2)
+		<< static_cast<double>(buffer_bytes) / (tokens + 1) << " bytes per token, a Token " << sizeof(Token) << '\n';
+
+	return true;
+}
+
+static bool run_program_benchmark(const std::filesystem::path& path, const Options& options) {
+	std::string name = path.filename().string();
+	SourceBuffer source(path);
+
+	if (!source.is_open()) {
+		std::cerr << "error: cannot open '" << path.string() << "'\n";
+		return false;
+	}
+
+	AstContext context;
+	Parser parser(source, context);
+	TranslationUnit* unit = parser.parse();
+	NameResolver resolver;
+	BytecodeCompiler compiler;
+
+	if (!parser.diagnostics().empty() || !resolver.resolve(*unit)) {
+		std::cerr << "error: '" << name << "' does not parse or resolve, run toyc on it to see why\n";
+		return false;
+	}
+
+	// Compiled as toyc --run does, with constant folding and the default passes.
+	unit = TypeChecker(context).check(*unit, resolver);
+	if (unit)
+		unit = ConstantFolder(context).fold(*unit);
+
+	if (!unit || !compiler.compile(*unit, resolver, context.constants())) {
+		std::cerr << "error: '" << name << "' does not compile, run toyc on it to see why\n";
+		return false;
+	}
+
+	const BytecodeProgram& program = compiler.program();
+	IrModule module = IrBuilder().build(*unit, resolver);
+
+	for (std::string_view pass : IR_PASSES) {
+		for (IrFunction& function : module.functions)
+			find_ir_pass(pass)(function);
+	}
+
+	Jit jit;
+	if (!jit.compile(module)) {
+		std::cerr << "error: cannot JIT-compile '" << name << "': " << jit.error() << '\n';
+		return false;
+	}
+
+	AstInterpreter interpreter(*unit, resolver);
+	VirtualMachine vm(program);
+	Type return_type = program.main >= 0 ? program.functions[program.main].return_type : Type::VOID;
+	double baseline = 0;
+	bool ok = true;
+
+	auto run = [&](std::string_view engine, auto& runner) {
+		bool ran = true;
+		double seconds = measure(options.min_time, [&] { ran = runner.run(); });
+		Value value = runner.result();
+		std::ostringstream result;
+
+		if (!ran)
+			result << "error";
+		else if (return_type == Type::FLOAT)
+			result << value.f;
+		else if (return_type != Type::VOID)
+			result << value.i;
+		else
+			result << '-';
+
+		if (!baseline)
+			baseline = seconds;
+		ok &= ran;
+
+		std::cout << std::left << std::setw(24) << name << std::setw(12) << engine << std::right << std::setw(14) << result.str()
+			<< std::setw(12) << std::fixed << std::setprecision(3) << seconds * 1e3
+			<< std::setw(9) << std::setprecision(1) << baseline / seconds << "x\n";
+	};
+
+	run("AST", interpreter);
+	run("VM", vm);
+	run("JIT", jit);
+
+	return ok;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+
+	if (!parse_options(argc, argv, options))
+		return 1;
+
+	if (options.emit) {
+		GeneratorOptions generator_options = options.generator;
+		generator_options.target_size = options.sizes.front().bytes;
+
+		std::cout << ProgramGenerator(generator_options).generate();
+		return 0;
+	}
+
+	if (!options.programs.empty()) {
+		std::cout << std::left << std::setw(24) << "program" << std::setw(12) << "engine" << std::right << std::setw(14) << "result"
+			<< std::setw(12) << "best ms" << std::setw(10) << "speedup" << '\n';
+
+		bool ok = true;
+		for (const std::filesystem::path& path : options.programs)
+			ok &= run_program_benchmark(path, options);
+
+		return ok ? 0 : 1;
+	}
+
+	std::cout << "seed " << options.generator.seed << ", depth " << options.generator.max_depth
+		<< ", expression size " << options.generator.expression_size << ", comments " << options.generator.comment_ratio
+		<< ", blank lines " << options.generator.blank_line_ratio << "\n\n";
+	std::cout << std::left << std::setw(8) << "input" << std::right << std::setw(13) << "size" << "  "
+		<< std::left << std::setw(14) << "stage" << std::right
+		<< std::setw(10) << "MB/s" << std::setw(12) << "Mtokens/s" << std::setw(12) << "Mnodes/s" << std::setw(12) << "best ms" << '\n';
+
+	bool ok = true;
+	for (const InputSize& size : options.sizes)
+		ok &= run_benchmark(size, options);
+
+	return ok ? 0 : 1;
+}
\ No newline at end of file
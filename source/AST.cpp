@@ -1,46 +1,158 @@
 #include "AST.h"
 
-CompoundStatement::CompoundStatement(std::vector<std::unique_ptr<Statement>>&& stmts)
-	: m_statements(std::move(stmts)) {}
+CompoundStatement::CompoundStatement(AstList<Statement*> stmts)
+	: Statement(NodeKind::COMPOUND_STATEMENT), m_statements(stmts) {}
 
-VariableDeclaration::VariableDeclaration(Type type, std::string&& id, std::unique_ptr<Expression> init_value)
-	: m_type(type), m_id(std::move(id)), m_initial_value(std::move(init_value)) {}
+VariableDeclaration::VariableDeclaration(Type type, std::string_view id, Expression* init_value)
+	: DeclarationStatement(NodeKind::VARIABLE_DECLARATION), m_type(type), m_id(id), m_initial_value(init_value) {}
 
-FunctionDeclaration::FunctionDeclaration(Type ret_type, std::string&& id, std::vector<TypedId>&& params, std::unique_ptr<CompoundStatement>&& stmt)
-	: m_ret_type(ret_type), m_id(std::move(id)), m_parameters(std::move(params)), m_statement(std::move(stmt)) {}
+FunctionDeclaration::FunctionDeclaration(Type ret_type, std::string_view id, AstList<TypedId> params, CompoundStatement* stmt)
+	: DeclarationStatement(NodeKind::FUNCTION_DECLARATION), m_parameters(params), m_statement(stmt), m_id(id), m_ret_type(ret_type) {}
 
-IfStatement::IfStatement(std::unique_ptr<Expression> condition, std::unique_ptr<Statement> statement) :
-	m_condition(std::move(condition)), m_statement(std::move(statement)) {}
+IfStatement::IfStatement(Expression* condition, Statement* statement) :
+	Statement(NodeKind::IF_STATEMENT), m_condition(condition), m_statement(statement) {}
 
-ForStatement::ForStatement(std::unique_ptr<VariableDeclaration> var_decl, std::unique_ptr<Expression> condition_expr, std::unique_ptr<Expression> loop_expr, std::unique_ptr<Statement> stmt) :
-		m_variable_declaration(std::move(var_decl)), m_condition_expr(std::move(condition_expr)), m_loop_expr(std::move(loop_expr)), m_statement(std::move(stmt)) {}
+ForStatement::ForStatement(VariableDeclaration* var_decl, Expression* condition_expr, Expression* loop_expr, Statement* stmt) :
+		Statement(NodeKind::FOR_STATEMENT), m_variable_declaration(var_decl), m_condition_expr(condition_expr), m_loop_expr(loop_expr), m_statement(stmt) {}
 
-WhileStatement::WhileStatement(std::unique_ptr<Expression> condition_expr, std::unique_ptr<Statement> statement) :
-	m_condition_expr(std::move(condition_expr)), m_statement(std::move(statement)) {}
+WhileStatement::WhileStatement(Expression* condition_expr, Statement* statement) :
+	Statement(NodeKind::WHILE_STATEMENT), m_condition_expr(condition_expr), m_statement(statement) {}
 
-ReturnStatement::ReturnStatement(std::unique_ptr<Expression> return_expr) :
-	m_return_expr(std::move(return_expr)) {}
+ReturnStatement::ReturnStatement(Expression* return_expr) :
+	Statement(NodeKind::RETURN_STATEMENT), m_return_expr(return_expr) {}
 
-BinaryExpression::BinaryExpression(BinaryOp op, std::unique_ptr<Expression> left, std::unique_ptr<Expression> right)
-	: m_op(op), m_left(std::move(left)), m_right(std::move(right)) {}
+BinaryExpression::BinaryExpression(BinaryOp op, Expression* left, Expression* right)
+	: Expression(NodeKind::BINARY_EXPRESSION), m_op(op), m_left(left), m_right(right) {}
 
-UnaryExpression::UnaryExpression(UnaryOp op, std::unique_ptr<Expression> expr)
-	: m_op(op), m_expr(std::move(expr)) {}
+UnaryExpression::UnaryExpression(UnaryOp op, Expression* expr)
+	: Expression(NodeKind::UNARY_EXPRESSION), m_op(op), m_expr(expr) {}
 
-IdAtom::IdAtom(std::string&& id) :
-	m_id(std::move(id)) {}
+IdAtom::IdAtom(std::string_view id) :
+	Atom(NodeKind::ID_ATOM), m_id(id) {}
 
-FuncCallAtom::FuncCallAtom(std::string&& id, std::vector<std::unique_ptr<Expression>>&& arguments) :
-	m_id(std::move(id)), m_arguments(std::move(arguments)) {}
+FuncCallAtom::FuncCallAtom(std::string_view id, AstList<Expression*> arguments) :
+	Atom(NodeKind::FUNC_CALL_ATOM), m_id(id), m_arguments(arguments) {}
 
-IntLiteral::IntLiteral(int integer) :
-	m_integer(integer) {}
+IntLiteral::IntLiteral(int integer, uint32_t constant) :
+	Literal(NodeKind::INT_LITERAL), m_integer(integer), m_constant(constant) {
+	set_type(Type::INT);
+}
 
-FloatLiteral::FloatLiteral(float floating) :
-	m_floating(floating) {}
+FloatLiteral::FloatLiteral(float floating, uint32_t constant) :
+	Literal(NodeKind::FLOAT_LITERAL), m_floating(floating), m_constant(constant) {
+	set_type(Type::FLOAT);
+}
 
 BoolLiteral::BoolLiteral(bool boolean) :
-	m_boolean(boolean) {}
+	Literal(NodeKind::BOOL_LITERAL), m_boolean(boolean) {
+	set_type(Type::BOOL);
+}
 
-TranslationUnit::TranslationUnit(std::vector<std::unique_ptr<Statement>>&& statements)
-	: m_statements(std::move(statements)) {}
\ No newline at end of file
+TranslationUnit::TranslationUnit(AstList<Statement*> statements)
+	: m_statements(statements) {}
+
+static bool ast_equal(AstList<Statement*> a, AstList<Statement*> b) {
+	if (a.size() != b.size())
+		return false;
+
+	for (uint32_t i = 0; i < a.size(); i++) {
+		if (!ast_equal(a[i], b[i]))
+			return false;
+	}
+
+	return true;
+}
+
+bool ast_equal(const Statement* a, const Statement* b) {
+	if (!a || !b)
+		return a == b;
+
+	if (a->kind() != b->kind())
+		return false;
+
+	switch (a->kind()) {
+	case NodeKind::COMPOUND_STATEMENT:
+		return ast_equal(static_cast<const CompoundStatement*>(a)->statements(), static_cast<const CompoundStatement*>(b)->statements());
+	case NodeKind::VARIABLE_DECLARATION: {
+		auto x = static_cast<const VariableDeclaration*>(a);
+		auto y = static_cast<const VariableDeclaration*>(b);
+		return x->type() == y->type() && x->id() == y->id() && ast_equal(x->initial_value(), y->initial_value());
+	}
+	case NodeKind::FUNCTION_DECLARATION: {
+		auto x = static_cast<const FunctionDeclaration*>(a);
+		auto y = static_cast<const FunctionDeclaration*>(b);
+		if (x->return_type() != y->return_type() || x->id() != y->id() || x->parameters().size() != y->parameters().size())
+			return false;
+
+		for (uint32_t i = 0; i < x->parameters().size(); i++) {
+			if (x->parameters()[i].type != y->parameters()[i].type || x->parameters()[i].id != y->parameters()[i].id)
+				return false;
+		}
+
+		return ast_equal(x->statement(), y->statement());
+	}
+	case NodeKind::IF_STATEMENT: {
+		auto x = static_cast<const IfStatement*>(a);
+		auto y = static_cast<const IfStatement*>(b);
+		return ast_equal(x->condition(), y->condition()) && ast_equal(x->statement(), y->statement());
+	}
+	case NodeKind::FOR_STATEMENT: {
+		auto x = static_cast<const ForStatement*>(a);
+		auto y = static_cast<const ForStatement*>(b);
+		return ast_equal(x->variable_declaration(), y->variable_declaration()) && ast_equal(x->condition_expr(), y->condition_expr()) &&
+			ast_equal(x->loop_expr(), y->loop_expr()) && ast_equal(x->statement(), y->statement());
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		auto x = static_cast<const WhileStatement*>(a);
+		auto y = static_cast<const WhileStatement*>(b);
+		return ast_equal(x->condition_expr(), y->condition_expr()) && ast_equal(x->statement(), y->statement());
+	}
+	case NodeKind::RETURN_STATEMENT:
+		return ast_equal(static_cast<const ReturnStatement*>(a)->return_expr(), static_cast<const ReturnStatement*>(b)->return_expr());
+	case NodeKind::BINARY_EXPRESSION:
+		// Down the left operands in a loop, see push_left_chain().
+		while (a && b && a->kind() == NodeKind::BINARY_EXPRESSION && b->kind() == NodeKind::BINARY_EXPRESSION) {
+			auto x = static_cast<const BinaryExpression*>(a);
+			auto y = static_cast<const BinaryExpression*>(b);
+			if (x->op() != y->op() || !ast_equal(x->right(), y->right()))
+				return false;
+
+			a = x->left();
+			b = y->left();
+		}
+
+		return ast_equal(a, b);
+	case NodeKind::UNARY_EXPRESSION: {
+		auto x = static_cast<const UnaryExpression*>(a);
+		auto y = static_cast<const UnaryExpression*>(b);
+		return x->op() == y->op() && (x->op() != UnaryOp::CAST || x->type() == y->type()) && ast_equal(x->expr(), y->expr());
+	}
+	case NodeKind::ID_ATOM:
+		return static_cast<const IdAtom*>(a)->id() == static_cast<const IdAtom*>(b)->id();
+	case NodeKind::FUNC_CALL_ATOM: {
+		auto x = static_cast<const FuncCallAtom*>(a);
+		auto y = static_cast<const FuncCallAtom*>(b);
+		if (x->id() != y->id() || x->arguments().size() != y->arguments().size())
+			return false;
+
+		for (uint32_t i = 0; i < x->arguments().size(); i++) {
+			if (!ast_equal(x->arguments()[i], y->arguments()[i]))
+				return false;
+		}
+
+		return true;
+	}
+	case NodeKind::INT_LITERAL:
+		return static_cast<const IntLiteral*>(a)->integer() == static_cast<const IntLiteral*>(b)->integer();
+	case NodeKind::FLOAT_LITERAL:
+		return static_cast<const FloatLiteral*>(a)->floating() == static_cast<const FloatLiteral*>(b)->floating();
+	case NodeKind::BOOL_LITERAL:
+		return static_cast<const BoolLiteral*>(a)->boolean() == static_cast<const BoolLiteral*>(b)->boolean();
+	}
+
+	return false;
+}
+
+bool ast_equal(const TranslationUnit& a, const TranslationUnit& b) {
+	return ast_equal(a.statements(), b.statements());
+}
\ No newline at end of file
@@ -1,101 +1,212 @@
 #pragma once
 
-#include <memory>
-#include <string>
-#include <variant>
+#include <cstdint>
+#include <string_view>
 #include <vector>
 
+// All nodes live in an AstContext arena and are never destroyed one by one,
+// so every node type has to stay trivially destructible.
+
+template<typename T>
+class AstList {
+public:
+	AstList() = default;
+	AstList(T* data, uint32_t size)
+		: m_data(data), m_size(size) {}
+
+	T* begin() const { return m_data; }
+	T* end() const { return m_data + m_size; }
+	T& operator[](uint32_t index) const { return m_data[index]; }
+
+	uint32_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+private:
+	T* m_data = nullptr;
+	uint32_t m_size = 0;
+};
+
+enum class NodeKind : uint8_t {
+	COMPOUND_STATEMENT = 0,
+	VARIABLE_DECLARATION,
+	FUNCTION_DECLARATION,
+	IF_STATEMENT,
+	FOR_STATEMENT,
+	WHILE_STATEMENT,
+	RETURN_STATEMENT,
+
+	BINARY_EXPRESSION,
+	UNARY_EXPRESSION,
+	ID_ATOM,
+	FUNC_CALL_ATOM,
+	INT_LITERAL,
+	FLOAT_LITERAL,
+	BOOL_LITERAL
+};
+
+enum class Type {
+	VOID = 0,
+	BOOL,
+	INT,
+	FLOAT
+};
+
 class Statement {
 public:
-	virtual ~Statement() = 0 {};
+	NodeKind kind() const { return m_kind; }
+	bool is_expression() const { return m_kind >= NodeKind::BINARY_EXPRESSION; }
+
+protected:
+	Statement(NodeKind kind)
+		: m_kind(kind) {}
+
+private:
+	NodeKind m_kind;
 };
 
 class Expression : public Statement {
 public:
-	virtual ~Expression() = 0 {}
+	// What the expression evaluates to, as TypeChecker found; literals know
+	// their own type, everything else is VOID until it is checked.
+	Type type() const { return m_type; }
+	void set_type(Type type) { m_type = type; }
+
+protected:
+	using Statement::Statement;
+
+private:
+	Type m_type = Type::VOID;
 };
 
 class CompoundStatement final : public Statement {
 public:
-	CompoundStatement(std::vector<std::unique_ptr<Statement>>&& stmts);
+	CompoundStatement(AstList<Statement*> stmts);
+
+	AstList<Statement*> statements() const { return m_statements; }
 
 private:
-	std::vector<std::unique_ptr<Statement>> m_statements;
+	AstList<Statement*> m_statements;
 };
 
 class DeclarationStatement : public Statement {
-public:
-	virtual ~DeclarationStatement() = 0 {}
+protected:
+	using Statement::Statement;
 };
 
-enum class Type {
-	VOID = 0,
-	BOOL,
-	INT,
-	FLOAT
+enum class BindingKind : uint8_t {
+	UNRESOLVED = 0,
+	LOCAL,
+	GLOBAL,
+	FUNCTION
+};
+
+// What a name refers to, filled in by NameResolver. A local is a register of
+// the function at the given nesting depth, a global a slot of the program and
+// a function an index into the program's functions.
+struct Binding {
+	BindingKind kind = BindingKind::UNRESOLVED;
+	Type type = Type::VOID;
+	uint16_t depth = 0;
+	uint32_t slot = 0;
 };
 
 class VariableDeclaration final : public DeclarationStatement {
 public:
-	VariableDeclaration(Type type, std::string&& id, std::unique_ptr<Expression> init_value);
+	VariableDeclaration(Type type, std::string_view id, Expression* init_value);
+
+	Type type() const { return m_type; }
+	std::string_view id() const { return m_id; }
+	Expression* initial_value() const { return m_initial_value; }
+
+	const Binding& binding() const { return m_binding; }
+	void bind(Binding binding) { m_binding = binding; }
+
+	// Whether the variable is ever the target of '=', '++' or '--'.
+	bool assigned() const { return m_assigned; }
+	void set_assigned() { m_assigned = true; }
 
 private:
 	Type m_type;
-	std::string m_id;
-	std::unique_ptr<Expression> m_initial_value;
+	std::string_view m_id;
+	Expression* m_initial_value;
+	Binding m_binding;
+	bool m_assigned = false;
 };
 
 struct TypedId {
 	Type type;
-	std::string id;
+	std::string_view id;
 };
 
 class FunctionDeclaration final : public DeclarationStatement {
 public:
-	FunctionDeclaration(Type ret_type, std::string&& id, std::vector<TypedId>&& params, std::unique_ptr<CompoundStatement>&& stmt);
+	FunctionDeclaration(Type ret_type, std::string_view id, AstList<TypedId> params, CompoundStatement* stmt);
+
+	Type return_type() const { return m_ret_type; }
+	std::string_view id() const { return m_id; }
+	AstList<TypedId> parameters() const { return m_parameters; }
+	CompoundStatement* statement() const { return m_statement; }
+
+	// Index among the program's functions; parameters are its first registers.
+	uint32_t index() const { return m_index; }
+	void set_index(uint32_t index) { m_index = index; }
 
 private:
-	std::vector<TypedId> m_parameters;
-	std::unique_ptr<CompoundStatement> m_statement;
-	std::string m_id;
+	AstList<TypedId> m_parameters;
+	CompoundStatement* m_statement;
+	std::string_view m_id;
 	Type m_ret_type;
+	uint32_t m_index = 0;
 };
 
 class IfStatement final : public Statement {
 public:
-	IfStatement(std::unique_ptr<Expression> condition, std::unique_ptr<Statement> statement);
+	IfStatement(Expression* condition, Statement* statement);
+
+	Expression* condition() const { return m_condition; }
+	Statement* statement() const { return m_statement; }
 
 private:
-	std::unique_ptr<Expression> m_condition;
-	std::unique_ptr<Statement> m_statement;
+	Expression* m_condition;
+	Statement* m_statement;
 };
 
 class ForStatement final : public Statement {
 public:
-	ForStatement(std::unique_ptr<VariableDeclaration> var_decl, std::unique_ptr<Expression> condition_expr, std::unique_ptr<Expression> loop_expr, std::unique_ptr<Statement> stmt);
+	ForStatement(VariableDeclaration* var_decl, Expression* condition_expr, Expression* loop_expr, Statement* stmt);
+
+	VariableDeclaration* variable_declaration() const { return m_variable_declaration; }
+	Expression* condition_expr() const { return m_condition_expr; }
+	Expression* loop_expr() const { return m_loop_expr; }
+	Statement* statement() const { return m_statement; }
 
 private:
-	std::unique_ptr<VariableDeclaration> m_variable_declaration;
-	std::unique_ptr<Expression> m_condition_expr;
-	std::unique_ptr<Expression> m_loop_expr;
-	std::unique_ptr<Statement> m_statement;
+	VariableDeclaration* m_variable_declaration;
+	Expression* m_condition_expr;
+	Expression* m_loop_expr;
+	Statement* m_statement;
 };
 
 class WhileStatement final : public Statement {
 public:
-	WhileStatement(std::unique_ptr<Expression> condition_expr, std::unique_ptr<Statement> statement);
+	WhileStatement(Expression* condition_expr, Statement* statement);
+
+	Expression* condition_expr() const { return m_condition_expr; }
+	Statement* statement() const { return m_statement; }
 
 private:
-	std::unique_ptr<Expression> m_condition_expr;
-	std::unique_ptr<Statement> m_statement;
+	Expression* m_condition_expr;
+	Statement* m_statement;
 };
 
 class ReturnStatement final : public Statement {
 public:
-	ReturnStatement(std::unique_ptr<Expression> return_expr);
+	ReturnStatement(Expression* return_expr);
+
+	Expression* return_expr() const { return m_return_expr; }
 
 private:
-	std::unique_ptr<Expression> m_return_expr;
+	Expression* m_return_expr;
 };
 
 enum class BinaryOp {
@@ -118,83 +229,143 @@ enum class BinaryOp {
 enum class UnaryOp {
 	PRE_INCREMENT,
 	PRE_DECREMENT,
+	// Converts the operand to the type of the expression.
 	CAST
 };
 
 class BinaryExpression final : public Expression {
 public:
-	BinaryExpression(BinaryOp op, std::unique_ptr<Expression> left, std::unique_ptr<Expression> rigth);
+	BinaryExpression(BinaryOp op, Expression* left, Expression* rigth);
+
+	BinaryOp op() const { return m_op; }
+	Expression* left() const { return m_left; }
+	Expression* right() const { return m_right; }
 
 private:
 	BinaryOp m_op;
-	std::unique_ptr<Expression> m_left;
-	std::unique_ptr<Expression> m_right;
+	Expression* m_left;
+	Expression* m_right;
 };
 
 class UnaryExpression final : public Expression {
 public:
-	UnaryExpression(UnaryOp op, std::unique_ptr<Expression> expr);
+	UnaryExpression(UnaryOp op, Expression* expr);
+
+	UnaryOp op() const { return m_op; }
+	Expression* expr() const { return m_expr; }
 
 private:
 	UnaryOp m_op;
-	std::unique_ptr<Expression> m_expr;
+	Expression* m_expr;
 };
 
 class Atom : public Expression {
-public:
-	virtual ~Atom() = 0 {}
+protected:
+	using Expression::Expression;
 };
 
 class IdAtom final : public Atom {
 public:
-	IdAtom(std::string&& id);
+	IdAtom(std::string_view id);
+
+	std::string_view id() const { return m_id; }
+
+	const Binding& binding() const { return m_binding; }
+	void bind(Binding binding) { m_binding = binding; }
 
 private:
-	std::string m_id;
+	std::string_view m_id;
+	Binding m_binding;
 };
 
 class FuncCallAtom final : public Atom {
 public:
-	FuncCallAtom(std::string&& id, std::vector<std::unique_ptr<Expression>>&& arguments);
+	FuncCallAtom(std::string_view id, AstList<Expression*> arguments);
+
+	std::string_view id() const { return m_id; }
+	AstList<Expression*> arguments() const { return m_arguments; }
+
+	const Binding& binding() const { return m_binding; }
+	void bind(Binding binding) { m_binding = binding; }
 
 private:
-	std::string m_id;
-	std::vector<std::unique_ptr<Expression>> m_arguments;
+	std::string_view m_id;
+	AstList<Expression*> m_arguments;
+	Binding m_binding;
 };
 
 class Literal : public Atom {
-public:
-	virtual ~Literal() = 0 {}
+protected:
+	using Atom::Atom;
 };
 
+// Int and float literals come from AstContext, which interns their values;
+// constant() is the value's index in the context's ConstantPool.
 class IntLiteral final : public Literal {
 public:
-	IntLiteral(int integer);
+	IntLiteral(int integer, uint32_t constant);
+
+	int integer() const { return m_integer; }
+	uint32_t constant() const { return m_constant; }
+	void set_constant(uint32_t constant) { m_constant = constant; }
 
 private:
 	int m_integer;
+	uint32_t m_constant;
 };
 
 class FloatLiteral final : public Literal {
 public:
-	FloatLiteral(float floating);
+	FloatLiteral(float floating, uint32_t constant);
+
+	float floating() const { return m_floating; }
+	uint32_t constant() const { return m_constant; }
+	void set_constant(uint32_t constant) { m_constant = constant; }
 
 private:
 	float m_floating;
+	uint32_t m_constant;
 };
 
 class BoolLiteral final : public Literal {
 public:
 	BoolLiteral(bool boolean);
 
+	bool boolean() const { return m_boolean; }
+
 private:
 	bool m_boolean;
 };
 
 class TranslationUnit {
 public:
-	TranslationUnit(std::vector<std::unique_ptr<Statement>>&& statements);
+	TranslationUnit(AstList<Statement*> statements);
+
+	AstList<Statement*> statements() const { return m_statements; }
 
 private:
-	std::vector<std::unique_ptr<Statement>> m_statements;
-};
\ No newline at end of file
+	AstList<Statement*> m_statements;
+};
+
+// Deep comparison of node kinds, operators, types, names and literal values.
+bool ast_equal(const Statement* a, const Statement* b);
+bool ast_equal(const TranslationUnit& a, const TranslationUnit& b);
+
+// A chain of left-associative operators like 1 + 2 + ... + n nests down the
+// left operands, one level per operator, so the passes walk it in a loop
+// rather than recursing. This pushes expr and the binary expressions below it
+// along the left operands onto chain, outermost first, and returns the
+// operand the chain starts with. '=' nests the other way and is not part of
+// a chain, so expr must not be one either.
+template<typename Binary>
+Expression* push_left_chain(Binary* expr, std::vector<Binary*>& chain) {
+	while (true) {
+		chain.push_back(expr);
+
+		Expression* left = expr->left();
+		if (!left || left->kind() != NodeKind::BINARY_EXPRESSION || static_cast<Binary*>(left)->op() == BinaryOp::ASSIGN)
+			return left;
+
+		expr = static_cast<Binary*>(left);
+	}
+}
\ No newline at end of file
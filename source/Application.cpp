@@ -1,17 +1,606 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 
-#include "Parser.h"
+#include "AstCache.h"
+#include "BytecodeCompiler.h"
+#include "ConstantFolder.h"
+#include "IrBuilder.h"
+#include "IrPasses.h"
+#include "Jit.h"
+#include "NameResolver.h"
+#include "ParallelParser.h"
+#include "Trace.h"
+#include "TypeChecker.h"
+#include "VirtualMachine.h"
 
-void test_parser(const std::filesystem::path& filename) {
-	Parser parser(filename);
+struct Options {
+	std::vector<std::filesystem::path> inputs;
+	std::filesystem::path cache_directory;
+	std::filesystem::path trace_file;
+	unsigned jobs = std::thread::hardware_concurrency();
+	bool stats = false;
+	Lexing lexing = Lexing::INLINE;
+	size_t error_limit = DiagnosticEngine::DEFAULT_ERROR_LIMIT;
+	size_t nesting_limit = Parser::DEFAULT_NESTING_LIMIT;
+	bool json_diagnostics = false;
+	bool run = false;
+	bool jit = false;
+	bool dump_bytecode = false;
+	bool fold = true;
+	bool dump_ir = false;
+	std::vector<std::string_view> ir_passes{ "dce", "gvn", "licm", "gvn", "dce" };
+};
 
-	auto ast = parser.parse();
+struct FileResult {
+	std::vector<Diagnostic> diagnostics;
+	std::vector<Diagnostic> warnings;
+	std::string bytecode;
+	std::string ir;
+	// What the program returned, or its runtime error.
+	std::string run_status;
+	bool run_failed = false;
+	size_t bytes = 0;
+	size_t nodes = 0;
+	// Inserted by type checking.
+	size_t casts = 0;
+	// Removed by constant folding.
+	size_t folded_nodes = 0;
+	// Instructions before and after the IR passes.
+	size_t ir_instructions = 0;
+	size_t ir_optimized_instructions = 0;
+	bool opened = false;
+	// Why the file could not be opened.
+	std::string open_error;
+	bool cached = false;
+};
+
+static constexpr std::string_view SOURCE_EXTENSION = ".program";
+static constexpr int MAX_RESPONSE_FILE_DEPTH = 16;
+
+// Files at least this big are also split at top-level statements and parsed
+// on several workers.
+static constexpr size_t PARALLEL_PARSE_THRESHOLD = 1024 * 1024;
+
+// With --lexing=pipelined, files at least this big that are parsed on one
+// worker get a lexer thread of their own; below, starting it costs more than
+// it saves.
+static constexpr size_t PIPELINED_LEXING_THRESHOLD = 64 * 1024;
+
+static void print_usage() {
+	std::cout <<
+		"Usage: toyc [options] <input>...\n"
+		"\n"
+		"Inputs:\n"
+		"  <file>          source file\n"
+		"  <directory>     every *.program file below the directory\n"
+		"  @<file>         response file with more inputs, separated by whitespace\n"
+		"\n"
+		"Options:\n"
+		"  -j <n>, --jobs=<n>  number of worker threads (default: number of cores)\n"
+		"  --cache-dir=<dir>   reuse parse results stored in <dir> for unchanged sources\n"
+		"  --trace=<file>      write a Chrome trace-event profile of the run to <file>\n"
+		"  --run               compile to bytecode and run the top-level statements and main()\n"
+		"  --jit               like --run, but compile the optimized IR to x86-64 machine code\n"
+		"  --dump-bytecode     print the bytecode of every function\n"
+		"  --no-fold           compile without folding constants\n"
+		"  --dump-ir           print the SSA form of every function after the IR passes\n"
+		"  --ir-passes=<list>  comma-separated IR passes to run, from dce, gvn and licm\n"
+		"                      (default: dce,gvn,licm,gvn,dce)\n"
+		"  --lexing=<mode>     inline (default), buffered to lex every file up front, or\n"
+		"                      pipelined to lex files of 64 KB and more on a thread of\n"
+		"                      their own while they are parsed\n"
+		"  --error-limit=<n>   stop parsing a file after <n> errors, 0 for no limit\n"
+		"                      (default: 100)\n"
+		"  --nesting-limit=<n> stop parsing a file whose syntax tree gets deeper than <n>\n"
+		"                      levels, 0 for no limit (default: 1000)\n"
+		"  --diagnostics=json  print diagnostics as JSON objects, one per line\n"
+		"  --stats             print aggregate throughput\n"
+		"  -h, --help          print this message\n";
 }
 
-int main() {
-	std::string_view input_file = "tests/input.program";
+static bool add_input(std::string_view arg, std::vector<std::filesystem::path>& inputs, int depth) {
+	if (arg.front() == '@') {
+		if (depth == MAX_RESPONSE_FILE_DEPTH) {
+			std::cerr << "error: response files nested too deeply at '" << arg << "'\n";
+			return false;
+		}
+
+		std::ifstream response_file{ std::filesystem::path(arg.substr(1)) };
+		if (!response_file) {
+			std::cerr << "error: cannot open response file '" << arg.substr(1) << "'\n";
+			return false;
+		}
+
+		bool ok = true;
+		std::string entry;
+		while (response_file >> entry)
+			ok &= add_input(entry, inputs, depth + 1);
+
+		return ok;
+	}
+
+	std::filesystem::path path(arg);
+	std::error_code ec;
+
+	if (std::filesystem::is_directory(path, ec)) {
+		std::vector<std::filesystem::path> files;
+
+		for (auto it = std::filesystem::recursive_directory_iterator(path, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+			if (it->is_regular_file(ec) && it->path().extension() == SOURCE_EXTENSION)
+				files.push_back(it->path());
+		}
+
+		// Directory iteration order is unspecified, sort to keep the output stable.
+		std::sort(files.begin(), files.end());
+		inputs.insert(inputs.end(), files.begin(), files.end());
+	} else
+		inputs.push_back(std::move(path));
+
+	return true;
+}
+
+static bool parse_count(std::string_view value, size_t& count) {
+	size_t result = 0;
+
+	if (value.empty())
+		return false;
+
+	for (char c : value) {
+		if (c < '0' || c > '9' || result > 100000)
+			return false;
+
+		result = result * 10 + (c - '0');
+	}
+
+	count = result;
+
+	return true;
+}
+
+static bool parse_jobs(std::string_view value, unsigned& jobs) {
+	size_t count = 0;
+
+	if (!parse_count(value, count) || count == 0)
+		return false;
+
+	jobs = static_cast<unsigned>(count);
+
+	return true;
+}
+
+static bool parse_ir_passes(std::string_view list, std::vector<std::string_view>& passes) {
+	passes.clear();
+
+	while (!list.empty()) {
+		size_t comma = std::min(list.find(','), list.size());
+		std::string_view name = list.substr(0, comma);
+
+		if (!find_ir_pass(name)) {
+			std::cerr << "error: unknown IR pass '" << name << "'\n";
+			return false;
+		}
+
+		passes.push_back(name);
+		list.remove_prefix(std::min(comma + 1, list.size()));
+	}
+
+	return true;
+}
+
+static bool parse_options(int argc, char** argv, Options& options) {
+	bool ok = true;
+
+	for (int i = 1; i < argc; i++) {
+		std::string_view arg = argv[i];
+
+		if (arg == "-h" || arg == "--help") {
+			print_usage();
+			std::exit(0);
+		} else if (arg == "--stats")
+			options.stats = true;
+		else if (arg == "--lexing=inline")
+			options.lexing = Lexing::INLINE;
+		else if (arg == "--lexing=buffered")
+			options.lexing = Lexing::BUFFERED;
+		else if (arg == "--lexing=pipelined")
+			options.lexing = Lexing::PIPELINED;
+		else if (arg == "--no-fold")
+			options.fold = false;
+		else if (arg == "--run")
+			options.run = true;
+		else if (arg == "--jit")
+			options.run = options.jit = true;
+		else if (arg == "--dump-bytecode")
+			options.dump_bytecode = true;
+		else if (arg == "--dump-ir")
+			options.dump_ir = true;
+		else if (arg.substr(0, 12) == "--ir-passes=")
+			ok &= parse_ir_passes(arg.substr(12), options.ir_passes);
+		else if (arg == "--diagnostics=json")
+			options.json_diagnostics = true;
+		else if (arg == "--diagnostics=text")
+			options.json_diagnostics = false;
+		else if (arg.substr(0, 14) == "--error-limit=") {
+			if (!parse_count(arg.substr(14), options.error_limit)) {
+				std::cerr << "error: '--error-limit' expects a number\n";
+				ok = false;
+			}
+		}
+		else if (arg.substr(0, 16) == "--nesting-limit=") {
+			if (!parse_count(arg.substr(16), options.nesting_limit)) {
+				std::cerr << "error: '--nesting-limit' expects a number\n";
+				ok = false;
+			}
+		}
+		else if (arg == "-j" || arg == "--jobs") {
+			if (i + 1 == argc || !parse_jobs(argv[++i], options.jobs)) {
+				std::cerr << "error: '" << arg << "' expects a positive number\n";
+				ok = false;
+			}
+		} else if (arg == "--cache-dir" || arg.substr(0, 12) == "--cache-dir=") {
+			if (arg.size() > 12)
+				options.cache_directory = arg.substr(12);
+			else if (arg.size() == 11 && i + 1 < argc)
+				options.cache_directory = argv[++i];
+			else {
+				std::cerr << "error: '" << arg << "' expects a directory\n";
+				ok = false;
+			}
+		} else if (arg.substr(0, 8) == "--trace=" && arg.size() > 8)
+			options.trace_file = arg.substr(8);
+		else if (arg.substr(0, 2) == "-j" || arg.substr(0, 7) == "--jobs=") {
+			if (!parse_jobs(arg.substr(arg[1] == 'j' ? 2 : 7), options.jobs)) {
+				std::cerr << "error: '" << arg << "' expects a positive number\n";
+				ok = false;
+			}
+		} else if (arg.size() > 1 && arg.front() == '-') {
+			std::cerr << "error: unknown option '" << arg << "'\n";
+			ok = false;
+		} else if (!arg.empty())
+			ok &= add_input(arg, options.inputs, 0);
+	}
+
+	return ok;
+}
+
+// One line per diagnostic, as text or as a JSON object for tools. Errors
+// found after parsing have no position.
+static void append_diagnostic(std::string& out, const std::string& path, const Diagnostic& diagnostic, std::string_view severity, bool json) {
+	if (!json) {
+		if (diagnostic.pos.line > 0)
+			out += path + " [" + std::to_string(diagnostic.pos.line) + ',' + std::to_string(diagnostic.pos.column) + "] ";
+		else
+			out += path + ": ";
+
+		out += std::string(severity) + ": " + diagnostic.message + '\n';
+		return;
+	}
+
+	out += "{\"file\":";
+	append_json_string(out, path);
+	if (diagnostic.pos.line > 0)
+		out += ",\"line\":" + std::to_string(diagnostic.pos.line) + ",\"column\":" + std::to_string(diagnostic.pos.column);
+	out += severity == "Error" ? ",\"severity\":\"error\"" : ",\"severity\":\"warning\"";
+	out += ",\"message\":";
+	append_json_string(out, diagnostic.message);
+	out += "}\n";
+}
+
+static std::string format_value(Value value, Type type) {
+	std::ostringstream out;
+
+	if (type == Type::FLOAT)
+		out << value.f;
+	else if (type == Type::BOOL)
+		out << (value.i ? "true" : "false");
+	else
+		out << value.i;
+
+	return out.str();
+}
+
+// Builds SSA form and runs the passes, checking the IR after each step.
+static bool optimize_ir(const TranslationUnit& unit, const NameResolver& resolver, const Options& options, IrModule& module, FileResult& result) {
+	{
+		TraceScope trace("build_ir", "backend");
+		module = IrBuilder().build(unit, resolver);
+	}
+
+	auto verify = [&](std::string_view step) {
+		for (const IrFunction& function : module.functions) {
+			for (const std::string& error : verify_ir(module, function))
+				result.diagnostics.push_back({ {}, "Invalid IR " + std::string(step) + ": " + error });
+		}
+
+		return result.diagnostics.empty();
+	};
+
+	if (!verify("from the builder"))
+		return false;
+
+	for (const IrFunction& function : module.functions)
+		result.ir_instructions += function.instruction_count();
+
+	for (std::string_view name : options.ir_passes) {
+		TraceScope trace("ir_pass", "backend");
+		IrPass pass = find_ir_pass(name);
+
+		if (trace.active())
+			trace.set_detail(std::string(name));
+
+		for (IrFunction& function : module.functions)
+			pass(function);
+
+		if (!verify("after " + std::string(name)))
+			return false;
+	}
+
+	for (const IrFunction& function : module.functions)
+		result.ir_optimized_instructions += function.instruction_count();
+
+	if (options.dump_ir)
+		result.ir = dump_ir(module);
+
+	return true;
+}
+
+// Runs the top-level statements and main() on the VM or the JIT.
+template<typename Engine>
+static void execute(Engine& engine, const BytecodeProgram& program, const char* engine_name, FileResult& result) {
+	auto start = std::chrono::steady_clock::now();
+	bool ok;
+	{
+		TraceScope trace("run", engine_name);
+		ok = engine.run();
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	if (!ok) {
+		result.run_status = "runtime error: " + engine.error();
+		result.run_failed = true;
+	} else if (program.main >= 0) {
+		result.run_status = "main() returned " + format_value(engine.result(), program.functions[program.main].return_type) +
+			" in " + std::to_string(elapsed.count()) + " s";
+	} else
+		result.run_status = "ran in " + std::to_string(elapsed.count()) + " s";
+}
+
+static void run_program(TranslationUnit* unit, AstContext& context, const Options& options, FileResult& result) {
+	NameResolver resolver;
+	bool resolved;
+	{
+		TraceScope trace("resolve_names", "backend");
+		resolved = resolver.resolve(*unit);
+	}
+
+	result.warnings = resolver.warnings();
+
+	if (!resolved) {
+		result.diagnostics = resolver.errors();
+		return;
+	}
+
+	{
+		TraceScope trace("check_types", "backend");
+		TypeChecker checker(context);
+		unit = checker.check(*unit, resolver);
+
+		if (!unit) {
+			result.diagnostics = checker.errors();
+			return;
+		}
+
+		result.casts = checker.cast_count();
+		trace.add_arg("casts", checker.cast_count());
+	}
+
+	if (options.fold) {
+		TraceScope trace("fold_constants", "backend");
+		ConstantFolder folder(context);
+		unit = folder.fold(*unit);
+		result.folded_nodes = folder.stats().eliminated_nodes;
+
+		trace.add_arg("eliminated_nodes", folder.stats().eliminated_nodes);
+	}
+
+	BytecodeCompiler compiler;
+	bool compiled;
+	{
+		TraceScope trace("compile_bytecode", "backend");
+		compiled = compiler.compile(*unit, resolver, context.constants());
+	}
+
+	if (!compiled) {
+		result.diagnostics = compiler.diagnostics();
+		return;
+	}
+
+	const BytecodeProgram& program = compiler.program();
+
+	if (options.dump_bytecode)
+		result.bytecode = disassemble(program);
+
+	IrModule module;
+	if ((options.dump_ir || options.jit) && !optimize_ir(*unit, resolver, options, module, result))
+		return;
+
+	if (!options.run)
+		return;
+
+	if (!options.jit) {
+		VirtualMachine vm(program);
+		execute(vm, program, "vm", result);
+		return;
+	}
+
+	Jit jit;
+	bool compiled_to_code;
+	{
+		TraceScope trace("compile_jit", "backend");
+		compiled_to_code = jit.compile(module);
+
+		trace.add_arg("code_bytes", jit.code_size());
+	}
+
+	if (!compiled_to_code) {
+		result.diagnostics.push_back({ {}, "Cannot JIT-compile: " + jit.error() });
+		return;
+	}
+
+	execute(jit, program, "jit", result);
+}
+
+static FileResult compile_file(const std::filesystem::path& input_file, ThreadPool& pool, const AstCache* cache, const Options& options) {
+	FileResult result;
+	TraceScope trace("compile_file", "driver");
+
+	if (trace.active())
+		trace.set_detail(input_file.string());
+
+	SourceBuffer source(input_file);
+	if (!source.is_open()) {
+		result.open_error = source.error();
+		return result;
+	}
+
+	AstContext context;
+
+	TranslationUnit* unit = nullptr;
+	if (cache) {
+		TraceScope trace("cache_load", "cache");
+		unit = cache->load(source, context, result.diagnostics);
+	}
+
+	if (unit)
+		result.cached = true;
+	else {
+		if (source.size() >= PARALLEL_PARSE_THRESHOLD && pool.thread_count() > 1)
+			unit = parse_in_parallel(source, context, pool, options.lexing, options.error_limit, options.nesting_limit, result.diagnostics);
+		else {
+			Lexing lexing = options.lexing;
+			if (lexing == Lexing::PIPELINED && source.size() < PIPELINED_LEXING_THRESHOLD)
+				lexing = Lexing::INLINE;
+
+			Parser parser(source, context, lexing);
+			parser.set_error_limit(options.error_limit);
+			parser.set_nesting_limit(options.nesting_limit);
+			unit = parser.parse();
+			result.diagnostics = parser.diagnostics();
+		}
+
+		if (cache) {
+			TraceScope trace("cache_store", "cache");
+			cache->store(source, *unit, result.diagnostics);
+		}
+	}
+
+	result.opened = true;
+	result.bytes = source.size();
+	result.nodes = context.node_count();
+
+	if ((options.run || options.dump_bytecode || options.dump_ir) && result.diagnostics.empty())
+		run_program(unit, context, options, result);
+
+	trace.add_arg("bytes", result.bytes);
+	trace.add_arg("nodes", result.nodes);
+	trace.add_arg("cached", result.cached);
+
+	return result;
+}
+
+int main(int argc, char** argv) {
+	Options options;
+
+	if (!parse_options(argc, argv, options))
+		return 1;
+
+	if (options.inputs.empty()) {
+		print_usage();
+		return 1;
+	}
+
+	if (!options.trace_file.empty())
+		Trace::start();
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::unique_ptr<AstCache> cache;
+	if (!options.cache_directory.empty()) {
+		cache = std::make_unique<AstCache>(options.cache_directory);
+		cache->set_error_limit(options.error_limit);
+		cache->set_nesting_limit(options.nesting_limit);
+	}
+
+	std::vector<FileResult> results(options.inputs.size());
+	{
+		ThreadPool pool(options.jobs);
+
+		for (size_t i = 0; i < options.inputs.size(); i++)
+			pool.submit([&, i] { results[i] = compile_file(options.inputs[i], pool, cache.get(), options); });
+
+		pool.wait();
+	}
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	// The pool is joined, so no worker is still recording.
+	if (!options.trace_file.empty() && !Trace::write(options.trace_file))
+		std::cerr << "error: cannot write trace file '" << options.trace_file.string() << "'\n";
+
+	// Results are reported in input order no matter which worker finished first.
+	std::string output;
+	size_t failed = 0, cached = 0, bytes = 0, nodes = 0, casts = 0, folded_nodes = 0, ir_instructions = 0, ir_optimized_instructions = 0;
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const FileResult& result = results[i];
+		std::string path = options.inputs[i].string();
+
+		if (!result.opened)
+			output += path + ": error: " + result.open_error + '\n';
+
+		for (const Diagnostic& diagnostic : result.diagnostics)
+			append_diagnostic(output, path, diagnostic, "Error", options.json_diagnostics);
+		for (const Diagnostic& diagnostic : result.warnings)
+			append_diagnostic(output, path, diagnostic, "Warning", options.json_diagnostics);
+
+		output += result.bytecode;
+		output += result.ir;
+		if (!result.run_status.empty())
+			output += path + ": " + result.run_status + '\n';
+
+		failed += !result.opened || !result.diagnostics.empty() || result.run_failed;
+		cached += result.cached;
+		bytes += result.bytes;
+		nodes += result.nodes;
+		casts += result.casts;
+		folded_nodes += result.folded_nodes;
+		ir_instructions += result.ir_instructions;
+		ir_optimized_instructions += result.ir_optimized_instructions;
+	}
+
+	std::cout << output;
+
+	if (options.stats) {
+		double seconds = std::max(elapsed.count(), 1e-9);
+
+		std::cerr << results.size() << " files (" << failed << " with errors, " << cached << " from cache), "
+			<< bytes / 1e6 << " MB, " << nodes << " AST nodes in " << seconds << " s: "
+			<< results.size() / seconds << " files/s, " << bytes / 1e6 / seconds << " MB/s, "
+			<< nodes / seconds << " nodes/s on " << options.jobs << " threads\n";
 
-	test_parser(input_file);
+		if (options.run || options.dump_bytecode || options.dump_ir)
+			std::cerr << "type checking inserted " << casts << " casts\n";
+		if ((options.run || options.dump_bytecode || options.dump_ir) && options.fold)
+			std::cerr << "constant folding removed " << folded_nodes << " AST nodes\n";
+		if (options.dump_ir || options.jit)
+			std::cerr << "IR passes took " << ir_instructions << " instructions to " << ir_optimized_instructions << '\n';
+	}
 
-	std::cin.get();
+	return failed ? 1 : 0;
 }
\ No newline at end of file
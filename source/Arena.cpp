@@ -0,0 +1,25 @@
+#include "Arena.h"
+
+#include <algorithm>
+
+void* Arena::allocate_slow(size_t size, size_t alignment) {
+	size_t block_size = std::max(m_block_size, size + alignment);
+
+	m_blocks.emplace_back(new char[block_size]);
+	m_cursor = m_blocks.back().get();
+	m_limit = m_cursor + block_size;
+	m_reserved += block_size;
+
+	if (m_block_size < 16 * 1024 * 1024)
+		m_block_size *= 2;
+
+	return allocate(size, alignment);
+}
+
+size_t Arena::bytes_allocated() const {
+	return m_allocated;
+}
+
+size_t Arena::bytes_reserved() const {
+	return m_reserved;
+}
\ No newline at end of file
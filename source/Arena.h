@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Bump allocator. Memory is only released all at once, when the arena dies.
+class Arena {
+public:
+	Arena() = default;
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* allocate(size_t size, size_t alignment);
+
+	size_t bytes_allocated() const;
+	size_t bytes_reserved() const;
+
+private:
+	void* allocate_slow(size_t size, size_t alignment);
+
+private:
+	std::vector<std::unique_ptr<char[]>> m_blocks;
+	char* m_cursor = nullptr;
+	char* m_limit = nullptr;
+	size_t m_block_size = 64 * 1024;
+	size_t m_allocated = 0;
+	size_t m_reserved = 0;
+};
+
+inline void* Arena::allocate(size_t size, size_t alignment) {
+	char* p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(m_cursor) + alignment - 1) & ~(alignment - 1));
+
+	if (!m_cursor || p + size > m_limit)
+		return allocate_slow(size, alignment);
+
+	m_cursor = p + size;
+	m_allocated += size;
+
+	return p;
+}
\ No newline at end of file
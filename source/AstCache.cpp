@@ -0,0 +1,301 @@
+#include "AstCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <random>
+
+// Bump FORMAT_VERSION whenever the layout below or FlatAst's changes. Entries
+// are also keyed by the compiler build, so that a changed parser never picks
+// up trees that an older one produced.
+static constexpr char MAGIC[8] = { 'T', 'O', 'Y', 'C', 'A', 'S', 'T', '\0' };
+static constexpr uint32_t FORMAT_VERSION = 1;
+static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+static constexpr std::string_view COMPILER_VERSION = "toyc " __DATE__ " " __TIME__;
+
+// Followed by kinds, tags, lhs, rhs, extra, name offsets, names and the
+// diagnostics, each section padded to 4 bytes.
+struct EntryHeader {
+	char magic[8];
+	uint32_t format_version;
+	uint32_t byte_order;
+	uint64_t key_name;
+	uint64_t key_check;
+	uint64_t source_size;
+	uint64_t payload_hash;
+	uint32_t node_count;
+	uint32_t extra_count;
+	uint32_t name_offset_count;
+	uint32_t names_size;
+	uint32_t top_level_first;
+	uint32_t top_level_count;
+	uint32_t diagnostic_count;
+	uint32_t reserved;
+};
+
+struct DiagnosticHeader {
+	int32_t line;
+	int32_t column;
+	uint32_t length;
+};
+
+static uint64_t rotate_left(uint64_t value, int count) {
+	return (value << count) | (value >> (64 - count));
+}
+
+static uint64_t mix(uint64_t value) {
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+
+	return value;
+}
+
+// Two independent 64-bit lanes in one pass over the data, 8 bytes at a time.
+static void hash_bytes(const char* data, size_t size, uint64_t seed, uint64_t& first, uint64_t& second) {
+	uint64_t a = seed ^ 0x9e3779b97f4a7c15ull;
+	uint64_t b = seed ^ 0xc2b2ae3d27d4eb4full;
+
+	for (size_t i = 0; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, 8);
+
+		a = rotate_left(a ^ (word * 0x87c37b91114253d5ull), 31) * 0x4cf5ad432745937full;
+		b = rotate_left(b ^ (word * 0x52dce729da3ed7b5ull), 29) * 0x38495ab5ull;
+	}
+
+	uint64_t tail = 0;
+	std::memcpy(&tail, data + (size & ~size_t(7)), size & 7);
+
+	first = mix(a ^ tail ^ size);
+	second = mix(b ^ rotate_left(tail, 17) ^ (size * 0x9e3779b97f4a7c15ull));
+}
+
+static uint64_t hash_bytes(const char* data, size_t size) {
+	uint64_t first, second;
+	hash_bytes(data, size, 0, first, second);
+
+	return first ^ second;
+}
+
+static void append(std::string& buffer, const void* data, size_t size) {
+	buffer.append(static_cast<const char*>(data), size);
+}
+
+static void pad(std::string& buffer) {
+	buffer.resize((buffer.size() + 3) & ~size_t(3));
+}
+
+// Bounds-checked cursor over a mapped entry.
+class EntryReader {
+public:
+	EntryReader(const char* begin, const char* end)
+		: m_cursor(begin), m_end(end) {}
+
+	template<typename Container>
+	bool read(Container& values, size_t count) {
+		size_t size = count * sizeof(typename Container::value_type);
+		if (size > static_cast<size_t>(m_end - m_cursor))
+			return false;
+
+		values.resize(count);
+		std::memcpy(values.data(), m_cursor, size);
+		m_cursor += size;
+
+		return true;
+	}
+
+	bool read(void* data, size_t size) {
+		if (size > static_cast<size_t>(m_end - m_cursor))
+			return false;
+
+		std::memcpy(data, m_cursor, size);
+		m_cursor += size;
+
+		return true;
+	}
+
+	void skip_padding(const char* begin) {
+		m_cursor += (4 - (m_cursor - begin) % 4) % 4;
+	}
+
+	bool at_end() const {
+		return m_cursor == m_end;
+	}
+
+private:
+	const char* m_cursor;
+	const char* m_end;
+};
+
+AstCache::AstCache(std::filesystem::path directory)
+	: m_directory(std::move(directory)) {}
+
+const std::filesystem::path& AstCache::directory() const {
+	return m_directory;
+}
+
+void AstCache::set_error_limit(size_t error_limit) {
+	m_error_limit = error_limit;
+}
+
+void AstCache::set_nesting_limit(size_t nesting_limit) {
+	m_nesting_limit = nesting_limit;
+}
+
+AstCache::Key AstCache::make_key(const SourceBuffer& source) const {
+	uint64_t seed = hash_bytes(COMPILER_VERSION.data(), COMPILER_VERSION.size());
+	seed = mix(seed ^ m_error_limit);
+	seed = mix(seed ^ m_nesting_limit);
+
+	Key key;
+	hash_bytes(source.begin(), source.size(), seed, key.name, key.check);
+
+	return key;
+}
+
+std::filesystem::path AstCache::entry_path(Key key) const {
+	static constexpr char digits[] = "0123456789abcdef";
+
+	std::string name(16, '0');
+	for (int i = 0; i < 16; i++)
+		name[i] = digits[(key.name >> (60 - 4 * i)) & 15];
+
+	return m_directory / (name + ".ast");
+}
+
+TranslationUnit* AstCache::load(const SourceBuffer& source, AstContext& context, std::vector<Diagnostic>& diagnostics) const {
+	Key key = make_key(source);
+
+	std::error_code ec;
+	std::filesystem::path path = entry_path(key);
+	if (!std::filesystem::is_regular_file(path, ec))
+		return nullptr;
+
+	SourceBuffer entry(path);
+	if (!entry.is_open())
+		return nullptr;
+
+	EntryHeader header;
+	EntryReader reader(entry.begin(), entry.end());
+
+	if (!reader.read(&header, sizeof(header)) ||
+		std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+		header.format_version != FORMAT_VERSION ||
+		header.byte_order != BYTE_ORDER_MARK ||
+		header.key_name != key.name ||
+		header.key_check != key.check ||
+		header.source_size != source.size() ||
+		header.payload_hash != hash_bytes(entry.begin() + sizeof(header), entry.size() - sizeof(header)))
+		return nullptr;
+
+	FlatAst ast;
+	bool ok = reader.read(ast.m_kinds, header.node_count) &&
+		reader.read(ast.m_tags, header.node_count);
+
+	reader.skip_padding(entry.begin());
+
+	ok = ok && reader.read(ast.m_lhs, header.node_count) &&
+		reader.read(ast.m_rhs, header.node_count) &&
+		reader.read(ast.m_extra, header.extra_count) &&
+		reader.read(ast.m_name_offsets, header.name_offset_count);
+
+	ok = ok && header.name_offset_count != 0 && reader.read(ast.m_names, header.names_size);
+	if (!ok)
+		return nullptr;
+
+	ast.m_top_level_first = header.top_level_first;
+	ast.m_top_level_count = header.top_level_count;
+	reader.skip_padding(entry.begin());
+
+	std::vector<Diagnostic> cached_diagnostics(header.diagnostic_count);
+	for (Diagnostic& diagnostic : cached_diagnostics) {
+		DiagnosticHeader diagnostic_header;
+		if (!reader.read(&diagnostic_header, sizeof(diagnostic_header)))
+			return nullptr;
+
+		diagnostic.pos = { diagnostic_header.line, diagnostic_header.column };
+		diagnostic.message.resize(diagnostic_header.length);
+		if (!reader.read(diagnostic.message.data(), diagnostic_header.length))
+			return nullptr;
+
+		reader.skip_padding(entry.begin());
+	}
+
+	if (!reader.at_end())
+		return nullptr;
+
+	diagnostics = std::move(cached_diagnostics);
+
+	return unflatten(ast, context);
+}
+
+bool AstCache::store(const SourceBuffer& source, const TranslationUnit& unit, const std::vector<Diagnostic>& diagnostics) const {
+	Key key = make_key(source);
+	FlatAst ast = flatten(unit);
+
+	EntryHeader header = {};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.format_version = FORMAT_VERSION;
+	header.byte_order = BYTE_ORDER_MARK;
+	header.key_name = key.name;
+	header.key_check = key.check;
+	header.source_size = source.size();
+	header.node_count = ast.size();
+	header.extra_count = static_cast<uint32_t>(ast.m_extra.size());
+	header.name_offset_count = static_cast<uint32_t>(ast.m_name_offsets.size());
+	header.names_size = static_cast<uint32_t>(ast.m_names.size());
+	header.top_level_first = ast.m_top_level_first;
+	header.top_level_count = ast.m_top_level_count;
+	header.diagnostic_count = static_cast<uint32_t>(diagnostics.size());
+
+	std::string buffer(sizeof(header), '\0');
+
+	append(buffer, ast.m_kinds.data(), ast.m_kinds.size());
+	append(buffer, ast.m_tags.data(), ast.m_tags.size());
+	pad(buffer);
+	append(buffer, ast.m_lhs.data(), ast.m_lhs.size() * sizeof(uint32_t));
+	append(buffer, ast.m_rhs.data(), ast.m_rhs.size() * sizeof(uint32_t));
+	append(buffer, ast.m_extra.data(), ast.m_extra.size() * sizeof(uint32_t));
+	append(buffer, ast.m_name_offsets.data(), ast.m_name_offsets.size() * sizeof(uint32_t));
+	append(buffer, ast.m_names.data(), ast.m_names.size());
+	pad(buffer);
+
+	for (const Diagnostic& diagnostic : diagnostics) {
+		DiagnosticHeader diagnostic_header = { diagnostic.pos.line, diagnostic.pos.column, static_cast<uint32_t>(diagnostic.message.size()) };
+		append(buffer, &diagnostic_header, sizeof(diagnostic_header));
+		append(buffer, diagnostic.message.data(), diagnostic.message.size());
+		pad(buffer);
+	}
+
+	header.payload_hash = hash_bytes(buffer.data() + sizeof(header), buffer.size() - sizeof(header));
+	std::memcpy(buffer.data(), &header, sizeof(header));
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_directory, ec);
+
+	// Several workers, or compilers, may store the same entry at once. Each
+	// writes a file of its own and renames it into place, so readers only
+	// ever see complete entries.
+	std::filesystem::path path = entry_path(key);
+	std::filesystem::path temporary = path;
+	temporary += "." + std::to_string(std::random_device()()) + ".tmp";
+
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		if (!file.write(buffer.data(), buffer.size()) || !file.flush()) {
+			file.close();
+			std::filesystem::remove(temporary, ec);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temporary, path, ec);
+	if (ec) {
+		std::filesystem::remove(temporary, ec);
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
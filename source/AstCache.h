@@ -0,0 +1,42 @@
+#pragma once
+
+#include "FlatAst.h"
+#include "Parser.h"
+
+#include <filesystem>
+
+// Parse results on disk, one file per source text, named after a hash of the
+// text, the compiler version and the parser's settings. An entry holds the FlatAst arrays and the
+// diagnostics as they are in memory, so loading one maps the file and rebuilds
+// the tree without touching the Tokenizer or Parser.
+class AstCache {
+public:
+	AstCache(std::filesystem::path directory);
+
+	TranslationUnit* load(const SourceBuffer& source, AstContext& context, std::vector<Diagnostic>& diagnostics) const;
+	bool store(const SourceBuffer& source, const TranslationUnit& unit, const std::vector<Diagnostic>& diagnostics) const;
+
+	const std::filesystem::path& directory() const;
+
+	// The limits of the parses stored and loaded, which an entry is keyed by:
+	// a parse stopped at the error limit has lost diagnostics, and a tree
+	// stored without a nesting limit must not reach passes that recurse.
+	// DiagnosticEngine::DEFAULT_ERROR_LIMIT and Parser::DEFAULT_NESTING_LIMIT
+	// unless set.
+	void set_error_limit(size_t error_limit);
+	void set_nesting_limit(size_t nesting_limit);
+
+private:
+	struct Key {
+		uint64_t name;
+		uint64_t check;
+	};
+
+	Key make_key(const SourceBuffer& source) const;
+	std::filesystem::path entry_path(Key key) const;
+
+private:
+	std::filesystem::path m_directory;
+	size_t m_error_limit = DiagnosticEngine::DEFAULT_ERROR_LIMIT;
+	size_t m_nesting_limit = Parser::DEFAULT_NESTING_LIMIT;
+};
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "AstContext.h"
+
+IntLiteral* AstContext::int_literal(int32_t value) {
+	uint32_t constant = m_constants.intern_int(value);
+	Literal*& literal = literal_node(constant);
+	if (!literal)
+		literal = create<IntLiteral>(value, constant);
+
+	return static_cast<IntLiteral*>(literal);
+}
+
+FloatLiteral* AstContext::float_literal(float value) {
+	uint32_t constant = m_constants.intern_float(value);
+	Literal*& literal = literal_node(constant);
+	if (!literal)
+		literal = create<FloatLiteral>(value, constant);
+
+	return static_cast<FloatLiteral*>(literal);
+}
+
+Literal*& AstContext::literal_node(uint32_t constant) {
+	if (constant >= m_literals.size())
+		m_literals.resize(m_constants.size());
+
+	return m_literals[constant];
+}
+
+const ConstantPool& AstContext::constants() const {
+	return m_constants;
+}
+
+void AstContext::adopt(std::unique_ptr<AstContext> context) {
+	intern_constants(*context);
+
+	// Adopted literals serve as the nodes of constants that have none here yet.
+	for (Literal* adopted : context->m_literals) {
+		uint32_t constant = adopted->kind() == NodeKind::INT_LITERAL ? static_cast<IntLiteral*>(adopted)->constant() :
+			static_cast<FloatLiteral*>(adopted)->constant();
+
+		Literal*& literal = literal_node(constant);
+		if (!literal)
+			literal = adopted;
+	}
+
+	m_node_count += context->m_node_count;
+	m_adopted.push_back(std::move(context));
+}
+
+void AstContext::intern_constants(AstContext& context) {
+	// The constants join this pool, under indices of its own, which the
+	// literals are renumbered to.
+	const ConstantPool& constants = context.m_constants;
+	for (uint32_t i = 0; i < constants.size(); i++) {
+		uint32_t constant = m_constants.intern(constants.type(i), constants.bits(i));
+		Literal* literal = context.m_literals[i];
+
+		if (literal->kind() == NodeKind::INT_LITERAL)
+			static_cast<IntLiteral*>(literal)->set_constant(constant);
+		else
+			static_cast<FloatLiteral*>(literal)->set_constant(constant);
+	}
+}
+
+size_t AstContext::node_count() const {
+	return m_node_count;
+}
+
+const Arena& AstContext::arena() const {
+	return m_arena;
+}
\ No newline at end of file
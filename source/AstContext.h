@@ -0,0 +1,89 @@
+#pragma once
+
+#include "AST.h"
+#include "Arena.h"
+#include "ConstantPool.h"
+
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Owns every node, list and identifier of one tree. Dropping the context frees
+// the whole tree at once, without walking it.
+class AstContext {
+public:
+	AstContext() = default;
+
+	AstContext(const AstContext&) = delete;
+	AstContext& operator=(const AstContext&) = delete;
+
+	template<typename T, typename... Args>
+	T* create(Args&&... args);
+
+	template<typename T>
+	AstList<T> make_list(const T* data, size_t size);
+
+	std::string_view make_string(std::string_view str);
+
+	// The node of an int or float value, one for all its occurrences, with the
+	// value interned into constants().
+	IntLiteral* int_literal(int32_t value);
+	FloatLiteral* float_literal(float value);
+
+	// The constants of the tree, those of adopted contexts included.
+	const ConstantPool& constants() const;
+
+	// Keeps another context's nodes alive for as long as this one, so that trees
+	// built separately (e.g. on other threads) can be linked into this one.
+	void adopt(std::unique_ptr<AstContext> context);
+	// Only adds another context's constants to this one's and renumbers its
+	// literals to them; the context stays with its owner, which has to keep it
+	// alive while they are in use.
+	void intern_constants(AstContext& context);
+
+	size_t node_count() const;
+	const Arena& arena() const;
+
+private:
+	Literal*& literal_node(uint32_t constant);
+
+private:
+	Arena m_arena;
+	size_t m_node_count = 0;
+	ConstantPool m_constants;
+	// The node of each constant, by index.
+	std::vector<Literal*> m_literals;
+	std::vector<std::unique_ptr<AstContext>> m_adopted;
+};
+
+template<typename T, typename... Args>
+T* AstContext::create(Args&&... args) {
+	static_assert(std::is_trivially_destructible_v<T>, "AST nodes are never destroyed");
+
+	m_node_count++;
+
+	return new (m_arena.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+template<typename T>
+AstList<T> AstContext::make_list(const T* data, size_t size) {
+	static_assert(std::is_trivially_copyable_v<T>, "AST lists are copied bytewise");
+
+	if (size == 0)
+		return {};
+
+	T* list = static_cast<T*>(m_arena.allocate(sizeof(T) * size, alignof(T)));
+	std::memcpy(list, data, sizeof(T) * size);
+
+	return { list, static_cast<uint32_t>(size) };
+}
+
+inline std::string_view AstContext::make_string(std::string_view str) {
+	char* copy = static_cast<char*>(m_arena.allocate(str.size(), 1));
+	std::memcpy(copy, str.data(), str.size());
+
+	return { copy, str.size() };
+}
\ No newline at end of file
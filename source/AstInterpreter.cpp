@@ -0,0 +1,487 @@
+#include "AstInterpreter.h"
+
+#include <algorithm>
+
+// int arithmetic wraps around instead of being undefined.
+static int32_t wrap(uint32_t value) {
+	return static_cast<int32_t>(value);
+}
+
+// Number of local slots a function body uses, not counting the bodies of
+// the functions declared in it.
+static uint32_t frame_size(const Statement* stmt) {
+	if (!stmt)
+		return 0;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT: {
+		uint32_t size = 0;
+		for (const Statement* child : static_cast<const CompoundStatement*>(stmt)->statements())
+			size = std::max(size, frame_size(child));
+		return size;
+	}
+	case NodeKind::VARIABLE_DECLARATION: {
+		const Binding& binding = static_cast<const VariableDeclaration*>(stmt)->binding();
+		return binding.kind == BindingKind::LOCAL ? binding.slot + 1 : 0;
+	}
+	case NodeKind::IF_STATEMENT:
+		return frame_size(static_cast<const IfStatement*>(stmt)->statement());
+	case NodeKind::FOR_STATEMENT: {
+		auto& for_stmt = *static_cast<const ForStatement*>(stmt);
+		return std::max(frame_size(for_stmt.variable_declaration()), frame_size(for_stmt.statement()));
+	}
+	case NodeKind::WHILE_STATEMENT:
+		return frame_size(static_cast<const WhileStatement*>(stmt)->statement());
+	default:
+		return 0;
+	}
+}
+
+AstInterpreter::AstInterpreter(const TranslationUnit& unit, const NameResolver& resolver)
+	: m_unit(unit), m_functions(resolver.functions().size()), m_frame_sizes(resolver.functions().size()), m_globals(resolver.global_count()) {
+	for (const Statement* stmt : unit.statements())
+		find_functions(stmt);
+
+	for (const Statement* stmt : unit.statements()) {
+		if (stmt && stmt->kind() != NodeKind::FUNCTION_DECLARATION)
+			m_frame_sizes[0] = std::max(m_frame_sizes[0], frame_size(stmt));
+	}
+
+	for (size_t i = 1; i < m_functions.size(); i++)
+		m_frame_sizes[i] = std::max(m_functions[i]->parameters().size(), frame_size(m_functions[i]->statement()));
+}
+
+// Functions can be declared in any body, so the whole tree is searched.
+void AstInterpreter::find_functions(const Statement* stmt) {
+	if (!stmt)
+		return;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT:
+		for (const Statement* child : static_cast<const CompoundStatement*>(stmt)->statements())
+			find_functions(child);
+		break;
+	case NodeKind::FUNCTION_DECLARATION: {
+		auto declaration = static_cast<const FunctionDeclaration*>(stmt);
+		m_functions[declaration->index()] = declaration;
+		find_functions(declaration->statement());
+		break;
+	}
+	case NodeKind::IF_STATEMENT:
+		find_functions(static_cast<const IfStatement*>(stmt)->statement());
+		break;
+	case NodeKind::FOR_STATEMENT:
+		find_functions(static_cast<const ForStatement*>(stmt)->statement());
+		break;
+	case NodeKind::WHILE_STATEMENT:
+		find_functions(static_cast<const WhileStatement*>(stmt)->statement());
+		break;
+	default:
+		break;
+	}
+}
+
+bool AstInterpreter::run() {
+	std::fill(m_globals.begin(), m_globals.end(), Value{});
+	m_result = {};
+
+	Value ignored;
+	if (!invoke(0, nullptr, ignored))
+		return false;
+
+	for (const Statement* stmt : m_unit.statements()) {
+		if (!stmt || stmt->kind() != NodeKind::FUNCTION_DECLARATION)
+			continue;
+
+		auto& declaration = *static_cast<const FunctionDeclaration*>(stmt);
+		if (declaration.id() == "main" && declaration.parameters().empty())
+			return invoke(declaration.index(), nullptr, m_result);
+	}
+
+	return true;
+}
+
+bool AstInterpreter::call(uint32_t function, const std::vector<Value>& arguments, Value& result) {
+	if (function > 0 && arguments.size() != m_functions[function]->parameters().size()) {
+		m_error = "wrong number of arguments for function '" + std::string(m_functions[function]->id()) + '\'';
+		return false;
+	}
+
+	std::vector<Value> copy = arguments;
+
+	return invoke(function, copy.data(), result);
+}
+
+Value AstInterpreter::result() const {
+	return m_result;
+}
+
+const std::string& AstInterpreter::error() const {
+	return m_error;
+}
+
+// Function 0 runs the top-level statements, the others their body.
+bool AstInterpreter::invoke(uint32_t function, Value* arguments, Value& result) {
+	m_error.clear();
+	m_failed = false;
+	m_depth = 0;
+	m_function = function;
+
+	std::vector<Value> locals(m_frame_sizes[function]);
+	m_locals = locals.data();
+	m_return = {};
+
+	if (function == 0) {
+		for (const Statement* stmt : m_unit.statements()) {
+			if (execute(stmt) == Flow::FAILED)
+				return false;
+		}
+
+		return true;
+	}
+
+	const FunctionDeclaration& declaration = *m_functions[function];
+	std::copy(arguments, arguments + declaration.parameters().size(), m_locals);
+
+	if (declaration.statement() && execute(declaration.statement()) == Flow::FAILED)
+		return false;
+
+	result = m_return;
+
+	return true;
+}
+
+void AstInterpreter::runtime_error(const char* message) {
+	if (m_failed)
+		return;
+
+	std::string function = m_function ? std::string(m_functions[m_function]->id()) : "<top-level>";
+
+	m_error = std::string(message) + " in function '" + function + '\'';
+	m_failed = true;
+}
+
+AstInterpreter::Flow AstInterpreter::execute(const Statement* stmt) {
+	if (!stmt)
+		return Flow::NEXT;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT:
+		for (const Statement* child : static_cast<const CompoundStatement*>(stmt)->statements()) {
+			Flow flow = execute(child);
+			if (flow != Flow::NEXT)
+				return flow;
+		}
+		return Flow::NEXT;
+	case NodeKind::VARIABLE_DECLARATION:
+		return execute_variable_declaration(*static_cast<const VariableDeclaration*>(stmt));
+	case NodeKind::FUNCTION_DECLARATION:
+		return Flow::NEXT;
+	case NodeKind::IF_STATEMENT: {
+		auto& if_stmt = *static_cast<const IfStatement*>(stmt);
+
+		if (condition(if_stmt.condition()))
+			return execute(if_stmt.statement());
+		return m_failed ? Flow::FAILED : Flow::NEXT;
+	}
+	case NodeKind::FOR_STATEMENT: {
+		auto& for_stmt = *static_cast<const ForStatement*>(stmt);
+
+		if (for_stmt.variable_declaration() && execute_variable_declaration(*for_stmt.variable_declaration()) != Flow::NEXT)
+			return Flow::FAILED;
+
+		while (!for_stmt.condition_expr() || condition(for_stmt.condition_expr())) {
+			Flow flow = execute(for_stmt.statement());
+			if (flow != Flow::NEXT)
+				return flow;
+
+			if (for_stmt.loop_expr())
+				evaluate(for_stmt.loop_expr());
+			if (m_failed)
+				return Flow::FAILED;
+		}
+		return m_failed ? Flow::FAILED : Flow::NEXT;
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		auto& while_stmt = *static_cast<const WhileStatement*>(stmt);
+
+		while (condition(while_stmt.condition_expr())) {
+			Flow flow = execute(while_stmt.statement());
+			if (flow != Flow::NEXT)
+				return flow;
+		}
+		return m_failed ? Flow::FAILED : Flow::NEXT;
+	}
+	case NodeKind::RETURN_STATEMENT: {
+		const Expression* value = static_cast<const ReturnStatement*>(stmt)->return_expr();
+
+		if (value)
+			m_return = evaluate(value);
+		return m_failed ? Flow::FAILED : Flow::RETURN;
+	}
+	default:
+		evaluate(static_cast<const Expression*>(stmt));
+		return m_failed ? Flow::FAILED : Flow::NEXT;
+	}
+}
+
+AstInterpreter::Flow AstInterpreter::execute_variable_declaration(const VariableDeclaration& declaration) {
+	Value value{};
+
+	// Globals start out as zero.
+	if (declaration.binding().kind == BindingKind::GLOBAL && !declaration.initial_value())
+		return Flow::NEXT;
+
+	if (declaration.initial_value())
+		value = evaluate(declaration.initial_value());
+
+	store(declaration.binding(), value);
+
+	return m_failed ? Flow::FAILED : Flow::NEXT;
+}
+
+Value AstInterpreter::evaluate(const Expression* expr) {
+	switch (expr->kind()) {
+	case NodeKind::INT_LITERAL: {
+		Value value;
+		value.i = static_cast<const IntLiteral*>(expr)->integer();
+		return value;
+	}
+	case NodeKind::FLOAT_LITERAL: {
+		Value value;
+		value.f = static_cast<const FloatLiteral*>(expr)->floating();
+		return value;
+	}
+	case NodeKind::BOOL_LITERAL: {
+		Value value;
+		value.i = static_cast<const BoolLiteral*>(expr)->boolean();
+		return value;
+	}
+	case NodeKind::ID_ATOM: {
+		const Binding& binding = static_cast<const IdAtom*>(expr)->binding();
+		return binding.kind == BindingKind::LOCAL ? m_locals[binding.slot] : m_globals[binding.slot];
+	}
+	case NodeKind::FUNC_CALL_ATOM:
+		return evaluate_call(*static_cast<const FuncCallAtom*>(expr));
+	case NodeKind::UNARY_EXPRESSION:
+		return evaluate_unary(*static_cast<const UnaryExpression*>(expr));
+	default:
+		break;
+	}
+
+	auto binary = static_cast<const BinaryExpression*>(expr);
+	if (binary->op() == BinaryOp::ASSIGN) {
+		const Binding& binding = static_cast<const IdAtom*>(binary->left())->binding();
+		Value value = evaluate(binary->right());
+
+		store(binding, value);
+		return value;
+	}
+
+	// Left to right down a chain of left operands, see push_left_chain().
+	size_t base = m_chain.size();
+	Value left = evaluate(push_left_chain(binary, m_chain));
+
+	while (m_chain.size() > base) {
+		binary = m_chain.back();
+		m_chain.pop_back();
+		left = evaluate_binary(*binary, left);
+	}
+
+	return left;
+}
+
+// a is the value of the left operand.
+Value AstInterpreter::evaluate_binary(const BinaryExpression& expr, Value a) {
+	switch (expr.op()) {
+	case BinaryOp::COMA:
+		return evaluate(expr.right());
+	case BinaryOp::LOGICAL_OR:
+	case BinaryOp::LOGICAL_AND: {
+		bool is_and = expr.op() == BinaryOp::LOGICAL_AND;
+		Value value;
+
+		value.i = a.i != 0;
+		if (value.i != is_and)
+			return value;
+
+		value.i = condition(expr.right());
+		return value;
+	}
+	default:
+		break;
+	}
+
+	// TypeChecker gave both operands the type the operator works on.
+	Value b = evaluate(expr.right());
+	Value value;
+
+	if (expr.left()->type() == Type::FLOAT) {
+		switch (expr.op()) {
+		case BinaryOp::PLUS:
+			value.f = a.f + b.f;
+			return value;
+		case BinaryOp::MINUS:
+			value.f = a.f - b.f;
+			return value;
+		case BinaryOp::MULTIPLY:
+			value.f = a.f * b.f;
+			return value;
+		case BinaryOp::DIVIDE:
+			value.f = a.f / b.f;
+			return value;
+		case BinaryOp::LOGICAL_EQUAL:
+			value.i = a.f == b.f;
+			break;
+		case BinaryOp::LOGICAL_NOT_EQUAL:
+			value.i = a.f != b.f;
+			break;
+		case BinaryOp::LESS:
+			value.i = a.f < b.f;
+			break;
+		case BinaryOp::GREATER:
+			value.i = a.f > b.f;
+			break;
+		case BinaryOp::LESS_EQUAL:
+			value.i = a.f <= b.f;
+			break;
+		default:
+			value.i = a.f >= b.f;
+			break;
+		}
+
+		return value;
+	}
+
+	switch (expr.op()) {
+	case BinaryOp::PLUS:
+		value.i = wrap(static_cast<uint32_t>(a.i) + static_cast<uint32_t>(b.i));
+		return value;
+	case BinaryOp::MINUS:
+		value.i = wrap(static_cast<uint32_t>(a.i) - static_cast<uint32_t>(b.i));
+		return value;
+	case BinaryOp::MULTIPLY:
+		value.i = wrap(static_cast<uint32_t>(a.i) * static_cast<uint32_t>(b.i));
+		return value;
+	case BinaryOp::DIVIDE:
+		if (b.i == 0) {
+			runtime_error("division by zero");
+			return Value{};
+		}
+
+		// INT_MIN / -1 overflows like the other operators.
+		value.i = b.i == -1 ? wrap(0u - static_cast<uint32_t>(a.i)) : a.i / b.i;
+		return value;
+	case BinaryOp::LOGICAL_EQUAL:
+		value.i = a.i == b.i;
+		break;
+	case BinaryOp::LOGICAL_NOT_EQUAL:
+		value.i = a.i != b.i;
+		break;
+	case BinaryOp::LESS:
+		value.i = a.i < b.i;
+		break;
+	case BinaryOp::GREATER:
+		value.i = a.i > b.i;
+		break;
+	case BinaryOp::LESS_EQUAL:
+		value.i = a.i <= b.i;
+		break;
+	default:
+		value.i = a.i >= b.i;
+		break;
+	}
+
+	return value;
+}
+
+Value AstInterpreter::evaluate_unary(const UnaryExpression& expr) {
+	if (expr.op() == UnaryOp::CAST)
+		return convert(evaluate(expr.expr()), expr.expr()->type(), expr.type());
+
+	const Binding& binding = static_cast<const IdAtom*>(expr.expr())->binding();
+	Value value = binding.kind == BindingKind::LOCAL ? m_locals[binding.slot] : m_globals[binding.slot];
+	int32_t step = expr.op() == UnaryOp::PRE_INCREMENT ? 1 : -1;
+
+	if (binding.type == Type::FLOAT)
+		value.f += static_cast<float>(step);
+	else
+		value.i = wrap(static_cast<uint32_t>(value.i) + static_cast<uint32_t>(step));
+
+	store(binding, value);
+
+	return value;
+}
+
+Value AstInterpreter::evaluate_call(const FuncCallAtom& call) {
+	uint32_t index = call.binding().slot;
+	const FunctionDeclaration& declaration = *m_functions[index];
+
+	// The callee's locals, starting with the arguments.
+	std::vector<Value> locals(m_frame_sizes[index]);
+	for (uint32_t i = 0; i < call.arguments().size(); i++)
+		locals[i] = evaluate(call.arguments()[i]);
+
+	if (m_failed)
+		return Value{};
+
+	if (m_depth == MAX_CALL_DEPTH) {
+		runtime_error("stack overflow");
+		return Value{};
+	}
+
+	uint32_t caller = m_function;
+	Value* caller_locals = m_locals;
+
+	m_function = index;
+	m_locals = locals.data();
+	m_return = {};
+	m_depth++;
+
+	if (declaration.statement())
+		execute(declaration.statement());
+
+	Value value = m_return;
+
+	m_depth--;
+	m_function = caller;
+	m_locals = caller_locals;
+	m_return = {};
+
+	return value;
+}
+
+bool AstInterpreter::condition(const Expression* expr) {
+	return evaluate(expr).i != 0;
+}
+
+void AstInterpreter::store(const Binding& binding, Value value) {
+	if (binding.kind == BindingKind::LOCAL)
+		m_locals[binding.slot] = value;
+	else
+		m_globals[binding.slot] = value;
+}
+
+// Conversions as in C.
+Value AstInterpreter::convert(Value value, Type from, Type to) {
+	Value result = value;
+
+	switch (to) {
+	case Type::INT:
+		// A bool already is 0 or 1.
+		if (from == Type::FLOAT)
+			result.i = float_to_int(value.f);
+		break;
+	case Type::FLOAT:
+		if (from != Type::FLOAT)
+			result.f = static_cast<float>(value.i);
+		break;
+	case Type::BOOL:
+		result.i = from == Type::FLOAT ? value.f != 0 : value.i != 0;
+		break;
+	default:
+		break;
+	}
+
+	return result;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Bytecode.h"
+#include "NameResolver.h"
+
+#include <string>
+#include <vector>
+
+// Runs a TranslationUnit by walking the tree, as a baseline for the VM and
+// the JIT. The unit has to be resolved and typed without errors, and it
+// computes what they do: the same casts, wrapping int arithmetic and runtime
+// errors.
+class AstInterpreter {
+public:
+	static constexpr uint32_t MAX_CALL_DEPTH = 4096;
+
+	AstInterpreter(const TranslationUnit& unit, const NameResolver& resolver);
+
+	// Runs the top-level statements, then main() if there is one. Returns
+	// false on a runtime error, described by error().
+	bool run();
+
+	// Calls a function with arguments of its parameter types.
+	bool call(uint32_t function, const std::vector<Value>& arguments, Value& result);
+
+	// What main() returned, zero without a main().
+	Value result() const;
+	const std::string& error() const;
+
+private:
+	// What a statement did: carry on, return from the function or stop on a
+	// runtime error.
+	enum class Flow {
+		NEXT,
+		RETURN,
+		FAILED
+	};
+
+	bool invoke(uint32_t function, Value* arguments, Value& result);
+	void runtime_error(const char* message);
+
+	Flow execute(const Statement* stmt);
+	Flow execute_variable_declaration(const VariableDeclaration& declaration);
+
+	Value evaluate(const Expression* expr);
+	Value evaluate_binary(const BinaryExpression& expr, Value a);
+	Value evaluate_unary(const UnaryExpression& expr);
+	Value evaluate_call(const FuncCallAtom& call);
+	bool condition(const Expression* expr);
+
+	void find_functions(const Statement* stmt);
+	void store(const Binding& binding, Value value);
+	static Value convert(Value value, Type from, Type to);
+
+private:
+	const TranslationUnit& m_unit;
+	// Declarations in the unit by function index, nullptr for the top-level
+	// function; NameResolver's are the ones before type checking.
+	std::vector<const FunctionDeclaration*> m_functions;
+	// Locals each function needs, by function index.
+	std::vector<uint32_t> m_frame_sizes;
+	std::vector<Value> m_globals;
+
+	uint32_t m_function = 0;
+	Value* m_locals = nullptr;
+	Value m_return{};
+	uint32_t m_depth = 0;
+	// Operators of the chains being evaluated, see push_left_chain().
+	std::vector<const BinaryExpression*> m_chain;
+
+	Value m_result{};
+	std::string m_error;
+	bool m_failed = false;
+};
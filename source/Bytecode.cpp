@@ -0,0 +1,123 @@
+#include "Bytecode.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+void Instruction::set_imm(uint32_t value) {
+	b = static_cast<uint16_t>(value);
+	c = static_cast<uint16_t>(value >> 16);
+}
+
+int32_t float_to_int(float value) {
+	if (!(value == value))
+		return 0;
+	if (value >= 2147483648.0f)
+		return std::numeric_limits<int32_t>::max();
+	if (value < -2147483648.0f)
+		return std::numeric_limits<int32_t>::min();
+
+	return static_cast<int32_t>(value);
+}
+
+const char* opcode_name(Opcode op) {
+	static const char* names[] = {
+#define X(name) #name,
+		TOY_OPCODES(X)
+#undef X
+	};
+
+	return names[static_cast<size_t>(op)];
+}
+
+static const char* type_name(Type type) {
+	switch (type) {
+	case Type::BOOL:
+		return "bool";
+	case Type::INT:
+		return "int";
+	case Type::FLOAT:
+		return "float";
+	default:
+		return "void";
+	}
+}
+
+static std::string register_name(uint16_t index) {
+	return 'r' + std::to_string(index);
+}
+
+static std::string operands(const BytecodeProgram& program, const Instruction& instruction) {
+	switch (instruction.op) {
+	case Opcode::LOAD_INT:
+		return register_name(instruction.a) + ", " + std::to_string(static_cast<int32_t>(instruction.imm()));
+	case Opcode::LOAD_CONST:
+		return register_name(instruction.a) + ", c" + std::to_string(instruction.imm());
+	case Opcode::LOAD_GLOBAL:
+	case Opcode::STORE_GLOBAL:
+		return register_name(instruction.a) + ", g" + std::to_string(instruction.imm());
+	case Opcode::MOVE:
+	case Opcode::INT_TO_FLOAT:
+	case Opcode::FLOAT_TO_INT:
+	case Opcode::INT_TO_BOOL:
+	case Opcode::FLOAT_TO_BOOL:
+		return register_name(instruction.a) + ", " + register_name(instruction.b);
+	case Opcode::INC_I:
+	case Opcode::DEC_I:
+	case Opcode::INC_F:
+	case Opcode::DEC_F:
+	case Opcode::RETURN:
+		return register_name(instruction.a);
+	case Opcode::JUMP:
+		return std::to_string(instruction.imm());
+	case Opcode::JUMP_IF_FALSE:
+	case Opcode::JUMP_IF_TRUE:
+		return register_name(instruction.a) + ", " + std::to_string(instruction.imm());
+	case Opcode::CALL:
+		return register_name(instruction.a) + ", " + program.functions[instruction.imm()].name;
+	case Opcode::RETURN_VOID:
+		return {};
+	default:
+		return register_name(instruction.a) + ", " + register_name(instruction.b) + ", " + register_name(instruction.c);
+	}
+}
+
+std::string disassemble(const BytecodeProgram& program) {
+	std::string out;
+
+	if (!program.constants.empty()) {
+		out += "constants\n";
+
+		for (size_t i = 0; i < program.constants.size(); i++) {
+			std::string index = 'c' + std::to_string(i);
+			Type type = program.constant_types[i];
+
+			out += std::string(6 - std::min<size_t>(index.size(), 5), ' ') + index + "  " + type_name(type) + ' ' +
+				(type == Type::FLOAT ? std::to_string(program.constants[i].f) : std::to_string(program.constants[i].i)) + '\n';
+		}
+
+		out += '\n';
+	}
+
+	for (const BytecodeFunction& function : program.functions) {
+		out += function.name + '(';
+		for (size_t i = 0; i < function.parameters.size(); i++)
+			out += (i ? ", " : "") + std::string(type_name(function.parameters[i]));
+		out += ") -> " + std::string(type_name(function.return_type)) + ", " + std::to_string(function.register_count) + " registers\n";
+
+		for (size_t i = 0; i < function.code.size(); i++) {
+			const Instruction& instruction = function.code[i];
+			std::string index = std::to_string(i);
+
+			out += std::string(6 - std::min<size_t>(index.size(), 5), ' ') + index + "  " + opcode_name(instruction.op);
+			std::string args = operands(program, instruction);
+			if (!args.empty())
+				out += std::string(16 - std::min<size_t>(std::strlen(opcode_name(instruction.op)), 15), ' ') + args;
+			out += '\n';
+		}
+
+		out += '\n';
+	}
+
+	return out;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "AST.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Register machine: every function has a fixed number of registers, with the
+// parameters in the first ones. Operands a, b and c are register numbers
+// unless the opcode says otherwise; "imm" is the 32-bit value b | c << 16.
+// The suffix _I marks int (and bool, as 0 or 1) operands, _F float ones.
+#define TOY_OPCODES(X) \
+	X(MOVE)          /* a = b */ \
+	X(LOAD_INT)      /* a = imm */ \
+	X(LOAD_CONST)    /* a = constants[imm] */ \
+	X(LOAD_GLOBAL)   /* a = globals[imm] */ \
+	X(STORE_GLOBAL)  /* globals[imm] = a */ \
+	X(ADD_I) X(SUB_I) X(MUL_I) X(DIV_I) \
+	X(ADD_F) X(SUB_F) X(MUL_F) X(DIV_F) \
+	X(EQ_I) X(NE_I) X(LT_I) X(LE_I) \
+	X(EQ_F) X(NE_F) X(LT_F) X(LE_F) \
+	X(INC_I) X(DEC_I) X(INC_F) X(DEC_F) /* a = a +- 1 */ \
+	X(INT_TO_FLOAT) X(FLOAT_TO_INT)      /* a = b */ \
+	X(INT_TO_BOOL) X(FLOAT_TO_BOOL)      /* a = b != 0 */ \
+	X(JUMP)          /* pc = imm */ \
+	X(JUMP_IF_FALSE) /* if (!a) pc = imm */ \
+	X(JUMP_IF_TRUE)  /* if (a) pc = imm */ \
+	X(CALL)          /* a = functions[imm](a, a + 1, ...) */ \
+	X(RETURN)        /* returns a */ \
+	X(RETURN_VOID)
+
+enum class Opcode : uint8_t {
+#define X(name) name,
+	TOY_OPCODES(X)
+#undef X
+};
+
+struct Instruction {
+	Opcode op;
+	uint16_t a = 0;
+	uint16_t b = 0;
+	uint16_t c = 0;
+
+	uint32_t imm() const { return b | static_cast<uint32_t>(c) << 16; }
+	void set_imm(uint32_t value);
+};
+
+union Value {
+	int32_t i;
+	float f;
+};
+
+struct BytecodeFunction {
+	std::string name;
+	Type return_type = Type::VOID;
+	std::vector<Type> parameters;
+	uint16_t register_count = 0;
+	std::vector<Instruction> code;
+};
+
+struct BytecodeProgram {
+	std::vector<BytecodeFunction> functions;
+	// The int and float constants that LOAD_CONST loads, and their types.
+	std::vector<Value> constants;
+	std::vector<Type> constant_types;
+	uint32_t global_count = 0;
+	// Runs the top-level statements, which also initialize the globals.
+	uint32_t entry = 0;
+	// A main() without parameters, which runs after the entry function.
+	int32_t main = -1;
+};
+
+// FLOAT_TO_INT: saturates, and NaN becomes zero.
+int32_t float_to_int(float value);
+
+const char* opcode_name(Opcode op);
+std::string disassemble(const BytecodeProgram& program);
\ No newline at end of file
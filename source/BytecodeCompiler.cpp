@@ -0,0 +1,593 @@
+#include "BytecodeCompiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint16_t MAX_REGISTERS = UINT16_MAX;
+
+// Calls cannot reach the caller's locals, so only assignments and increments
+// can change a variable that an operand to their left has already read.
+static bool has_side_effects(const Expression* expr) {
+	if (!expr)
+		return false;
+
+	switch (expr->kind()) {
+	case NodeKind::BINARY_EXPRESSION:
+		// Down the left operands in a loop, see push_left_chain().
+		while (expr && expr->kind() == NodeKind::BINARY_EXPRESSION) {
+			auto binary = static_cast<const BinaryExpression*>(expr);
+			if (binary->op() == BinaryOp::ASSIGN || has_side_effects(binary->right()))
+				return true;
+
+			expr = binary->left();
+		}
+
+		return has_side_effects(expr);
+	case NodeKind::UNARY_EXPRESSION: {
+		auto unary = static_cast<const UnaryExpression*>(expr);
+		return unary->op() != UnaryOp::CAST || has_side_effects(unary->expr());
+	}
+	case NodeKind::FUNC_CALL_ATOM:
+		for (const Expression* argument : static_cast<const FuncCallAtom*>(expr)->arguments()) {
+			if (has_side_effects(argument))
+				return true;
+		}
+		return false;
+	default:
+		return false;
+	}
+}
+
+// Instructions whose only effect is to write register a, so that they can
+// write their result somewhere else instead.
+static bool writes_only_a(Opcode op) {
+	switch (op) {
+	case Opcode::INC_I:
+	case Opcode::DEC_I:
+	case Opcode::INC_F:
+	case Opcode::DEC_F:
+	case Opcode::STORE_GLOBAL:
+	case Opcode::JUMP:
+	case Opcode::JUMP_IF_FALSE:
+	case Opcode::JUMP_IF_TRUE:
+	case Opcode::CALL:
+	case Opcode::RETURN:
+	case Opcode::RETURN_VOID:
+		return false;
+	default:
+		return true;
+	}
+}
+
+bool BytecodeCompiler::compile(const TranslationUnit& unit, const NameResolver& resolver, const ConstantPool& constants) {
+	m_program = {};
+	m_diagnostics.clear();
+
+	// Every function gets its header up front, so that calls can be compiled
+	// before the callee.
+	m_program.functions.push_back({ "<top-level>", Type::VOID, {}, 0, {} });
+
+	for (size_t i = 1; i < resolver.functions().size(); i++) {
+		const FunctionDeclaration& declaration = *resolver.functions()[i];
+
+		BytecodeFunction function;
+		function.name = std::string(declaration.id());
+		function.return_type = declaration.return_type();
+		for (const TypedId& parameter : declaration.parameters())
+			function.parameters.push_back(parameter.type);
+
+		m_program.functions.push_back(std::move(function));
+	}
+
+	m_program.global_count = resolver.global_count();
+	m_program.entry = 0;
+	m_function = 0;
+	m_next_register = 0;
+	m_label = 0;
+
+	for (const Statement* stmt : unit.statements()) {
+		if (!stmt)
+			continue;
+
+		if (stmt->kind() == NodeKind::FUNCTION_DECLARATION) {
+			auto& declaration = *static_cast<const FunctionDeclaration*>(stmt);
+
+			if (declaration.id() == "main" && declaration.parameters().empty())
+				m_program.main = static_cast<int32_t>(declaration.index());
+
+			compile_function(declaration, declaration.index());
+		} else if (stmt->kind() == NodeKind::VARIABLE_DECLARATION)
+			compile_variable_declaration(*static_cast<const VariableDeclaration*>(stmt), true);
+		else
+			compile_statement(stmt);
+	}
+
+	finish_function();
+
+	for (uint32_t i = 0; i < constants.size(); i++) {
+		uint32_t bits = constants.bits(i);
+		Value value;
+		std::memcpy(&value, &bits, sizeof(bits));
+
+		m_program.constants.push_back(value);
+		m_program.constant_types.push_back(constants.type(i));
+	}
+
+	return m_diagnostics.empty();
+}
+
+const BytecodeProgram& BytecodeCompiler::program() const {
+	return m_program;
+}
+
+const std::vector<Diagnostic>& BytecodeCompiler::diagnostics() const {
+	return m_diagnostics;
+}
+
+// The tree has no positions, so errors name the function they are in instead.
+void BytecodeCompiler::error(std::string message) {
+	if (m_function != m_program.entry)
+		message += " in function '" + m_program.functions[m_function].name + '\'';
+
+	m_diagnostics.push_back({ {}, std::move(message) });
+}
+
+uint16_t BytecodeCompiler::allocate_register() {
+	BytecodeFunction& function = m_program.functions[m_function];
+
+	if (m_next_register == MAX_REGISTERS) {
+		error("More than " + std::to_string(MAX_REGISTERS) + " registers needed");
+		return MAX_REGISTERS - 1;
+	}
+
+	uint16_t reg = m_next_register++;
+	function.register_count = std::max(function.register_count, m_next_register);
+
+	return reg;
+}
+
+size_t BytecodeCompiler::emit(Opcode op, uint16_t a, uint16_t b, uint16_t c) {
+	std::vector<Instruction>& code = m_program.functions[m_function].code;
+	code.push_back({ op, a, b, c });
+
+	return code.size() - 1;
+}
+
+size_t BytecodeCompiler::emit_imm(Opcode op, uint16_t a, uint32_t imm) {
+	Instruction instruction{ op, a };
+	instruction.set_imm(imm);
+
+	std::vector<Instruction>& code = m_program.functions[m_function].code;
+	code.push_back(instruction);
+
+	return code.size() - 1;
+}
+
+size_t BytecodeCompiler::emit_jump(Opcode op, uint16_t condition) {
+	return emit_imm(op, condition, 0);
+}
+
+size_t BytecodeCompiler::label() {
+	m_label = m_program.functions[m_function].code.size();
+	return m_label;
+}
+
+void BytecodeCompiler::patch(size_t jump, size_t target) {
+	m_program.functions[m_function].code[jump].set_imm(static_cast<uint32_t>(target));
+}
+
+void BytecodeCompiler::compile_function(const FunctionDeclaration& declaration, uint32_t index) {
+	uint32_t function = m_function;
+	uint16_t next_register = m_next_register;
+	size_t last_label = m_label;
+
+	m_function = index;
+	m_next_register = 0;
+	m_label = 0;
+
+	// Parameters are the first registers.
+	for (size_t i = 0; i < declaration.parameters().size(); i++)
+		allocate_register();
+
+	if (declaration.statement()) {
+		for (const Statement* stmt : declaration.statement()->statements())
+			compile_statement(stmt);
+	}
+
+	finish_function();
+
+	m_function = function;
+	m_next_register = next_register;
+	m_label = last_label;
+}
+
+// Falling off the end returns zero from a function that has a return type.
+void BytecodeCompiler::finish_function() {
+	const BytecodeFunction& function = m_program.functions[m_function];
+
+	if (!function.code.empty() && m_label != function.code.size()) {
+		Opcode last = function.code.back().op;
+
+		if (last == Opcode::RETURN || last == Opcode::RETURN_VOID)
+			return;
+	}
+
+	if (function.return_type == Type::VOID)
+		emit(Opcode::RETURN_VOID);
+	else {
+		uint16_t reg = allocate_register();
+		emit_imm(Opcode::LOAD_INT, reg, 0);
+		emit(Opcode::RETURN, reg);
+	}
+}
+
+void BytecodeCompiler::compile_statement(const Statement* stmt) {
+	if (!stmt)
+		return;
+
+	uint16_t mark = m_next_register;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT:
+		for (const Statement* child : static_cast<const CompoundStatement*>(stmt)->statements())
+			compile_statement(child);
+		break;
+	case NodeKind::VARIABLE_DECLARATION:
+		// Keeps the register it declares.
+		compile_variable_declaration(*static_cast<const VariableDeclaration*>(stmt), false);
+		return;
+	case NodeKind::FUNCTION_DECLARATION: {
+		auto& declaration = *static_cast<const FunctionDeclaration*>(stmt);
+		compile_function(declaration, declaration.index());
+		break;
+	}
+	case NodeKind::IF_STATEMENT:
+		compile_if_statement(*static_cast<const IfStatement*>(stmt));
+		break;
+	case NodeKind::FOR_STATEMENT:
+		compile_for_statement(*static_cast<const ForStatement*>(stmt));
+		break;
+	case NodeKind::WHILE_STATEMENT:
+		compile_while_statement(*static_cast<const WhileStatement*>(stmt));
+		break;
+	case NodeKind::RETURN_STATEMENT:
+		compile_return_statement(*static_cast<const ReturnStatement*>(stmt));
+		break;
+	default:
+		compile_expression(static_cast<const Expression*>(stmt));
+		break;
+	}
+
+	m_next_register = mark;
+}
+
+void BytecodeCompiler::compile_variable_declaration(const VariableDeclaration& declaration, bool global) {
+	uint16_t mark = m_next_register;
+	Operand value{};
+
+	// The initializer cannot see the variable it initializes.
+	if (declaration.initial_value())
+		value = compile_expression(declaration.initial_value());
+
+	m_next_register = mark;
+
+	if (global) {
+		// Globals start out as zero.
+		if (declaration.initial_value())
+			emit_imm(Opcode::STORE_GLOBAL, value.reg, declaration.binding().slot);
+		return;
+	}
+
+	// The free registers start at the slot of the variable.
+	uint16_t reg = allocate_register();
+
+	if (declaration.initial_value())
+		move_into(value, reg);
+	else
+		emit_imm(Opcode::LOAD_INT, reg, 0);
+}
+
+void BytecodeCompiler::compile_if_statement(const IfStatement& stmt) {
+	uint16_t mark = m_next_register;
+
+	Operand condition = compile_expression(stmt.condition());
+	size_t skip = emit_jump(Opcode::JUMP_IF_FALSE, condition.reg);
+	m_next_register = mark;
+
+	compile_statement(stmt.statement());
+	patch(skip, label());
+}
+
+// Loops test their condition at the bottom, so that an iteration costs a
+// single conditional jump.
+void BytecodeCompiler::compile_for_statement(const ForStatement& stmt) {
+	if (stmt.variable_declaration())
+		compile_variable_declaration(*stmt.variable_declaration(), false);
+
+	uint16_t mark = m_next_register;
+	size_t enter = emit_jump(Opcode::JUMP);
+	size_t body = label();
+
+	compile_statement(stmt.statement());
+	m_next_register = mark;
+
+	if (stmt.loop_expr()) {
+		compile_expression(stmt.loop_expr());
+		m_next_register = mark;
+	}
+
+	patch(enter, label());
+
+	if (stmt.condition_expr()) {
+		Operand condition = compile_expression(stmt.condition_expr());
+		patch(emit_jump(Opcode::JUMP_IF_TRUE, condition.reg), body);
+	} else
+		patch(emit_jump(Opcode::JUMP), body);
+}
+
+void BytecodeCompiler::compile_while_statement(const WhileStatement& stmt) {
+	uint16_t mark = m_next_register;
+	size_t enter = emit_jump(Opcode::JUMP);
+	size_t body = label();
+
+	compile_statement(stmt.statement());
+	m_next_register = mark;
+	patch(enter, label());
+
+	Operand condition = compile_expression(stmt.condition_expr());
+	patch(emit_jump(Opcode::JUMP_IF_TRUE, condition.reg), body);
+
+	m_next_register = mark;
+}
+
+void BytecodeCompiler::compile_return_statement(const ReturnStatement& stmt) {
+	if (stmt.return_expr())
+		emit(Opcode::RETURN, compile_expression(stmt.return_expr()).reg);
+	else
+		emit(Opcode::RETURN_VOID);
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::compile_expression(const Expression* expr) {
+	switch (expr->kind()) {
+	case NodeKind::INT_LITERAL: {
+		uint16_t reg = allocate_register();
+		emit_imm(Opcode::LOAD_CONST, reg, static_cast<const IntLiteral*>(expr)->constant());
+		return { reg, Type::INT, true };
+	}
+	case NodeKind::FLOAT_LITERAL: {
+		uint16_t reg = allocate_register();
+		emit_imm(Opcode::LOAD_CONST, reg, static_cast<const FloatLiteral*>(expr)->constant());
+		return { reg, Type::FLOAT, true };
+	}
+	case NodeKind::BOOL_LITERAL: {
+		uint16_t reg = allocate_register();
+		emit_imm(Opcode::LOAD_INT, reg, static_cast<const BoolLiteral*>(expr)->boolean());
+		return { reg, Type::BOOL, true };
+	}
+	case NodeKind::ID_ATOM: {
+		const Binding& binding = static_cast<const IdAtom*>(expr)->binding();
+
+		if (binding.kind == BindingKind::LOCAL)
+			return { static_cast<uint16_t>(binding.slot), binding.type, false };
+
+		uint16_t reg = allocate_register();
+		emit_imm(Opcode::LOAD_GLOBAL, reg, binding.slot);
+		return { reg, binding.type, true };
+	}
+	case NodeKind::FUNC_CALL_ATOM:
+		return compile_call(*static_cast<const FuncCallAtom*>(expr));
+	case NodeKind::UNARY_EXPRESSION:
+		return compile_unary_expression(*static_cast<const UnaryExpression*>(expr));
+	default:
+		break;
+	}
+
+	auto binary = static_cast<const BinaryExpression*>(expr);
+	if (binary->op() == BinaryOp::ASSIGN)
+		return compile_assignment(*binary);
+
+	// Left to right down a chain of left operands, see push_left_chain().
+	// Every operator of the chain reuses the registers from mark on.
+	uint16_t mark = m_next_register;
+	size_t base = m_chain.size();
+	Operand left = compile_expression(push_left_chain(binary, m_chain));
+
+	while (m_chain.size() > base) {
+		binary = m_chain.back();
+		m_chain.pop_back();
+		left = compile_binary_expression(*binary, left, mark);
+	}
+
+	return left;
+}
+
+// left is the compiled left operand, which was compiled with mark as the
+// first free register.
+BytecodeCompiler::Operand BytecodeCompiler::compile_binary_expression(const BinaryExpression& expr, Operand left, uint16_t mark) {
+	switch (expr.op()) {
+	case BinaryOp::COMA:
+		m_next_register = mark;
+		return compile_expression(expr.right());
+	case BinaryOp::LOGICAL_OR:
+	case BinaryOp::LOGICAL_AND:
+		return compile_logical_expression(expr, left, mark);
+	default:
+		break;
+	}
+
+	// Operands are evaluated left to right, so a variable has to be read
+	// before the right operand can change it.
+	if (!left.temporary && has_side_effects(expr.right())) {
+		uint16_t reg = allocate_register();
+		emit(Opcode::MOVE, reg, left.reg);
+		left = { reg, left.type, true };
+	}
+
+	Operand right = compile_expression(expr.right());
+
+	// Both operands are ints or both are floats.
+	bool floating = left.type == Type::FLOAT;
+	Opcode op;
+	bool swap = false;
+
+	switch (expr.op()) {
+	case BinaryOp::PLUS:
+		op = floating ? Opcode::ADD_F : Opcode::ADD_I;
+		break;
+	case BinaryOp::MINUS:
+		op = floating ? Opcode::SUB_F : Opcode::SUB_I;
+		break;
+	case BinaryOp::MULTIPLY:
+		op = floating ? Opcode::MUL_F : Opcode::MUL_I;
+		break;
+	case BinaryOp::DIVIDE:
+		op = floating ? Opcode::DIV_F : Opcode::DIV_I;
+		break;
+	case BinaryOp::LOGICAL_EQUAL:
+		op = floating ? Opcode::EQ_F : Opcode::EQ_I;
+		break;
+	case BinaryOp::LOGICAL_NOT_EQUAL:
+		op = floating ? Opcode::NE_F : Opcode::NE_I;
+		break;
+	case BinaryOp::LESS:
+		op = floating ? Opcode::LT_F : Opcode::LT_I;
+		break;
+	case BinaryOp::GREATER:
+		op = floating ? Opcode::LT_F : Opcode::LT_I;
+		swap = true;
+		break;
+	case BinaryOp::LESS_EQUAL:
+		op = floating ? Opcode::LE_F : Opcode::LE_I;
+		break;
+	default:
+		op = floating ? Opcode::LE_F : Opcode::LE_I;
+		swap = true;
+		break;
+	}
+
+	m_next_register = mark;
+	uint16_t reg = allocate_register();
+
+	if (swap)
+		std::swap(left, right);
+	emit(op, reg, left.reg, right.reg);
+
+	return { reg, expr.type(), true };
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::compile_logical_expression(const BinaryExpression& expr, Operand left, uint16_t mark) {
+	bool is_and = expr.op() == BinaryOp::LOGICAL_AND;
+
+	m_next_register = mark;
+	uint16_t reg = allocate_register();
+	move_into(left, reg);
+
+	size_t skip = emit_jump(is_and ? Opcode::JUMP_IF_FALSE : Opcode::JUMP_IF_TRUE, reg);
+
+	Operand right = compile_expression(expr.right());
+	move_into(right, reg);
+	m_next_register = reg + 1;
+
+	patch(skip, label());
+
+	return { reg, Type::BOOL, true };
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::compile_assignment(const BinaryExpression& expr) {
+	const Binding& binding = static_cast<const IdAtom*>(expr.left())->binding();
+	Operand value = compile_expression(expr.right());
+
+	if (binding.kind == BindingKind::GLOBAL) {
+		emit_imm(Opcode::STORE_GLOBAL, value.reg, binding.slot);
+		return value;
+	}
+
+	move_into(value, static_cast<uint16_t>(binding.slot));
+
+	return { static_cast<uint16_t>(binding.slot), binding.type, false };
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::compile_unary_expression(const UnaryExpression& expr) {
+	if (expr.op() == UnaryOp::CAST)
+		return convert(compile_expression(expr.expr()), expr.type());
+
+	const Binding& binding = static_cast<const IdAtom*>(expr.expr())->binding();
+	Opcode op;
+	if (expr.op() == UnaryOp::PRE_INCREMENT)
+		op = binding.type == Type::FLOAT ? Opcode::INC_F : Opcode::INC_I;
+	else
+		op = binding.type == Type::FLOAT ? Opcode::DEC_F : Opcode::DEC_I;
+
+	if (binding.kind == BindingKind::LOCAL) {
+		emit(op, static_cast<uint16_t>(binding.slot));
+		return { static_cast<uint16_t>(binding.slot), binding.type, false };
+	}
+
+	uint16_t reg = allocate_register();
+	emit_imm(Opcode::LOAD_GLOBAL, reg, binding.slot);
+	emit(op, reg);
+	emit_imm(Opcode::STORE_GLOBAL, reg, binding.slot);
+
+	return { reg, binding.type, true };
+}
+
+// Arguments go to consecutive registers, which become the first registers
+// of the callee; the result comes back in the first of them.
+BytecodeCompiler::Operand BytecodeCompiler::compile_call(const FuncCallAtom& call) {
+	uint32_t index = call.binding().slot;
+	size_t parameter_count = m_program.functions[index].parameters.size();
+	uint16_t base = m_next_register;
+	uint16_t slots = static_cast<uint16_t>(std::max<size_t>(parameter_count, 1));
+	for (uint16_t i = 0; i < slots; i++)
+		allocate_register();
+
+	for (uint32_t i = 0; i < parameter_count; i++) {
+		Operand argument = compile_expression(call.arguments()[i]);
+		move_into(argument, static_cast<uint16_t>(base + i));
+		m_next_register = base + slots;
+	}
+
+	emit_imm(Opcode::CALL, base, index);
+	m_next_register = base + 1;
+
+	return { base, m_program.functions[index].return_type, true };
+}
+
+BytecodeCompiler::Operand BytecodeCompiler::convert(Operand value, Type type) {
+	Opcode op;
+	switch (type) {
+	case Type::INT:
+		// A bool already is 0 or 1.
+		if (value.type == Type::BOOL)
+			return { value.reg, Type::INT, value.temporary };
+		op = Opcode::FLOAT_TO_INT;
+		break;
+	case Type::FLOAT:
+		op = Opcode::INT_TO_FLOAT;
+		break;
+	case Type::BOOL:
+		op = value.type == Type::FLOAT ? Opcode::FLOAT_TO_BOOL : Opcode::INT_TO_BOOL;
+		break;
+	default:
+		return value;
+	}
+
+	uint16_t reg = value.temporary ? value.reg : allocate_register();
+	emit(op, reg, value.reg);
+
+	return { reg, type, true };
+}
+
+// Makes the instruction that computed a temporary write to reg directly,
+// unless a jump lands after it and other paths computed the value as well.
+void BytecodeCompiler::move_into(Operand value, uint16_t reg) {
+	if (value.reg == reg)
+		return;
+
+	std::vector<Instruction>& code = m_program.functions[m_function].code;
+
+	if (value.temporary && !code.empty() && m_label != code.size() && code.back().a == value.reg && writes_only_a(code.back().op))
+		code.back().a = reg;
+	else
+		emit(Opcode::MOVE, reg, value.reg);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Bytecode.h"
+#include "ConstantPool.h"
+#include "NameResolver.h"
+
+#include <vector>
+
+// Lowers a TranslationUnit to bytecode, after NameResolver has bound its
+// names and TypeChecker has typed it without errors. Top-level statements
+// become the entry function and top-level variables its globals; locals live
+// in the registers that their bindings name. Every conversion is a CAST.
+class BytecodeCompiler {
+public:
+	// Returns false, with the reasons in diagnostics(), when a function needs
+	// more registers than an instruction can name; program() is unusable then.
+	// Literals load the constants of the tree's pool by the index they hold,
+	// so constants has to be the pool of the context that made them.
+	bool compile(const TranslationUnit& unit, const NameResolver& resolver, const ConstantPool& constants);
+
+	const BytecodeProgram& program() const;
+	const std::vector<Diagnostic>& diagnostics() const;
+
+private:
+	// Where the value of an expression ended up. Temporaries may be
+	// overwritten, the registers of variables may not.
+	struct Operand {
+		uint16_t reg;
+		Type type;
+		bool temporary;
+	};
+
+	void error(std::string message);
+
+	uint16_t allocate_register();
+
+	size_t emit(Opcode op, uint16_t a = 0, uint16_t b = 0, uint16_t c = 0);
+	size_t emit_imm(Opcode op, uint16_t a, uint32_t imm);
+	size_t emit_jump(Opcode op, uint16_t condition = 0);
+	size_t label();
+	void patch(size_t jump, size_t target);
+
+	void compile_function(const FunctionDeclaration& declaration, uint32_t index);
+	void finish_function();
+
+	void compile_statement(const Statement* stmt);
+	void compile_variable_declaration(const VariableDeclaration& declaration, bool global);
+	void compile_if_statement(const IfStatement& stmt);
+	void compile_for_statement(const ForStatement& stmt);
+	void compile_while_statement(const WhileStatement& stmt);
+	void compile_return_statement(const ReturnStatement& stmt);
+
+	Operand compile_expression(const Expression* expr);
+	Operand compile_binary_expression(const BinaryExpression& expr, Operand left, uint16_t mark);
+	Operand compile_logical_expression(const BinaryExpression& expr, Operand left, uint16_t mark);
+	Operand compile_assignment(const BinaryExpression& expr);
+	Operand compile_unary_expression(const UnaryExpression& expr);
+	Operand compile_call(const FuncCallAtom& call);
+
+	// A CAST of the value to the type.
+	Operand convert(Operand value, Type type);
+	void move_into(Operand value, uint16_t reg);
+
+private:
+	BytecodeProgram m_program;
+	std::vector<Diagnostic> m_diagnostics;
+
+	uint32_t m_function = 0;
+	uint16_t m_next_register = 0;
+	// Operators of the chains being compiled, see push_left_chain().
+	std::vector<const BinaryExpression*> m_chain;
+	// Code offset that the last bound label points to; the instruction before
+	// it must not be rewritten.
+	size_t m_label = 0;
+};
\ No newline at end of file
@@ -0,0 +1,604 @@
+#include "ConstantFolder.h"
+
+static bool is_literal(const Expression* expr) {
+	if (!expr)
+		return false;
+
+	NodeKind kind = expr->kind();
+	return kind == NodeKind::INT_LITERAL || kind == NodeKind::FLOAT_LITERAL || kind == NodeKind::BOOL_LITERAL;
+}
+
+static bool declares_function(const Statement* stmt) {
+	if (!stmt)
+		return false;
+
+	switch (stmt->kind()) {
+	case NodeKind::FUNCTION_DECLARATION:
+		return true;
+	case NodeKind::COMPOUND_STATEMENT:
+		for (const Statement* child : static_cast<const CompoundStatement*>(stmt)->statements()) {
+			if (declares_function(child))
+				return true;
+		}
+		return false;
+	case NodeKind::IF_STATEMENT:
+		return declares_function(static_cast<const IfStatement*>(stmt)->statement());
+	case NodeKind::FOR_STATEMENT:
+		return declares_function(static_cast<const ForStatement*>(stmt)->statement());
+	case NodeKind::WHILE_STATEMENT:
+		return declares_function(static_cast<const WhileStatement*>(stmt)->statement());
+	default:
+		return false;
+	}
+}
+
+static size_t count_nodes(const Statement* stmt) {
+	if (!stmt)
+		return 0;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT: {
+		size_t count = 1;
+		for (const Statement* child : static_cast<const CompoundStatement*>(stmt)->statements())
+			count += count_nodes(child);
+		return count;
+	}
+	case NodeKind::VARIABLE_DECLARATION:
+		return 1 + count_nodes(static_cast<const VariableDeclaration*>(stmt)->initial_value());
+	case NodeKind::FUNCTION_DECLARATION:
+		return 1 + count_nodes(static_cast<const FunctionDeclaration*>(stmt)->statement());
+	case NodeKind::IF_STATEMENT: {
+		auto if_stmt = static_cast<const IfStatement*>(stmt);
+		return 1 + count_nodes(if_stmt->condition()) + count_nodes(if_stmt->statement());
+	}
+	case NodeKind::FOR_STATEMENT: {
+		auto for_stmt = static_cast<const ForStatement*>(stmt);
+		return 1 + count_nodes(for_stmt->variable_declaration()) + count_nodes(for_stmt->condition_expr()) +
+			count_nodes(for_stmt->loop_expr()) + count_nodes(for_stmt->statement());
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		auto while_stmt = static_cast<const WhileStatement*>(stmt);
+		return 1 + count_nodes(while_stmt->condition_expr()) + count_nodes(while_stmt->statement());
+	}
+	case NodeKind::RETURN_STATEMENT:
+		return 1 + count_nodes(static_cast<const ReturnStatement*>(stmt)->return_expr());
+	case NodeKind::BINARY_EXPRESSION: {
+		size_t count = 0;
+
+		// Down the left operands in a loop, see push_left_chain().
+		while (stmt && stmt->kind() == NodeKind::BINARY_EXPRESSION) {
+			auto binary = static_cast<const BinaryExpression*>(stmt);
+			count += 1 + count_nodes(binary->right());
+			stmt = binary->left();
+		}
+
+		return count + count_nodes(stmt);
+	}
+	case NodeKind::UNARY_EXPRESSION:
+		return 1 + count_nodes(static_cast<const UnaryExpression*>(stmt)->expr());
+	case NodeKind::FUNC_CALL_ATOM: {
+		size_t count = 1;
+		for (const Expression* argument : static_cast<const FuncCallAtom*>(stmt)->arguments())
+			count += count_nodes(argument);
+		return count;
+	}
+	default:
+		return 1;
+	}
+}
+
+static size_t count_nodes(const TranslationUnit& unit) {
+	size_t count = 0;
+	for (const Statement* stmt : unit.statements())
+		count += count_nodes(stmt);
+
+	return count;
+}
+
+ConstantFolder::ConstantFolder(AstContext& context)
+	: m_context(context) {}
+
+TranslationUnit* ConstantFolder::fold(TranslationUnit& unit) {
+	m_stats = {};
+	m_locals.clear();
+	m_globals.clear();
+	m_depth = 0;
+
+	size_t base = m_statements.size();
+	bool changed = fold_statements(unit.statements());
+
+	TranslationUnit* folded = &unit;
+	if (changed)
+		folded = m_context.create<TranslationUnit>(m_context.make_list(m_statements.data() + base, m_statements.size() - base));
+	m_statements.resize(base);
+
+	m_stats.eliminated_nodes = count_nodes(unit) - count_nodes(*folded);
+
+	return folded;
+}
+
+const ConstantFolder::Stats& ConstantFolder::stats() const {
+	return m_stats;
+}
+
+ConstantFolder::Constant ConstantFolder::constant(const Expression* expr) {
+	Constant constant;
+
+	switch (expr->kind()) {
+	case NodeKind::INT_LITERAL:
+		constant.type = Type::INT;
+		constant.value.i = static_cast<const IntLiteral*>(expr)->integer();
+		break;
+	case NodeKind::FLOAT_LITERAL:
+		constant.type = Type::FLOAT;
+		constant.value.f = static_cast<const FloatLiteral*>(expr)->floating();
+		break;
+	case NodeKind::BOOL_LITERAL:
+		constant.type = Type::BOOL;
+		constant.value.i = static_cast<const BoolLiteral*>(expr)->boolean();
+		break;
+	default:
+		break;
+	}
+
+	return constant;
+}
+
+// As a CAST, see BytecodeCompiler::convert.
+ConstantFolder::Constant ConstantFolder::convert(Constant constant, Type type) {
+	if (constant.type == type)
+		return constant;
+
+	Constant converted;
+	converted.type = type;
+
+	switch (type) {
+	case Type::INT:
+		converted.value.i = constant.type == Type::FLOAT ? float_to_int(constant.value.f) : constant.value.i;
+		break;
+	case Type::FLOAT:
+		converted.value.f = static_cast<float>(constant.value.i);
+		break;
+	case Type::BOOL:
+		converted.value.i = constant.type == Type::FLOAT ? constant.value.f != 0 : constant.value.i != 0;
+		break;
+	default:
+		break;
+	}
+
+	return converted;
+}
+
+// Returns false for the int division by zero, which has to happen at run time.
+// Both operands are ints or both are floats.
+bool ConstantFolder::evaluate(BinaryOp op, Constant left, Constant right, Constant& result) {
+	result.type = Type::BOOL;
+
+	if (left.type == Type::FLOAT) {
+		float a = left.value.f, b = right.value.f;
+
+		switch (op) {
+		case BinaryOp::PLUS:
+			result = { Type::FLOAT, {} };
+			result.value.f = a + b;
+			return true;
+		case BinaryOp::MINUS:
+			result = { Type::FLOAT, {} };
+			result.value.f = a - b;
+			return true;
+		case BinaryOp::MULTIPLY:
+			result = { Type::FLOAT, {} };
+			result.value.f = a * b;
+			return true;
+		case BinaryOp::DIVIDE:
+			result = { Type::FLOAT, {} };
+			result.value.f = a / b;
+			return true;
+		case BinaryOp::LOGICAL_EQUAL:
+			result.value.i = a == b;
+			return true;
+		case BinaryOp::LOGICAL_NOT_EQUAL:
+			result.value.i = a != b;
+			return true;
+		case BinaryOp::LESS:
+			result.value.i = a < b;
+			return true;
+		case BinaryOp::GREATER:
+			result.value.i = b < a;
+			return true;
+		case BinaryOp::LESS_EQUAL:
+			result.value.i = a <= b;
+			return true;
+		case BinaryOp::GREATER_EQUAL:
+			result.value.i = b <= a;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	int32_t a = left.value.i, b = right.value.i;
+	uint32_t ua = static_cast<uint32_t>(a), ub = static_cast<uint32_t>(b);
+
+	switch (op) {
+	case BinaryOp::PLUS:
+		result = { Type::INT, {} };
+		result.value.i = static_cast<int32_t>(ua + ub);
+		return true;
+	case BinaryOp::MINUS:
+		result = { Type::INT, {} };
+		result.value.i = static_cast<int32_t>(ua - ub);
+		return true;
+	case BinaryOp::MULTIPLY:
+		result = { Type::INT, {} };
+		result.value.i = static_cast<int32_t>(ua * ub);
+		return true;
+	case BinaryOp::DIVIDE:
+		if (b == 0)
+			return false;
+
+		result = { Type::INT, {} };
+		result.value.i = b == -1 ? static_cast<int32_t>(0u - ua) : a / b;
+		return true;
+	case BinaryOp::LOGICAL_EQUAL:
+		result.value.i = a == b;
+		return true;
+	case BinaryOp::LOGICAL_NOT_EQUAL:
+		result.value.i = a != b;
+		return true;
+	case BinaryOp::LESS:
+		result.value.i = a < b;
+		return true;
+	case BinaryOp::GREATER:
+		result.value.i = b < a;
+		return true;
+	case BinaryOp::LESS_EQUAL:
+		result.value.i = a <= b;
+		return true;
+	case BinaryOp::GREATER_EQUAL:
+		result.value.i = b <= a;
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Returns nullptr when the statement has no effect.
+Statement* ConstantFolder::fold_statement(Statement* stmt) {
+	if (!stmt)
+		return nullptr;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT: {
+		auto compound = static_cast<CompoundStatement*>(stmt);
+		size_t base = m_statements.size();
+
+		if (fold_statements(compound->statements()))
+			stmt = m_context.create<CompoundStatement>(m_context.make_list(m_statements.data() + base, m_statements.size() - base));
+		m_statements.resize(base);
+
+		return stmt;
+	}
+	case NodeKind::VARIABLE_DECLARATION:
+		return fold_variable_declaration(static_cast<VariableDeclaration*>(stmt));
+	case NodeKind::FUNCTION_DECLARATION:
+		return fold_function(static_cast<FunctionDeclaration*>(stmt));
+	case NodeKind::IF_STATEMENT: {
+		auto if_stmt = static_cast<IfStatement*>(stmt);
+		Expression* condition = fold_expression(if_stmt->condition());
+
+		if (is_literal(condition)) {
+			if (constant(condition).value.i) {
+				m_stats.pruned_branches++;
+				Statement* body = fold_statement(if_stmt->statement());
+
+				// A declaration keeps the scope that the 'if' gave it.
+				if (body && body->kind() == NodeKind::VARIABLE_DECLARATION)
+					body = m_context.create<CompoundStatement>(m_context.make_list(&body, 1));
+				return body;
+			}
+
+			// The compiler still expects to see every function.
+			if (!declares_function(if_stmt->statement())) {
+				m_stats.pruned_branches++;
+				return nullptr;
+			}
+		}
+
+		Statement* body = fold_body(if_stmt->statement());
+		if (condition == if_stmt->condition() && body == if_stmt->statement())
+			return stmt;
+
+		return m_context.create<IfStatement>(condition, body);
+	}
+	case NodeKind::FOR_STATEMENT: {
+		auto for_stmt = static_cast<ForStatement*>(stmt);
+		VariableDeclaration* declaration = for_stmt->variable_declaration() ? fold_variable_declaration(for_stmt->variable_declaration()) : nullptr;
+		Expression* condition = fold_expression(for_stmt->condition_expr());
+		Expression* loop = fold_expression(for_stmt->loop_expr());
+		Statement* body = fold_body(for_stmt->statement());
+
+		if (declaration == for_stmt->variable_declaration() && condition == for_stmt->condition_expr() &&
+			loop == for_stmt->loop_expr() && body == for_stmt->statement())
+			return stmt;
+
+		return m_context.create<ForStatement>(declaration, condition, loop, body);
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		auto while_stmt = static_cast<WhileStatement*>(stmt);
+		Expression* condition = fold_expression(while_stmt->condition_expr());
+
+		if (is_literal(condition) && !constant(condition).value.i && !declares_function(while_stmt->statement())) {
+			m_stats.pruned_branches++;
+			return nullptr;
+		}
+
+		Statement* body = fold_body(while_stmt->statement());
+		if (condition == while_stmt->condition_expr() && body == while_stmt->statement())
+			return stmt;
+
+		return m_context.create<WhileStatement>(condition, body);
+	}
+	case NodeKind::RETURN_STATEMENT: {
+		auto return_stmt = static_cast<ReturnStatement*>(stmt);
+		Expression* value = fold_expression(return_stmt->return_expr());
+
+		return value == return_stmt->return_expr() ? stmt : m_context.create<ReturnStatement>(value);
+	}
+	default: {
+		Expression* expr = fold_expression(static_cast<Expression*>(stmt));
+		return is_literal(expr) ? nullptr : expr;
+	}
+	}
+}
+
+// The body of an if or a loop cannot be left out, but can be empty.
+Statement* ConstantFolder::fold_body(Statement* stmt) {
+	if (!stmt)
+		return nullptr;
+
+	Statement* folded = fold_statement(stmt);
+	return folded ? folded : m_context.create<CompoundStatement>(AstList<Statement*>{});
+}
+
+// Appends the statements that remain to m_statements; returns whether any of
+// them changed or went away.
+bool ConstantFolder::fold_statements(AstList<Statement*> stmts) {
+	bool changed = false;
+
+	for (Statement* stmt : stmts) {
+		Statement* folded = fold_statement(stmt);
+
+		if (folded)
+			m_statements.push_back(folded);
+		changed |= folded != stmt;
+	}
+
+	return changed;
+}
+
+FunctionDeclaration* ConstantFolder::fold_function(FunctionDeclaration* declaration) {
+	m_depth++;
+
+	// Parameters are never constant.
+	for (uint32_t i = 0; i < declaration->parameters().size(); i++)
+		*variable({ BindingKind::LOCAL, Type::VOID, m_depth, i }) = {};
+
+	CompoundStatement* body = declaration->statement();
+	size_t base = m_statements.size();
+
+	if (body && fold_statements(body->statements()))
+		body = m_context.create<CompoundStatement>(m_context.make_list(m_statements.data() + base, m_statements.size() - base));
+	m_statements.resize(base);
+
+	m_depth--;
+
+	if (body == declaration->statement())
+		return declaration;
+
+	auto folded = m_context.create<FunctionDeclaration>(declaration->return_type(), declaration->id(), declaration->parameters(), body);
+	folded->set_index(declaration->index());
+
+	return folded;
+}
+
+VariableDeclaration* ConstantFolder::fold_variable_declaration(VariableDeclaration* declaration) {
+	Expression* initial_value = fold_expression(declaration->initial_value());
+	Constant value;
+
+	if (is_literal(initial_value))
+		value = constant(initial_value);
+	else if (!initial_value)
+		value = { declaration->type(), {} };
+
+	*variable(declaration->binding()) = declaration->assigned() ? Constant{} : value;
+
+	if (initial_value == declaration->initial_value())
+		return declaration;
+
+	auto folded = m_context.create<VariableDeclaration>(declaration->type(), declaration->id(), initial_value);
+	folded->bind(declaration->binding());
+	if (declaration->assigned())
+		folded->set_assigned();
+
+	return folded;
+}
+
+Expression* ConstantFolder::fold_expression(Expression* expr) {
+	if (!expr)
+		return nullptr;
+
+	switch (expr->kind()) {
+	case NodeKind::ID_ATOM: {
+		const Binding& binding = static_cast<IdAtom*>(expr)->binding();
+
+		if (binding.kind == BindingKind::GLOBAL && m_depth != 0)
+			return expr;
+
+		Constant* value = variable(binding);
+		if (!value || value->type == Type::VOID)
+			return expr;
+
+		m_stats.propagated_variables++;
+		return make_literal(*value);
+	}
+	case NodeKind::FUNC_CALL_ATOM: {
+		auto call = static_cast<FuncCallAtom*>(expr);
+		size_t base = m_expressions.size();
+		bool changed = false;
+
+		for (Expression* argument : call->arguments()) {
+			Expression* folded = fold_expression(argument);
+			m_expressions.push_back(folded);
+			changed |= folded != argument;
+		}
+
+		if (changed) {
+			auto folded = m_context.create<FuncCallAtom>(call->id(), m_context.make_list(m_expressions.data() + base, m_expressions.size() - base));
+			folded->bind(call->binding());
+			folded->set_type(call->type());
+			expr = folded;
+		}
+		m_expressions.resize(base);
+
+		return expr;
+	}
+	case NodeKind::UNARY_EXPRESSION: {
+		auto unary = static_cast<UnaryExpression*>(expr);
+
+		// The operand of '++' and '--' is a variable that changes.
+		if (unary->op() != UnaryOp::CAST)
+			return expr;
+
+		Expression* operand = fold_expression(unary->expr());
+
+		if (is_literal(operand)) {
+			m_stats.folded_expressions++;
+			return make_literal(convert(constant(operand), unary->type()));
+		}
+
+		if (operand == unary->expr())
+			return expr;
+
+		auto folded = m_context.create<UnaryExpression>(UnaryOp::CAST, operand);
+		folded->set_type(unary->type());
+		return folded;
+	}
+	case NodeKind::BINARY_EXPRESSION: {
+		auto binary = static_cast<BinaryExpression*>(expr);
+
+		// The left side of '=' is a variable that changes.
+		if (binary->op() == BinaryOp::ASSIGN)
+			return fold_binary_expression(binary, binary->left());
+
+		// Left to right down a chain of left operands, see push_left_chain().
+		size_t base = m_chain.size();
+		Expression* left = fold_expression(push_left_chain(binary, m_chain));
+
+		while (m_chain.size() > base) {
+			binary = m_chain.back();
+			m_chain.pop_back();
+			left = fold_binary_expression(binary, left);
+		}
+
+		return left;
+	}
+	default:
+		return expr;
+	}
+}
+
+// left is the folded left operand.
+Expression* ConstantFolder::fold_binary_expression(BinaryExpression* expr, Expression* left) {
+	Expression* right = fold_expression(expr->right());
+
+	switch (expr->op()) {
+	case BinaryOp::ASSIGN:
+		break;
+	case BinaryOp::COMA:
+		if (is_literal(left)) {
+			m_stats.folded_expressions++;
+			return right;
+		}
+		break;
+	case BinaryOp::LOGICAL_OR:
+	case BinaryOp::LOGICAL_AND:
+		if (Expression* folded = fold_logical_expression(expr, left, right)) {
+			m_stats.folded_expressions++;
+			return folded;
+		}
+		break;
+	default: {
+		Constant result;
+
+		if (is_literal(left) && is_literal(right) && evaluate(expr->op(), constant(left), constant(right), result)) {
+			m_stats.folded_expressions++;
+			return make_literal(result);
+		}
+		break;
+	}
+	}
+
+	if (left == expr->left() && right == expr->right())
+		return expr;
+
+	auto folded = m_context.create<BinaryExpression>(expr->op(), left, right);
+	folded->set_type(expr->type());
+
+	return folded;
+}
+
+// Returns nullptr when the expression does not simplify. An operand is only
+// dropped when it is a literal, so no side effect is lost; both are bools.
+Expression* ConstantFolder::fold_logical_expression(BinaryExpression* expr, Expression* left, Expression* right) {
+	bool is_and = expr->op() == BinaryOp::LOGICAL_AND;
+
+	if (is_literal(left)) {
+		bool value = constant(left).value.i != 0;
+
+		// false && x, true || x
+		if (value != is_and)
+			return m_context.create<BoolLiteral>(value);
+
+		// true && x, false || x
+		return right;
+	}
+
+	// x && true, x || false
+	if (is_literal(right) && (constant(right).value.i != 0) == is_and)
+		return left;
+
+	return nullptr;
+}
+
+ConstantFolder::Constant* ConstantFolder::variable(const Binding& binding) {
+	if (binding.kind == BindingKind::GLOBAL) {
+		if (binding.slot >= m_globals.size())
+			m_globals.resize(binding.slot + 1);
+
+		return &m_globals[binding.slot];
+	}
+
+	if (binding.kind != BindingKind::LOCAL)
+		return nullptr;
+
+	if (binding.depth >= m_locals.size())
+		m_locals.resize(binding.depth + 1);
+
+	std::vector<Constant>& locals = m_locals[binding.depth];
+	if (binding.slot >= locals.size())
+		locals.resize(binding.slot + 1);
+
+	return &locals[binding.slot];
+}
+
+Expression* ConstantFolder::make_literal(Constant constant) {
+	switch (constant.type) {
+	case Type::FLOAT:
+		return m_context.float_literal(constant.value.f);
+	case Type::BOOL:
+		return m_context.create<BoolLiteral>(constant.value.i != 0);
+	default:
+		return m_context.int_literal(constant.value.i);
+	}
+}
\ No newline at end of file
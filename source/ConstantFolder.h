@@ -0,0 +1,73 @@
+#pragma once
+
+#include "AstContext.h"
+#include "Bytecode.h"
+
+#include <vector>
+
+// Folds constant subexpressions of a resolved and typed TranslationUnit with
+// the semantics of the VM: int arithmetic wraps, int division by zero is left
+// for the VM to report, and casts of constants become literals of their type.
+// Variables that are never assigned are replaced by their value when it is
+// constant; globals only in top-level code, since a function may run before
+// their initializer. 'if' and 'while' statements with a false condition are
+// dropped, and an 'if' whose condition is true is replaced by its body.
+//
+// Unchanged subtrees are shared with the input; changed ones are rebuilt in
+// the context with the same types, so the input stays valid.
+class ConstantFolder {
+public:
+	struct Stats {
+		size_t folded_expressions = 0;
+		size_t propagated_variables = 0;
+		size_t pruned_branches = 0;
+		// Nodes in the input tree minus nodes in the folded one.
+		size_t eliminated_nodes = 0;
+	};
+
+	ConstantFolder(AstContext& context);
+
+	TranslationUnit* fold(TranslationUnit& unit);
+
+	const Stats& stats() const;
+
+private:
+	struct Constant {
+		// VOID when the value is not known.
+		Type type = Type::VOID;
+		Value value{};
+	};
+
+	static Constant constant(const Expression* expr);
+	static Constant convert(Constant constant, Type type);
+	static bool evaluate(BinaryOp op, Constant left, Constant right, Constant& result);
+
+	Statement* fold_statement(Statement* stmt);
+	Statement* fold_body(Statement* stmt);
+	bool fold_statements(AstList<Statement*> stmts);
+	FunctionDeclaration* fold_function(FunctionDeclaration* declaration);
+	VariableDeclaration* fold_variable_declaration(VariableDeclaration* declaration);
+
+	Expression* fold_expression(Expression* expr);
+	Expression* fold_binary_expression(BinaryExpression* expr, Expression* left);
+	Expression* fold_logical_expression(BinaryExpression* expr, Expression* left, Expression* right);
+
+	Constant* variable(const Binding& binding);
+	Expression* make_literal(Constant constant);
+
+private:
+	AstContext& m_context;
+	Stats m_stats;
+
+	// Children of the lists being rebuilt, innermost last.
+	std::vector<Statement*> m_statements;
+	std::vector<Expression*> m_expressions;
+	// Operators of the chains being folded, see push_left_chain().
+	std::vector<BinaryExpression*> m_chain;
+
+	// Values of the locals of the functions being folded, by nesting depth
+	// and slot, and of the globals.
+	std::vector<std::vector<Constant>> m_locals;
+	std::vector<Constant> m_globals;
+	uint16_t m_depth = 0;
+};
\ No newline at end of file
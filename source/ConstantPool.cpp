@@ -0,0 +1,84 @@
+#include "ConstantPool.h"
+
+#include <cstring>
+#include <utility>
+
+static constexpr size_t INITIAL_CAPACITY = 64;
+
+ConstantPool::ConstantPool()
+	: m_slots(INITIAL_CAPACITY) {}
+
+// Fibonacci hashing of type and bits together; the high half of the product
+// mixes in all of them.
+uint32_t ConstantPool::hash(Type type, uint32_t bits) {
+	uint64_t key = static_cast<uint64_t>(type) << 32 | bits;
+
+	return static_cast<uint32_t>((key * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+uint32_t ConstantPool::intern(Type type, uint32_t bits) {
+	uint32_t entry_hash = hash(type, bits);
+	size_t mask = m_slots.size() - 1;
+
+	for (size_t i = entry_hash & mask;; i = (i + 1) & mask) {
+		Slot& slot = m_slots[i];
+
+		if (slot.index == 0) {
+			uint32_t index = static_cast<uint32_t>(m_entries.size());
+
+			slot = { entry_hash, index + 1 };
+			m_entries.push_back({ type, bits });
+
+			// Kept at most half full, so that probe runs stay short.
+			if (m_entries.size() * 2 > m_slots.size())
+				grow();
+
+			return index;
+		}
+
+		const Entry& entry = m_entries[slot.index - 1];
+		if (slot.hash == entry_hash && entry.type == type && entry.bits == bits)
+			return slot.index - 1;
+	}
+}
+
+uint32_t ConstantPool::intern_int(int32_t value) {
+	return intern(Type::INT, static_cast<uint32_t>(value));
+}
+
+uint32_t ConstantPool::intern_float(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	return intern(Type::FLOAT, bits);
+}
+
+void ConstantPool::grow() {
+	std::vector<Slot> slots(m_slots.size() * 2);
+	size_t mask = slots.size() - 1;
+
+	for (const Slot& slot : m_slots) {
+		if (slot.index == 0)
+			continue;
+
+		size_t i = slot.hash & mask;
+		while (slots[i].index != 0)
+			i = (i + 1) & mask;
+
+		slots[i] = slot;
+	}
+
+	m_slots = std::move(slots);
+}
+
+Type ConstantPool::type(uint32_t index) const {
+	return m_entries[index].type;
+}
+
+uint32_t ConstantPool::bits(uint32_t index) const {
+	return m_entries[index].bits;
+}
+
+uint32_t ConstantPool::size() const {
+	return static_cast<uint32_t>(m_entries.size());
+}
\ No newline at end of file
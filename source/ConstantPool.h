@@ -0,0 +1,42 @@
+#pragma once
+
+#include "AST.h"
+
+#include <cstdint>
+#include <vector>
+
+// The distinct int and float constants of a translation unit, each with a
+// dense index that backends can refer to it by. A constant is its type and
+// the bits of its value, so 0.0 and -0.0 are two constants; the table is open
+// addressing with linear probing over one flat array, as IdentifierTable is.
+class ConstantPool {
+public:
+	ConstantPool();
+
+	uint32_t intern(Type type, uint32_t bits);
+	uint32_t intern_int(int32_t value);
+	uint32_t intern_float(float value);
+
+	Type type(uint32_t index) const;
+	uint32_t bits(uint32_t index) const;
+	uint32_t size() const;
+
+private:
+	struct Slot {
+		uint32_t hash;
+		// Index plus one, zero for an empty slot.
+		uint32_t index;
+	};
+
+	struct Entry {
+		Type type;
+		uint32_t bits;
+	};
+
+	static uint32_t hash(Type type, uint32_t bits);
+	void grow();
+
+private:
+	std::vector<Slot> m_slots;
+	std::vector<Entry> m_entries;
+};
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "Diagnostics.h"
+
+DiagnosticEngine::DiagnosticEngine(size_t error_limit)
+	: m_error_limit(error_limit) {}
+
+void DiagnosticEngine::set_error_limit(size_t error_limit) {
+	m_error_limit = error_limit;
+}
+
+void append_diagnostics(std::vector<Diagnostic>& diagnostics, const std::vector<Diagnostic>& more) {
+	auto first = more.begin();
+
+	if (first != more.end() && !diagnostics.empty() && diagnostics.back().pos.line == first->pos.line &&
+		diagnostics.back().pos.column == first->pos.column)
+		++first;
+
+	diagnostics.insert(diagnostics.end(), first, more.end());
+}
+
+void DiagnosticEngine::report(uint32_t offset, std::string_view message) {
+	if (full() || (!m_separated && !m_entries.empty() && m_entries.back().offset == offset))
+		return;
+	if (m_error_limit != 0 && m_entries.size() >= m_error_limit) {
+		m_dropped = true;
+		return;
+	}
+
+	m_separated = false;
+	m_entries.push_back({ offset, message });
+}
+
+void DiagnosticEngine::stop(uint32_t offset, std::string message) {
+	if (m_stopped)
+		return;
+
+	m_stopped = true;
+	m_stop_offset = offset;
+	m_stop_message = std::move(message);
+}
+
+void DiagnosticEngine::separate() {
+	m_separated = true;
+}
+
+bool DiagnosticEngine::empty() const {
+	return m_entries.empty() && !m_stopped;
+}
+
+bool DiagnosticEngine::full() const {
+	return m_stopped || m_dropped;
+}
+
+bool DiagnosticEngine::stopped() const {
+	return m_stopped;
+}
+
+size_t DiagnosticEngine::size() const {
+	return m_entries.size();
+}
+
+std::vector<Diagnostic> DiagnosticEngine::diagnostics(const SourceBuffer& source, size_t first) const {
+	std::vector<Diagnostic> diagnostics;
+	diagnostics.reserve(first < m_entries.size() ? m_entries.size() - first + 2 : 2);
+
+	for (size_t i = first; i < m_entries.size(); i++)
+		diagnostics.push_back({ source.lines().position(m_entries[i].offset), std::string(m_entries[i].message) });
+
+	if (m_dropped)
+		diagnostics.push_back({ source.lines().position(m_entries.back().offset), "Too many errors, stopped after " + std::to_string(m_error_limit) });
+	if (m_stopped)
+		diagnostics.push_back({ source.lines().position(m_stop_offset), m_stop_message });
+
+	return diagnostics;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "SourceBuffer.h"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct Diagnostic {
+	Position pos;
+	std::string message;
+};
+
+// Collects the parser's diagnostics without formatting them: an entry is the
+// offset of the token it is about and a message that outlives the engine, the
+// parser's being string literals. diagnostics() turns them into Diagnostics
+// once the parser is done, looking up the positions in the source's lines,
+// which are only indexed if there is a diagnostic to place.
+//
+// An error at the offset of the one before it is taken for a consequence of
+// that one and dropped. Errors past the first error_limit are dropped too, and
+// once one has been, full() tells the parser to stop; a limit of 0 means no
+// limit. stop() ends the parse early, regardless of the limit.
+//
+// Diagnostics of parts parsed apart are joined with append_diagnostics(),
+// which applies the same rule where the parts meet, provided each part was
+// started with separate().
+class DiagnosticEngine {
+public:
+	static constexpr size_t DEFAULT_ERROR_LIMIT = 100;
+
+	DiagnosticEngine(size_t error_limit = DEFAULT_ERROR_LIMIT);
+
+	void set_error_limit(size_t error_limit);
+
+	void report(uint32_t offset, std::string_view message);
+	// Reports an error the parser cannot go on after; full() from then on.
+	void stop(uint32_t offset, std::string message);
+	// Keeps the next error even at the offset of the one before.
+	void separate();
+
+	bool empty() const;
+	bool full() const;
+	bool stopped() const;
+	size_t size() const;
+
+	// The errors from the first-th on in the order they were reported, one
+	// saying that the parser stopped if it dropped an error for the limit and
+	// the one it stopped at.
+	std::vector<Diagnostic> diagnostics(const SourceBuffer& source, size_t first = 0) const;
+
+private:
+	struct Entry {
+		uint32_t offset;
+		std::string_view message;
+	};
+
+	std::vector<Entry> m_entries;
+	size_t m_error_limit;
+	bool m_separated = false;
+	bool m_dropped = false;
+	bool m_stopped = false;
+	uint32_t m_stop_offset = 0;
+	std::string m_stop_message;
+};
+
+// Appends more to diagnostics, dropping the first of them if it is at the
+// position of the last one.
+void append_diagnostics(std::vector<Diagnostic>& diagnostics, const std::vector<Diagnostic>& more);
\ No newline at end of file
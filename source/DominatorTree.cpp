@@ -0,0 +1,127 @@
+#include "DominatorTree.h"
+
+#include <algorithm>
+#include <utility>
+
+DominatorTree::DominatorTree(const IrFunction& function) {
+	size_t block_count = function.blocks.size();
+
+	m_position.assign(block_count, UNREACHABLE);
+	m_idom.assign(block_count, nullptr);
+	m_children.resize(block_count);
+	m_enter.assign(block_count, 0);
+	m_exit.assign(block_count, 0);
+
+	if (block_count == 0)
+		return;
+
+	// Postorder without recursion: a block is done once its last successor is.
+	std::vector<std::pair<IrBlock*, size_t>> stack;
+	std::vector<bool> visited(block_count);
+	IrBlock* entry = function.blocks[0].get();
+
+	stack.push_back({ entry, 0 });
+	visited[entry->id] = true;
+
+	while (!stack.empty()) {
+		auto& [block, next] = stack.back();
+
+		if (next == block->successors.size()) {
+			m_order.push_back(block);
+			stack.pop_back();
+			continue;
+		}
+
+		IrBlock* successor = block->successors[next++];
+		if (!visited[successor->id]) {
+			visited[successor->id] = true;
+			stack.push_back({ successor, 0 });
+		}
+	}
+
+	std::reverse(m_order.begin(), m_order.end());
+	for (size_t i = 0; i < m_order.size(); i++)
+		m_position[m_order[i]->id] = static_cast<uint32_t>(i);
+
+	auto intersect = [this](IrBlock* a, IrBlock* b) {
+		while (a != b) {
+			while (m_position[a->id] > m_position[b->id])
+				a = m_idom[a->id];
+			while (m_position[b->id] > m_position[a->id])
+				b = m_idom[b->id];
+		}
+		return a;
+	};
+
+	// The entry is its own idom while iterating.
+	m_idom[entry->id] = entry;
+
+	for (bool changed = true; changed;) {
+		changed = false;
+
+		for (size_t i = 1; i < m_order.size(); i++) {
+			IrBlock* block = m_order[i];
+			IrBlock* idom = nullptr;
+
+			for (IrBlock* predecessor : block->predecessors) {
+				if (!m_idom[predecessor->id])
+					continue;
+
+				idom = idom ? intersect(predecessor, idom) : predecessor;
+			}
+
+			if (idom != m_idom[block->id]) {
+				m_idom[block->id] = idom;
+				changed = true;
+			}
+		}
+	}
+
+	m_idom[entry->id] = nullptr;
+
+	for (size_t i = 1; i < m_order.size(); i++)
+		m_children[m_idom[m_order[i]->id]->id].push_back(m_order[i]);
+
+	uint32_t counter = 0;
+	std::vector<std::pair<IrBlock*, size_t>> walk;
+	walk.push_back({ entry, 0 });
+	m_enter[entry->id] = counter++;
+
+	while (!walk.empty()) {
+		auto& [block, next] = walk.back();
+		const std::vector<IrBlock*>& children = m_children[block->id];
+
+		if (next == children.size()) {
+			m_exit[block->id] = counter++;
+			walk.pop_back();
+			continue;
+		}
+
+		IrBlock* child = children[next++];
+		m_enter[child->id] = counter++;
+		walk.push_back({ child, 0 });
+	}
+}
+
+bool DominatorTree::reachable(const IrBlock* block) const {
+	return m_position[block->id] != UNREACHABLE;
+}
+
+IrBlock* DominatorTree::idom(const IrBlock* block) const {
+	return m_idom[block->id];
+}
+
+bool DominatorTree::dominates(const IrBlock* a, const IrBlock* b) const {
+	if (!reachable(a) || !reachable(b))
+		return false;
+
+	return m_enter[a->id] <= m_enter[b->id] && m_exit[b->id] <= m_exit[a->id];
+}
+
+const std::vector<IrBlock*>& DominatorTree::reverse_postorder() const {
+	return m_order;
+}
+
+const std::vector<IrBlock*>& DominatorTree::children(const IrBlock* block) const {
+	return m_children[block->id];
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Ir.h"
+
+#include <vector>
+
+// Dominators of an IrFunction, by Cooper, Harvey and Kennedy's iteration over
+// the reverse postorder. Blocks have to be numbered by IrFunction::renumber()
+// and the tree is stale once the CFG changes.
+class DominatorTree {
+public:
+	DominatorTree(const IrFunction& function);
+
+	bool reachable(const IrBlock* block) const;
+	// nullptr for the entry and for unreachable blocks.
+	IrBlock* idom(const IrBlock* block) const;
+	bool dominates(const IrBlock* a, const IrBlock* b) const;
+
+	// Reachable blocks only; every block comes after its dominators.
+	const std::vector<IrBlock*>& reverse_postorder() const;
+	const std::vector<IrBlock*>& children(const IrBlock* block) const;
+
+private:
+	static constexpr uint32_t UNREACHABLE = UINT32_MAX;
+
+	std::vector<IrBlock*> m_order;
+	// By block id.
+	std::vector<uint32_t> m_position;
+	std::vector<IrBlock*> m_idom;
+	std::vector<std::vector<IrBlock*>> m_children;
+	// Preorder interval of each block in the tree.
+	std::vector<uint32_t> m_enter;
+	std::vector<uint32_t> m_exit;
+};
\ No newline at end of file
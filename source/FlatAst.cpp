@@ -0,0 +1,451 @@
+#include "FlatAst.h"
+#include "AstContext.h"
+
+#include <cstring>
+
+template<typename To, typename From>
+static To bit_cast(From from) {
+	static_assert(sizeof(To) == sizeof(From));
+
+	To to;
+	std::memcpy(&to, &from, sizeof(To));
+
+	return to;
+}
+
+int FlatAst::int_value(NodeHandle node) const {
+	return bit_cast<int>(m_lhs[node]);
+}
+
+float FlatAst::float_value(NodeHandle node) const {
+	return bit_cast<float>(m_lhs[node]);
+}
+
+bool FlatAst::bool_value(NodeHandle node) const {
+	return m_lhs[node] != 0;
+}
+
+std::string_view FlatAst::name(uint32_t name) const {
+	return std::string_view(m_names).substr(m_name_offsets[name], m_name_offsets[name + 1] - m_name_offsets[name]);
+}
+
+uint32_t FlatAst::name_count() const {
+	return static_cast<uint32_t>(m_name_offsets.size() - 1);
+}
+
+uint32_t FlatAst::top_level_count() const {
+	return m_top_level_count;
+}
+
+NodeHandle FlatAst::top_level(uint32_t index) const {
+	return m_extra[m_top_level_first + index];
+}
+
+size_t FlatAst::memory_usage() const {
+	return m_kinds.size() * (sizeof(NodeKind) + sizeof(uint8_t) + 2 * sizeof(uint32_t)) +
+		m_extra.size() * sizeof(uint32_t) +
+		m_names.size() + m_name_offsets.size() * sizeof(uint32_t);
+}
+
+NodeHandle FlatAstBuilder::add_node(NodeKind kind, uint8_t tag, uint32_t lhs, uint32_t rhs) {
+	m_ast.m_kinds.push_back(kind);
+	m_ast.m_tags.push_back(tag);
+	m_ast.m_lhs.push_back(lhs);
+	m_ast.m_rhs.push_back(rhs);
+
+	return static_cast<NodeHandle>(m_ast.m_kinds.size() - 1);
+}
+
+uint32_t FlatAstBuilder::add_name(std::string_view name) {
+	auto [it, inserted] = m_name_ids.try_emplace(std::string(name), m_ast.name_count());
+
+	if (inserted) {
+		m_ast.m_names += name;
+		m_ast.m_name_offsets.push_back(static_cast<uint32_t>(m_ast.m_names.size()));
+	}
+
+	return it->second;
+}
+
+NodeHandle FlatAstBuilder::add_compound_statement(const NodeHandle* stmts, uint32_t count) {
+	uint32_t first = static_cast<uint32_t>(m_ast.m_extra.size());
+	m_ast.m_extra.insert(m_ast.m_extra.end(), stmts, stmts + count);
+
+	return add_node(NodeKind::COMPOUND_STATEMENT, 0, first, count);
+}
+
+NodeHandle FlatAstBuilder::add_variable_declaration(Type type, std::string_view id, NodeHandle init_value) {
+	return add_node(NodeKind::VARIABLE_DECLARATION, static_cast<uint8_t>(type), add_name(id), init_value);
+}
+
+NodeHandle FlatAstBuilder::add_function_declaration(Type ret_type, std::string_view id, const TypedId* params, uint32_t count, NodeHandle stmt) {
+	uint32_t name = add_name(id);
+	uint32_t first = static_cast<uint32_t>(m_ast.m_extra.size());
+
+	m_ast.m_extra.push_back(stmt);
+	m_ast.m_extra.push_back(count);
+	for (uint32_t i = 0; i < count; i++) {
+		m_ast.m_extra.push_back(static_cast<uint32_t>(params[i].type));
+		m_ast.m_extra.push_back(add_name(params[i].id));
+	}
+
+	return add_node(NodeKind::FUNCTION_DECLARATION, static_cast<uint8_t>(ret_type), name, first);
+}
+
+NodeHandle FlatAstBuilder::add_if_statement(NodeHandle condition, NodeHandle statement) {
+	return add_node(NodeKind::IF_STATEMENT, 0, condition, statement);
+}
+
+NodeHandle FlatAstBuilder::add_for_statement(NodeHandle var_decl, NodeHandle condition_expr, NodeHandle loop_expr, NodeHandle stmt) {
+	uint32_t first = static_cast<uint32_t>(m_ast.m_extra.size());
+
+	m_ast.m_extra.push_back(var_decl);
+	m_ast.m_extra.push_back(condition_expr);
+	m_ast.m_extra.push_back(loop_expr);
+
+	return add_node(NodeKind::FOR_STATEMENT, 0, first, stmt);
+}
+
+NodeHandle FlatAstBuilder::add_while_statement(NodeHandle condition_expr, NodeHandle statement) {
+	return add_node(NodeKind::WHILE_STATEMENT, 0, condition_expr, statement);
+}
+
+NodeHandle FlatAstBuilder::add_return_statement(NodeHandle return_expr) {
+	return add_node(NodeKind::RETURN_STATEMENT, 0, return_expr, NO_NODE);
+}
+
+NodeHandle FlatAstBuilder::add_binary_expression(BinaryOp op, NodeHandle left, NodeHandle right) {
+	return add_node(NodeKind::BINARY_EXPRESSION, static_cast<uint8_t>(op), left, right);
+}
+
+NodeHandle FlatAstBuilder::add_unary_expression(UnaryOp op, NodeHandle expr) {
+	return add_node(NodeKind::UNARY_EXPRESSION, static_cast<uint8_t>(op), expr, NO_NODE);
+}
+
+NodeHandle FlatAstBuilder::add_id_atom(std::string_view id) {
+	return add_node(NodeKind::ID_ATOM, 0, add_name(id), NO_NODE);
+}
+
+NodeHandle FlatAstBuilder::add_func_call_atom(std::string_view id, const NodeHandle* args, uint32_t count) {
+	uint32_t name = add_name(id);
+	uint32_t first = static_cast<uint32_t>(m_ast.m_extra.size());
+
+	m_ast.m_extra.push_back(count);
+	m_ast.m_extra.insert(m_ast.m_extra.end(), args, args + count);
+
+	return add_node(NodeKind::FUNC_CALL_ATOM, 0, name, first);
+}
+
+NodeHandle FlatAstBuilder::add_int_literal(int integer) {
+	return add_node(NodeKind::INT_LITERAL, 0, bit_cast<uint32_t>(integer), NO_NODE);
+}
+
+NodeHandle FlatAstBuilder::add_float_literal(float floating) {
+	return add_node(NodeKind::FLOAT_LITERAL, 0, bit_cast<uint32_t>(floating), NO_NODE);
+}
+
+NodeHandle FlatAstBuilder::add_bool_literal(bool boolean) {
+	return add_node(NodeKind::BOOL_LITERAL, 0, boolean, NO_NODE);
+}
+
+FlatAst FlatAstBuilder::finish(const NodeHandle* statements, uint32_t count) {
+	m_ast.m_top_level_first = static_cast<uint32_t>(m_ast.m_extra.size());
+	m_ast.m_top_level_count = count;
+	m_ast.m_extra.insert(m_ast.m_extra.end(), statements, statements + count);
+
+	m_name_ids.clear();
+
+	return std::move(m_ast);
+}
+
+// Flattens children before their parents, left to right, with the nodes still
+// to visit on m_work rather than on the call stack: with no nesting limit the
+// tree can be nested without bound. Handles of flattened children wait on
+// m_stack until their parent is built.
+class Flattener {
+public:
+	FlatAst flatten(const TranslationUnit& unit);
+
+private:
+	struct Step {
+		const Statement* stmt;
+		// Whether the children have been flattened and the node can be built.
+		bool build;
+	};
+
+	void flatten(const Statement* stmt);
+	void push_children(const Statement* stmt);
+	NodeHandle build(const Statement* stmt);
+	NodeHandle pop();
+
+private:
+	FlatAstBuilder m_builder;
+	std::vector<Step> m_work;
+	std::vector<NodeHandle> m_stack;
+};
+
+FlatAst Flattener::flatten(const TranslationUnit& unit) {
+	for (Statement* stmt : unit.statements())
+		flatten(stmt);
+
+	return m_builder.finish(m_stack.data(), static_cast<uint32_t>(m_stack.size()));
+}
+
+// Leaves the handle of stmt on m_stack.
+void Flattener::flatten(const Statement* stmt) {
+	m_work.push_back({ stmt, false });
+
+	while (!m_work.empty()) {
+		Step step = m_work.back();
+		m_work.pop_back();
+
+		if (!step.stmt)
+			m_stack.push_back(NO_NODE);
+		else if (step.build)
+			m_stack.push_back(build(step.stmt));
+		else {
+			m_work.push_back({ step.stmt, true });
+			push_children(step.stmt);
+		}
+	}
+}
+
+// Last child first, so that the first one is flattened first.
+void Flattener::push_children(const Statement* stmt) {
+	auto push = [&](const Statement* child) {
+		m_work.push_back({ child, false });
+	};
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT: {
+		AstList<Statement*> statements = static_cast<const CompoundStatement*>(stmt)->statements();
+		for (uint32_t i = statements.size(); i-- > 0;)
+			push(statements[i]);
+		break;
+	}
+	case NodeKind::VARIABLE_DECLARATION:
+		push(static_cast<const VariableDeclaration*>(stmt)->initial_value());
+		break;
+	case NodeKind::FUNCTION_DECLARATION:
+		push(static_cast<const FunctionDeclaration*>(stmt)->statement());
+		break;
+	case NodeKind::IF_STATEMENT: {
+		auto if_stmt = static_cast<const IfStatement*>(stmt);
+		push(if_stmt->statement());
+		push(if_stmt->condition());
+		break;
+	}
+	case NodeKind::FOR_STATEMENT: {
+		auto for_stmt = static_cast<const ForStatement*>(stmt);
+		push(for_stmt->statement());
+		push(for_stmt->loop_expr());
+		push(for_stmt->condition_expr());
+		push(for_stmt->variable_declaration());
+		break;
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		auto while_stmt = static_cast<const WhileStatement*>(stmt);
+		push(while_stmt->statement());
+		push(while_stmt->condition_expr());
+		break;
+	}
+	case NodeKind::RETURN_STATEMENT:
+		push(static_cast<const ReturnStatement*>(stmt)->return_expr());
+		break;
+	case NodeKind::BINARY_EXPRESSION: {
+		auto binary = static_cast<const BinaryExpression*>(stmt);
+		push(binary->right());
+		push(binary->left());
+		break;
+	}
+	case NodeKind::UNARY_EXPRESSION:
+		push(static_cast<const UnaryExpression*>(stmt)->expr());
+		break;
+	case NodeKind::FUNC_CALL_ATOM: {
+		AstList<Expression*> arguments = static_cast<const FuncCallAtom*>(stmt)->arguments();
+		for (uint32_t i = arguments.size(); i-- > 0;)
+			push(arguments[i]);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+// Takes the handles of the children off m_stack, last child first.
+NodeHandle Flattener::build(const Statement* stmt) {
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT: {
+		size_t first = m_stack.size() - static_cast<const CompoundStatement*>(stmt)->statements().size();
+		NodeHandle node = m_builder.add_compound_statement(m_stack.data() + first, static_cast<uint32_t>(m_stack.size() - first));
+		m_stack.resize(first);
+
+		return node;
+	}
+	case NodeKind::VARIABLE_DECLARATION: {
+		auto var_decl = static_cast<const VariableDeclaration*>(stmt);
+		return m_builder.add_variable_declaration(var_decl->type(), var_decl->id(), pop());
+	}
+	case NodeKind::FUNCTION_DECLARATION: {
+		auto func_decl = static_cast<const FunctionDeclaration*>(stmt);
+		AstList<TypedId> params = func_decl->parameters();
+
+		return m_builder.add_function_declaration(func_decl->return_type(), func_decl->id(), params.begin(), params.size(), pop());
+	}
+	case NodeKind::IF_STATEMENT: {
+		NodeHandle statement = pop();
+		NodeHandle condition = pop();
+
+		return m_builder.add_if_statement(condition, statement);
+	}
+	case NodeKind::FOR_STATEMENT: {
+		NodeHandle statement = pop();
+		NodeHandle loop = pop();
+		NodeHandle condition = pop();
+		NodeHandle var_decl = pop();
+
+		return m_builder.add_for_statement(var_decl, condition, loop, statement);
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		NodeHandle statement = pop();
+		NodeHandle condition = pop();
+
+		return m_builder.add_while_statement(condition, statement);
+	}
+	case NodeKind::RETURN_STATEMENT:
+		return m_builder.add_return_statement(pop());
+	case NodeKind::BINARY_EXPRESSION: {
+		NodeHandle right = pop();
+		NodeHandle left = pop();
+
+		return m_builder.add_binary_expression(static_cast<const BinaryExpression*>(stmt)->op(), left, right);
+	}
+	case NodeKind::UNARY_EXPRESSION:
+		return m_builder.add_unary_expression(static_cast<const UnaryExpression*>(stmt)->op(), pop());
+	case NodeKind::ID_ATOM:
+		return m_builder.add_id_atom(static_cast<const IdAtom*>(stmt)->id());
+	case NodeKind::FUNC_CALL_ATOM: {
+		auto call = static_cast<const FuncCallAtom*>(stmt);
+		size_t first = m_stack.size() - call->arguments().size();
+		NodeHandle node = m_builder.add_func_call_atom(call->id(), m_stack.data() + first, static_cast<uint32_t>(m_stack.size() - first));
+		m_stack.resize(first);
+
+		return node;
+	}
+	case NodeKind::INT_LITERAL:
+		return m_builder.add_int_literal(static_cast<const IntLiteral*>(stmt)->integer());
+	case NodeKind::FLOAT_LITERAL:
+		return m_builder.add_float_literal(static_cast<const FloatLiteral*>(stmt)->floating());
+	case NodeKind::BOOL_LITERAL:
+		return m_builder.add_bool_literal(static_cast<const BoolLiteral*>(stmt)->boolean());
+	}
+
+	return NO_NODE;
+}
+
+NodeHandle Flattener::pop() {
+	NodeHandle node = m_stack.back();
+	m_stack.pop_back();
+
+	return node;
+}
+
+FlatAst flatten(const TranslationUnit& unit) {
+	return Flattener().flatten(unit);
+}
+
+TranslationUnit* unflatten(const FlatAst& ast, AstContext& context) {
+	std::vector<std::string_view> names(ast.name_count());
+	for (uint32_t i = 0; i < ast.name_count(); i++)
+		names[i] = context.make_string(ast.name(i));
+
+	// Operands always have smaller handles than their parents, so one pass in
+	// handle order finds every child already built.
+	std::vector<Statement*> nodes(ast.size());
+	std::vector<Statement*> statements;
+	std::vector<Expression*> arguments;
+	std::vector<TypedId> parameters;
+
+	auto node = [&](NodeHandle handle) {
+		return handle == NO_NODE ? nullptr : nodes[handle];
+	};
+	auto expression = [&](NodeHandle handle) {
+		return static_cast<Expression*>(node(handle));
+	};
+
+	for (NodeHandle handle = 0; handle < ast.size(); handle++) {
+		uint32_t lhs = ast.lhs(handle);
+		uint32_t rhs = ast.rhs(handle);
+
+		switch (ast.kind(handle)) {
+		case NodeKind::COMPOUND_STATEMENT:
+			statements.clear();
+			for (uint32_t i = 0; i < rhs; i++)
+				statements.push_back(node(ast.extra(lhs + i)));
+
+			nodes[handle] = context.create<CompoundStatement>(context.make_list(statements.data(), statements.size()));
+			break;
+		case NodeKind::VARIABLE_DECLARATION:
+			nodes[handle] = context.create<VariableDeclaration>(ast.type(handle), names[lhs], expression(rhs));
+			break;
+		case NodeKind::FUNCTION_DECLARATION: {
+			uint32_t count = ast.extra(rhs + 1);
+
+			parameters.clear();
+			for (uint32_t i = 0; i < count; i++)
+				parameters.push_back({ static_cast<Type>(ast.extra(rhs + 2 + 2 * i)), names[ast.extra(rhs + 3 + 2 * i)] });
+
+			nodes[handle] = context.create<FunctionDeclaration>(ast.type(handle), names[lhs], context.make_list(parameters.data(), parameters.size()),
+				static_cast<CompoundStatement*>(node(ast.extra(rhs))));
+			break;
+		}
+		case NodeKind::IF_STATEMENT:
+			nodes[handle] = context.create<IfStatement>(expression(lhs), node(rhs));
+			break;
+		case NodeKind::FOR_STATEMENT:
+			nodes[handle] = context.create<ForStatement>(static_cast<VariableDeclaration*>(node(ast.extra(lhs))),
+				expression(ast.extra(lhs + 1)), expression(ast.extra(lhs + 2)), node(rhs));
+			break;
+		case NodeKind::WHILE_STATEMENT:
+			nodes[handle] = context.create<WhileStatement>(expression(lhs), node(rhs));
+			break;
+		case NodeKind::RETURN_STATEMENT:
+			nodes[handle] = context.create<ReturnStatement>(expression(lhs));
+			break;
+		case NodeKind::BINARY_EXPRESSION:
+			nodes[handle] = context.create<BinaryExpression>(ast.binary_op(handle), expression(lhs), expression(rhs));
+			break;
+		case NodeKind::UNARY_EXPRESSION:
+			nodes[handle] = context.create<UnaryExpression>(ast.unary_op(handle), expression(lhs));
+			break;
+		case NodeKind::ID_ATOM:
+			nodes[handle] = context.create<IdAtom>(names[lhs]);
+			break;
+		case NodeKind::FUNC_CALL_ATOM: {
+			uint32_t count = ast.extra(rhs);
+
+			arguments.clear();
+			for (uint32_t i = 0; i < count; i++)
+				arguments.push_back(expression(ast.extra(rhs + 1 + i)));
+
+			nodes[handle] = context.create<FuncCallAtom>(names[lhs], context.make_list(arguments.data(), arguments.size()));
+			break;
+		}
+		case NodeKind::INT_LITERAL:
+			nodes[handle] = context.int_literal(ast.int_value(handle));
+			break;
+		case NodeKind::FLOAT_LITERAL:
+			nodes[handle] = context.float_literal(ast.float_value(handle));
+			break;
+		case NodeKind::BOOL_LITERAL:
+			nodes[handle] = context.create<BoolLiteral>(ast.bool_value(handle));
+			break;
+		}
+	}
+
+	statements.clear();
+	for (uint32_t i = 0; i < ast.top_level_count(); i++)
+		statements.push_back(nodes[ast.top_level(i)]);
+
+	return context.create<TranslationUnit>(context.make_list(statements.data(), statements.size()));
+}
\ No newline at end of file
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "AST.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using NodeHandle = uint32_t;
+
+constexpr NodeHandle NO_NODE = UINT32_MAX;
+
+// The same tree as AST.h, stored as parallel arrays indexed by a 32-bit handle.
+// Children are always added before their parent, so walking the handles in
+// increasing order visits every node after all of its operands.
+//
+// What lhs/rhs hold depends on the kind ("extra" indexes m_extra):
+//   COMPOUND_STATEMENT    lhs: extra of the first child, rhs: child count
+//   VARIABLE_DECLARATION  tag: Type, lhs: name, rhs: initial value
+//   FUNCTION_DECLARATION  tag: return Type, lhs: name, rhs: extra of [body, count, (type, name)...]
+//   IF_STATEMENT          lhs: condition, rhs: statement
+//   FOR_STATEMENT         lhs: extra of [declaration, condition, loop], rhs: statement
+//   WHILE_STATEMENT       lhs: condition, rhs: statement
+//   RETURN_STATEMENT      lhs: return value
+//   BINARY_EXPRESSION     tag: BinaryOp, lhs/rhs: operands
+//   UNARY_EXPRESSION      tag: UnaryOp, lhs: operand
+//   ID_ATOM               lhs: name
+//   FUNC_CALL_ATOM        lhs: name, rhs: extra of [count, arguments...]
+//   *_LITERAL             lhs: bits of the value
+class FlatAst {
+public:
+	uint32_t size() const;
+
+	NodeKind kind(NodeHandle node) const;
+	uint8_t tag(NodeHandle node) const;
+	uint32_t lhs(NodeHandle node) const;
+	uint32_t rhs(NodeHandle node) const;
+	uint32_t extra(uint32_t index) const;
+
+	Type type(NodeHandle node) const;
+	BinaryOp binary_op(NodeHandle node) const;
+	UnaryOp unary_op(NodeHandle node) const;
+	int int_value(NodeHandle node) const;
+	float float_value(NodeHandle node) const;
+	bool bool_value(NodeHandle node) const;
+
+	std::string_view name(uint32_t name) const;
+	uint32_t name_count() const;
+
+	uint32_t top_level_count() const;
+	NodeHandle top_level(uint32_t index) const;
+
+	size_t memory_usage() const;
+
+private:
+	friend class FlatAstBuilder;
+	friend class AstCache;
+
+	std::vector<NodeKind> m_kinds;
+	std::vector<uint8_t> m_tags;
+	std::vector<uint32_t> m_lhs;
+	std::vector<uint32_t> m_rhs;
+	std::vector<uint32_t> m_extra;
+
+	std::string m_names;
+	std::vector<uint32_t> m_name_offsets = { 0 };
+
+	uint32_t m_top_level_first = 0;
+	uint32_t m_top_level_count = 0;
+};
+
+// One add_* call per parser production; lists are passed in as (data, count)
+// so a parser can collect them on a scratch stack, as Parser does.
+class FlatAstBuilder {
+public:
+	NodeHandle add_compound_statement(const NodeHandle* stmts, uint32_t count);
+	NodeHandle add_variable_declaration(Type type, std::string_view id, NodeHandle init_value);
+	NodeHandle add_function_declaration(Type ret_type, std::string_view id, const TypedId* params, uint32_t count, NodeHandle stmt);
+	NodeHandle add_if_statement(NodeHandle condition, NodeHandle statement);
+	NodeHandle add_for_statement(NodeHandle var_decl, NodeHandle condition_expr, NodeHandle loop_expr, NodeHandle stmt);
+	NodeHandle add_while_statement(NodeHandle condition_expr, NodeHandle statement);
+	NodeHandle add_return_statement(NodeHandle return_expr);
+	NodeHandle add_binary_expression(BinaryOp op, NodeHandle left, NodeHandle right);
+	NodeHandle add_unary_expression(UnaryOp op, NodeHandle expr);
+	NodeHandle add_id_atom(std::string_view id);
+	NodeHandle add_func_call_atom(std::string_view id, const NodeHandle* args, uint32_t count);
+	NodeHandle add_int_literal(int integer);
+	NodeHandle add_float_literal(float floating);
+	NodeHandle add_bool_literal(bool boolean);
+
+	FlatAst finish(const NodeHandle* statements, uint32_t count);
+
+private:
+	NodeHandle add_node(NodeKind kind, uint8_t tag, uint32_t lhs, uint32_t rhs);
+	uint32_t add_name(std::string_view name);
+
+private:
+	FlatAst m_ast;
+	std::unordered_map<std::string, uint32_t> m_name_ids;
+};
+
+class AstContext;
+
+FlatAst flatten(const TranslationUnit& unit);
+
+// The inverse of flatten: rebuilds the pointer tree in context.
+TranslationUnit* unflatten(const FlatAst& ast, AstContext& context);
+
+inline uint32_t FlatAst::size() const {
+	return static_cast<uint32_t>(m_kinds.size());
+}
+
+inline NodeKind FlatAst::kind(NodeHandle node) const {
+	return m_kinds[node];
+}
+
+inline uint8_t FlatAst::tag(NodeHandle node) const {
+	return m_tags[node];
+}
+
+inline uint32_t FlatAst::lhs(NodeHandle node) const {
+	return m_lhs[node];
+}
+
+inline uint32_t FlatAst::rhs(NodeHandle node) const {
+	return m_rhs[node];
+}
+
+inline uint32_t FlatAst::extra(uint32_t index) const {
+	return m_extra[index];
+}
+
+inline Type FlatAst::type(NodeHandle node) const {
+	return static_cast<Type>(m_tags[node]);
+}
+
+inline BinaryOp FlatAst::binary_op(NodeHandle node) const {
+	return static_cast<BinaryOp>(m_tags[node]);
+}
+
+inline UnaryOp FlatAst::unary_op(NodeHandle node) const {
+	return static_cast<UnaryOp>(m_tags[node]);
+}
\ No newline at end of file
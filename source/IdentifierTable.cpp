@@ -0,0 +1,71 @@
+#include "IdentifierTable.h"
+
+#include <utility>
+
+static constexpr size_t INITIAL_CAPACITY = 256;
+
+IdentifierTable::IdentifierTable()
+	: m_slots(INITIAL_CAPACITY) {}
+
+// FNV-1a, with the high half folded into the low bits that pick the slot.
+uint32_t IdentifierTable::hash(std::string_view name) {
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	for (char c : name) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3ull;
+	}
+
+	return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+uint32_t IdentifierTable::intern(std::string_view name) {
+	uint32_t name_hash = hash(name);
+	size_t mask = m_slots.size() - 1;
+
+	for (size_t i = name_hash & mask;; i = (i + 1) & mask) {
+		Slot& slot = m_slots[i];
+
+		if (slot.id == 0) {
+			uint32_t id = static_cast<uint32_t>(m_names.size());
+
+			slot = { name_hash, id + 1 };
+			m_names.push_back(name);
+
+			// Kept at most half full, so that probe runs stay short.
+			if (m_names.size() * 2 > m_slots.size())
+				grow();
+
+			return id;
+		}
+
+		if (slot.hash == name_hash && m_names[slot.id - 1] == name)
+			return slot.id - 1;
+	}
+}
+
+void IdentifierTable::grow() {
+	std::vector<Slot> slots(m_slots.size() * 2);
+	size_t mask = slots.size() - 1;
+
+	for (const Slot& slot : m_slots) {
+		if (slot.id == 0)
+			continue;
+
+		size_t i = slot.hash & mask;
+		while (slots[i].id != 0)
+			i = (i + 1) & mask;
+
+		slots[i] = slot;
+	}
+
+	m_slots = std::move(slots);
+}
+
+std::string_view IdentifierTable::name(uint32_t id) const {
+	return m_names[id];
+}
+
+uint32_t IdentifierTable::size() const {
+	return static_cast<uint32_t>(m_names.size());
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Maps every distinct name to a dense id, so that later lookups are array
+// indexing. Open addressing with linear probing over one flat array; names
+// are not copied and have to outlive the table, as AST names do.
+class IdentifierTable {
+public:
+	IdentifierTable();
+
+	uint32_t intern(std::string_view name);
+
+	std::string_view name(uint32_t id) const;
+	uint32_t size() const;
+
+private:
+	struct Slot {
+		uint32_t hash;
+		// Id plus one, zero for an empty slot.
+		uint32_t id;
+	};
+
+	static uint32_t hash(std::string_view name);
+	void grow();
+
+private:
+	std::vector<Slot> m_slots;
+	std::vector<std::string_view> m_names;
+};
\ No newline at end of file
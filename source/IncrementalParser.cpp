@@ -0,0 +1,210 @@
+#include "IncrementalParser.h"
+
+#include <algorithm>
+
+// Every pass parses into a context of its own, which lives until the last of
+// its segments is replaced. Once edits have spread over this many of them the
+// whole file is parsed again into one.
+static constexpr size_t MAX_LIVE_CONTEXTS = 32;
+
+static uint32_t find_line_start(std::string_view text, uint32_t offset) {
+	while (offset != 0 && text[offset - 1] != '\n')
+		offset--;
+
+	return offset;
+}
+
+IncrementalParser::IncrementalParser(std::string text)
+	: m_text(std::move(text)) {
+	reparse();
+	link();
+}
+
+TranslationUnit* IncrementalParser::apply(const std::vector<TextEdit>& edits) {
+	for (const TextEdit& e : edits)
+		edit(e);
+
+	reparse();
+	link();
+
+	return m_unit;
+}
+
+TranslationUnit* IncrementalParser::unit() const {
+	return m_unit;
+}
+
+const AstContext& IncrementalParser::context() const {
+	return *m_context;
+}
+
+const std::vector<Diagnostic>& IncrementalParser::diagnostics() const {
+	return m_diagnostics;
+}
+
+std::string_view IncrementalParser::text() const {
+	return m_text;
+}
+
+size_t IncrementalParser::reparsed_bytes() const {
+	return m_reparsed_bytes;
+}
+
+void IncrementalParser::edit(const TextEdit& edit) {
+	uint32_t offset = static_cast<uint32_t>(std::min<size_t>(edit.offset, m_text.size()));
+	uint32_t removed = static_cast<uint32_t>(std::min<size_t>(edit.removed, m_text.size() - offset));
+	int64_t delta = static_cast<int64_t>(edit.inserted.size()) - removed;
+
+	// A text without statements still needs something to mark dirty.
+	if (m_segments.empty()) {
+		Segment segment;
+		segment.lookahead_end = static_cast<uint32_t>(m_text.size());
+		m_segments.push_back(std::move(segment));
+	}
+
+	m_text.replace(offset, removed, edit.inserted);
+
+	// Together the segments and their lookahead cover the whole text, so this
+	// dirties at least one of them. Touching the edit counts too, since the
+	// tokenizer looks one character past each token.
+	for (Segment& segment : m_segments) {
+		if (segment.lookahead_end < offset)
+			continue;
+
+		if (segment.begin > offset + removed) {
+			segment.begin = static_cast<uint32_t>(segment.begin + delta);
+			segment.end = static_cast<uint32_t>(segment.end + delta);
+			segment.lookahead_end = static_cast<uint32_t>(segment.lookahead_end + delta);
+			continue;
+		}
+
+		segment.begin = std::min(segment.begin, offset);
+		segment.end = static_cast<uint32_t>(std::max(segment.end, offset + removed) + delta);
+		segment.lookahead_end = static_cast<uint32_t>(std::max(segment.lookahead_end, offset + removed) + delta);
+		segment.dirty = true;
+	}
+}
+
+void IncrementalParser::reparse() {
+	m_reparsed_bytes = 0;
+
+	if (!m_segments.empty() && std::none_of(m_segments.begin(), m_segments.end(), [](const Segment& segment) { return segment.dirty; }))
+		return;
+
+	// Parsing all of the text again leaves nothing that refers to the old
+	// constants.
+	if (std::all_of(m_segments.begin(), m_segments.end(), [](const Segment& segment) { return segment.dirty; }))
+		m_context = std::make_unique<AstContext>();
+
+	SourceBuffer source(std::string_view{ m_text });
+	auto context = std::make_shared<AstContext>();
+	m_passes.push_back(context);
+
+	std::vector<Segment> segments;
+	int line = 1;
+	size_t i = 0;
+
+	// The first parse has no segments yet and starts as one dirty run.
+	do {
+		if (i < m_segments.size() && !m_segments[i].dirty) {
+			move_segment(m_segments[i], line);
+			line += m_segments[i].newlines;
+			segments.push_back(std::move(m_segments[i++]));
+			continue;
+		}
+
+		// Between two top-level statements the parser carries no state but the
+		// position, so it can start over at the end of an untouched segment and
+		// stop as soon as it reaches the start of the next untouched one.
+		uint32_t run_begin = i < m_segments.size() ? m_segments[i].begin : 0;
+		Parser parser(source, { run_begin, static_cast<uint32_t>(source.size()) }, *context);
+		// Stopping at a limit would leave the rest of the text without segments.
+		parser.set_error_limit(0);
+		bool synced = false;
+
+		while (!synced) {
+			Segment segment;
+			segment.begin = parser.consumed_end();
+			segment.line = line;
+
+			// A fresh parse may drop the segment's first diagnostic for being at
+			// the position of the last one before it; link() decides that.
+			size_t first_diagnostic = parser.diagnostic_count();
+			parser.separate_diagnostics();
+			segment.statement = parser.parse_top_level_statement();
+			segment.end = parser.consumed_end();
+			segment.lookahead_end = parser.lookahead_end();
+
+			if (!segment.statement && segment.end == segment.begin)
+				break;
+
+			segment.newlines = static_cast<int>(std::count(m_text.begin() + segment.begin, m_text.begin() + segment.end, '\n'));
+			segment.diagnostics = parser.diagnostics(first_diagnostic);
+			if (!segment.diagnostics.empty())
+				segment.column = segment.begin - find_line_start(m_text, segment.begin);
+			segment.context = context;
+			segment.dirty = false;
+
+			m_reparsed_bytes += segment.end - segment.begin;
+			line += segment.newlines;
+			segments.push_back(std::move(segment));
+
+			if (!segments.back().statement)
+				break;
+
+			uint32_t cut = segments.back().end;
+			while (i < m_segments.size() && m_segments[i].begin < cut)
+				i++;
+
+			synced = i < m_segments.size() && !m_segments[i].dirty && m_segments[i].begin == cut;
+		}
+
+		if (!synced)
+			break;
+	} while (i < m_segments.size());
+
+	m_segments = std::move(segments);
+	m_context->intern_constants(*context);
+}
+
+void IncrementalParser::move_segment(Segment& segment, int line) {
+	if (segment.diagnostics.empty()) {
+		segment.line = line;
+		return;
+	}
+
+	// Only the first line of a segment shares text with the segment before,
+	// so only columns on it can have shifted.
+	uint32_t column = segment.begin - find_line_start(m_text, segment.begin);
+
+	for (Diagnostic& diagnostic : segment.diagnostics) {
+		if (diagnostic.pos.line == segment.line)
+			diagnostic.pos.column += static_cast<int>(column) - static_cast<int>(segment.column);
+
+		diagnostic.pos.line += line - segment.line;
+	}
+
+	segment.line = line;
+	segment.column = column;
+}
+
+void IncrementalParser::link() {
+	m_statements.clear();
+	m_diagnostics.clear();
+
+	for (const Segment& segment : m_segments) {
+		if (segment.statement)
+			m_statements.push_back(segment.statement);
+
+		append_diagnostics(m_diagnostics, segment.diagnostics);
+	}
+
+	m_translation_unit.emplace(AstList<Statement*>(m_statements.data(), static_cast<uint32_t>(m_statements.size())));
+	m_unit = &*m_translation_unit;
+
+	m_passes.erase(std::remove_if(m_passes.begin(), m_passes.end(), [](const std::weak_ptr<AstContext>& pass) { return pass.expired(); }), m_passes.end());
+	if (m_passes.size() > MAX_LIVE_CONTEXTS) {
+		for (Segment& segment : m_segments)
+			segment.dirty = true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Parser.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Replaces removed bytes at offset with inserted. Offsets refer to the text as
+// it is after the edits before it in the same batch.
+struct TextEdit {
+	uint32_t offset = 0;
+	uint32_t removed = 0;
+	std::string inserted;
+};
+
+// Keeps the parse of one file up to date under text edits. The file is cut
+// where the parser finished each top-level statement; an edit re-tokenizes and
+// reparses from the first statement it touches until the parser lines up with
+// the start of an untouched one again, whose tree is then reused as it is.
+// The result is always the one a fresh Parser would produce for the new text.
+class IncrementalParser {
+public:
+	IncrementalParser(std::string text);
+
+	IncrementalParser(const IncrementalParser&) = delete;
+	IncrementalParser& operator=(const IncrementalParser&) = delete;
+
+	TranslationUnit* apply(const std::vector<TextEdit>& edits);
+
+	TranslationUnit* unit() const;
+	// Holds the constants that the literals of unit() index.
+	const AstContext& context() const;
+	const std::vector<Diagnostic>& diagnostics() const;
+	std::string_view text() const;
+
+	// Bytes that the last parse had to tokenize again.
+	size_t reparsed_bytes() const;
+
+private:
+	struct Segment {
+		uint32_t begin = 0;
+		uint32_t end = 0;
+		// The parser peeks at the token after a statement, so edits up to the
+		// end of that token can change how the statement parses.
+		uint32_t lookahead_end = 0;
+		// Where the segment started when it was parsed; diagnostics are moved
+		// along with it.
+		int line = 1;
+		uint32_t column = 0;
+		int newlines = 0;
+		Statement* statement = nullptr;
+		std::vector<Diagnostic> diagnostics;
+		// Shared by all segments that were parsed in the same pass.
+		std::shared_ptr<AstContext> context;
+		bool dirty = true;
+	};
+
+	void edit(const TextEdit& edit);
+	void reparse();
+	void move_segment(Segment& segment, int line);
+	void link();
+
+private:
+	std::string m_text;
+	std::vector<Segment> m_segments;
+	std::vector<std::weak_ptr<AstContext>> m_passes;
+	// The constants of every pass since the whole file was last parsed, which
+	// the pass renumbers its literals to once it is done; those of statements
+	// that are gone again stay until then.
+	std::unique_ptr<AstContext> m_context;
+	std::vector<Statement*> m_statements;
+	std::optional<TranslationUnit> m_translation_unit;
+	TranslationUnit* m_unit = nullptr;
+	std::vector<Diagnostic> m_diagnostics;
+	size_t m_reparsed_bytes = 0;
+};
\ No newline at end of file
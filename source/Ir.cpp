@@ -0,0 +1,492 @@
+#include "Ir.h"
+#include "DominatorTree.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <unordered_set>
+
+bool IrInstruction::has_side_effects() const {
+	switch (op) {
+	case IrOp::STORE_GLOBAL:
+	case IrOp::CALL:
+	case IrOp::JUMP:
+	case IrOp::BRANCH:
+	case IrOp::RETURN:
+		return true;
+	case IrOp::DIV:
+		// Traps on zero.
+		return type == Type::INT;
+	default:
+		return false;
+	}
+}
+
+IrInstruction* IrBlock::terminator() const {
+	if (instructions.empty() || !instructions.back()->is_terminator())
+		return nullptr;
+
+	return instructions.back();
+}
+
+size_t IrBlock::first_non_phi() const {
+	size_t i = 0;
+	while (i < instructions.size() && instructions[i]->op == IrOp::PHI)
+		i++;
+
+	return i;
+}
+
+IrBlock* IrFunction::create_block() {
+	blocks.push_back(std::make_unique<IrBlock>());
+	blocks.back()->id = static_cast<uint32_t>(blocks.size() - 1);
+
+	return blocks.back().get();
+}
+
+IrInstruction* IrFunction::create(IrOp op, Type type, std::vector<IrInstruction*> args, uint32_t imm) {
+	instructions.push_back(std::make_unique<IrInstruction>());
+
+	IrInstruction* instruction = instructions.back().get();
+	instruction->op = op;
+	instruction->type = type;
+	instruction->imm = imm;
+	instruction->id = static_cast<uint32_t>(instructions.size() - 1);
+	instruction->args = std::move(args);
+
+	return instruction;
+}
+
+size_t IrFunction::instruction_count() const {
+	size_t count = 0;
+	for (const auto& block : blocks)
+		count += block->instructions.size();
+
+	return count;
+}
+
+void IrFunction::renumber() {
+	uint32_t next_id = 0;
+
+	for (size_t i = 0; i < blocks.size(); i++) {
+		blocks[i]->id = static_cast<uint32_t>(i);
+
+		for (IrInstruction* instruction : blocks[i]->instructions)
+			instruction->id = next_id++;
+	}
+}
+
+void IrFunction::remove_edge(IrBlock* from, IrBlock* to) {
+	auto successor = std::find(from->successors.begin(), from->successors.end(), to);
+	if (successor != from->successors.end())
+		from->successors.erase(successor);
+
+	auto predecessor = std::find(to->predecessors.begin(), to->predecessors.end(), from);
+	if (predecessor == to->predecessors.end())
+		return;
+
+	size_t index = predecessor - to->predecessors.begin();
+	to->predecessors.erase(predecessor);
+
+	for (size_t i = 0; i < to->first_non_phi(); i++)
+		to->instructions[i]->args.erase(to->instructions[i]->args.begin() + index);
+}
+
+bool IrFunction::remove_unreachable_blocks() {
+	std::unordered_set<IrBlock*> reachable;
+	std::vector<IrBlock*> stack{ blocks[0].get() };
+	reachable.insert(blocks[0].get());
+
+	while (!stack.empty()) {
+		IrBlock* block = stack.back();
+		stack.pop_back();
+
+		for (IrBlock* successor : block->successors) {
+			if (reachable.insert(successor).second)
+				stack.push_back(successor);
+		}
+	}
+
+	if (reachable.size() == blocks.size())
+		return false;
+
+	for (auto& block : blocks) {
+		if (reachable.count(block.get()))
+			continue;
+
+		while (!block->successors.empty())
+			remove_edge(block.get(), block->successors.back());
+	}
+
+	blocks.erase(std::remove_if(blocks.begin(), blocks.end(), [&](const auto& block) { return !reachable.count(block.get()); }), blocks.end());
+	renumber();
+
+	return true;
+}
+
+const char* ir_op_name(IrOp op) {
+	static const char* names[] = {
+#define X(name) #name,
+		TOY_IR_OPS(X)
+#undef X
+	};
+
+	return names[static_cast<size_t>(op)];
+}
+
+static const char* type_name(Type type) {
+	switch (type) {
+	case Type::BOOL:
+		return "bool";
+	case Type::INT:
+		return "int";
+	case Type::FLOAT:
+		return "float";
+	default:
+		return "void";
+	}
+}
+
+static std::string lower_name(IrOp op) {
+	std::string name = ir_op_name(op);
+	std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+	return name;
+}
+
+static std::string constant_text(const IrInstruction& instruction) {
+	switch (instruction.type) {
+	case Type::FLOAT: {
+		float value;
+		std::memcpy(&value, &instruction.imm, sizeof(value));
+		return std::to_string(value);
+	}
+	case Type::BOOL:
+		return instruction.imm ? "true" : "false";
+	default:
+		return std::to_string(static_cast<int32_t>(instruction.imm));
+	}
+}
+
+// Where each instruction of the function sits, by id, so that lookups need no
+// hashing. Instructions that no block holds may share an id with one that does.
+struct Positions {
+	std::vector<const IrInstruction*> instructions;
+	std::vector<uint32_t> indices;
+
+	Positions(const IrFunction& function)
+		: instructions(function.instructions.size()), indices(function.instructions.size()) {}
+
+	void add(const IrInstruction* instruction, uint32_t index) {
+		if (instruction->id < instructions.size()) {
+			instructions[instruction->id] = instruction;
+			indices[instruction->id] = index;
+		}
+	}
+
+	bool contains(const IrInstruction* instruction) const {
+		return instruction->id < instructions.size() && instructions[instruction->id] == instruction;
+	}
+
+	uint32_t operator[](const IrInstruction* instruction) const {
+		return indices[instruction->id];
+	}
+};
+
+std::string dump_ir(const IrModule& module, const IrFunction& function) {
+	Positions values(function);
+	uint32_t value_count = 0;
+
+	for (const auto& block : function.blocks) {
+		for (const IrInstruction* instruction : block->instructions) {
+			if (instruction->type != Type::VOID)
+				values.add(instruction, value_count++);
+		}
+	}
+
+	auto value = [&](const IrInstruction* instruction) {
+		return values.contains(instruction) ? '%' + std::to_string(values[instruction]) : std::string("%?");
+	};
+	auto label = [&](const IrBlock* block) {
+		bool held = block->id < function.blocks.size() && function.blocks[block->id].get() == block;
+		return held ? 'b' + std::to_string(block->id) : std::string("b?");
+	};
+
+	std::string out = "function " + function.name + '(';
+	for (size_t i = 0; i < function.parameters.size(); i++)
+		out += (i ? ", " : "") + std::string(type_name(function.parameters[i]));
+	out += ") -> " + std::string(type_name(function.return_type)) + '\n';
+
+	for (const auto& block : function.blocks) {
+		out += label(block.get()) + ':';
+		for (size_t i = 0; i < block->predecessors.size(); i++)
+			out += (i ? ", " : " ; preds ") + label(block->predecessors[i]);
+		out += '\n';
+
+		for (const IrInstruction* instruction : block->instructions) {
+			out += '\t';
+			if (instruction->type != Type::VOID)
+				out += value(instruction) + ": " + type_name(instruction->type) + " = ";
+			out += lower_name(instruction->op);
+
+			switch (instruction->op) {
+			case IrOp::CONST:
+				out += ' ' + constant_text(*instruction);
+				break;
+			case IrOp::PARAM:
+				out += ' ' + std::to_string(instruction->imm);
+				break;
+			case IrOp::LOAD_GLOBAL:
+				out += " g" + std::to_string(instruction->imm);
+				break;
+			case IrOp::STORE_GLOBAL:
+				out += " g" + std::to_string(instruction->imm) + ", " + value(instruction->args[0]);
+				break;
+			case IrOp::CALL:
+				out += ' ' + (instruction->imm < module.functions.size() ? module.functions[instruction->imm].name : "?") + '(';
+				for (size_t i = 0; i < instruction->args.size(); i++)
+					out += (i ? ", " : "") + value(instruction->args[i]);
+				out += ')';
+				break;
+			case IrOp::PHI:
+				for (size_t i = 0; i < instruction->args.size(); i++) {
+					out += (i ? ", [" : " [") + value(instruction->args[i]) + ", ";
+					out += (i < block->predecessors.size() ? label(block->predecessors[i]) : std::string("b?")) + ']';
+				}
+				break;
+			case IrOp::JUMP:
+			case IrOp::BRANCH:
+				for (size_t i = 0; i < instruction->args.size(); i++)
+					out += (i ? ", " : " ") + value(instruction->args[i]);
+				for (size_t i = 0; i < block->successors.size(); i++)
+					out += (i || !instruction->args.empty() ? ", " : " ") + label(block->successors[i]);
+				break;
+			default:
+				for (size_t i = 0; i < instruction->args.size(); i++)
+					out += (i ? ", " : " ") + value(instruction->args[i]);
+				break;
+			}
+
+			out += '\n';
+		}
+	}
+
+	return out;
+}
+
+std::string dump_ir(const IrModule& module) {
+	std::string out;
+
+	for (const IrFunction& function : module.functions)
+		out += dump_ir(module, function) + '\n';
+
+	return out;
+}
+
+static size_t successor_count(IrOp op) {
+	switch (op) {
+	case IrOp::JUMP:
+		return 1;
+	case IrOp::BRANCH:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+static bool is_number(Type type) {
+	return type == Type::INT || type == Type::FLOAT;
+}
+
+// Returns what is wrong with the types of an instruction's operands and value.
+static const char* check_types(const IrModule& module, const IrFunction& function, const IrInstruction& instruction) {
+	const std::vector<IrInstruction*>& args = instruction.args;
+
+	auto arity = [&](size_t count) { return args.size() == count; };
+	auto arg_type = [&](size_t index) { return args[index]->type; };
+
+	switch (instruction.op) {
+	case IrOp::CONST:
+		return arity(0) && instruction.type != Type::VOID ? nullptr : "constant without a type";
+	case IrOp::PARAM:
+		if (!arity(0) || instruction.imm >= function.parameters.size())
+			return "no such parameter";
+		return instruction.type == function.parameters[instruction.imm] ? nullptr : "parameter of the wrong type";
+	case IrOp::LOAD_GLOBAL:
+		return arity(0) && instruction.imm < module.global_count && instruction.type != Type::VOID ? nullptr : "bad global load";
+	case IrOp::STORE_GLOBAL:
+		return arity(1) && instruction.imm < module.global_count && instruction.type == Type::VOID ? nullptr : "bad global store";
+	case IrOp::ADD:
+	case IrOp::SUB:
+	case IrOp::MUL:
+	case IrOp::DIV:
+		if (!arity(2) || !is_number(instruction.type))
+			return "arithmetic on something other than two numbers";
+		return arg_type(0) == instruction.type && arg_type(1) == instruction.type ? nullptr : "arithmetic on operands of another type";
+	case IrOp::EQ:
+	case IrOp::NE:
+	case IrOp::LT:
+	case IrOp::LE:
+		if (!arity(2) || instruction.type != Type::BOOL)
+			return "comparison that is not a bool of two operands";
+		return is_number(arg_type(0)) && arg_type(0) == arg_type(1) ? nullptr : "comparison of operands of different types";
+	case IrOp::BOOL_TO_INT:
+		return arity(1) && arg_type(0) == Type::BOOL && instruction.type == Type::INT ? nullptr : "bad conversion";
+	case IrOp::INT_TO_FLOAT:
+		return arity(1) && (arg_type(0) == Type::INT || arg_type(0) == Type::BOOL) && instruction.type == Type::FLOAT ? nullptr : "bad conversion";
+	case IrOp::FLOAT_TO_INT:
+		return arity(1) && arg_type(0) == Type::FLOAT && instruction.type == Type::INT ? nullptr : "bad conversion";
+	case IrOp::INT_TO_BOOL:
+		return arity(1) && arg_type(0) == Type::INT && instruction.type == Type::BOOL ? nullptr : "bad conversion";
+	case IrOp::FLOAT_TO_BOOL:
+		return arity(1) && arg_type(0) == Type::FLOAT && instruction.type == Type::BOOL ? nullptr : "bad conversion";
+	case IrOp::CALL: {
+		if (instruction.imm >= module.functions.size())
+			return "call of an unknown function";
+
+		const IrFunction& callee = module.functions[instruction.imm];
+		if (args.size() != callee.parameters.size() || instruction.type != callee.return_type)
+			return "call that does not match the callee";
+		for (size_t i = 0; i < args.size(); i++) {
+			if (arg_type(i) != callee.parameters[i])
+				return "argument of the wrong type";
+		}
+		return nullptr;
+	}
+	case IrOp::PHI:
+		if (instruction.type == Type::VOID)
+			return "phi without a type";
+		for (size_t i = 0; i < args.size(); i++) {
+			if (arg_type(i) != instruction.type)
+				return "phi operand of another type";
+		}
+		return nullptr;
+	case IrOp::JUMP:
+		return arity(0) ? nullptr : "jump with operands";
+	case IrOp::BRANCH:
+		return arity(1) && arg_type(0) == Type::BOOL ? nullptr : "branch on something other than a bool";
+	case IrOp::RETURN:
+		if (function.return_type == Type::VOID)
+			return arity(0) ? nullptr : "value returned from a void function";
+		return arity(1) && arg_type(0) == function.return_type ? nullptr : "return of the wrong type";
+	}
+
+	return nullptr;
+}
+
+std::vector<std::string> verify_ir(const IrModule& module, const IrFunction& function) {
+	std::vector<std::string> errors;
+
+	auto error = [&](const IrBlock* block, const IrInstruction* instruction, const char* message) {
+		std::string text = "function '" + function.name + "', b" + std::to_string(block->id);
+		if (instruction)
+			text += std::string(", ") + ir_op_name(instruction->op);
+		errors.push_back(text + ": " + message);
+	};
+
+	if (function.blocks.empty()) {
+		errors.push_back("function '" + function.name + "' has no blocks");
+		return errors;
+	}
+
+	Positions positions(function);
+	uint32_t next_id = 0;
+	bool numbered = true;
+
+	for (size_t i = 0; i < function.blocks.size(); i++) {
+		const IrBlock* block = function.blocks[i].get();
+		numbered &= block->id == i;
+
+		for (size_t j = 0; j < block->instructions.size(); j++) {
+			numbered &= block->instructions[j]->id == next_id++;
+			positions.add(block->instructions[j], static_cast<uint32_t>(j));
+		}
+	}
+
+	if (!numbered) {
+		errors.push_back("function '" + function.name + "' is not numbered by renumber()");
+		return errors;
+	}
+
+	if (!function.blocks[0]->predecessors.empty())
+		error(function.blocks[0].get(), nullptr, "the entry has predecessors");
+
+	DominatorTree dominators(function);
+
+	for (const auto& owned : function.blocks) {
+		const IrBlock* block = owned.get();
+		const IrInstruction* terminator = block->terminator();
+
+		if (!terminator) {
+			error(block, nullptr, "block does not end in a terminator");
+			continue;
+		}
+
+		if (block->successors.size() != successor_count(terminator->op))
+			error(block, terminator, "wrong number of successors");
+
+		for (const IrBlock* successor : block->successors) {
+			if (std::count(successor->predecessors.begin(), successor->predecessors.end(), block) !=
+				std::count(block->successors.begin(), block->successors.end(), successor))
+				error(block, nullptr, "successor does not list the block as a predecessor");
+		}
+
+		for (const IrBlock* predecessor : block->predecessors) {
+			if (std::find(predecessor->successors.begin(), predecessor->successors.end(), block) == predecessor->successors.end())
+				error(block, nullptr, "predecessor does not list the block as a successor");
+		}
+
+		size_t phi_end = block->first_non_phi();
+
+		for (size_t i = 0; i < block->instructions.size(); i++) {
+			const IrInstruction* instruction = block->instructions[i];
+
+			if (instruction->block != block)
+				error(block, instruction, "instruction does not know its block");
+			if (instruction->is_terminator() && i + 1 != block->instructions.size())
+				error(block, instruction, "terminator in the middle of the block");
+			if (instruction->op == IrOp::PHI && i >= phi_end)
+				error(block, instruction, "phi after other instructions");
+			if (instruction->op == IrOp::PHI && instruction->args.size() != block->predecessors.size()) {
+				error(block, instruction, "phi operands do not match the predecessors");
+				continue;
+			}
+
+			bool defined = true;
+			for (const IrInstruction* arg : instruction->args)
+				defined &= arg && positions.contains(arg);
+
+			if (!defined) {
+				error(block, instruction, "operand that no block holds");
+				continue;
+			}
+
+			if (const char* message = check_types(module, function, *instruction))
+				error(block, instruction, message);
+
+			if (!dominators.reachable(block))
+				continue;
+
+			// A definition has to dominate its uses; for a phi, the end of the
+			// predecessor that the operand comes from.
+			for (size_t j = 0; j < instruction->args.size(); j++) {
+				const IrInstruction* arg = instruction->args[j];
+				const IrBlock* use = instruction->op == IrOp::PHI ? block->predecessors[j] : block;
+				bool dominated;
+
+				if (!dominators.reachable(use))
+					continue;
+
+				if (arg->block == use && use == block && instruction->op != IrOp::PHI)
+					dominated = positions[arg] < i;
+				else
+					dominated = dominators.dominates(arg->block, use);
+
+				if (!dominated)
+					error(block, instruction, "operand that does not dominate its use");
+			}
+		}
+	}
+
+	return errors;
+}
\ No newline at end of file
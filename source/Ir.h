@@ -0,0 +1,98 @@
+#pragma once
+
+#include "AST.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// SSA form: every instruction defines one value of its type, once, and phis
+// merge values at the start of a block. bool values are 0 or 1.
+#define TOY_IR_OPS(X) \
+	X(CONST)         /* imm, as float bits for float */ \
+	X(PARAM)         /* parameter imm */ \
+	X(LOAD_GLOBAL)   /* globals[imm] */ \
+	X(STORE_GLOBAL)  /* globals[imm] = args[0] */ \
+	X(ADD) X(SUB) X(MUL) X(DIV) /* int or float, as the value */ \
+	X(EQ) X(NE) X(LT) X(LE)     /* bool, of two int or two float operands */ \
+	X(BOOL_TO_INT) X(INT_TO_FLOAT) X(FLOAT_TO_INT) X(INT_TO_BOOL) X(FLOAT_TO_BOOL) \
+	X(CALL)          /* functions[imm](args...) */ \
+	X(PHI)           /* args[i] is the value on the edge from predecessors[i] */ \
+	X(JUMP)          /* to successors[0] */ \
+	X(BRANCH)        /* to successors[0] if args[0], else successors[1] */ \
+	X(RETURN)        /* args[0], if the function returns a value */
+
+enum class IrOp : uint8_t {
+#define X(name) name,
+	TOY_IR_OPS(X)
+#undef X
+};
+
+struct IrBlock;
+
+struct IrInstruction {
+	IrOp op;
+	Type type;
+	uint32_t imm = 0;
+	// Dense within the function; see IrFunction::renumber().
+	uint32_t id = 0;
+	IrBlock* block = nullptr;
+	std::vector<IrInstruction*> args;
+
+	bool is_terminator() const { return op == IrOp::JUMP || op == IrOp::BRANCH || op == IrOp::RETURN; }
+	// Whether removing the instruction can change what the program does.
+	bool has_side_effects() const;
+};
+
+struct IrBlock {
+	uint32_t id = 0;
+	// Phis first, then the rest, then exactly one terminator.
+	std::vector<IrInstruction*> instructions;
+	std::vector<IrBlock*> predecessors;
+	std::vector<IrBlock*> successors;
+
+	IrInstruction* terminator() const;
+	// Index of the first instruction that is not a phi.
+	size_t first_non_phi() const;
+};
+
+struct IrFunction {
+	std::string name;
+	Type return_type = Type::VOID;
+	std::vector<Type> parameters;
+	// blocks[0] is the entry, which has no predecessors.
+	std::vector<std::unique_ptr<IrBlock>> blocks;
+	// Owns every instruction, including the ones no block holds any more.
+	std::vector<std::unique_ptr<IrInstruction>> instructions;
+
+	IrBlock* create_block();
+	IrInstruction* create(IrOp op, Type type, std::vector<IrInstruction*> args = {}, uint32_t imm = 0);
+	// Instructions that blocks hold.
+	size_t instruction_count() const;
+
+	// Numbers the blocks and the instructions that blocks hold in order.
+	void renumber();
+	// Removes the edge from one block to another, with its phi operands.
+	void remove_edge(IrBlock* from, IrBlock* to);
+	// Drops blocks that the entry cannot reach, and their edges.
+	bool remove_unreachable_blocks();
+};
+
+struct IrModule {
+	// Indexed like BytecodeProgram::functions.
+	std::vector<IrFunction> functions;
+	uint32_t global_count = 0;
+	uint32_t entry = 0;
+	int32_t main = -1;
+};
+
+const char* ir_op_name(IrOp op);
+
+// One line per instruction, with blocks and values numbered in order, so that
+// the output of a pass can be compared with an expected one.
+std::string dump_ir(const IrModule& module);
+std::string dump_ir(const IrModule& module, const IrFunction& function);
+
+// Returns what is wrong with the function; nothing when it is well-formed SSA.
+std::vector<std::string> verify_ir(const IrModule& module, const IrFunction& function);
\ No newline at end of file
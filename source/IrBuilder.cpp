@@ -0,0 +1,625 @@
+#include "IrBuilder.h"
+#include "DominatorTree.h"
+
+#include <algorithm>
+#include <cstring>
+
+IrModule IrBuilder::build(const TranslationUnit& unit, const NameResolver& resolver) {
+	m_module = {};
+	m_pending.clear();
+
+	m_module.functions.resize(resolver.functions().size());
+	m_module.functions[0].name = "<top-level>";
+	m_module.global_count = resolver.global_count();
+
+	for (size_t i = 1; i < resolver.functions().size(); i++) {
+		const FunctionDeclaration& declaration = *resolver.functions()[i];
+		IrFunction& function = m_module.functions[i];
+
+		function.name = std::string(declaration.id());
+		function.return_type = declaration.return_type();
+		for (const TypedId& parameter : declaration.parameters())
+			function.parameters.push_back(parameter.type);
+	}
+
+	for (const Statement* stmt : unit.statements()) {
+		if (!stmt || stmt->kind() != NodeKind::FUNCTION_DECLARATION)
+			continue;
+
+		auto& declaration = *static_cast<const FunctionDeclaration*>(stmt);
+		if (declaration.id() == "main" && declaration.parameters().empty())
+			m_module.main = static_cast<int32_t>(declaration.index());
+	}
+
+	// Top-level function declarations are queued like nested ones.
+	build_function(m_module.functions[0], unit.statements());
+
+	while (!m_pending.empty()) {
+		const FunctionDeclaration* declaration = m_pending.back();
+		m_pending.pop_back();
+
+		AstList<Statement*> statements = declaration->statement() ? declaration->statement()->statements() : AstList<Statement*>{};
+		build_function(m_module.functions[declaration->index()], statements);
+	}
+
+	return std::move(m_module);
+}
+
+void IrBuilder::build_function(IrFunction& function, AstList<Statement*> statements) {
+	m_function = &function;
+	m_blocks.clear();
+
+	IrBlock* entry = create_block();
+	seal(entry);
+	set_block(entry);
+
+	// Parameters are the first slots.
+	for (uint32_t i = 0; i < function.parameters.size(); i++)
+		write_variable(i, entry, emit(IrOp::PARAM, function.parameters[i], {}, i));
+
+	for (const Statement* stmt : statements)
+		build_statement(stmt);
+
+	// Falling off the end returns zero from a function that has a return type.
+	if (!m_block->terminator()) {
+		if (function.return_type == Type::VOID)
+			emit(IrOp::RETURN, Type::VOID);
+		else
+			emit(IrOp::RETURN, Type::VOID, { constant(function.return_type, 0) });
+	}
+
+	remove_trivial_phis();
+	order_blocks();
+}
+
+IrBlock* IrBuilder::create_block() {
+	m_blocks.emplace_back();
+	return m_function->create_block();
+}
+
+void IrBuilder::set_block(IrBlock* block) {
+	m_block = block;
+}
+
+void IrBuilder::add_edge(IrBlock* from, IrBlock* to) {
+	from->successors.push_back(to);
+	to->predecessors.push_back(from);
+}
+
+// No predecessors are added to a sealed block, so its incomplete phis can get
+// their operands.
+void IrBuilder::seal(IrBlock* block) {
+	BlockState& state = m_blocks[block->id];
+	std::vector<std::pair<uint32_t, IrInstruction*>> phis = std::move(state.incomplete_phis);
+
+	state.incomplete_phis.clear();
+	state.sealed = true;
+
+	for (auto [slot, phi] : phis)
+		add_phi_operands(slot, phi);
+}
+
+void IrBuilder::jump(IrBlock* target) {
+	emit(IrOp::JUMP, Type::VOID);
+	add_edge(m_block, target);
+}
+
+void IrBuilder::branch(IrInstruction* condition, IrBlock* if_true, IrBlock* if_false) {
+	emit(IrOp::BRANCH, Type::VOID, { condition });
+	add_edge(m_block, if_true);
+	add_edge(m_block, if_false);
+}
+
+IrInstruction* IrBuilder::emit(IrOp op, Type type, std::vector<IrInstruction*> args, uint32_t imm) {
+	IrInstruction* instruction = m_function->create(op, type, std::move(args), imm);
+
+	instruction->block = m_block;
+	m_block->instructions.push_back(instruction);
+
+	return instruction;
+}
+
+IrInstruction* IrBuilder::constant(Type type, uint32_t bits) {
+	return emit(IrOp::CONST, type, {}, bits);
+}
+
+// The value of a variable on a path that never defines it, which only
+// unreachable code can read. Placed in the entry, it dominates every use.
+IrInstruction* IrBuilder::undefined(Type type) {
+	IrBlock* entry = m_function->blocks[0].get();
+	IrInstruction* instruction = m_function->create(IrOp::CONST, type);
+
+	instruction->block = entry;
+	entry->instructions.insert(entry->instructions.begin(), instruction);
+
+	return instruction;
+}
+
+IrInstruction* IrBuilder::create_phi(IrBlock* block, Type type) {
+	IrInstruction* phi = m_function->create(IrOp::PHI, type);
+
+	phi->block = block;
+	block->instructions.insert(block->instructions.begin(), phi);
+
+	return phi;
+}
+
+void IrBuilder::write_variable(uint32_t slot, IrBlock* block, IrInstruction* value) {
+	std::vector<IrInstruction*>& definitions = m_blocks[block->id].definitions;
+
+	if (slot >= definitions.size())
+		definitions.resize(slot + 1);
+	definitions[slot] = value;
+}
+
+// The lookup through the predecessors keeps the blocks it is in on m_reads
+// rather than on the call stack, as a variable read after a long run of
+// blocks that do not define it, such as the ones of a chain of '&&', would
+// otherwise take a call per block.
+IrInstruction* IrBuilder::read_variable(uint32_t slot, Type type, IrBlock* block) {
+	// The value of the block if it is known without its predecessors'.
+	auto enter = [&](IrBlock* block) -> IrInstruction* {
+		const std::vector<IrInstruction*>& definitions = m_blocks[block->id].definitions;
+		IrInstruction* value = nullptr;
+
+		if (slot < definitions.size() && definitions[slot])
+			return definitions[slot];
+
+		if (!m_blocks[block->id].sealed) {
+			value = create_phi(block, type);
+			m_blocks[block->id].incomplete_phis.push_back({ slot, value });
+		} else if (block->predecessors.empty())
+			value = undefined(type);
+		else {
+			// Defined first, so that a loop back to the block finds the phi.
+			IrInstruction* phi = block->predecessors.size() > 1 ? create_phi(block, type) : nullptr;
+			if (phi)
+				write_variable(slot, block, phi);
+			m_reads.push_back({ block, phi, 0 });
+			return nullptr;
+		}
+
+		write_variable(slot, block, value);
+
+		return value;
+	};
+
+	IrInstruction* value = enter(block);
+
+	while (!m_reads.empty()) {
+		ReadFrame& read = m_reads.back();
+
+		// Either the phi's operand from the predecessor before read.next, or
+		// the value of the only predecessor.
+		if (value && read.phi) {
+			read.phi->args.push_back(value);
+			value = nullptr;
+		}
+
+		if (!value && read.next < read.block->predecessors.size()) {
+			value = enter(read.block->predecessors[read.next++]);
+			continue;
+		}
+
+		if (read.phi)
+			value = read.phi;
+		write_variable(slot, read.block, value);
+		m_reads.pop_back();
+	}
+
+	return value;
+}
+
+IrInstruction* IrBuilder::add_phi_operands(uint32_t slot, IrInstruction* phi) {
+	for (IrBlock* predecessor : phi->block->predecessors)
+		phi->args.push_back(read_variable(slot, phi->type, predecessor));
+
+	return phi;
+}
+
+// A phi whose operands are itself and one other value is that value. Removing
+// one can only make the phis that use it trivial, so as in Braun et al. only
+// those are checked again, and the removed phis are dropped in one sweep.
+void IrBuilder::remove_trivial_phis() {
+	std::vector<IrInstruction*> forward(m_function->instructions.size());
+	// The phis that use each phi.
+	std::vector<std::vector<IrInstruction*>> users(m_function->instructions.size());
+	std::vector<IrInstruction*> worklist;
+
+	// Points the phis on the way at the value too, as a phi can be forwarded
+	// along a chain of removed phis as long as the loop nest is deep.
+	auto resolve = [&](IrInstruction* value) {
+		IrInstruction* result = value;
+		while (result->id < forward.size() && forward[result->id])
+			result = forward[result->id];
+
+		while (value != result) {
+			IrInstruction* next = forward[value->id];
+			forward[value->id] = result;
+			value = next;
+		}
+
+		return result;
+	};
+
+	for (auto& block : m_function->blocks) {
+		size_t phis_end = block->first_non_phi();
+
+		for (size_t i = 0; i < phis_end; i++) {
+			IrInstruction* phi = block->instructions[i];
+			worklist.push_back(phi);
+
+			for (IrInstruction* arg : phi->args) {
+				if (arg->op == IrOp::PHI && arg != phi)
+					users[arg->id].push_back(phi);
+			}
+		}
+	}
+
+	// First phi first.
+	std::reverse(worklist.begin(), worklist.end());
+
+	while (!worklist.empty()) {
+		IrInstruction* phi = worklist.back();
+		worklist.pop_back();
+
+		if (forward[phi->id])
+			continue;
+
+		IrInstruction* same = nullptr;
+		bool trivial = true;
+
+		for (IrInstruction*& arg : phi->args) {
+			arg = resolve(arg);
+
+			if (arg == same || arg == phi)
+				continue;
+			if (same) {
+				trivial = false;
+				break;
+			}
+			same = arg;
+		}
+
+		if (!trivial)
+			continue;
+
+		if (!same)
+			same = undefined(phi->type);
+
+		forward.resize(m_function->instructions.size());
+		users.resize(m_function->instructions.size());
+		forward[phi->id] = same;
+
+		// The users now use same, and are its users too. Along the headers of
+		// a loop nest each phi is forwarded to the next, so passing on users
+		// that are gone already would pile them up.
+		for (IrInstruction* user : users[phi->id]) {
+			if (forward[user->id])
+				continue;
+
+			worklist.push_back(user);
+			if (same->op == IrOp::PHI)
+				users[same->id].push_back(user);
+		}
+		users[phi->id].clear();
+	}
+
+	for (auto& block : m_function->blocks) {
+		std::vector<IrInstruction*>& instructions = block->instructions;
+		auto phis_end = instructions.begin() + block->first_non_phi();
+
+		instructions.erase(std::remove_if(instructions.begin(), phis_end, [&](IrInstruction* phi) {
+			return phi->id < forward.size() && forward[phi->id];
+		}), phis_end);
+
+		for (IrInstruction* instruction : instructions) {
+			for (IrInstruction*& arg : instruction->args)
+				arg = resolve(arg);
+		}
+	}
+}
+
+// Reachable blocks in reverse postorder, so that dumps read top to bottom.
+void IrBuilder::order_blocks() {
+	DominatorTree dominators(*m_function);
+	std::vector<std::unique_ptr<IrBlock>> blocks(m_function->blocks.size());
+	std::vector<std::unique_ptr<IrBlock>> unreachable;
+	size_t next = 0;
+
+	for (IrBlock* block : dominators.reverse_postorder())
+		blocks[next++] = std::move(m_function->blocks[block->id]);
+
+	for (auto& block : m_function->blocks) {
+		if (block)
+			blocks[next++] = std::move(block);
+	}
+
+	m_function->blocks = std::move(blocks);
+	m_function->renumber();
+}
+
+void IrBuilder::build_statement(const Statement* stmt) {
+	if (!stmt)
+		return;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT:
+		for (const Statement* child : static_cast<const CompoundStatement*>(stmt)->statements())
+			build_statement(child);
+		break;
+	case NodeKind::VARIABLE_DECLARATION:
+		build_variable_declaration(*static_cast<const VariableDeclaration*>(stmt));
+		break;
+	case NodeKind::FUNCTION_DECLARATION:
+		m_pending.push_back(static_cast<const FunctionDeclaration*>(stmt));
+		break;
+	case NodeKind::IF_STATEMENT:
+		build_if_statement(*static_cast<const IfStatement*>(stmt));
+		break;
+	case NodeKind::FOR_STATEMENT: {
+		auto& for_stmt = *static_cast<const ForStatement*>(stmt);
+
+		if (for_stmt.variable_declaration())
+			build_variable_declaration(*for_stmt.variable_declaration());
+		build_loop(for_stmt.condition_expr(), for_stmt.statement(), for_stmt.loop_expr());
+		break;
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		auto& while_stmt = *static_cast<const WhileStatement*>(stmt);
+		build_loop(while_stmt.condition_expr(), while_stmt.statement(), nullptr);
+		break;
+	}
+	case NodeKind::RETURN_STATEMENT:
+		build_return_statement(*static_cast<const ReturnStatement*>(stmt));
+		break;
+	default:
+		build_expression(static_cast<const Expression*>(stmt));
+		break;
+	}
+}
+
+void IrBuilder::build_variable_declaration(const VariableDeclaration& declaration) {
+	const Binding& binding = declaration.binding();
+
+	if (binding.kind == BindingKind::GLOBAL) {
+		// Globals start out as zero.
+		if (declaration.initial_value())
+			emit(IrOp::STORE_GLOBAL, Type::VOID, { build_expression(declaration.initial_value()) }, binding.slot);
+		return;
+	}
+
+	IrInstruction* value = declaration.initial_value() ? build_expression(declaration.initial_value()) : constant(declaration.type(), 0);
+	write_variable(binding.slot, m_block, value);
+}
+
+void IrBuilder::build_if_statement(const IfStatement& stmt) {
+	IrInstruction* condition = build_expression(stmt.condition());
+	IrBlock* then_block = create_block();
+	IrBlock* join = create_block();
+
+	branch(condition, then_block, join);
+	seal(then_block);
+
+	set_block(then_block);
+	build_statement(stmt.statement());
+	jump(join);
+
+	seal(join);
+	set_block(join);
+}
+
+// The header tests the condition; the body and the step jump back to it.
+void IrBuilder::build_loop(const Expression* condition, const Statement* body, const Expression* step) {
+	IrBlock* header = create_block();
+	IrBlock* body_block = create_block();
+	IrBlock* exit = create_block();
+
+	jump(header);
+	set_block(header);
+
+	if (condition)
+		branch(build_expression(condition), body_block, exit);
+	else
+		jump(body_block);
+
+	seal(body_block);
+	set_block(body_block);
+	build_statement(body);
+	if (step)
+		build_expression(step);
+	jump(header);
+
+	seal(header);
+	seal(exit);
+	set_block(exit);
+}
+
+void IrBuilder::build_return_statement(const ReturnStatement& stmt) {
+	if (m_function->return_type == Type::VOID || !stmt.return_expr())
+		emit(IrOp::RETURN, Type::VOID);
+	else
+		emit(IrOp::RETURN, Type::VOID, { build_expression(stmt.return_expr()) });
+
+	// Whatever follows is unreachable, and goes to a block without predecessors.
+	IrBlock* dead = create_block();
+	seal(dead);
+	set_block(dead);
+}
+
+IrInstruction* IrBuilder::build_expression(const Expression* expr) {
+	switch (expr->kind()) {
+	case NodeKind::INT_LITERAL:
+		return constant(Type::INT, static_cast<uint32_t>(static_cast<const IntLiteral*>(expr)->integer()));
+	case NodeKind::FLOAT_LITERAL: {
+		float value = static_cast<const FloatLiteral*>(expr)->floating();
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return constant(Type::FLOAT, bits);
+	}
+	case NodeKind::BOOL_LITERAL:
+		return constant(Type::BOOL, static_cast<const BoolLiteral*>(expr)->boolean());
+	case NodeKind::ID_ATOM: {
+		const Binding& binding = static_cast<const IdAtom*>(expr)->binding();
+
+		if (binding.kind == BindingKind::LOCAL)
+			return read_variable(binding.slot, binding.type, m_block);
+
+		return emit(IrOp::LOAD_GLOBAL, binding.type, {}, binding.slot);
+	}
+	case NodeKind::FUNC_CALL_ATOM:
+		return build_call(*static_cast<const FuncCallAtom*>(expr));
+	case NodeKind::UNARY_EXPRESSION:
+		return build_unary_expression(*static_cast<const UnaryExpression*>(expr));
+	default:
+		break;
+	}
+
+	auto binary = static_cast<const BinaryExpression*>(expr);
+	if (binary->op() == BinaryOp::ASSIGN)
+		return build_assignment(*binary);
+
+	// Left to right down a chain of left operands, see push_left_chain().
+	size_t base = m_chain.size();
+	IrInstruction* left = build_expression(push_left_chain(binary, m_chain));
+
+	while (m_chain.size() > base) {
+		binary = m_chain.back();
+		m_chain.pop_back();
+		left = build_binary_expression(*binary, left);
+	}
+
+	return left;
+}
+
+// left is the value of the left operand.
+IrInstruction* IrBuilder::build_binary_expression(const BinaryExpression& expr, IrInstruction* left) {
+	switch (expr.op()) {
+	case BinaryOp::COMA:
+		return build_expression(expr.right());
+	case BinaryOp::LOGICAL_OR:
+	case BinaryOp::LOGICAL_AND:
+		return build_logical_expression(expr, left);
+	default:
+		break;
+	}
+
+	// Both operands are ints or both are floats.
+	IrInstruction* right = build_expression(expr.right());
+	Type type = left->type;
+
+	switch (expr.op()) {
+	case BinaryOp::PLUS:
+		return emit(IrOp::ADD, type, { left, right });
+	case BinaryOp::MINUS:
+		return emit(IrOp::SUB, type, { left, right });
+	case BinaryOp::MULTIPLY:
+		return emit(IrOp::MUL, type, { left, right });
+	case BinaryOp::DIVIDE:
+		return emit(IrOp::DIV, type, { left, right });
+	case BinaryOp::LOGICAL_EQUAL:
+		return emit(IrOp::EQ, Type::BOOL, { left, right });
+	case BinaryOp::LOGICAL_NOT_EQUAL:
+		return emit(IrOp::NE, Type::BOOL, { left, right });
+	case BinaryOp::LESS:
+		return emit(IrOp::LT, Type::BOOL, { left, right });
+	case BinaryOp::GREATER:
+		return emit(IrOp::LT, Type::BOOL, { right, left });
+	case BinaryOp::LESS_EQUAL:
+		return emit(IrOp::LE, Type::BOOL, { left, right });
+	default:
+		return emit(IrOp::LE, Type::BOOL, { right, left });
+	}
+}
+
+// The right operand gets a block of its own; the result is a phi of the left
+// operand, when it decides, and the right one.
+IrInstruction* IrBuilder::build_logical_expression(const BinaryExpression& expr, IrInstruction* left) {
+	IrBlock* left_end = m_block;
+	IrBlock* right_block = create_block();
+	IrBlock* join = create_block();
+
+	if (expr.op() == BinaryOp::LOGICAL_AND)
+		branch(left, right_block, join);
+	else
+		branch(left, join, right_block);
+
+	seal(right_block);
+	set_block(right_block);
+	IrInstruction* right = build_expression(expr.right());
+	jump(join);
+
+	seal(join);
+	set_block(join);
+
+	IrInstruction* phi = create_phi(join, Type::BOOL);
+	for (IrBlock* predecessor : join->predecessors)
+		phi->args.push_back(predecessor == left_end ? left : right);
+
+	return phi;
+}
+
+IrInstruction* IrBuilder::build_assignment(const BinaryExpression& expr) {
+	const Binding& binding = static_cast<const IdAtom*>(expr.left())->binding();
+	IrInstruction* value = build_expression(expr.right());
+
+	if (binding.kind == BindingKind::GLOBAL)
+		emit(IrOp::STORE_GLOBAL, Type::VOID, { value }, binding.slot);
+	else
+		write_variable(binding.slot, m_block, value);
+
+	return value;
+}
+
+IrInstruction* IrBuilder::build_unary_expression(const UnaryExpression& expr) {
+	if (expr.op() == UnaryOp::CAST)
+		return convert(build_expression(expr.expr()), expr.type());
+
+	const Binding& binding = static_cast<const IdAtom*>(expr.expr())->binding();
+	float float_one = 1;
+	uint32_t one = 1;
+
+	if (binding.type == Type::FLOAT)
+		std::memcpy(&one, &float_one, sizeof(one));
+
+	IrInstruction* value = binding.kind == BindingKind::GLOBAL ?
+		emit(IrOp::LOAD_GLOBAL, binding.type, {}, binding.slot) :
+		read_variable(binding.slot, binding.type, m_block);
+	IrOp op = expr.op() == UnaryOp::PRE_INCREMENT ? IrOp::ADD : IrOp::SUB;
+
+	value = emit(op, binding.type, { value, constant(binding.type, one) });
+
+	if (binding.kind == BindingKind::GLOBAL)
+		emit(IrOp::STORE_GLOBAL, Type::VOID, { value }, binding.slot);
+	else
+		write_variable(binding.slot, m_block, value);
+
+	return value;
+}
+
+IrInstruction* IrBuilder::build_call(const FuncCallAtom& call) {
+	uint32_t index = call.binding().slot;
+	const IrFunction& callee = m_module.functions[index];
+	std::vector<IrInstruction*> args;
+
+	for (uint32_t i = 0; i < call.arguments().size(); i++)
+		args.push_back(build_expression(call.arguments()[i]));
+
+	return emit(IrOp::CALL, callee.return_type, std::move(args), index);
+}
+
+IrInstruction* IrBuilder::convert(IrInstruction* value, Type type) {
+	if (value->type == type)
+		return value;
+
+	switch (type) {
+	case Type::INT:
+		return emit(value->type == Type::BOOL ? IrOp::BOOL_TO_INT : IrOp::FLOAT_TO_INT, Type::INT, { value });
+	case Type::FLOAT:
+		return emit(IrOp::INT_TO_FLOAT, Type::FLOAT, { value });
+	case Type::BOOL:
+		return emit(value->type == Type::FLOAT ? IrOp::FLOAT_TO_BOOL : IrOp::INT_TO_BOOL, Type::BOOL, { value });
+	default:
+		return value;
+	}
+}
\ No newline at end of file
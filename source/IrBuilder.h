@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Ir.h"
+#include "NameResolver.h"
+
+#include <utility>
+#include <vector>
+
+// Builds SSA form straight from the tree, as in Braun et al., "Simple and
+// Efficient Construction of Static Single Assignment Form": locals are looked
+// up by their binding's slot, through the predecessors of a block when the
+// block does not define them itself, and phis are added where paths meet.
+// Phis of blocks whose predecessors are not all known yet are completed when
+// the block is sealed, and phis that merge a single value are removed once
+// the function is done. Globals stay in memory.
+//
+// The unit has to be resolved and typed without errors; every conversion is
+// a CAST, which becomes one conversion instruction.
+class IrBuilder {
+public:
+	IrModule build(const TranslationUnit& unit, const NameResolver& resolver);
+
+private:
+	struct BlockState {
+		// Current value of each slot at the end of the block, if defined in it.
+		std::vector<IrInstruction*> definitions;
+		// Phis of an unsealed block, with the slots they merge.
+		std::vector<std::pair<uint32_t, IrInstruction*>> incomplete_phis;
+		bool sealed = false;
+	};
+
+	// A block whose value of a variable read_variable() is looking up.
+	struct ReadFrame {
+		IrBlock* block;
+		// Merges the predecessors' values, if there are several.
+		IrInstruction* phi;
+		// The predecessor to read next.
+		size_t next;
+	};
+
+	void build_function(IrFunction& function, AstList<Statement*> statements);
+
+	IrBlock* create_block();
+	void set_block(IrBlock* block);
+	void add_edge(IrBlock* from, IrBlock* to);
+	void seal(IrBlock* block);
+	void jump(IrBlock* target);
+	void branch(IrInstruction* condition, IrBlock* if_true, IrBlock* if_false);
+
+	IrInstruction* emit(IrOp op, Type type, std::vector<IrInstruction*> args = {}, uint32_t imm = 0);
+	IrInstruction* constant(Type type, uint32_t bits);
+	IrInstruction* undefined(Type type);
+	IrInstruction* create_phi(IrBlock* block, Type type);
+
+	void write_variable(uint32_t slot, IrBlock* block, IrInstruction* value);
+	IrInstruction* read_variable(uint32_t slot, Type type, IrBlock* block);
+	IrInstruction* add_phi_operands(uint32_t slot, IrInstruction* phi);
+	void remove_trivial_phis();
+	void order_blocks();
+
+	void build_statement(const Statement* stmt);
+	void build_variable_declaration(const VariableDeclaration& declaration);
+	void build_if_statement(const IfStatement& stmt);
+	void build_loop(const Expression* condition, const Statement* body, const Expression* step);
+	void build_return_statement(const ReturnStatement& stmt);
+
+	IrInstruction* build_expression(const Expression* expr);
+	IrInstruction* build_binary_expression(const BinaryExpression& expr, IrInstruction* left);
+	IrInstruction* build_logical_expression(const BinaryExpression& expr, IrInstruction* left);
+	IrInstruction* build_assignment(const BinaryExpression& expr);
+	IrInstruction* build_unary_expression(const UnaryExpression& expr);
+	IrInstruction* build_call(const FuncCallAtom& call);
+
+	IrInstruction* convert(IrInstruction* value, Type type);
+
+private:
+	IrModule m_module;
+	// Nested functions, built after the function that declares them.
+	std::vector<const FunctionDeclaration*> m_pending;
+
+	IrFunction* m_function = nullptr;
+	IrBlock* m_block = nullptr;
+	// By block id.
+	std::vector<BlockState> m_blocks;
+	// Blocks of the lookup in read_variable().
+	std::vector<ReadFrame> m_reads;
+	// Operators of the chains being built, see push_left_chain().
+	std::vector<const BinaryExpression*> m_chain;
+};
\ No newline at end of file
@@ -0,0 +1,496 @@
+#include "IrPasses.h"
+#include "DominatorTree.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+// Rewrites every use of a replaced value, following chains of replacements.
+// Indexed by instruction id.
+static void replace_uses(IrFunction& function, const std::vector<IrInstruction*>& replacements) {
+	for (auto& block : function.blocks) {
+		for (IrInstruction* instruction : block->instructions) {
+			for (IrInstruction*& arg : instruction->args) {
+				while (arg->id < replacements.size() && replacements[arg->id])
+					arg = replacements[arg->id];
+			}
+		}
+	}
+}
+
+static void remove_replaced(IrFunction& function, const std::vector<IrInstruction*>& replacements) {
+	for (auto& block : function.blocks) {
+		std::vector<IrInstruction*>& instructions = block->instructions;
+
+		instructions.erase(std::remove_if(instructions.begin(), instructions.end(), [&](IrInstruction* instruction) {
+			return replacements[instruction->id] != nullptr;
+		}), instructions.end());
+	}
+}
+
+static bool fold_constant_branches(IrFunction& function) {
+	bool changed = false;
+
+	for (auto& block : function.blocks) {
+		IrInstruction* terminator = block->terminator();
+		if (!terminator || terminator->op != IrOp::BRANCH || terminator->args[0]->op != IrOp::CONST)
+			continue;
+
+		function.remove_edge(block.get(), block->successors[terminator->args[0]->imm ? 1 : 0]);
+		terminator->op = IrOp::JUMP;
+		terminator->args.clear();
+		changed = true;
+	}
+
+	return changed;
+}
+
+static bool remove_trivial_phis(IrFunction& function) {
+	function.renumber();
+
+	std::vector<IrInstruction*> replacements(function.instruction_count());
+	bool changed = false;
+
+	for (auto& block : function.blocks) {
+		for (size_t i = 0; i < block->first_non_phi(); i++) {
+			IrInstruction* phi = block->instructions[i];
+			IrInstruction* same = nullptr;
+			bool trivial = true;
+
+			for (IrInstruction* arg : phi->args) {
+				while (replacements[arg->id])
+					arg = replacements[arg->id];
+
+				if (arg == same || arg == phi)
+					continue;
+				if (same) {
+					trivial = false;
+					break;
+				}
+				same = arg;
+			}
+
+			// A phi of nothing but itself only survives in code the entry cannot reach.
+			if (!trivial || !same)
+				continue;
+
+			replacements[phi->id] = same;
+			changed = true;
+		}
+	}
+
+	if (changed) {
+		replace_uses(function, replacements);
+		remove_replaced(function, replacements);
+	}
+
+	return changed;
+}
+
+static bool remove_dead_values(IrFunction& function) {
+	function.renumber();
+
+	std::vector<bool> live(function.instruction_count());
+	std::vector<IrInstruction*> worklist;
+
+	for (auto& block : function.blocks) {
+		for (IrInstruction* instruction : block->instructions) {
+			if (instruction->has_side_effects()) {
+				live[instruction->id] = true;
+				worklist.push_back(instruction);
+			}
+		}
+	}
+
+	while (!worklist.empty()) {
+		IrInstruction* instruction = worklist.back();
+		worklist.pop_back();
+
+		for (IrInstruction* arg : instruction->args) {
+			if (!live[arg->id]) {
+				live[arg->id] = true;
+				worklist.push_back(arg);
+			}
+		}
+	}
+
+	bool changed = false;
+
+	for (auto& block : function.blocks) {
+		std::vector<IrInstruction*>& instructions = block->instructions;
+		size_t size = instructions.size();
+
+		instructions.erase(std::remove_if(instructions.begin(), instructions.end(), [&](IrInstruction* instruction) {
+			return !live[instruction->id];
+		}), instructions.end());
+
+		changed |= instructions.size() != size;
+	}
+
+	return changed;
+}
+
+// Appends a block to the one that jumps to it, when nothing else does.
+static bool merge_blocks(IrFunction& function) {
+	bool changed = false;
+
+	for (auto& block : function.blocks) {
+		while (true) {
+			IrInstruction* terminator = block->terminator();
+			if (!terminator || terminator->op != IrOp::JUMP)
+				break;
+
+			IrBlock* successor = block->successors[0];
+			if (successor == block.get() || successor->predecessors.size() != 1 || successor->first_non_phi() != 0)
+				break;
+
+			block->instructions.pop_back();
+			for (IrInstruction* instruction : successor->instructions) {
+				instruction->block = block.get();
+				block->instructions.push_back(instruction);
+			}
+
+			block->successors = std::move(successor->successors);
+			for (IrBlock* next : block->successors)
+				std::replace(next->predecessors.begin(), next->predecessors.end(), successor, block.get());
+
+			successor->instructions.clear();
+			successor->successors.clear();
+			successor->predecessors.clear();
+			changed = true;
+		}
+	}
+
+	if (!changed)
+		return false;
+
+	// Every block that is still in use ends with a terminator.
+	function.blocks.erase(std::remove_if(function.blocks.begin() + 1, function.blocks.end(), [](const auto& block) {
+		return block->instructions.empty();
+	}), function.blocks.end());
+	function.renumber();
+
+	return true;
+}
+
+bool eliminate_dead_code(IrFunction& function) {
+	bool changed = false;
+
+	for (bool again = true; again;) {
+		again = fold_constant_branches(function);
+		again |= function.remove_unreachable_blocks();
+		again |= remove_trivial_phis(function);
+		again |= remove_dead_values(function);
+		again |= merge_blocks(function);
+
+		changed |= again;
+	}
+
+	function.renumber();
+
+	return changed;
+}
+
+static bool is_commutative(IrOp op) {
+	return op == IrOp::ADD || op == IrOp::MUL || op == IrOp::EQ || op == IrOp::NE;
+}
+
+// Operands in the order values are compared in; commutative ones sorted.
+static std::pair<const IrInstruction*, const IrInstruction*> ordered_operands(const IrInstruction& instruction) {
+	const IrInstruction* a = instruction.args[0];
+	const IrInstruction* b = instruction.args[1];
+
+	if (is_commutative(instruction.op) && b->id < a->id)
+		std::swap(a, b);
+
+	return { a, b };
+}
+
+namespace {
+
+// Instructions compute the same value when they agree on the operation, the
+// type, the immediate and the operands. Phis are only equal to phis of the same
+// block.
+struct ValueHash {
+	size_t operator()(const IrInstruction* instruction) const {
+		size_t hash = static_cast<size_t>(instruction->op) * 31 + static_cast<size_t>(instruction->type);
+		hash = hash * 1000003 ^ instruction->imm;
+
+		if (instruction->op == IrOp::PHI)
+			hash = hash * 1000003 ^ std::hash<const void*>()(instruction->block);
+
+		if (instruction->args.size() == 2) {
+			auto [a, b] = ordered_operands(*instruction);
+			return (hash * 1000003 ^ std::hash<const void*>()(a)) * 1000003 ^ std::hash<const void*>()(b);
+		}
+
+		for (const IrInstruction* arg : instruction->args)
+			hash = hash * 1000003 ^ std::hash<const void*>()(arg);
+
+		return hash;
+	}
+};
+
+struct ValueEqual {
+	bool operator()(const IrInstruction* a, const IrInstruction* b) const {
+		if (a->op != b->op || a->type != b->type || a->imm != b->imm || a->args.size() != b->args.size())
+			return false;
+		if (a->op == IrOp::PHI)
+			return a->block == b->block && a->args == b->args;
+		if (a->args.size() == 2)
+			return ordered_operands(*a) == ordered_operands(*b);
+
+		return a->args == b->args;
+	}
+};
+
+}
+
+static bool is_numbered(IrOp op) {
+	switch (op) {
+	case IrOp::LOAD_GLOBAL:
+	case IrOp::STORE_GLOBAL:
+	case IrOp::CALL:
+	case IrOp::JUMP:
+	case IrOp::BRANCH:
+	case IrOp::RETURN:
+		return false;
+	default:
+		return true;
+	}
+}
+
+// Walks the dominator tree with a table of the values available in each block,
+// so a value is only ever replaced by one that dominates it.
+bool number_values(IrFunction& function) {
+	function.renumber();
+
+	DominatorTree dominators(function);
+	std::vector<IrInstruction*> replacements(function.instruction_count());
+	std::unordered_set<IrInstruction*, ValueHash, ValueEqual> available;
+	// Values in the order they were added, and where each open block's start.
+	std::vector<IrInstruction*> added;
+	std::vector<size_t> scopes;
+	std::vector<std::pair<IrBlock*, size_t>> stack;
+	bool changed = false;
+
+	auto visit = [&](IrBlock* block) {
+		scopes.push_back(added.size());
+
+		for (IrInstruction* instruction : block->instructions) {
+			for (IrInstruction*& arg : instruction->args) {
+				while (replacements[arg->id])
+					arg = replacements[arg->id];
+			}
+
+			if (!is_numbered(instruction->op))
+				continue;
+
+			auto [it, inserted] = available.insert(instruction);
+			if (inserted)
+				added.push_back(instruction);
+			else {
+				replacements[instruction->id] = *it;
+				changed = true;
+			}
+		}
+	};
+
+	if (!function.blocks.empty()) {
+		visit(function.blocks[0].get());
+		stack.push_back({ function.blocks[0].get(), 0 });
+	}
+
+	while (!stack.empty()) {
+		auto& [block, next] = stack.back();
+		const std::vector<IrBlock*>& children = dominators.children(block);
+
+		if (next == children.size()) {
+			while (added.size() > scopes.back()) {
+				available.erase(added.back());
+				added.pop_back();
+			}
+
+			scopes.pop_back();
+			stack.pop_back();
+			continue;
+		}
+
+		IrBlock* child = children[next++];
+		visit(child);
+		stack.push_back({ child, 0 });
+	}
+
+	if (!changed)
+		return false;
+
+	// Phi operands on back edges were visited before their replacements were known.
+	replace_uses(function, replacements);
+	remove_replaced(function, replacements);
+	function.renumber();
+
+	return true;
+}
+
+static bool is_invariant_op(const IrInstruction& instruction, bool has_call, const std::unordered_set<uint32_t>& stored) {
+	switch (instruction.op) {
+	case IrOp::CONST:
+	case IrOp::ADD:
+	case IrOp::SUB:
+	case IrOp::MUL:
+	case IrOp::EQ:
+	case IrOp::NE:
+	case IrOp::LT:
+	case IrOp::LE:
+	case IrOp::BOOL_TO_INT:
+	case IrOp::INT_TO_FLOAT:
+	case IrOp::FLOAT_TO_INT:
+	case IrOp::INT_TO_BOOL:
+	case IrOp::FLOAT_TO_BOOL:
+		return true;
+	case IrOp::DIV:
+		return instruction.type == Type::FLOAT || (instruction.args[1]->op == IrOp::CONST && instruction.args[1]->imm != 0);
+	case IrOp::LOAD_GLOBAL:
+		return !has_call && !stored.count(instruction.imm);
+	default:
+		return false;
+	}
+}
+
+namespace {
+
+struct Loop {
+	IrBlock* header;
+	std::vector<bool> blocks;
+	size_t size;
+};
+
+}
+
+static bool hoist_from_loop(IrFunction& function, const DominatorTree& dominators, const Loop& loop) {
+	IrBlock* preheader = nullptr;
+
+	for (IrBlock* predecessor : loop.header->predecessors) {
+		if (loop.blocks[predecessor->id])
+			continue;
+		if (preheader)
+			return false;
+		preheader = predecessor;
+	}
+
+	if (!preheader || preheader->successors.size() != 1)
+		return false;
+
+	std::vector<bool> variant(function.instruction_count());
+	std::unordered_set<uint32_t> stored;
+	bool has_call = false;
+
+	for (auto& block : function.blocks) {
+		if (!loop.blocks[block->id])
+			continue;
+
+		for (IrInstruction* instruction : block->instructions) {
+			variant[instruction->id] = true;
+			has_call |= instruction->op == IrOp::CALL;
+			if (instruction->op == IrOp::STORE_GLOBAL)
+				stored.insert(instruction->imm);
+		}
+	}
+
+	bool changed = false;
+
+	// In reverse postorder every operand outside a phi is seen before its use.
+	for (IrBlock* block : dominators.reverse_postorder()) {
+		if (!loop.blocks[block->id])
+			continue;
+
+		std::vector<IrInstruction*> kept;
+
+		for (IrInstruction* instruction : block->instructions) {
+			bool invariant = is_invariant_op(*instruction, has_call, stored) &&
+				std::none_of(instruction->args.begin(), instruction->args.end(), [&](IrInstruction* arg) { return variant[arg->id]; });
+
+			if (!invariant) {
+				kept.push_back(instruction);
+				continue;
+			}
+
+			variant[instruction->id] = false;
+			instruction->block = preheader;
+			preheader->instructions.insert(preheader->instructions.end() - 1, instruction);
+			changed = true;
+		}
+
+		block->instructions = std::move(kept);
+	}
+
+	return changed;
+}
+
+bool hoist_loop_invariants(IrFunction& function) {
+	function.renumber();
+
+	DominatorTree dominators(function);
+	std::vector<Loop> loops;
+
+	// A loop is a header with back edges from blocks it dominates, and every
+	// block that reaches one of those without passing through the header.
+	for (IrBlock* header : dominators.reverse_postorder()) {
+		Loop loop{ header, std::vector<bool>(function.blocks.size()), 1 };
+		std::vector<IrBlock*> stack;
+		bool has_back_edge = false;
+
+		loop.blocks[header->id] = true;
+
+		for (IrBlock* predecessor : header->predecessors) {
+			if (!dominators.dominates(header, predecessor))
+				continue;
+
+			has_back_edge = true;
+			if (!loop.blocks[predecessor->id]) {
+				loop.blocks[predecessor->id] = true;
+				loop.size++;
+				stack.push_back(predecessor);
+			}
+		}
+
+		if (!has_back_edge)
+			continue;
+
+		while (!stack.empty()) {
+			IrBlock* block = stack.back();
+			stack.pop_back();
+
+			for (IrBlock* predecessor : block->predecessors) {
+				if (dominators.reachable(predecessor) && !loop.blocks[predecessor->id]) {
+					loop.blocks[predecessor->id] = true;
+					loop.size++;
+					stack.push_back(predecessor);
+				}
+			}
+		}
+
+		loops.push_back(std::move(loop));
+	}
+
+	// Inner loops first, so what leaves them can leave the outer ones too.
+	std::stable_sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) { return a.size < b.size; });
+
+	bool changed = false;
+	for (const Loop& loop : loops)
+		changed |= hoist_from_loop(function, dominators, loop);
+
+	function.renumber();
+
+	return changed;
+}
+
+IrPass find_ir_pass(std::string_view name) {
+	if (name == "dce")
+		return eliminate_dead_code;
+	if (name == "gvn")
+		return number_values;
+	if (name == "licm")
+		return hoist_loop_invariants;
+
+	return nullptr;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Ir.h"
+
+#include <string_view>
+
+// Optimizations over one function of SSA form. Each returns whether it changed
+// the function, and leaves it renumbered and valid for verify_ir().
+
+// Folds branches on constants, then drops unreachable blocks, phis that merge
+// one value, values nothing with a side effect depends on, and jumps to blocks
+// with no other predecessor.
+bool eliminate_dead_code(IrFunction& function);
+
+// Global value numbering: a value computed again where an equal one dominates
+// it is replaced by that one. Loads and calls are never merged.
+bool number_values(IrFunction& function);
+
+// Moves loop-invariant values of while and for loops to the block before the
+// loop header. Only values that cannot trap are moved, since the loop body may
+// never run, and global loads only out of loops without calls or stores to the
+// same global.
+bool hoist_loop_invariants(IrFunction& function);
+
+using IrPass = bool (*)(IrFunction& function);
+
+// "dce", "gvn" or "licm"; nullptr for anything else.
+IrPass find_ir_pass(std::string_view name);
\ No newline at end of file
@@ -0,0 +1,886 @@
+#include "Jit.h"
+#include "X86Emitter.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(_WIN32)
+#define TOY_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// How far below the caller of call() the code may take the stack, which is
+// less than the 8 MB a thread gets by default.
+static constexpr uintptr_t STACK_BUDGET = 4 * 1024 * 1024;
+static constexpr int32_t PAGE_SIZE = 4096;
+
+enum RuntimeError : uint32_t {
+	DIVISION_BY_ZERO,
+	STACK_OVERFLOW
+};
+
+static constexpr Register STATE = Register::RBX;
+static constexpr Register GLOBALS = Register::R12;
+static constexpr Register INT_ARGUMENTS[] = { Register::RDI, Register::RSI, Register::RDX, Register::RCX, Register::R8, Register::R9 };
+static constexpr uint8_t FLOAT_ARGUMENT_COUNT = 8;
+
+namespace {
+
+// Where the System V convention puts an argument: the next free integer or
+// SSE register of its kind, else the next 8 bytes on the stack.
+struct ArgumentLocation {
+	bool on_stack;
+	bool floating;
+	uint8_t index;
+};
+
+}
+
+static std::vector<ArgumentLocation> locate_arguments(const std::vector<Type>& types, uint32_t& stack_count) {
+	std::vector<ArgumentLocation> locations;
+	uint8_t next_int = 0, next_float = 0;
+
+	stack_count = 0;
+
+	for (Type type : types) {
+		bool floating = type == Type::FLOAT;
+		uint8_t& next = floating ? next_float : next_int;
+		uint8_t count = floating ? FLOAT_ARGUMENT_COUNT : static_cast<uint8_t>(std::size(INT_ARGUMENTS));
+
+		if (next < count)
+			locations.push_back({ false, floating, next++ });
+		else
+			locations.push_back({ true, floating, static_cast<uint8_t>(stack_count++) });
+	}
+
+	return locations;
+}
+
+static Xmm xmm(uint8_t index) {
+	return static_cast<Xmm>(index);
+}
+
+namespace {
+
+// Emits one function. Slots below the saved registers hold the parameters,
+// then the values and, for each phi, the operand its predecessors write before
+// jumping, so that phis of a block never overwrite each other's operands. A
+// slot is shared by values that are never live at the same time.
+class FunctionEmitter {
+public:
+	FunctionEmitter(X86Emitter& emitter, const IrModule& module, uint32_t index, const std::vector<X86Emitter::Label>& entries, uintptr_t state, uintptr_t globals, uintptr_t error_handler)
+		: m_emitter(emitter), m_module(module), m_function(module.functions[index]), m_index(index), m_entries(entries),
+		m_state(state), m_globals(globals), m_error_handler(error_handler) {}
+
+	void emit();
+
+private:
+	Memory slot(uint32_t index) const { return { Register::RBP, -24 - 8 * static_cast<int32_t>(index) }; }
+	Memory value(const IrInstruction* instruction) const { return slot(m_value_slots[instruction->id]); }
+	Memory incoming(const IrInstruction* phi) const { return slot(m_incoming_slots[phi->id]); }
+	Memory global(uint32_t index) const { return { GLOBALS, 4 * static_cast<int32_t>(index) }; }
+
+	uint32_t allocate_slots();
+	void emit_prologue();
+	void emit_epilogue();
+	void emit_instruction(const IrInstruction& instruction, const IrBlock& block, size_t position);
+	void emit_edge(const IrBlock& from, const IrBlock& to);
+	void emit_jump(const IrBlock& from, const IrBlock& to, size_t position);
+	void emit_call(const IrInstruction& instruction);
+	void emit_compare(const IrInstruction& instruction);
+	void emit_error(X86Emitter::Label label, RuntimeError error);
+	void store_flag(const IrInstruction& instruction, Condition condition);
+
+private:
+	X86Emitter& m_emitter;
+	const IrModule& m_module;
+	const IrFunction& m_function;
+	uint32_t m_index;
+	const std::vector<X86Emitter::Label>& m_entries;
+	uintptr_t m_state;
+	uintptr_t m_globals;
+	uintptr_t m_error_handler;
+
+	// By instruction id.
+	std::vector<uint32_t> m_value_slots;
+	std::vector<uint32_t> m_incoming_slots;
+	std::vector<X86Emitter::Label> m_blocks;
+	int32_t m_frame_size = 0;
+	X86Emitter::Label m_division_by_zero = 0;
+	X86Emitter::Label m_stack_overflow = 0;
+	bool m_divides = false;
+};
+
+}
+
+// Where each value is live is over-approximated by one range of positions
+// in the order the blocks are emitted in, from the first one it is live at to
+// the last, which lets a single linear scan hand out the slots.
+uint32_t FunctionEmitter::allocate_slots() {
+	size_t block_count = m_function.blocks.size();
+	size_t instruction_count = 0;
+
+	for (const auto& block : m_function.blocks)
+		instruction_count += block->instructions.size();
+
+	std::vector<uint32_t> positions(instruction_count);
+	std::vector<uint32_t> block_begin(block_count);
+	std::vector<uint32_t> block_end(block_count);
+	// The ids of each block's predecessors, in one array.
+	std::vector<uint32_t> predecessor_begin(block_count + 1, 0);
+	std::vector<uint32_t> predecessors;
+	uint32_t position = 0;
+
+	for (const auto& block : m_function.blocks) {
+		block_begin[block->id] = position;
+		for (const IrInstruction* instruction : block->instructions)
+			positions[instruction->id] = position++;
+		block_end[block->id] = position - 1;
+
+		for (const IrBlock* predecessor : block->predecessors)
+			predecessors.push_back(predecessor->id);
+		predecessor_begin[block->id + 1] = static_cast<uint32_t>(predecessors.size());
+	}
+
+	// A phi's operand is written at the end of each predecessor and read by
+	// the phi.
+	std::vector<uint32_t> first(instruction_count), last(instruction_count);
+	std::vector<uint32_t> incoming_first(instruction_count), incoming_last(instruction_count);
+
+	for (const auto& block : m_function.blocks) {
+		for (const IrInstruction* instruction : block->instructions) {
+			first[instruction->id] = last[instruction->id] = positions[instruction->id];
+
+			if (instruction->op != IrOp::PHI)
+				continue;
+
+			incoming_first[instruction->id] = incoming_last[instruction->id] = positions[instruction->id];
+			for (const IrBlock* predecessor : block->predecessors) {
+				incoming_first[instruction->id] = std::min(incoming_first[instruction->id], block_end[predecessor->id]);
+				incoming_last[instruction->id] = std::max(incoming_last[instruction->id], block_end[predecessor->id]);
+			}
+		}
+	}
+
+	// Where each value is read: the block and the position, which for a phi
+	// operand is the end of the predecessor it comes from. Grouped by value,
+	// so that the walk below finishes one value before it starts the next.
+	struct Use {
+		const IrBlock* block;
+		uint32_t at;
+	};
+	std::vector<uint32_t> use_begin(instruction_count + 1, 0);
+
+	for (const auto& block : m_function.blocks) {
+		for (const IrInstruction* instruction : block->instructions) {
+			for (const IrInstruction* arg : instruction->args)
+				use_begin[arg->id + 1]++;
+		}
+	}
+
+	for (size_t i = 0; i < instruction_count; i++)
+		use_begin[i + 1] += use_begin[i];
+
+	std::vector<Use> uses(use_begin[instruction_count]);
+	std::vector<uint32_t> use_end(use_begin.begin(), use_begin.end() - 1);
+
+	for (const auto& block : m_function.blocks) {
+		for (const IrInstruction* instruction : block->instructions) {
+			for (size_t i = 0; i < instruction->args.size(); i++) {
+				const IrBlock* from = instruction->op == IrOp::PHI ? block->predecessors[i] : block.get();
+				uint32_t at = instruction->op == IrOp::PHI ? block_end[from->id] : positions[instruction->id];
+
+				uses[use_end[instruction->args[i]->id]++] = { from, at };
+			}
+		}
+	}
+
+	// A value read outside the block that defines it is live into every block
+	// on the way back from the read to the definition; the stamp of a block is
+	// the id of the last value found live into it.
+	std::vector<uint32_t> live_in(block_count, UINT32_MAX);
+	std::vector<uint32_t> worklist;
+
+	for (const auto& block : m_function.blocks) {
+		for (const IrInstruction* value : block->instructions) {
+			uint32_t id = value->id;
+			uint32_t definition = block->id;
+
+			for (uint32_t i = use_begin[id]; i < use_begin[id + 1]; i++) {
+				const Use& use = uses[i];
+				last[id] = std::max(last[id], use.at);
+
+				if (use.block->id == definition || live_in[use.block->id] == id)
+					continue;
+
+				live_in[use.block->id] = id;
+				worklist.push_back(use.block->id);
+
+				while (!worklist.empty()) {
+					uint32_t live = worklist.back();
+					worklist.pop_back();
+					first[id] = std::min(first[id], block_begin[live]);
+
+					for (uint32_t j = predecessor_begin[live]; j < predecessor_begin[live + 1]; j++) {
+						uint32_t predecessor = predecessors[j];
+						first[id] = std::min(first[id], block_end[predecessor]);
+						last[id] = std::max(last[id], block_end[predecessor]);
+
+						if (predecessor != definition && live_in[predecessor] != id) {
+							live_in[predecessor] = id;
+							worklist.push_back(predecessor);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	struct Interval {
+		uint32_t first;
+		uint32_t last;
+		uint32_t* slot;
+	};
+	std::vector<Interval> intervals;
+
+	m_value_slots.assign(instruction_count, 0);
+	m_incoming_slots.assign(instruction_count, 0);
+
+	for (const auto& block : m_function.blocks) {
+		for (const IrInstruction* instruction : block->instructions) {
+			uint32_t id = instruction->id;
+
+			if (instruction->type != Type::VOID)
+				intervals.push_back({ first[id], last[id], &m_value_slots[id] });
+			if (instruction->op == IrOp::PHI)
+				intervals.push_back({ incoming_first[id], incoming_last[id], &m_incoming_slots[id] });
+		}
+	}
+
+	std::sort(intervals.begin(), intervals.end(), [](const Interval& a, const Interval& b) { return a.first < b.first; });
+
+	// The slots in use as a min-heap of (last position, slot). One that ends
+	// where another starts stays taken, as an instruction may write its value
+	// before it has read all of its operands.
+	uint32_t slot_count = static_cast<uint32_t>(m_function.parameters.size());
+	std::vector<std::pair<uint32_t, uint32_t>> active;
+	std::vector<uint32_t> free_slots;
+
+	for (const Interval& interval : intervals) {
+		while (!active.empty() && active.front().first < interval.first) {
+			free_slots.push_back(active.front().second);
+			std::pop_heap(active.begin(), active.end(), std::greater<>());
+			active.pop_back();
+		}
+
+		uint32_t slot;
+		if (free_slots.empty())
+			slot = slot_count++;
+		else {
+			slot = free_slots.back();
+			free_slots.pop_back();
+		}
+
+		*interval.slot = slot;
+		active.emplace_back(interval.last, slot);
+		std::push_heap(active.begin(), active.end(), std::greater<>());
+	}
+
+	return slot_count;
+}
+
+void FunctionEmitter::emit() {
+	uint32_t slot_count = allocate_slots();
+
+	for (size_t i = 0; i < m_function.blocks.size(); i++)
+		m_blocks.push_back(m_emitter.create_label());
+
+	// RBP, RBX and R12 are saved, which leaves the stack 16-byte aligned for
+	// calls as long as the frame is a multiple of 16.
+	m_frame_size = static_cast<int32_t>((slot_count * 8 + 15) & ~15u);
+	m_division_by_zero = m_emitter.create_label();
+	m_stack_overflow = m_emitter.create_label();
+
+	m_emitter.bind(m_entries[m_index]);
+	emit_prologue();
+
+	for (const auto& block : m_function.blocks) {
+		m_emitter.bind(m_blocks[block->id]);
+
+		for (size_t i = 0; i < block->instructions.size(); i++)
+			emit_instruction(*block->instructions[i], *block, i);
+	}
+
+	emit_error(m_stack_overflow, STACK_OVERFLOW);
+	if (m_divides)
+		emit_error(m_division_by_zero, DIVISION_BY_ZERO);
+}
+
+void FunctionEmitter::emit_prologue() {
+	m_emitter.push(Register::RBP);
+	m_emitter.mov64(Register::RBP, Register::RSP);
+	m_emitter.push(STATE);
+	m_emitter.push(GLOBALS);
+	m_emitter.mov64(STATE, m_state);
+	m_emitter.mov64(GLOBALS, m_globals);
+
+	// Checked before the frame is touched: the limit is the first field of the state.
+	m_emitter.lea64(Register::RAX, { Register::RSP, -m_frame_size });
+	m_emitter.cmp64(Register::RAX, { STATE, 0 });
+	m_emitter.jump_if(Condition::BELOW, m_stack_overflow);
+
+	// Pages are touched in order, so that the guard page below the stack is
+	// never skipped.
+	if (m_frame_size > PAGE_SIZE) {
+		X86Emitter::Label loop = m_emitter.create_label();
+
+		m_emitter.mov(Register::RAX, m_frame_size / PAGE_SIZE);
+		m_emitter.bind(loop);
+		m_emitter.sub64(Register::RSP, PAGE_SIZE);
+		m_emitter.mov(Memory{ Register::RSP, 0 }, 0);
+		m_emitter.dec(Register::RAX);
+		m_emitter.jump_if(Condition::NOT_EQUAL, loop);
+
+		if (m_frame_size % PAGE_SIZE)
+			m_emitter.sub64(Register::RSP, m_frame_size % PAGE_SIZE);
+	} else if (m_frame_size)
+		m_emitter.sub64(Register::RSP, m_frame_size);
+
+	uint32_t stack_count;
+	std::vector<ArgumentLocation> locations = locate_arguments(m_function.parameters, stack_count);
+
+	for (uint32_t i = 0; i < locations.size(); i++) {
+		const ArgumentLocation& location = locations[i];
+		bool is_bool = m_function.parameters[i] == Type::BOOL;
+		Memory stack_argument{ Register::RBP, 16 + 8 * location.index };
+
+		// Only the low byte of a bool argument is defined.
+		if (location.floating && !location.on_stack)
+			m_emitter.movss(slot(i), xmm(location.index));
+		else if (!location.on_stack && is_bool) {
+			m_emitter.movzx_byte(Register::RAX, INT_ARGUMENTS[location.index]);
+			m_emitter.mov(slot(i), Register::RAX);
+		} else if (!location.on_stack)
+			m_emitter.mov(slot(i), INT_ARGUMENTS[location.index]);
+		else {
+			if (is_bool)
+				m_emitter.movzx_byte(Register::RAX, stack_argument);
+			else
+				m_emitter.mov(Register::RAX, stack_argument);
+			m_emitter.mov(slot(i), Register::RAX);
+		}
+	}
+}
+
+void FunctionEmitter::emit_epilogue() {
+	m_emitter.lea64(Register::RSP, { Register::RBP, -16 });
+	m_emitter.pop(GLOBALS);
+	m_emitter.pop(STATE);
+	m_emitter.pop(Register::RBP);
+	m_emitter.ret();
+}
+
+void FunctionEmitter::emit_error(X86Emitter::Label label, RuntimeError error) {
+	m_emitter.bind(label);
+	m_emitter.mov64(Register::RDI, STATE);
+	m_emitter.mov(Register::RSI, static_cast<int32_t>(error));
+	m_emitter.mov(Register::RDX, static_cast<int32_t>(m_index));
+	m_emitter.mov64(Register::RAX, m_error_handler);
+	m_emitter.call(Register::RAX);
+}
+
+// Writes the operands of the successor's phis that come from this block.
+void FunctionEmitter::emit_edge(const IrBlock& from, const IrBlock& to) {
+	size_t predecessor = std::find(to.predecessors.begin(), to.predecessors.end(), &from) - to.predecessors.begin();
+
+	for (size_t i = 0; i < to.first_non_phi(); i++) {
+		const IrInstruction* phi = to.instructions[i];
+
+		m_emitter.mov(Register::RAX, value(phi->args[predecessor]));
+		m_emitter.mov(incoming(phi), Register::RAX);
+	}
+}
+
+void FunctionEmitter::emit_jump(const IrBlock& from, const IrBlock& to, size_t position) {
+	emit_edge(from, to);
+
+	// Falls through to the next block.
+	if (to.id != from.id + 1 || position + 1 != from.instructions.size())
+		m_emitter.jump(m_blocks[to.id]);
+}
+
+void FunctionEmitter::store_flag(const IrInstruction& instruction, Condition condition) {
+	m_emitter.setcc(condition, Register::RAX);
+	m_emitter.movzx_byte(Register::RAX, Register::RAX);
+	m_emitter.mov(value(&instruction), Register::RAX);
+}
+
+void FunctionEmitter::emit_compare(const IrInstruction& instruction) {
+	const IrInstruction* a = instruction.args[0];
+	const IrInstruction* b = instruction.args[1];
+
+	if (a->type != Type::FLOAT) {
+		m_emitter.mov(Register::RAX, value(a));
+		m_emitter.cmp(Register::RAX, value(b));
+
+		switch (instruction.op) {
+		case IrOp::EQ:
+			return store_flag(instruction, Condition::EQUAL);
+		case IrOp::NE:
+			return store_flag(instruction, Condition::NOT_EQUAL);
+		case IrOp::LT:
+			return store_flag(instruction, Condition::LESS);
+		default:
+			return store_flag(instruction, Condition::LESS_EQUAL);
+		}
+	}
+
+	// An unordered comparison sets ZF, PF and CF, and has to come out false
+	// for everything but !=.
+	switch (instruction.op) {
+	case IrOp::EQ:
+	case IrOp::NE:
+		m_emitter.movss(Xmm::XMM0, value(a));
+		m_emitter.ucomiss(Xmm::XMM0, value(b));
+
+		if (instruction.op == IrOp::EQ) {
+			m_emitter.setcc(Condition::EQUAL, Register::RAX);
+			m_emitter.setcc(Condition::NO_PARITY, Register::RCX);
+			m_emitter.and_byte(Register::RAX, Register::RCX);
+		} else {
+			m_emitter.setcc(Condition::NOT_EQUAL, Register::RAX);
+			m_emitter.setcc(Condition::PARITY, Register::RCX);
+			m_emitter.or_byte(Register::RAX, Register::RCX);
+		}
+
+		m_emitter.movzx_byte(Register::RAX, Register::RAX);
+		m_emitter.mov(value(&instruction), Register::RAX);
+		break;
+	default:
+		// a < b as b > a, which is false when unordered.
+		m_emitter.movss(Xmm::XMM0, value(b));
+		m_emitter.ucomiss(Xmm::XMM0, value(a));
+		store_flag(instruction, instruction.op == IrOp::LT ? Condition::ABOVE : Condition::ABOVE_EQUAL);
+		break;
+	}
+}
+
+void FunctionEmitter::emit_call(const IrInstruction& instruction) {
+	const IrFunction& callee = m_module.functions[instruction.imm];
+	uint32_t stack_count;
+	std::vector<ArgumentLocation> locations = locate_arguments(callee.parameters, stack_count);
+	int32_t stack_bytes = static_cast<int32_t>(8 * (stack_count + stack_count % 2));
+
+	if (stack_count % 2)
+		m_emitter.sub64(Register::RSP, 8);
+
+	for (size_t i = locations.size(); i-- > 0;) {
+		if (!locations[i].on_stack)
+			continue;
+
+		m_emitter.mov(Register::RAX, value(instruction.args[i]));
+		m_emitter.push(Register::RAX);
+	}
+
+	for (size_t i = 0; i < locations.size(); i++) {
+		if (locations[i].on_stack)
+			continue;
+
+		if (locations[i].floating)
+			m_emitter.movss(xmm(locations[i].index), value(instruction.args[i]));
+		else
+			m_emitter.mov(INT_ARGUMENTS[locations[i].index], value(instruction.args[i]));
+	}
+
+	m_emitter.call(m_entries[instruction.imm]);
+
+	if (stack_bytes)
+		m_emitter.add64(Register::RSP, stack_bytes);
+
+	if (instruction.type == Type::FLOAT)
+		m_emitter.movss(value(&instruction), Xmm::XMM0);
+	else if (instruction.type != Type::VOID)
+		m_emitter.mov(value(&instruction), Register::RAX);
+}
+
+void FunctionEmitter::emit_instruction(const IrInstruction& instruction, const IrBlock& block, size_t position) {
+	const std::vector<IrInstruction*>& args = instruction.args;
+	bool floating = !args.empty() && args[0]->type == Type::FLOAT;
+
+	switch (instruction.op) {
+	case IrOp::CONST:
+		m_emitter.mov(value(&instruction), static_cast<int32_t>(instruction.imm));
+		break;
+	case IrOp::PARAM:
+		m_emitter.mov(Register::RAX, slot(instruction.imm));
+		m_emitter.mov(value(&instruction), Register::RAX);
+		break;
+	case IrOp::LOAD_GLOBAL:
+		m_emitter.mov(Register::RAX, global(instruction.imm));
+		m_emitter.mov(value(&instruction), Register::RAX);
+		break;
+	case IrOp::STORE_GLOBAL:
+		m_emitter.mov(Register::RAX, value(args[0]));
+		m_emitter.mov(global(instruction.imm), Register::RAX);
+		break;
+	case IrOp::ADD:
+	case IrOp::SUB:
+	case IrOp::MUL:
+		if (floating) {
+			m_emitter.movss(Xmm::XMM0, value(args[0]));
+			if (instruction.op == IrOp::ADD)
+				m_emitter.addss(Xmm::XMM0, value(args[1]));
+			else if (instruction.op == IrOp::SUB)
+				m_emitter.subss(Xmm::XMM0, value(args[1]));
+			else
+				m_emitter.mulss(Xmm::XMM0, value(args[1]));
+			m_emitter.movss(value(&instruction), Xmm::XMM0);
+		} else {
+			m_emitter.mov(Register::RAX, value(args[0]));
+			if (instruction.op == IrOp::ADD)
+				m_emitter.add(Register::RAX, value(args[1]));
+			else if (instruction.op == IrOp::SUB)
+				m_emitter.sub(Register::RAX, value(args[1]));
+			else
+				m_emitter.imul(Register::RAX, value(args[1]));
+			m_emitter.mov(value(&instruction), Register::RAX);
+		}
+		break;
+	case IrOp::DIV:
+		if (floating) {
+			m_emitter.movss(Xmm::XMM0, value(args[0]));
+			m_emitter.divss(Xmm::XMM0, value(args[1]));
+			m_emitter.movss(value(&instruction), Xmm::XMM0);
+		} else {
+			// INT_MIN / -1 traps in IDIV; like the VM, it wraps instead.
+			X86Emitter::Label divide = m_emitter.create_label();
+			X86Emitter::Label done = m_emitter.create_label();
+
+			m_divides = true;
+			m_emitter.mov(Register::RCX, value(args[1]));
+			m_emitter.test(Register::RCX, Register::RCX);
+			m_emitter.jump_if(Condition::EQUAL, m_division_by_zero);
+			m_emitter.mov(Register::RAX, value(args[0]));
+			m_emitter.cmp(Register::RCX, -1);
+			m_emitter.jump_if(Condition::NOT_EQUAL, divide);
+			m_emitter.neg(Register::RAX);
+			m_emitter.jump(done);
+			m_emitter.bind(divide);
+			m_emitter.cdq();
+			m_emitter.idiv(Register::RCX);
+			m_emitter.bind(done);
+			m_emitter.mov(value(&instruction), Register::RAX);
+		}
+		break;
+	case IrOp::EQ:
+	case IrOp::NE:
+	case IrOp::LT:
+	case IrOp::LE:
+		emit_compare(instruction);
+		break;
+	case IrOp::BOOL_TO_INT:
+		m_emitter.mov(Register::RAX, value(args[0]));
+		m_emitter.mov(value(&instruction), Register::RAX);
+		break;
+	case IrOp::INT_TO_FLOAT:
+		m_emitter.cvtsi2ss(Xmm::XMM0, value(args[0]));
+		m_emitter.movss(value(&instruction), Xmm::XMM0);
+		break;
+	case IrOp::FLOAT_TO_INT: {
+		// CVTTSS2SI returns INT_MIN for NaN and out of range values, which
+		// float_to_int() saturates instead.
+		X86Emitter::Label done = m_emitter.create_label();
+
+		m_emitter.movss(Xmm::XMM0, value(args[0]));
+		m_emitter.cvttss2si(Register::RAX, Xmm::XMM0);
+		m_emitter.cmp(Register::RAX, INT32_MIN);
+		m_emitter.jump_if(Condition::NOT_EQUAL, done);
+		m_emitter.mov64(Register::RAX, reinterpret_cast<uintptr_t>(&float_to_int));
+		m_emitter.call(Register::RAX);
+		m_emitter.bind(done);
+		m_emitter.mov(value(&instruction), Register::RAX);
+		break;
+	}
+	case IrOp::INT_TO_BOOL:
+		m_emitter.mov(Register::RAX, value(args[0]));
+		m_emitter.test(Register::RAX, Register::RAX);
+		store_flag(instruction, Condition::NOT_EQUAL);
+		break;
+	case IrOp::FLOAT_TO_BOOL:
+		// NaN is true, as NaN != 0.
+		m_emitter.movss(Xmm::XMM0, value(args[0]));
+		m_emitter.xorps(Xmm::XMM1, Xmm::XMM1);
+		m_emitter.ucomiss(Xmm::XMM0, Xmm::XMM1);
+		m_emitter.setcc(Condition::NOT_EQUAL, Register::RAX);
+		m_emitter.setcc(Condition::PARITY, Register::RCX);
+		m_emitter.or_byte(Register::RAX, Register::RCX);
+		m_emitter.movzx_byte(Register::RAX, Register::RAX);
+		m_emitter.mov(value(&instruction), Register::RAX);
+		break;
+	case IrOp::CALL:
+		emit_call(instruction);
+		break;
+	case IrOp::PHI:
+		m_emitter.mov(Register::RAX, incoming(&instruction));
+		m_emitter.mov(value(&instruction), Register::RAX);
+		break;
+	case IrOp::JUMP:
+		emit_jump(block, *block.successors[0], position);
+		break;
+	case IrOp::BRANCH: {
+		const IrBlock& if_true = *block.successors[0];
+		const IrBlock& if_false = *block.successors[1];
+
+		m_emitter.mov(Register::RAX, value(args[0]));
+		m_emitter.test(Register::RAX, Register::RAX);
+
+		if (if_false.first_non_phi() == 0) {
+			m_emitter.jump_if(Condition::EQUAL, m_blocks[if_false.id]);
+			emit_jump(block, if_true, position);
+		} else {
+			X86Emitter::Label false_edge = m_emitter.create_label();
+
+			m_emitter.jump_if(Condition::EQUAL, false_edge);
+			emit_edge(block, if_true);
+			m_emitter.jump(m_blocks[if_true.id]);
+			m_emitter.bind(false_edge);
+			emit_jump(block, if_false, position);
+		}
+		break;
+	}
+	case IrOp::RETURN:
+		if (!args.empty() && args[0]->type == Type::FLOAT)
+			m_emitter.movss(Xmm::XMM0, value(args[0]));
+		else if (!args.empty())
+			m_emitter.mov(Register::RAX, value(args[0]));
+		emit_epilogue();
+		break;
+	}
+}
+
+// Loads the arguments from a Value array into their registers and stack
+// slots, calls the function and stores what it returns.
+static void emit_trampoline(X86Emitter& emitter, const IrFunction& function, X86Emitter::Label entry) {
+	static constexpr Register ARGUMENTS = Register::RBX;
+	static constexpr Register RESULT = Register::R12;
+
+	uint32_t stack_count;
+	std::vector<ArgumentLocation> locations = locate_arguments(function.parameters, stack_count);
+	int32_t stack_bytes = static_cast<int32_t>(8 * (stack_count + stack_count % 2));
+
+	emitter.push(Register::RBP);
+	emitter.mov64(Register::RBP, Register::RSP);
+	emitter.push(ARGUMENTS);
+	emitter.push(RESULT);
+	emitter.mov64(ARGUMENTS, Register::RDI);
+	emitter.mov64(RESULT, Register::RSI);
+
+	if (stack_count % 2)
+		emitter.sub64(Register::RSP, 8);
+
+	for (size_t i = locations.size(); i-- > 0;) {
+		if (!locations[i].on_stack)
+			continue;
+
+		emitter.mov(Register::RAX, { ARGUMENTS, 4 * static_cast<int32_t>(i) });
+		emitter.push(Register::RAX);
+	}
+
+	for (size_t i = 0; i < locations.size(); i++) {
+		Memory argument{ ARGUMENTS, 4 * static_cast<int32_t>(i) };
+
+		if (locations[i].on_stack)
+			continue;
+		if (locations[i].floating)
+			emitter.movss(xmm(locations[i].index), argument);
+		else
+			emitter.mov(INT_ARGUMENTS[locations[i].index], argument);
+	}
+
+	emitter.call(entry);
+
+	if (stack_bytes)
+		emitter.add64(Register::RSP, stack_bytes);
+
+	if (function.return_type == Type::FLOAT)
+		emitter.movss(Memory{ RESULT, 0 }, Xmm::XMM0);
+	else if (function.return_type != Type::VOID)
+		emitter.mov(Memory{ RESULT, 0 }, Register::RAX);
+
+	emitter.lea64(Register::RSP, { Register::RBP, -16 });
+	emitter.pop(RESULT);
+	emitter.pop(ARGUMENTS);
+	emitter.pop(Register::RBP);
+	emitter.ret();
+}
+
+Jit::~Jit() {
+#ifdef TOY_JIT
+	if (m_code)
+		munmap(m_code, m_code_size);
+#endif
+}
+
+bool Jit::compile(const IrModule& module) {
+#ifndef TOY_JIT
+	(void)module;
+	m_error = "the JIT needs x86-64 with the System V calling convention";
+	return false;
+#else
+	m_functions.clear();
+	m_names.clear();
+	m_globals.assign(std::max<uint32_t>(module.global_count, 1), Value{});
+	m_state = {};
+	m_state.jit = this;
+	m_entry = module.entry;
+	m_main = module.main;
+
+	X86Emitter emitter;
+	std::vector<X86Emitter::Label> entries;
+	std::vector<X86Emitter::Label> trampolines;
+
+	for (size_t i = 0; i < module.functions.size(); i++) {
+		entries.push_back(emitter.create_label());
+		trampolines.push_back(emitter.create_label());
+	}
+
+	for (uint32_t i = 0; i < module.functions.size(); i++) {
+		FunctionEmitter(emitter, module, i, entries, reinterpret_cast<uintptr_t>(&m_state), reinterpret_cast<uintptr_t>(m_globals.data()),
+			reinterpret_cast<uintptr_t>(&Jit::runtime_error)).emit();
+	}
+
+	for (uint32_t i = 0; i < module.functions.size(); i++) {
+		emitter.bind(trampolines[i]);
+		emit_trampoline(emitter, module.functions[i], entries[i]);
+	}
+
+	for (uint32_t i = 0; i < module.functions.size(); i++) {
+		const IrFunction& function = module.functions[i];
+		m_functions.push_back({ function.name, function.return_type, function.parameters, emitter.offset(entries[i]), emitter.offset(trampolines[i]) });
+	}
+
+	// Names point into m_functions, which no longer grows.
+	for (uint32_t i = 0; i < m_functions.size(); i++)
+		m_names.emplace(m_functions[i].name, i);
+
+	return map_code(emitter.finish());
+#endif
+}
+
+bool Jit::map_code(const std::vector<uint8_t>& code) {
+#ifdef TOY_JIT
+	if (m_code)
+		munmap(m_code, m_code_size);
+
+	size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	size_t size = (std::max<size_t>(code.size(), 1) + page_size - 1) / page_size * page_size;
+
+	// Written first, then made executable, so the pages are never both.
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		m_code = nullptr;
+		m_error = "cannot map memory for the code";
+		return false;
+	}
+
+	std::memcpy(memory, code.data(), code.size());
+
+	if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(memory, size);
+		m_code = nullptr;
+		m_error = "cannot make the code executable";
+		return false;
+	}
+
+	m_code = static_cast<uint8_t*>(memory);
+	m_code_size = size;
+
+	return true;
+#else
+	(void)code;
+	return false;
+#endif
+}
+
+bool Jit::run() {
+	std::fill(m_globals.begin(), m_globals.end(), Value{});
+	m_result = {};
+
+	Value ignored;
+	if (!call(m_entry, {}, ignored))
+		return false;
+
+	if (m_main >= 0)
+		return call(static_cast<uint32_t>(m_main), {}, m_result);
+
+	return true;
+}
+
+bool Jit::call(uint32_t function, const std::vector<Value>& arguments, Value& result) {
+	const Function& callee = m_functions[function];
+
+	if (arguments.size() != callee.parameters.size()) {
+		m_error = "wrong number of arguments for function '" + callee.name + '\'';
+		return false;
+	}
+
+	using Trampoline = void (*)(const Value* arguments, Value* result);
+	auto trampoline = reinterpret_cast<Trampoline>(m_code + callee.trampoline);
+	std::jmp_buf jump;
+	char marker;
+	uintptr_t stack = reinterpret_cast<uintptr_t>(&marker);
+
+	m_error.clear();
+	m_state.stack_limit = stack > STACK_BUDGET ? stack - STACK_BUDGET : 0;
+	m_state.jump = &jump;
+
+	// runtime_error() jumps back here; the frames in between are all JIT code.
+	if (setjmp(jump)) {
+		m_state = { 0, this, nullptr };
+		return false;
+	}
+
+	trampoline(arguments.data(), &result);
+	m_state = { 0, this, nullptr };
+
+	return true;
+}
+
+void Jit::runtime_error(State* state, uint32_t error, uint32_t function) {
+	Jit& jit = *state->jit;
+
+	jit.m_error = std::string(error == DIVISION_BY_ZERO ? "division by zero" : "stack overflow") + " in function '" + jit.m_functions[function].name + '\'';
+
+	if (state->jump)
+		std::longjmp(*state->jump, 1);
+
+	std::fprintf(stderr, "runtime error: %s\n", jit.m_error.c_str());
+	std::abort();
+}
+
+Value Jit::result() const {
+	return m_result;
+}
+
+const std::string& Jit::error() const {
+	return m_error;
+}
+
+int32_t Jit::find(std::string_view name) const {
+	auto it = m_names.find(name);
+	return it != m_names.end() ? static_cast<int32_t>(it->second) : -1;
+}
+
+const void* Jit::address(std::string_view name) const {
+	int32_t index = find(name);
+	return index >= 0 && m_code ? m_code + m_functions[index].offset : nullptr;
+}
+
+size_t Jit::code_size() const {
+	return m_code_size;
+}
\ No newline at end of file
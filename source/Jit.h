@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Bytecode.h"
+#include "Ir.h"
+
+#include <csetjmp>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Compiles an IrModule to x86-64 machine code in executable memory. Functions
+// follow the System V calling convention, so they can be called from C++ with
+// the matching signature: int is int32_t, float is float and bool is bool.
+//
+// Every value lives in a stack slot of its function, which it shares with
+// values that are never live at the same time; an instruction loads its
+// operands into scratch registers and stores its result back. RBX points at
+// the JIT's state and R12 at the globals.
+class Jit {
+public:
+	Jit() = default;
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+	~Jit();
+
+	// Returns false, with the reason in error(), when the module cannot be
+	// compiled on this platform or the memory cannot be mapped.
+	bool compile(const IrModule& module);
+
+	// Like VirtualMachine: runs the top-level function, then main() if there
+	// is one, and turns division by zero and running out of stack into an
+	// error instead of a crash.
+	bool run();
+	bool call(uint32_t function, const std::vector<Value>& arguments, Value& result);
+	Value result() const;
+	const std::string& error() const;
+
+	// Index of the first function with the name, or -1.
+	int32_t find(std::string_view name) const;
+	// Entry point of a compiled function, nullptr if there is none with the
+	// name. Calling it directly skips the checks of call(): a runtime error
+	// prints a message and aborts.
+	const void* address(std::string_view name) const;
+	// Typed entry point, nullptr unless the signature matches the function's.
+	template<typename Signature>
+	Signature* function(std::string_view name) const;
+
+	size_t code_size() const;
+
+private:
+	struct Function {
+		std::string name;
+		Type return_type;
+		std::vector<Type> parameters;
+		uint32_t offset = 0;
+		// Calls the function with arguments read from a Value array.
+		uint32_t trampoline = 0;
+	};
+
+	// What the machine code reads through RBX; the layout is part of the code.
+	struct State {
+		// The stack may not grow below this; zero when not called by call().
+		uintptr_t stack_limit = 0;
+		Jit* jit = nullptr;
+		std::jmp_buf* jump = nullptr;
+	};
+
+	template<typename T>
+	static constexpr Type type_of();
+	template<typename Signature>
+	struct SignatureOf;
+
+	[[noreturn]] static void runtime_error(State* state, uint32_t error, uint32_t function);
+	bool map_code(const std::vector<uint8_t>& code);
+
+private:
+	std::vector<Function> m_functions;
+	std::unordered_map<std::string_view, uint32_t> m_names;
+	std::vector<Value> m_globals;
+	State m_state;
+	uint32_t m_entry = 0;
+	int32_t m_main = -1;
+
+	uint8_t* m_code = nullptr;
+	size_t m_code_size = 0;
+
+	Value m_result{};
+	std::string m_error;
+};
+
+template<typename T>
+constexpr Type Jit::type_of() {
+	if constexpr (std::is_same_v<T, void>)
+		return Type::VOID;
+	else if constexpr (std::is_same_v<T, bool>)
+		return Type::BOOL;
+	else if constexpr (std::is_same_v<T, int32_t>)
+		return Type::INT;
+	else {
+		static_assert(std::is_same_v<T, float>, "toy functions take and return int32_t, float and bool");
+		return Type::FLOAT;
+	}
+}
+
+template<typename R, typename... Args>
+struct Jit::SignatureOf<R(Args...)> {
+	static bool matches(const Function& function) {
+		return function.return_type == type_of<R>() && function.parameters == std::vector<Type>{ type_of<Args>()... };
+	}
+};
+
+template<typename Signature>
+Signature* Jit::function(std::string_view name) const {
+	int32_t index = find(name);
+
+	if (index < 0 || !SignatureOf<Signature>::matches(m_functions[index]))
+		return nullptr;
+
+	return reinterpret_cast<Signature*>(const_cast<void*>(address(name)));
+}
\ No newline at end of file
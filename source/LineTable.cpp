@@ -0,0 +1,32 @@
+#include "LineTable.h"
+#include "Trace.h"
+
+#include <algorithm>
+
+LineTable::LineTable(std::string_view text, ScanKernel kernel) {
+	TraceScope trace("index_lines", "parser");
+	const ScanKernels& scan = get_scan_kernels(kernel);
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+
+	m_starts.resize(scan.count_newlines(begin, end) + 1);
+	m_starts[0] = 0;
+	scan.find_line_starts(begin, end, begin, m_starts.data() + 1);
+
+	trace.add_arg("lines", m_starts.size());
+}
+
+size_t LineTable::line_count() const {
+	return m_starts.size();
+}
+
+Position LineTable::position(uint32_t offset) const {
+	// The last line that starts at or before the offset; the first one always does.
+	auto line = std::upper_bound(m_starts.begin(), m_starts.end(), offset) - 1;
+
+	return { static_cast<int>(line - m_starts.begin()) + 1, static_cast<int>(offset - *line) + 1 };
+}
+
+size_t LineTable::memory_usage() const {
+	return m_starts.capacity() * sizeof(uint32_t);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "ScanKernels.h"
+
+#include <string_view>
+#include <vector>
+
+struct Position {
+	int line;
+	int column;
+};
+
+// Where every line of a source starts. Tokens and diagnostics only carry byte
+// offsets; position() turns one into a line and column by binary search, so
+// the tokenizer never has to count lines. The newlines are counted first and
+// then collected into a table of exactly that size, both with the widest
+// kernel the CPU has.
+class LineTable {
+public:
+	LineTable(std::string_view text, ScanKernel kernel = best_scan_kernel());
+
+	size_t line_count() const;
+	// Offsets past the end are on the last line.
+	Position position(uint32_t offset) const;
+
+	size_t memory_usage() const;
+
+private:
+	// Offset of the first byte of each line, the first one being 0.
+	std::vector<uint32_t> m_starts;
+};
\ No newline at end of file
@@ -0,0 +1,312 @@
+#include "NameResolver.h"
+
+bool NameResolver::resolve(TranslationUnit& unit) {
+	m_errors.clear();
+	m_warnings.clear();
+	m_functions.assign(1, nullptr);
+	m_global_count = 0;
+	m_identifiers = IdentifierTable();
+	m_symbols.clear();
+	m_innermost.clear();
+	m_scopes.clear();
+	m_function = nullptr;
+	m_depth = 0;
+	m_next_slot = 0;
+
+	push_scope();
+
+	// Top-level functions are declared up front, so that they can call each
+	// other in any order.
+	for (Statement* stmt : unit.statements()) {
+		if (stmt && stmt->kind() == NodeKind::FUNCTION_DECLARATION)
+			declare_function(*static_cast<FunctionDeclaration*>(stmt));
+	}
+
+	for (Statement* stmt : unit.statements()) {
+		if (!stmt)
+			continue;
+
+		if (stmt->kind() == NodeKind::FUNCTION_DECLARATION)
+			resolve_function(*static_cast<FunctionDeclaration*>(stmt));
+		else if (stmt->kind() == NodeKind::VARIABLE_DECLARATION)
+			resolve_variable_declaration(*static_cast<VariableDeclaration*>(stmt), true);
+		else
+			resolve_statement(stmt);
+	}
+
+	pop_scope();
+
+	return m_errors.empty();
+}
+
+const std::vector<Diagnostic>& NameResolver::errors() const {
+	return m_errors;
+}
+
+const std::vector<Diagnostic>& NameResolver::warnings() const {
+	return m_warnings;
+}
+
+const std::vector<const FunctionDeclaration*>& NameResolver::functions() const {
+	return m_functions;
+}
+
+uint32_t NameResolver::global_count() const {
+	return m_global_count;
+}
+
+// The tree has no positions, so messages name the function they are in instead.
+void NameResolver::error(std::string message) {
+	if (m_function)
+		message += " in function '" + std::string(m_function->id()) + '\'';
+
+	m_errors.push_back({ {}, std::move(message) });
+}
+
+void NameResolver::warning(std::string message) {
+	if (m_function)
+		message += " in function '" + std::string(m_function->id()) + '\'';
+
+	m_warnings.push_back({ {}, std::move(message) });
+}
+
+const NameResolver::Symbol* NameResolver::find(std::string_view name) {
+	uint32_t id = m_identifiers.intern(name);
+
+	if (id >= m_innermost.size() || m_innermost[id] == NO_SYMBOL)
+		return nullptr;
+
+	return &m_symbols[m_innermost[id]];
+}
+
+const NameResolver::Symbol* NameResolver::find_variable(std::string_view name) {
+	const Symbol* symbol = find(name);
+
+	if (!symbol)
+		error("Unknown variable '" + std::string(name) + '\'');
+	else if (symbol->binding.kind == BindingKind::FUNCTION)
+		error('\'' + std::string(name) + "' is a function, not a variable");
+	else if (symbol->binding.kind == BindingKind::LOCAL && symbol->binding.depth != m_depth)
+		error("Cannot use local '" + std::string(name) + "' of an enclosing function");
+	else
+		return symbol;
+
+	return nullptr;
+}
+
+void NameResolver::declare(std::string_view name, Binding binding, VariableDeclaration* declaration) {
+	uint32_t id = m_identifiers.intern(name);
+
+	if (id >= m_innermost.size())
+		m_innermost.resize(id + 1, NO_SYMBOL);
+
+	uint32_t shadowed = m_innermost[id];
+
+	if (shadowed != NO_SYMBOL) {
+		if (shadowed >= m_scopes.back().first_symbol) {
+			error('\'' + std::string(name) + "' is already declared in this scope");
+			return;
+		}
+
+		warning('\'' + std::string(name) + "' shadows an earlier declaration");
+	}
+
+	m_innermost[id] = static_cast<uint32_t>(m_symbols.size());
+	m_symbols.push_back({ id, binding, declaration, shadowed });
+}
+
+void NameResolver::push_scope() {
+	m_scopes.push_back({ static_cast<uint32_t>(m_symbols.size()), m_next_slot });
+}
+
+void NameResolver::pop_scope() {
+	while (m_symbols.size() > m_scopes.back().first_symbol) {
+		const Symbol& symbol = m_symbols.back();
+
+		m_innermost[symbol.name] = symbol.shadowed;
+		m_symbols.pop_back();
+	}
+
+	m_next_slot = m_scopes.back().next_slot;
+	m_scopes.pop_back();
+}
+
+void NameResolver::declare_function(FunctionDeclaration& declaration) {
+	uint32_t index = static_cast<uint32_t>(m_functions.size());
+
+	declaration.set_index(index);
+	m_functions.push_back(&declaration);
+
+	declare(declaration.id(), { BindingKind::FUNCTION, declaration.return_type(), m_depth, index });
+}
+
+void NameResolver::resolve_function(FunctionDeclaration& declaration) {
+	const FunctionDeclaration* function = m_function;
+	uint32_t next_slot = m_next_slot;
+
+	m_function = &declaration;
+	m_depth++;
+	m_next_slot = 0;
+
+	// Parameters share the scope of the body, as in C.
+	push_scope();
+
+	for (const TypedId& parameter : declaration.parameters())
+		declare(parameter.id, { BindingKind::LOCAL, parameter.type, m_depth, m_next_slot++ });
+
+	if (declaration.statement()) {
+		for (Statement* stmt : declaration.statement()->statements())
+			resolve_statement(stmt);
+	}
+
+	pop_scope();
+
+	m_function = function;
+	m_depth--;
+	m_next_slot = next_slot;
+}
+
+void NameResolver::resolve_statement(Statement* stmt) {
+	if (!stmt)
+		return;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT:
+		push_scope();
+		for (Statement* child : static_cast<CompoundStatement*>(stmt)->statements())
+			resolve_statement(child);
+		pop_scope();
+		break;
+	case NodeKind::VARIABLE_DECLARATION:
+		resolve_variable_declaration(*static_cast<VariableDeclaration*>(stmt), false);
+		break;
+	case NodeKind::FUNCTION_DECLARATION: {
+		auto& declaration = *static_cast<FunctionDeclaration*>(stmt);
+		declare_function(declaration);
+		resolve_function(declaration);
+		break;
+	}
+	case NodeKind::IF_STATEMENT: {
+		auto& if_stmt = *static_cast<IfStatement*>(stmt);
+		resolve_expression(if_stmt.condition());
+		resolve_scoped_statement(if_stmt.statement());
+		break;
+	}
+	case NodeKind::FOR_STATEMENT: {
+		auto& for_stmt = *static_cast<ForStatement*>(stmt);
+		push_scope();
+		if (for_stmt.variable_declaration())
+			resolve_variable_declaration(*for_stmt.variable_declaration(), false);
+		resolve_expression(for_stmt.condition_expr());
+		resolve_expression(for_stmt.loop_expr());
+		resolve_scoped_statement(for_stmt.statement());
+		pop_scope();
+		break;
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		auto& while_stmt = *static_cast<WhileStatement*>(stmt);
+		resolve_expression(while_stmt.condition_expr());
+		resolve_scoped_statement(while_stmt.statement());
+		break;
+	}
+	case NodeKind::RETURN_STATEMENT:
+		resolve_expression(static_cast<ReturnStatement*>(stmt)->return_expr());
+		break;
+	default:
+		resolve_expression(static_cast<Expression*>(stmt));
+		break;
+	}
+}
+
+// The body of an if or a loop is a scope of its own even without braces.
+void NameResolver::resolve_scoped_statement(Statement* stmt) {
+	push_scope();
+	resolve_statement(stmt);
+	pop_scope();
+}
+
+void NameResolver::resolve_variable_declaration(VariableDeclaration& declaration, bool global) {
+	// The initializer cannot see the variable it initializes.
+	resolve_expression(declaration.initial_value());
+
+	Binding binding{ BindingKind::LOCAL, declaration.type(), m_depth, 0 };
+
+	if (global) {
+		binding.kind = BindingKind::GLOBAL;
+		binding.slot = m_global_count++;
+	} else
+		binding.slot = m_next_slot++;
+
+	declaration.bind(binding);
+	declare(declaration.id(), binding, &declaration);
+}
+
+void NameResolver::resolve_expression(Expression* expr) {
+	if (!expr)
+		return;
+
+	switch (expr->kind()) {
+	case NodeKind::ID_ATOM: {
+		auto& atom = *static_cast<IdAtom*>(expr);
+
+		if (const Symbol* symbol = find_variable(atom.id()))
+			atom.bind(symbol->binding);
+		break;
+	}
+	case NodeKind::FUNC_CALL_ATOM: {
+		auto& call = *static_cast<FuncCallAtom*>(expr);
+		const Symbol* symbol = find(call.id());
+
+		if (!symbol)
+			error("Unknown function '" + std::string(call.id()) + '\'');
+		else if (symbol->binding.kind != BindingKind::FUNCTION)
+			error('\'' + std::string(call.id()) + "' is not a function");
+		else
+			call.bind(symbol->binding);
+
+		for (Expression* argument : call.arguments())
+			resolve_expression(argument);
+		break;
+	}
+	case NodeKind::UNARY_EXPRESSION: {
+		auto& unary = *static_cast<UnaryExpression*>(expr);
+		if (unary.op() == UnaryOp::CAST)
+			resolve_expression(unary.expr());
+		else
+			resolve_assignment_target(unary.expr());
+		break;
+	}
+	case NodeKind::BINARY_EXPRESSION: {
+		auto binary = static_cast<BinaryExpression*>(expr);
+		if (binary->op() == BinaryOp::ASSIGN) {
+			resolve_assignment_target(binary->left());
+			resolve_expression(binary->right());
+			break;
+		}
+
+		// Left to right down a chain of left operands, see push_left_chain().
+		size_t base = m_chain.size();
+		resolve_expression(push_left_chain(binary, m_chain));
+
+		while (m_chain.size() > base) {
+			binary = m_chain.back();
+			m_chain.pop_back();
+			resolve_expression(binary->right());
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void NameResolver::resolve_assignment_target(Expression* expr) {
+	resolve_expression(expr);
+
+	if (!expr || expr->kind() != NodeKind::ID_ATOM)
+		return;
+
+	const Symbol* symbol = find(static_cast<IdAtom*>(expr)->id());
+	if (symbol && symbol->declaration)
+		symbol->declaration->set_assigned();
+}
\ No newline at end of file
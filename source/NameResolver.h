@@ -0,0 +1,80 @@
+#pragma once
+
+#include "IdentifierTable.h"
+#include "Parser.h"
+
+#include <vector>
+
+// Binds every name in a TranslationUnit to what it refers to, so that later
+// stages never look names up by string. Locals get the register slot that
+// BytecodeCompiler puts them in: parameters come first, and a block reuses
+// the slots of the blocks before it. Top-level variables are globals, and
+// functions are numbered with the top-level ones first, from 1; index 0 is
+// the function that runs the top-level statements.
+class NameResolver {
+public:
+	// Returns false, with the reasons in errors(), when a name cannot be
+	// resolved or is declared twice in one scope.
+	bool resolve(TranslationUnit& unit);
+
+	const std::vector<Diagnostic>& errors() const;
+	// Declarations that hide another one of the same name.
+	const std::vector<Diagnostic>& warnings() const;
+
+	// Indexed by function index, with nullptr for the top-level function.
+	const std::vector<const FunctionDeclaration*>& functions() const;
+	uint32_t global_count() const;
+
+private:
+	static constexpr uint32_t NO_SYMBOL = UINT32_MAX;
+
+	struct Symbol {
+		uint32_t name;
+		Binding binding;
+		// nullptr for parameters and functions.
+		VariableDeclaration* declaration;
+		// Symbol of the same name that this one hides, if any.
+		uint32_t shadowed;
+	};
+
+	struct Scope {
+		uint32_t first_symbol;
+		uint32_t next_slot;
+	};
+
+	void error(std::string message);
+	void warning(std::string message);
+
+	const Symbol* find(std::string_view name);
+	const Symbol* find_variable(std::string_view name);
+	void declare(std::string_view name, Binding binding, VariableDeclaration* declaration = nullptr);
+	void push_scope();
+	void pop_scope();
+
+	void declare_function(FunctionDeclaration& declaration);
+	void resolve_function(FunctionDeclaration& declaration);
+	void resolve_statement(Statement* stmt);
+	void resolve_scoped_statement(Statement* stmt);
+	void resolve_variable_declaration(VariableDeclaration& declaration, bool global);
+	void resolve_expression(Expression* expr);
+	void resolve_assignment_target(Expression* expr);
+
+private:
+	std::vector<Diagnostic> m_errors;
+	std::vector<Diagnostic> m_warnings;
+	std::vector<const FunctionDeclaration*> m_functions;
+	uint32_t m_global_count = 0;
+
+	IdentifierTable m_identifiers;
+	std::vector<Symbol> m_symbols;
+	// Innermost symbol of each identifier id.
+	std::vector<uint32_t> m_innermost;
+	std::vector<Scope> m_scopes;
+	// Operators of the chains being resolved, see push_left_chain().
+	std::vector<BinaryExpression*> m_chain;
+
+	// Function being resolved, and how deeply it is nested.
+	const FunctionDeclaration* m_function = nullptr;
+	uint16_t m_depth = 0;
+	uint32_t m_next_slot = 0;
+};
\ No newline at end of file
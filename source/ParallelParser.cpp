@@ -0,0 +1,134 @@
+#include "ParallelParser.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <atomic>
+
+static constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+std::vector<SourceRange> split_top_level_statements(const SourceBuffer& source, size_t target_size) {
+	std::vector<SourceRange> ranges;
+	const char* begin = source.begin();
+	const char* end = source.end();
+
+	SourceRange range;
+	int depth = 0;
+
+	for (const char* p = begin; p != end; p++) {
+		switch (*p) {
+		case '/':
+			if (p[1] == '/') {
+				while (p + 1 != end && p[1] != '\n')
+					p++;
+			}
+			break;
+		case '(':
+		case '{':
+			depth++;
+			break;
+		case ')':
+			if (--depth < 0)
+				return { source.range() };
+			break;
+		case '}':
+			if (--depth < 0)
+				return { source.range() };
+			if (depth == 0 && static_cast<size_t>(p + 1 - begin) - range.begin >= target_size) {
+				range.end = static_cast<uint32_t>(p + 1 - begin);
+				ranges.push_back(range);
+				range = { range.end, 0 };
+			}
+			break;
+		case ';':
+			if (depth == 0 && static_cast<size_t>(p + 1 - begin) - range.begin >= target_size) {
+				range.end = static_cast<uint32_t>(p + 1 - begin);
+				ranges.push_back(range);
+				range = { range.end, 0 };
+			}
+			break;
+		}
+	}
+
+	if (depth != 0)
+		return { source.range() };
+
+	range.end = static_cast<uint32_t>(source.size());
+	ranges.push_back(range);
+
+	return ranges;
+}
+
+static TranslationUnit* parse_serially(const SourceBuffer& source, AstContext& context, Lexing lexing, size_t error_limit, size_t nesting_limit, std::vector<Diagnostic>& diagnostics) {
+	Parser parser(source, context, lexing);
+	parser.set_error_limit(error_limit);
+	parser.set_nesting_limit(nesting_limit);
+	TranslationUnit* unit = parser.parse();
+
+	diagnostics = parser.diagnostics();
+
+	return unit;
+}
+
+TranslationUnit* parse_in_parallel(const SourceBuffer& source, AstContext& context, ThreadPool& pool, Lexing lexing, size_t error_limit, size_t nesting_limit, std::vector<Diagnostic>& diagnostics) {
+	size_t target_size = std::max(MIN_CHUNK_SIZE, source.size() / (pool.thread_count() * CHUNKS_PER_THREAD));
+	std::vector<SourceRange> ranges;
+	{
+		TraceScope trace("split", "parser");
+		ranges = split_top_level_statements(source, target_size);
+		trace.add_arg("chunks", ranges.size());
+	}
+
+	if (ranges.size() < 2)
+		return parse_serially(source, context, lexing, error_limit, nesting_limit, diagnostics);
+
+	struct Chunk {
+		std::unique_ptr<AstContext> context;
+		TranslationUnit* unit = nullptr;
+		bool has_errors = false;
+	};
+
+	std::vector<Chunk> chunks(ranges.size());
+	std::atomic<size_t> remaining = ranges.size();
+
+	for (size_t i = 0; i < ranges.size(); i++) {
+		pool.submit([&, i] {
+			Chunk& chunk = chunks[i];
+			chunk.context = std::make_unique<AstContext>();
+
+			// The first error decides that the file is parsed again; the
+			// chunk goes on to the next one, which is dropped.
+			Parser parser(source, ranges[i], *chunk.context, lexing == Lexing::PIPELINED ? Lexing::INLINE : lexing);
+			parser.set_error_limit(1);
+			parser.set_nesting_limit(nesting_limit);
+			chunk.unit = parser.parse();
+			chunk.has_errors = !parser.diagnostics().empty();
+
+			remaining--;
+		});
+	}
+
+	// We may be running on one of the pool's workers ourselves, so help out
+	// instead of blocking it.
+	while (remaining > 0) {
+		if (!pool.run_pending_task())
+			std::this_thread::yield();
+	}
+
+	if (std::any_of(chunks.begin(), chunks.end(), [](const Chunk& chunk) { return chunk.has_errors; }))
+		return parse_serially(source, context, lexing, error_limit, nesting_limit, diagnostics);
+
+	TraceScope trace("merge", "parser");
+
+	std::vector<Statement*> statements;
+	for (Chunk& chunk : chunks) {
+		AstList<Statement*> chunk_statements = chunk.unit->statements();
+		statements.insert(statements.end(), chunk_statements.begin(), chunk_statements.end());
+
+		context.adopt(std::move(chunk.context));
+	}
+
+	diagnostics.clear();
+
+	return context.create<TranslationUnit>(context.make_list(statements.data(), statements.size()));
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "Parser.h"
+#include "ThreadPool.h"
+
+// Cuts the source after top-level statements: a ';' or a closing '}' outside
+// any braces or parentheses, with '//' comments skipped. Consecutive
+// statements are grouped into ranges of at least target_size bytes. Returns a
+// single range when the nesting does not balance out.
+std::vector<SourceRange> split_top_level_statements(const SourceBuffer& source, size_t target_size);
+
+// Parses the ranges of split_top_level_statements concurrently on the pool and
+// links the results into one TranslationUnit in source order. If any range
+// reports an error the file is parsed again serially, so that positions and
+// diagnostics are always those of a plain Parser with the given limits.
+//
+// Every range is lexed as given, except that pipelined lexing only applies
+// to the serial parse: the ranges already keep the pool's workers busy, and
+// a lexer thread for each would only compete with them.
+TranslationUnit* parse_in_parallel(const SourceBuffer& source, AstContext& context, ThreadPool& pool, Lexing lexing, size_t error_limit, size_t nesting_limit, std::vector<Diagnostic>& diagnostics);
\ No newline at end of file
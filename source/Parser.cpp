@@ -1,250 +1,500 @@
 #include "Parser.h"
+#include "Trace.h"
 
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
 
-static void error(Position pos, std::string_view message) {
-	std::cout << '[' << pos.line << ',' << pos.column << "] Error: " << message << '\n';
-}
-
-static Type parse_type(const std::string& type_str) {
-	if (type_str == "int")
+static Type parse_type(TokenKind kind) {
+	switch (kind) {
+	case TokenKind::KW_INT:
 		return Type::INT;
-	else if (type_str == "float")
+	case TokenKind::KW_FLOAT:
 		return Type::FLOAT;
-	else if (type_str == "bool")
+	case TokenKind::KW_BOOL:
 		return Type::BOOL;
-	else
+	default:
 		return Type::VOID;
+	}
 }
 
-Parser::Parser(const std::filesystem::path& input_file)
-	: m_tokenizer(input_file) {}
+struct BinaryOperator {
+	TokenKind token = TokenKind::EOS;
+	BinaryOp op = BinaryOp::COMA;
+	int precedence = 0;
+	bool right_associative = false;
+	std::string_view missing_rhs_message;
+};
+
+enum {
+	NOT_AN_OPERATOR = 0,
+	COMA_PRECEDENCE,
+	ASSIGN_PRECEDENCE,
+	LOGICAL_OR_PRECEDENCE,
+	LOGICAL_AND_PRECEDENCE,
+	EQUALITY_PRECEDENCE,
+	RELATIONAL_PRECEDENCE,
+	ADDITIVE_PRECEDENCE,
+	MULTIPLICATIVE_PRECEDENCE
+};
+
+static constexpr BinaryOperator binary_operators[] = {
+	{ TokenKind::COMA, BinaryOp::COMA, COMA_PRECEDENCE, false, "Expected another expression after ','" },
+	{ TokenKind::EQUAL, BinaryOp::ASSIGN, ASSIGN_PRECEDENCE, true, "Expected expression after assign operator '='" },
+	{ TokenKind::LOGICAL_OR, BinaryOp::LOGICAL_OR, LOGICAL_OR_PRECEDENCE, false, "Expected another expression after '||'" },
+	{ TokenKind::LOGICAL_AND, BinaryOp::LOGICAL_AND, LOGICAL_AND_PRECEDENCE, false, "Expected another expression after '&&'" },
+	{ TokenKind::EQUAL_EQUAL, BinaryOp::LOGICAL_EQUAL, EQUALITY_PRECEDENCE, false, "Expected expression after equality operator '=='" },
+	{ TokenKind::NOT_EQUAL, BinaryOp::LOGICAL_NOT_EQUAL, EQUALITY_PRECEDENCE, false, "Expected expression after not equal operator '!='" },
+	{ TokenKind::LESS, BinaryOp::LESS, RELATIONAL_PRECEDENCE, false, "Expected expression after less operator '<'" },
+	{ TokenKind::LESS_EQUAL, BinaryOp::LESS_EQUAL, RELATIONAL_PRECEDENCE, false, "Expected expression after less equal operator '<='" },
+	{ TokenKind::GREATER, BinaryOp::GREATER, RELATIONAL_PRECEDENCE, false, "Expected expression after greater operator '>'" },
+	{ TokenKind::GREATER_EQUAL, BinaryOp::GREATER_EQUAL, RELATIONAL_PRECEDENCE, false, "Expected expression after greater equal operator '>='" },
+	{ TokenKind::PLUS, BinaryOp::PLUS, ADDITIVE_PRECEDENCE, false, "Expected expression after plus operator '+'" },
+	{ TokenKind::MINUS, BinaryOp::MINUS, ADDITIVE_PRECEDENCE, false, "Expected expression after minus operator '-'" },
+	{ TokenKind::STAR, BinaryOp::MULTIPLY, MULTIPLICATIVE_PRECEDENCE, false, "Expected expression after multiply operator '*'" },
+	{ TokenKind::SLASH, BinaryOp::DIVIDE, MULTIPLICATIVE_PRECEDENCE, false, "Expected expression after divide operator '/'" }
+};
+
+// Indexed by TokenKind; tokens that are not binary operators get precedence 0,
+// which is below every min_precedence and so ends the operator loop.
+static constexpr size_t BINARY_OPERATOR_TABLE_SIZE = 64;
+
+static constexpr std::array<BinaryOperator, BINARY_OPERATOR_TABLE_SIZE> make_binary_operator_table() {
+	std::array<BinaryOperator, BINARY_OPERATOR_TABLE_SIZE> table = {};
+
+	for (const BinaryOperator& op : binary_operators)
+		table[static_cast<size_t>(op.token)] = op;
+
+	return table;
+}
+
+static constexpr std::array<BinaryOperator, BINARY_OPERATOR_TABLE_SIZE> binary_operator_table = make_binary_operator_table();
+
+static_assert(static_cast<size_t>(TokenKind::RIGHT_BRACE) < BINARY_OPERATOR_TABLE_SIZE, "TokenKind outgrew the binary operator table");
+
+static const BinaryOperator& get_binary_operator(TokenKind kind) {
+	return binary_operator_table[static_cast<size_t>(kind)];
+}
+
+static bool is_comparison(BinaryOp op) {
+	return op == BinaryOp::LOGICAL_EQUAL || op == BinaryOp::LOGICAL_NOT_EQUAL || op == BinaryOp::LESS ||
+		op == BinaryOp::LESS_EQUAL || op == BinaryOp::GREATER || op == BinaryOp::GREATER_EQUAL;
+}
+
+// Whether the passes after parsing walk op and its left operand lhs as one
+// chain, in a loop (see push_left_chain()). A comparison gives a bool, which
+// TypeChecker casts before computing or comparing with it, and a cast in
+// between ends the chain.
+static bool continues_chain(BinaryOp op, const Expression* lhs) {
+	if (op == BinaryOp::ASSIGN || !lhs || lhs->kind() != NodeKind::BINARY_EXPRESSION)
+		return false;
 
-bool Parser::match_token(TokenKind kind) {
-	if (m_tokenizer.current().kind() == kind) {
-		m_tokenizer.next();
-		return true;
-	} else
+	BinaryOp lhs_op = static_cast<const BinaryExpression*>(lhs)->op();
+	if (lhs_op == BinaryOp::ASSIGN)
 		return false;
+
+	return !is_comparison(lhs_op) || op == BinaryOp::LOGICAL_AND || op == BinaryOp::LOGICAL_OR || op == BinaryOp::COMA;
+}
+
+template<typename T>
+static AstList<T> pop_list(AstContext& context, std::vector<T>& stack, size_t first) {
+	AstList<T> list = context.make_list(stack.data() + first, stack.size() - first);
+	stack.resize(first);
+
+	return list;
 }
 
-bool Parser::match_token(std::string_view str) {
-	if (m_tokenizer.current().kind() == TokenKind::NAME && m_tokenizer.current().lexeme() == str) {
-		m_tokenizer.next();
+Parser::Parser(const SourceBuffer& source, AstContext& context, Lexing lexing)
+	: Parser(source, source.range(), context, lexing) {}
+
+Parser::Parser(const SourceBuffer& source, SourceRange range, AstContext& context, Lexing lexing)
+	: m_source(source), m_tokens(m_source, range, lexing), m_context(context) {}
+
+void Parser::set_error_limit(size_t error_limit) {
+	m_diagnostics.set_error_limit(error_limit);
+}
+
+void Parser::set_nesting_limit(size_t nesting_limit) {
+	m_nesting_limit = nesting_limit != 0 ? nesting_limit : SIZE_MAX;
+}
+
+size_t Parser::diagnostic_count() const {
+	return m_diagnostics.size();
+}
+
+void Parser::separate_diagnostics() {
+	m_diagnostics.separate();
+}
+
+std::vector<Diagnostic> Parser::diagnostics(size_t first) const {
+	return m_diagnostics.diagnostics(m_source, first);
+}
+
+void Parser::error(std::string_view message) {
+	m_diagnostics.report(m_tokens.current().offset(), message);
+}
+
+void Parser::nesting_error() {
+	m_diagnostics.stop(m_tokens.current().offset(), "Nested deeper than " + std::to_string(m_nesting_limit) + " levels, stopped parsing");
+}
+
+bool Parser::exceeds_nesting_limit(size_t depth) const {
+	return depth > m_nesting_limit;
+}
+
+void Parser::skip_unexpected_token() {
+	if (m_tokens.token_count() != m_skipped_until)
+		error("Expected statement");
+
+	m_tokens.next();
+	m_skipped_until = m_tokens.token_count();
+}
+
+bool Parser::match_token(TokenKind kind) {
+	if (m_tokens.current().kind() == kind) {
+		m_tokens.next();
 		return true;
 	} else
 		return false;
 }
 
 bool Parser::is_token(TokenKind kind) {
-	return m_tokenizer.current().kind() == kind;
+	return m_tokens.current().kind() == kind;
 }
 
 void Parser::next_token() {
-	m_tokenizer.next();
+	m_tokens.next();
+}
+
+std::string_view Parser::get_token_lexeme() {
+	return m_tokens.current().lexeme(m_source.text());
+}
+
+static const char* trace_name(NodeKind kind) {
+	switch (kind) {
+	case NodeKind::FUNCTION_DECLARATION:
+		return "parse_function_declaration";
+	case NodeKind::VARIABLE_DECLARATION:
+		return "parse_variable_declaration";
+	case NodeKind::COMPOUND_STATEMENT:
+		return "parse_compound_statement";
+	case NodeKind::IF_STATEMENT:
+		return "parse_if_statement";
+	case NodeKind::FOR_STATEMENT:
+		return "parse_for_statement";
+	case NodeKind::WHILE_STATEMENT:
+		return "parse_while_statement";
+	case NodeKind::RETURN_STATEMENT:
+		return "parse_return_statement";
+	default:
+		return "parse_expression";
+	}
 }
 
-std::string& Parser::get_token_lexeme() {
-	return m_tokenizer.current().lexeme();
-}
+TranslationUnit* Parser::parse() {
+	TraceScope trace("parse", "parser");
+	uint64_t tokens = m_tokens.token_count(), scan_ticks = m_tokens.scan_ticks();
+	size_t nodes = m_context.node_count();
 
-Position Parser::get_token_position() {
-	return m_tokenizer.current().pos();
-}
+	TranslationUnit* unit = parse_translation_unit();
 
-std::unique_ptr<TranslationUnit> Parser::parse() {
-	return parse_translation_unit();
+	trace.add_arg("tokens", m_tokens.token_count() - tokens);
+	trace.add_arg("nodes", m_context.node_count() - nodes);
+	trace.add_duration_arg("lex_us", m_tokens.scan_ticks() - scan_ticks);
+
+	return unit;
 }
 
-std::unique_ptr<TranslationUnit> Parser::parse_translation_unit() {
-	std::vector<std::unique_ptr<Statement>> statements;
-	std::unique_ptr<Statement> stmt;
+// Scanning a single token is too short to be an event of its own, the time
+// spent in the tokenizer is an argument of each statement's event instead
+// (unless the tokens are pipelined, then the producer has an event of its own).
+Statement* Parser::parse_top_level_statement() {
+	TraceScope trace("parse_statement", "parser");
+	uint64_t tokens = m_tokens.token_count(), scan_ticks = m_tokens.scan_ticks();
+	size_t nodes = m_context.node_count();
 
-	while (true) {
+	Statement* stmt = nullptr;
+	while (!m_diagnostics.full()) {
 		stmt = parse_statement();
 
-		if (!stmt) {
-			if (m_tokenizer.current().kind() != TokenKind::EOS) {
-				error(m_tokenizer.current().pos(), "Expected statement");
-				m_tokenizer.next();
-				continue;
-			} else
-				break;
+		if (!stmt && m_tokens.current().kind() != TokenKind::EOS) {
+			skip_unexpected_token();
+			continue;
 		}
 
-		statements.push_back(std::move(stmt));
+		break;
 	}
 
-	return std::make_unique<TranslationUnit>(std::move(statements));
+	if (trace.active()) {
+		if (stmt)
+			trace.set_name(trace_name(stmt->kind()));
+		trace.add_arg("tokens", m_tokens.token_count() - tokens);
+		trace.add_arg("nodes", m_context.node_count() - nodes);
+		trace.add_duration_arg("lex_us", m_tokens.scan_ticks() - scan_ticks);
+	}
+
+	return stmt;
+}
+
+uint32_t Parser::consumed_end() const {
+	return m_tokens.previous_end();
 }
 
-std::unique_ptr<Statement> Parser::parse_statement() {
-	std::unique_ptr<Statement> stmt;
+uint32_t Parser::lookahead_end() {
+	const Token& token = m_tokens.current();
 
-	stmt = parse_compound_statement();
-	if (stmt) return stmt;
+	return token.offset() + token.length();
+}
 
-	stmt = parse_if_statement();
-	if (stmt) return stmt;
+TranslationUnit* Parser::parse_translation_unit() {
+	size_t first = m_statement_stack.size();
 
-	stmt = parse_for_statement();
-	if (stmt) return stmt;
+	while (Statement* stmt = parse_top_level_statement())
+		m_statement_stack.push_back(stmt);
 
-	stmt = parse_while_statement();
-	if (stmt) return stmt;
+	return m_context.create<TranslationUnit>(pop_list(m_context, m_statement_stack, first));
+}
 
-	stmt = parse_return_statement();
-	if (stmt) return stmt;
+// Rather than recursing into the body of a statement, the parser pushes a
+// frame with the parts before the body and goes on with the body. A finished
+// statement is the body of the frame on top, which then either wants another
+// one, as a block does up to its '}', or closes into a statement itself.
+Statement* Parser::parse_statement() {
+	size_t bottom = m_statement_frames.size();
+	size_t first_statement = m_statement_stack.size();
+	Statement* stmt = open_statement();
 
-	stmt = parse_declaration_statement();
-	if (stmt) return stmt;
+	while (m_statement_frames.size() > bottom) {
+		if (m_diagnostics.stopped()) {
+			m_statement_frames.resize(bottom);
+			m_statement_stack.resize(first_statement);
+			return nullptr;
+		}
 
-	stmt = parse_expression_statement();
-	if (stmt) return stmt;
+		StatementFrame& frame = m_statement_frames.back();
 
-	return nullptr;
-}
+		if (frame.kind == NodeKind::COMPOUND_STATEMENT) {
+			if (frame.started) {
+				if (stmt)
+					m_statement_stack.push_back(stmt);
+				else if (m_diagnostics.full())
+					frame.done = true;
+				else
+					skip_unexpected_token();
+			}
 
-std::unique_ptr<CompoundStatement> Parser::parse_compound_statement() {
-	if (match_token(TokenKind::LEFT_BRACE)) {
-		std::vector<std::unique_ptr<Statement>> statements;
+			frame.started = true;
 
-		while (true) {
-			if (match_token(TokenKind::RIGHT_BRACE))
-				return std::make_unique<CompoundStatement>(std::move(statements));
-			else if (match_token(TokenKind::EOS)) {
-				error(m_tokenizer.current().pos(), "Unexpected end of file");
-				return std::make_unique<CompoundStatement>(std::move(statements));
+			if (frame.done || match_token(TokenKind::RIGHT_BRACE)) {
+				stmt = close_statement(nullptr);
+				continue;
+			} else if (is_token(TokenKind::EOS)) {
+				error("Unexpected end of file");
+				stmt = close_statement(nullptr);
+				continue;
 			}
 
-			statements.push_back(parse_statement());
-		}
+			stmt = open_statement();
+		} else if (!frame.started) {
+			frame.started = true;
 
-		return std::make_unique<CompoundStatement>(std::move(statements));
-	} else
+			// Only a block can be the body of a function.
+			if (frame.kind == NodeKind::FUNCTION_DECLARATION && !is_token(TokenKind::LEFT_BRACE)) {
+				error("Expected statements enclosed in '{', '}'");
+				stmt = close_statement(nullptr);
+				continue;
+			}
+
+			stmt = open_statement();
+		} else
+			stmt = close_statement(stmt);
+	}
+
+	return stmt;
+}
+
+Statement* Parser::open_statement() {
+	switch (m_tokens.current().kind()) {
+	case TokenKind::LEFT_BRACE:
+		begin_compound_statement();
+		return nullptr;
+	case TokenKind::KW_IF:
+		begin_if_statement();
+		return nullptr;
+	case TokenKind::KW_FOR:
+		begin_for_statement();
 		return nullptr;
+	case TokenKind::KW_WHILE:
+		begin_while_statement();
+		return nullptr;
+	case TokenKind::KW_RETURN:
+		return parse_return_statement();
+	case TokenKind::KW_DEF:
+	case TokenKind::KW_INT:
+	case TokenKind::KW_FLOAT:
+	case TokenKind::KW_BOOL:
+		return parse_declaration_statement();
+	default:
+		return parse_expression_statement();
+	}
 }
 
-std::unique_ptr<Expression> Parser::parse_expression_statement() {
-	std::unique_ptr<Expression> expr = parse_expression();
+void Parser::push_statement_frame(const StatementFrame& frame) {
+	if (exceeds_nesting_limit(m_statement_frames.size() + 1)) {
+		nesting_error();
+		return;
+	}
+
+	m_statement_frames.push_back(frame);
+}
+
+Statement* Parser::close_statement(Statement* body) {
+	const StatementFrame& frame = m_statement_frames.back();
+	Statement* stmt;
+
+	switch (frame.kind) {
+	case NodeKind::COMPOUND_STATEMENT:
+		stmt = m_context.create<CompoundStatement>(pop_list(m_context, m_statement_stack, frame.first_statement));
+		break;
+	case NodeKind::IF_STATEMENT:
+		stmt = m_context.create<IfStatement>(frame.condition, body);
+		break;
+	case NodeKind::FOR_STATEMENT:
+		if (!body)
+			error("Expected statement");
+
+		stmt = m_context.create<ForStatement>(frame.var_decl, frame.condition, frame.expression, body);
+		break;
+	case NodeKind::WHILE_STATEMENT:
+		if (!body)
+			error("Expected statement");
+
+		stmt = m_context.create<WhileStatement>(frame.condition, body);
+		break;
+	default:
+		stmt = m_context.create<FunctionDeclaration>(frame.ret_type, frame.id, frame.params, static_cast<CompoundStatement*>(body));
+		break;
+	}
+
+	m_statement_frames.pop_back();
+
+	return stmt;
+}
+
+void Parser::begin_compound_statement() {
+	next_token();
+
+	StatementFrame frame = { NodeKind::COMPOUND_STATEMENT };
+	frame.first_statement = m_statement_stack.size();
+	push_statement_frame(frame);
+}
+
+Expression* Parser::parse_expression_statement() {
+	Expression* expr = parse_expression();
 
 	bool semicolon = match_token(TokenKind::SEMICOLON);
 	if (expr) {
 		if (!semicolon)
-			error(m_tokenizer.current().pos(), "Expected ';'");
+			error("Expected ';'");
 	} else
 		if (semicolon)
-			error(get_token_position(), "Unexpected ';'");
+			error("Unexpected ';'");
 
 	return expr;
 }
 
-std::unique_ptr<DeclarationStatement> Parser::parse_declaration_statement() {
-	std::unique_ptr<FunctionDeclaration> func_decl = parse_function_declaration();
-	if (func_decl)
-		return func_decl;
-	else {
-		std::unique_ptr<VariableDeclaration> var_decl = parse_variable_declaration();
-		if (var_decl && !match_token(TokenKind::SEMICOLON))
-			error(get_token_position(), "Expected ';' after function declaration");
-
-		return var_decl;
+// A function declaration only pushes its frame and returns nullptr.
+DeclarationStatement* Parser::parse_declaration_statement() {
+	if (is_token(TokenKind::KW_DEF)) {
+		begin_function_declaration();
+		return nullptr;
 	}
+
+	VariableDeclaration* var_decl = parse_variable_declaration();
+	if (var_decl && !match_token(TokenKind::SEMICOLON))
+		error("Expected ';' after function declaration");
+
+	return var_decl;
 }
 
-std::unique_ptr<FunctionDeclaration> Parser::parse_function_declaration() {
-	if (match_token("def")) {
-		std::string id;
-		if (is_token(TokenKind::NAME)) {
-			id = move(get_token_lexeme());
-			next_token();
-		} else
-			error(m_tokenizer.current().pos(), "Expected ID");
+void Parser::begin_function_declaration() {
+	next_token();
 
-		if (!match_token(TokenKind::LEFT_PAREN))
-			error(get_token_position(), "Expected '('");
+	StatementFrame frame = { NodeKind::FUNCTION_DECLARATION };
 
-		std::vector<TypedId> params = parse_parameters();
+	if (is_token(TokenKind::NAME)) {
+		frame.id = m_context.make_string(get_token_lexeme());
+		next_token();
+	} else
+		error("Expected ID");
 
-		if (!match_token(TokenKind::RIGHT_PAREN))
-			error(get_token_position(), "Expected ')'");
+	if (!match_token(TokenKind::LEFT_PAREN))
+		error("Expected '('");
 
-		Type ret_type = parse_return_type();
+	frame.params = parse_parameters();
 
-		std::unique_ptr<CompoundStatement> statement = parse_compound_statement();
-		if (!statement)
-			error(get_token_position(), "Expected statements enclosed in '{', '}'");
+	if (!match_token(TokenKind::RIGHT_PAREN))
+		error("Expected ')'");
 
-		return std::make_unique<FunctionDeclaration>(ret_type, std::move(id), std::move(params), std::move(statement));
-	}
+	frame.ret_type = parse_return_type();
 
-	return nullptr;
+	push_statement_frame(frame);
 }
 
 TypedId Parser::parse_typed_id() {
-	if (is_token(TokenKind::NAME)) {
-		TypedId typed_id;
-		typed_id.type = parse_type(get_token_lexeme());
-
-		if (typed_id.type == Type::VOID)
-			return typed_id;
+	TypedId typed_id;
+	typed_id.type = parse_type(m_tokens.current().kind());
 
+	if (typed_id.type != Type::VOID) {
 		next_token();
 
 		if (!is_token(TokenKind::NAME)) {
-			error(get_token_position(), "Expected ID");
+			error("Expected ID");
 			return typed_id;
 		}
 
-		typed_id.id = std::move(get_token_lexeme());
+		typed_id.id = m_context.make_string(get_token_lexeme());
 
 		next_token();
-
-		return typed_id;
 	}
 
-	return { Type::VOID };
+	return typed_id;
 }
 
-std::vector<TypedId> Parser::parse_parameters() {
-	std::vector<TypedId> params;
+AstList<TypedId> Parser::parse_parameters() {
+	size_t first = m_parameter_stack.size();
 
 	TypedId typed_id = parse_typed_id();
 	if (typed_id.type == Type::VOID)
-		return params;
+		return {};
 
-	params.push_back(std::move(typed_id));
+	m_parameter_stack.push_back(typed_id);
 
 	while (match_token(TokenKind::COMA)) {
 		TypedId typed_id = parse_typed_id();
 		if (typed_id.type == Type::VOID)
 			break;
 
-		params.push_back(std::move(typed_id));
+		m_parameter_stack.push_back(typed_id);
 	}
 
-	return params;
+	return pop_list(m_context, m_parameter_stack, first);
 }
 
 Type Parser::parse_return_type() {
 	Type type;
 	
 	if (match_token(TokenKind::ARROW)) {
-		if (!is_token(TokenKind::NAME)) {
-			error(get_token_position(), "Expected return type, 'void' assumed");
-			return Type::VOID;
-		}
+		type = parse_type(m_tokens.current().kind());
 
-		std::string_view ret_type = get_token_lexeme();
-		if (ret_type == "int")
-			type = Type::INT;
-		else if (ret_type == "float")
-			type = Type::FLOAT;
-		else if (ret_type == "bool")
-			type = Type::BOOL;
-		else {
-			error(get_token_position(), "Invlalid return type");
-			type = Type::VOID;
+		if (type == Type::VOID) {
+			if (!is_token(TokenKind::NAME)) {
+				error("Expected return type, 'void' assumed");
+				return Type::VOID;
+			}
+
+			error("Invlalid return type");
 		}
 
 		next_token();
@@ -254,314 +504,276 @@ Type Parser::parse_return_type() {
 		return Type::VOID;
 }
 
-std::unique_ptr<VariableDeclaration> Parser::parse_variable_declaration() {
+VariableDeclaration* Parser::parse_variable_declaration() {
 	TypedId typed_id = parse_typed_id();
 
 	if (typed_id.type == Type::VOID)
 		return nullptr;
 
-	std::unique_ptr<Expression> init_expr = parse_init_value();
+	Expression* init_expr = parse_init_value();
 	
-	return std::make_unique<VariableDeclaration>(typed_id.type, std::move(typed_id.id), std::move(init_expr));
+	return m_context.create<VariableDeclaration>(typed_id.type, typed_id.id, init_expr);
 }
 
-std::unique_ptr<Expression> Parser::parse_init_value() {
+Expression* Parser::parse_init_value() {
 	if (match_token(TokenKind::EQUAL)) {
 		return parse_conditional_expression();
 	} else
 		return nullptr;
 }
 
-std::unique_ptr<IfStatement> Parser::parse_if_statement() {
-	if (match_token("if")) {
-		if (!match_token(TokenKind::LEFT_PAREN))
-			error(get_token_position(), "Expected '('");
+void Parser::begin_if_statement() {
+	next_token();
 
-		std::unique_ptr<Expression> cond_expr = parse_conditional_expression();
-		if (!cond_expr)
-			error(get_token_position(), "Expected conditional expression");
+	StatementFrame frame = { NodeKind::IF_STATEMENT };
 
-		if (!match_token(TokenKind::RIGHT_PAREN))
-			error(get_token_position(), "Expected ')' after if condition");
+	if (!match_token(TokenKind::LEFT_PAREN))
+		error("Expected '('");
 
-		std::unique_ptr<Statement> stmt = parse_statement();
+	frame.condition = parse_conditional_expression();
+	if (!frame.condition)
+		error("Expected conditional expression");
 
-		return std::make_unique<IfStatement>(std::move(cond_expr), std::move(stmt));
-	} else
-		return nullptr;
+	if (!match_token(TokenKind::RIGHT_PAREN))
+		error("Expected ')' after if condition");
+
+	push_statement_frame(frame);
 }
 
-std::unique_ptr<ForStatement> Parser::parse_for_statement() {
-	if (match_token("for")) {
-		if (!match_token(TokenKind::LEFT_PAREN))
-			error(get_token_position(), "Expected '('");
+void Parser::begin_for_statement() {
+	next_token();
 
-		std::unique_ptr<VariableDeclaration> var_decl = parse_variable_declaration();
+	StatementFrame frame = { NodeKind::FOR_STATEMENT };
 
-		if (!match_token(TokenKind::SEMICOLON))
-			error(get_token_position(), "Expected ';'");
+	if (!match_token(TokenKind::LEFT_PAREN))
+		error("Expected '('");
 
-		std::unique_ptr<Expression> cond_expr = parse_conditional_expression();
+	frame.var_decl = parse_variable_declaration();
 
-		if (!match_token(TokenKind::SEMICOLON))
-			error(get_token_position(), "Expected ';'");
+	if (!match_token(TokenKind::SEMICOLON))
+		error("Expected ';'");
 
-		std::unique_ptr<Expression> expr = parse_expression();
+	frame.condition = parse_conditional_expression();
 
-		if (!match_token(TokenKind::RIGHT_PAREN))
-			error(get_token_position(), "Expected ')'");
+	if (!match_token(TokenKind::SEMICOLON))
+		error("Expected ';'");
 
-		std::unique_ptr<Statement> stmt = parse_statement();
-		if (!stmt)
-			error(get_token_position(), "Expected statement");
+	frame.expression = parse_expression();
 
-		return std::make_unique<ForStatement>(std::move(var_decl), std::move(cond_expr), std::move(expr), std::move(stmt));
-	} else
-		return nullptr;
+	if (!match_token(TokenKind::RIGHT_PAREN))
+		error("Expected ')'");
+
+	push_statement_frame(frame);
 }
 
-std::unique_ptr<WhileStatement> Parser::parse_while_statement() {
-	if (match_token("while")) {
-		if (!match_token(TokenKind::LEFT_PAREN))
-			error(get_token_position(), "Expected '('");
+void Parser::begin_while_statement() {
+	next_token();
 
-		std::unique_ptr<Expression> cond_expr = parse_conditional_expression();
-		if (!cond_expr)
-			error(get_token_position(), "Expected conditional expression");
+	StatementFrame frame = { NodeKind::WHILE_STATEMENT };
 
-		if (!match_token(TokenKind::RIGHT_PAREN))
-			error(get_token_position(), "Expected ')'");
+	if (!match_token(TokenKind::LEFT_PAREN))
+		error("Expected '('");
 
-		std::unique_ptr<Statement> stmt = parse_statement();
-		if (!stmt)
-			error(get_token_position(), "Expected statement");
+	frame.condition = parse_conditional_expression();
+	if (!frame.condition)
+		error("Expected conditional expression");
 
-		return std::make_unique<WhileStatement>(std::move(cond_expr), std::move(stmt));
-	} else
-		return nullptr;
+	if (!match_token(TokenKind::RIGHT_PAREN))
+		error("Expected ')'");
+
+	push_statement_frame(frame);
 }
 
-std::unique_ptr<ReturnStatement> Parser::parse_return_statement() {
-	if (match_token("return")) {
-		std::unique_ptr<Expression> ret_expr = parse_conditional_expression();
+ReturnStatement* Parser::parse_return_statement() {
+	if (match_token(TokenKind::KW_RETURN)) {
+		Expression* ret_expr = parse_conditional_expression();
 		
 		if (!match_token(TokenKind::SEMICOLON))
-			error(get_token_position(), "Expected ';'");
+			error("Expected ';'");
 
-		return std::make_unique<ReturnStatement>(std::move(ret_expr));
+		return m_context.create<ReturnStatement>(ret_expr);
 	} else
 		return nullptr;
 }
 
-std::unique_ptr<Expression> Parser::parse_expression() {
-	std::unique_ptr<Expression> lhs = parse_assignment_expression();
-
-	if (match_token(TokenKind::COMA)) {
-		std::unique_ptr<Expression> rhs = parse_assignment_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected another expression after ','");
-
-		return std::make_unique<BinaryExpression>(BinaryOp::COMA, std::move(lhs), std::move(rhs));
-	}
-	
-	return lhs;
+Expression* Parser::parse_expression() {
+	return parse_binary_expression(COMA_PRECEDENCE);
 }
 
-std::unique_ptr<Expression> Parser::parse_assignment_expression() {
-	std::unique_ptr<Expression> lhs = parse_conditional_expression();
-
-	if (match_token(TokenKind::EQUAL)) {
-		std::unique_ptr<Expression> rhs = parse_conditional_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after assign operator '='");
-
-		return std::make_unique<BinaryExpression>(BinaryOp::ASSIGN, std::move(lhs), std::move(rhs));
-	}
-
-	return lhs;
+Expression* Parser::parse_assignment_expression() {
+	return parse_binary_expression(ASSIGN_PRECEDENCE);
 }
 
-std::unique_ptr<Expression> Parser::parse_conditional_expression() {
-	return parse_logical_or_expression();
+Expression* Parser::parse_conditional_expression() {
+	return parse_binary_expression(LOGICAL_OR_PRECEDENCE);
 }
 
-std::unique_ptr<Expression> Parser::parse_logical_or_expression() {
-	std::unique_ptr<Expression> lhs = parse_logical_and_expression();
+// Precedence climbing with the pending operators and calls on a frame stack
+// instead of the native one. An operand is complete once the next token is
+// an operator that binds less tightly than min_precedence; it then becomes
+// the right operand or the next argument of the frame on top.
+Expression* Parser::parse_binary_expression(int min_precedence) {
+	size_t bottom = m_expression_frames.size();
+	size_t first_call = m_call_frames.size();
+	size_t first_argument = m_argument_stack.size();
+	uint32_t depth;
+	Expression* lhs = parse_operand(min_precedence, depth);
 
-	if (match_token(TokenKind::LOGICAL_OR)) {
-		std::unique_ptr<Expression> rhs = parse_logical_and_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected another expression after '||'");
+	while (true) {
+		if (m_diagnostics.stopped()) {
+			m_expression_frames.resize(bottom);
+			m_call_frames.resize(first_call);
+			m_argument_stack.resize(first_argument);
+			return nullptr;
+		}
 
-		return std::make_unique<BinaryExpression>(BinaryOp::LOGICAL_OR, std::move(lhs), std::move(rhs));
-	}
-	
-	return lhs;
-}
+		const BinaryOperator& op = get_binary_operator(m_tokens.current().kind());
+		if (op.precedence >= min_precedence) {
+			if (exceeds_nesting_limit(m_statement_frames.size() + m_expression_frames.size() + 1)) {
+				nesting_error();
+				continue;
+			}
 
-std::unique_ptr<Expression> Parser::parse_logical_and_expression() {
-	std::unique_ptr<Expression> lhs = parse_equality_expression();
+			next_token();
 
-	if (match_token(TokenKind::LOGICAL_AND)) {
-		std::unique_ptr<Expression> rhs = parse_equality_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected another expression after '&&'");
+			m_expression_frames.push_back({ &op, lhs, min_precedence, depth });
+			min_precedence = op.right_associative ? op.precedence : op.precedence + 1;
+			lhs = parse_operand(min_precedence, depth);
+			continue;
+		}
 
-		return std::make_unique<BinaryExpression>(BinaryOp::LOGICAL_AND, std::move(lhs), std::move(rhs));
-	}
-	
-	return lhs;
-}
+		if (m_expression_frames.size() == bottom)
+			return lhs;
 
-std::unique_ptr<Expression> Parser::parse_equality_expression() {
-	std::unique_ptr<Expression> lhs = parse_relational_expression();
+		ExpressionFrame& frame = m_expression_frames.back();
 
-	if (match_token(TokenKind::EQUAL_EQUAL)) {
-		std::unique_ptr<Expression> rhs = parse_relational_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after equality operator '=='");
+		if (frame.op) {
+			if (!lhs)
+				error(frame.op->missing_rhs_message);
 
-		return std::make_unique<BinaryExpression>(BinaryOp::LOGICAL_EQUAL, std::move(lhs), std::move(rhs));
-	} else if (match_token(TokenKind::NOT_EQUAL)) {
-		std::unique_ptr<Expression> rhs = parse_relational_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after not equal operator '!='");
+			// Only the right operand of a chain nests any deeper.
+			if (continues_chain(frame.op->op, frame.lhs))
+				depth = std::max(frame.depth, depth + 1);
+			else
+				depth = std::max(frame.depth, depth) + 1;
 
-		return std::make_unique<BinaryExpression>(BinaryOp::LOGICAL_NOT_EQUAL, std::move(lhs), std::move(rhs));
-	}
-	
-	return lhs;
-}
+			lhs = m_context.create<BinaryExpression>(frame.op->op, frame.lhs, lhs);
+		} else {
+			if (lhs) {
+				m_argument_stack.push_back(lhs);
+				frame.depth = std::max(frame.depth, depth);
 
-std::unique_ptr<Expression> Parser::parse_relational_expression() {
-	std::unique_ptr<Expression> lhs = parse_additive_expression();
+				if (match_token(TokenKind::COMA)) {
+					min_precedence = LOGICAL_OR_PRECEDENCE;
+					lhs = parse_operand(min_precedence, depth);
+					continue;
+				}
+			}
 
-	if (match_token(TokenKind::LESS)) {
-		std::unique_ptr<Expression> rhs = parse_additive_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after less operator '<'");
+			CallFrame call = m_call_frames.back();
+			m_call_frames.pop_back();
 
-		return std::make_unique<BinaryExpression>(BinaryOp::LESS, std::move(lhs), std::move(rhs));
-	} else if (match_token(TokenKind::LESS_EQUAL)) {
-		std::unique_ptr<Expression> rhs = parse_additive_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after less equal operator '<='");
+			AstList<Expression*> args = pop_list(m_context, m_argument_stack, call.first_argument);
 
-		return std::make_unique<BinaryExpression>(BinaryOp::LESS_EQUAL, std::move(lhs), std::move(rhs));
-	} else if (match_token(TokenKind::GREATER)) {
-		std::unique_ptr<Expression> rhs = parse_additive_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after greater operator '>'");
+			if (!match_token(TokenKind::RIGHT_PAREN))
+				error("Expected ')' after function call arguments");
 
-		return std::make_unique<BinaryExpression>(BinaryOp::GREATER, std::move(lhs), std::move(rhs));
-	} else if (match_token(TokenKind::GREATER_EQUAL)) {
-		std::unique_ptr<Expression> rhs = parse_additive_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after greater equal operator '>='");
+			lhs = m_context.create<FuncCallAtom>(call.id, args);
+			depth = frame.depth + 1;
 
-		return std::make_unique<BinaryExpression>(BinaryOp::GREATER_EQUAL, std::move(lhs), std::move(rhs));
+			if (call.prefixed) {
+				lhs = m_context.create<UnaryExpression>(call.prefix, lhs);
+				depth++;
+			}
+		}
+
+		min_precedence = frame.min_precedence;
+		m_expression_frames.pop_back();
+
+		if (exceeds_nesting_limit(m_statement_frames.size() + depth))
+			nesting_error();
 	}
-	
-	return lhs;
 }
 
-std::unique_ptr<Expression> Parser::parse_additive_expression() {
-	std::unique_ptr<Expression> lhs = parse_multiplicative_expression();
+Expression* Parser::parse_operand(int& min_precedence, uint32_t& depth) {
+	while (true) {
+		bool prefixed = true;
+		UnaryOp prefix = UnaryOp::PRE_INCREMENT;
 
-	if (match_token(TokenKind::PLUS)) {
-		std::unique_ptr<Expression> rhs = parse_multiplicative_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after plus operator '+'");
+		if (match_token(TokenKind::PLUS_PLUS))
+			prefix = UnaryOp::PRE_INCREMENT;
+		else if (match_token(TokenKind::MINUS_MINUS))
+			prefix = UnaryOp::PRE_DECREMENT;
+		else
+			prefixed = false;
 
-		return std::make_unique<BinaryExpression>(BinaryOp::PLUS, std::move(lhs), std::move(rhs));
-	} else if (match_token(TokenKind::MINUS)) {
-		std::unique_ptr<Expression> rhs = parse_multiplicative_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after minus operator '-'");
+		Expression* atom;
 
-		return std::make_unique<BinaryExpression>(BinaryOp::MINUS, std::move(lhs), std::move(rhs));
-	}
-	
-	return lhs;
-}
-
-std::unique_ptr<Expression> Parser::parse_multiplicative_expression() {
-	std::unique_ptr<Expression> lhs = parse_unary_expression();
+		if (is_token(TokenKind::NAME)) {
+			std::string_view id = m_context.make_string(get_token_lexeme());
+			next_token();
 
-	if (match_token(TokenKind::STAR)) {
-		std::unique_ptr<Expression> rhs = parse_unary_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after multiply operator '*'");
+			if (match_token(TokenKind::LEFT_PAREN)) {
+				if (exceeds_nesting_limit(m_statement_frames.size() + m_expression_frames.size() + 1)) {
+					nesting_error();
+					return nullptr;
+				}
 
-		return std::make_unique<BinaryExpression>(BinaryOp::MULTIPLY, std::move(lhs), std::move(rhs));
-	} else if (match_token(TokenKind::SLASH)) {
-		std::unique_ptr<Expression> rhs = parse_unary_expression();
-		if (!rhs)
-			error(get_token_position(), "Expected expression after divide operator '/'");
+				m_expression_frames.push_back({ nullptr, nullptr, min_precedence, 0 });
+				m_call_frames.push_back({ id, m_argument_stack.size(), prefixed, prefix });
+				min_precedence = LOGICAL_OR_PRECEDENCE;
+				continue;
+			}
 
-		return std::make_unique<BinaryExpression>(BinaryOp::DIVIDE, std::move(lhs), std::move(rhs));
-	}
-	
-	return lhs;
-}
+			atom = m_context.create<IdAtom>(id);
+		} else
+			atom = parse_atom();
 
-std::unique_ptr<Expression> Parser::parse_unary_expression() {
-	if (match_token(TokenKind::PLUS_PLUS)) {
-		return std::make_unique<UnaryExpression>(UnaryOp::PRE_INCREMENT, parse_atom());
-	} else if (match_token(TokenKind::MINUS_MINUS)) {
-		return std::make_unique<UnaryExpression>(UnaryOp::PRE_DECREMENT, parse_atom());
-	} else
-		return parse_atom();
-}
+		depth = atom ? 1 : 0;
 
-std::unique_ptr<Expression> Parser::parse_atom() {
-	if (match_token("true")) {
-		return std::make_unique<BoolLiteral>(true);
-	} else if (match_token("false")) {
-		return std::make_unique<BoolLiteral>(false);
-	} else if (is_token(TokenKind::NAME)) {
-		std::string id = std::move(get_token_lexeme());
-		next_token();
+		if (!prefixed)
+			return atom;
 
-		if (match_token(TokenKind::LEFT_PAREN)) {
-			std::vector<std::unique_ptr<Expression>> args = parse_arguments();
+		depth++;
 
-			if (!match_token(TokenKind::RIGHT_PAREN))
-				error(get_token_position(), "Expected ')' after function call arguments");
+		return m_context.create<UnaryExpression>(prefix, atom);
+	}
+}
 
-			return std::make_unique<FuncCallAtom>(std::move(id), std::move(args));
-		} else
-			return std::make_unique<IdAtom>(std::move(id));
+Expression* Parser::parse_atom() {
+	if (match_token(TokenKind::KW_TRUE)) {
+		return m_context.create<BoolLiteral>(true);
+	} else if (match_token(TokenKind::KW_FALSE)) {
+		return m_context.create<BoolLiteral>(false);
 	} else if (is_token(TokenKind::INT)) {
-		int number = std::stoi(get_token_lexeme());
+		// The tokenizer only lets digits through, so range is all that can fail.
+		std::string_view lexeme = get_token_lexeme();
+		int32_t number = 0;
+
+		if (std::from_chars(lexeme.data(), lexeme.data() + lexeme.size(), number).ec != std::errc())
+			error("Integer literal out of range");
 		next_token();
 
-		return std::make_unique<IntLiteral>(number);
+		return m_context.int_literal(number);
 	} else if (is_token(TokenKind::FLOAT)) {
-		float number = std::stof(get_token_lexeme());
+		std::string_view lexeme = get_token_lexeme();
+		const char* end = lexeme.data() + lexeme.size();
+		float number = 0.0f;
+
+		if (std::from_chars(lexeme.data(), end, number).ec != std::errc()) {
+			// Literals have no exponent, so one below 1 cannot overflow. It can
+			// only be too small for a normal float, which from_chars may report
+			// as out of range too, and it rounds to a denormal or 0 instead.
+			if (lexeme.find_first_not_of('0') == lexeme.find('.')) {
+				double wide = 0.0;
+				std::from_chars(lexeme.data(), end, wide);
+				number = static_cast<float>(wide);
+			} else
+				error("Float literal out of range");
+		}
 		next_token();
 
-		return std::make_unique<FloatLiteral>(number);
+		return m_context.float_literal(number);
 	} else
 		return nullptr;
-}
-
-std::vector<std::unique_ptr<Expression>> Parser::parse_arguments() {
-	std::vector<std::unique_ptr<Expression>> args;
-
-	std::unique_ptr<Expression> cond_expr = parse_conditional_expression();
-	if (!cond_expr)
-		return {};
-
-	args.push_back(std::move(cond_expr));
-
-	while (match_token(TokenKind::COMA)) {
-		cond_expr = parse_conditional_expression();
-		if (!cond_expr)
-			return args;
-
-		args.push_back(std::move(cond_expr));
-	}
-
-	return args;
 }
\ No newline at end of file
@@ -1,57 +1,149 @@
 #pragma once
 
-#include "AST.h"
-#include "Tokenizer.h"
+#include "AstContext.h"
+#include "Diagnostics.h"
+#include "TokenStream.h"
 
-#include <array>
+#include <string>
+#include <vector>
 
+struct BinaryOperator;
+
+// Statements and expressions are parsed without recursion: what nests is
+// kept on frame stacks on the heap, so input nested arbitrarily deep cannot
+// overflow the native stack. The passes that walk the tree afterwards do
+// recurse, so the parser stops with a diagnostic once the tree would get
+// deeper than the nesting limit. They walk a chain of left-associative
+// operators in a loop, though, so 1 + 2 + ... + n is not nested at all.
 class Parser {
 public:
-	Parser(const std::filesystem::path& input_file);
+	static constexpr size_t DEFAULT_NESTING_LIMIT = 1000;
+
+	Parser(const SourceBuffer& source, AstContext& context, Lexing lexing = Lexing::INLINE);
+	Parser(const SourceBuffer& source, SourceRange range, AstContext& context, Lexing lexing = Lexing::INLINE);
+
+	TranslationUnit* parse();
+
+	// Parses the input one statement of the translation unit at a time,
+	// reporting and skipping tokens that cannot start one. Returns nullptr at
+	// the end of the input, or once the error limit is reached.
+	Statement* parse_top_level_statement();
+
+	// Offsets just past the last consumed token and past the one after it,
+	// which the parser has already looked at.
+	uint32_t consumed_end() const;
+	uint32_t lookahead_end();
 
-	std::unique_ptr<TranslationUnit> parse();
+	// DiagnosticEngine::DEFAULT_ERROR_LIMIT unless set, 0 for no limit.
+	void set_error_limit(size_t error_limit);
+	// DEFAULT_NESTING_LIMIT unless set, 0 for no limit.
+	void set_nesting_limit(size_t nesting_limit);
+	size_t diagnostic_count() const;
+	// Starts the diagnostics of a part of the input that will be joined with
+	// those of the part before by append_diagnostics().
+	void separate_diagnostics();
+	// The diagnostics from the first-th on.
+	std::vector<Diagnostic> diagnostics(size_t first = 0) const;
 
 private:
+	// A statement whose body is being parsed, with the parts that come before
+	// the body; a block's statements so far are on m_statement_stack.
+	struct StatementFrame {
+		NodeKind kind;
+		// Whether the body being parsed is not the first.
+		bool started = false;
+		bool done = false;
+		size_t first_statement = 0;
+		VariableDeclaration* var_decl = nullptr;
+		Expression* condition = nullptr;
+		Expression* expression = nullptr;
+		Type ret_type = Type::VOID;
+		std::string_view id = {};
+		AstList<TypedId> params = {};
+	};
+
+	// A binary operator whose right operand is being parsed, or a call whose
+	// arguments are, then op is nullptr and the call is on m_call_frames.
+	// depth is that of the left operand or of the deepest argument so far.
+	struct ExpressionFrame {
+		const BinaryOperator* op;
+		Expression* lhs;
+		int min_precedence;
+		uint32_t depth;
+	};
+
+	// The arguments so far are on m_argument_stack.
+	struct CallFrame {
+		std::string_view id;
+		size_t first_argument;
+		bool prefixed;
+		UnaryOp prefix;
+	};
+
+	// Reports an error at the current token.
+	void error(std::string_view message);
+	// Reports that the tree got deeper than the nesting limit and stops the
+	// parser; the statement it was in is dropped.
+	void nesting_error();
+	bool exceeds_nesting_limit(size_t depth) const;
+	// Reports a token that cannot start a statement and skips it; a run of
+	// them is reported once.
+	void skip_unexpected_token();
 
 	bool match_token(TokenKind kind);
-	bool match_token(std::string_view str);
 	bool is_token(TokenKind kind);
 
 	void next_token();
 
-	std::string& get_token_lexeme();
-	Position get_token_position();
+	std::string_view get_token_lexeme();
 
-	std::unique_ptr<TranslationUnit> parse_translation_unit();
+	TranslationUnit* parse_translation_unit();
 	
-	std::unique_ptr<Statement> parse_statement();
-	std::unique_ptr<CompoundStatement> parse_compound_statement();
-	std::unique_ptr<Expression> parse_expression_statement();
-	std::unique_ptr<DeclarationStatement> parse_declaration_statement();
-	std::unique_ptr<FunctionDeclaration> parse_function_declaration();
+	Statement* parse_statement();
+	// Parses a statement without a body, or the start of one with a body and
+	// pushes its frame; returns nullptr then.
+	Statement* open_statement();
+	void push_statement_frame(const StatementFrame& frame);
+	Statement* close_statement(Statement* body);
+	void begin_compound_statement();
+	Expression* parse_expression_statement();
+	DeclarationStatement* parse_declaration_statement();
+	void begin_function_declaration();
 	TypedId parse_typed_id();
-	std::vector<TypedId> parse_parameters();
+	AstList<TypedId> parse_parameters();
 	Type parse_return_type();
-	std::unique_ptr<VariableDeclaration> parse_variable_declaration();
-	std::unique_ptr<Expression> parse_init_value();
-	std::unique_ptr<IfStatement> parse_if_statement();
-	std::unique_ptr<ForStatement> parse_for_statement();
-	std::unique_ptr<WhileStatement> parse_while_statement();
-	std::unique_ptr<ReturnStatement> parse_return_statement();
-
-	std::unique_ptr<Expression> parse_expression();
-	std::unique_ptr<Expression> parse_assignment_expression();
-	std::unique_ptr<Expression> parse_conditional_expression();
-	std::unique_ptr<Expression> parse_logical_or_expression();
-	std::unique_ptr<Expression> parse_logical_and_expression();
-	std::unique_ptr<Expression> parse_equality_expression();
-	std::unique_ptr<Expression> parse_relational_expression();
-	std::unique_ptr<Expression> parse_additive_expression();
-	std::unique_ptr<Expression> parse_multiplicative_expression();
-	std::unique_ptr<Expression> parse_unary_expression();
-	std::unique_ptr<Expression> parse_atom();
-	std::vector<std::unique_ptr<Expression>> parse_arguments();
+	VariableDeclaration* parse_variable_declaration();
+	Expression* parse_init_value();
+	void begin_if_statement();
+	void begin_for_statement();
+	void begin_while_statement();
+	ReturnStatement* parse_return_statement();
+
+	Expression* parse_expression();
+	Expression* parse_assignment_expression();
+	Expression* parse_conditional_expression();
+	Expression* parse_binary_expression(int min_precedence);
+	// Parses an operand, pushing a frame for each call it starts with and
+	// setting min_precedence for the argument; depth is that of the operand.
+	Expression* parse_operand(int& min_precedence, uint32_t& depth);
+	Expression* parse_atom();
 	
 private:
-	Tokenizer m_tokenizer;
+	const SourceBuffer& m_source;
+	TokenStream m_tokens;
+	AstContext& m_context;
+	DiagnosticEngine m_diagnostics;
+	// SIZE_MAX for no limit.
+	size_t m_nesting_limit = DEFAULT_NESTING_LIMIT;
+	// Token count just after the last token skip_unexpected_token() skipped.
+	uint64_t m_skipped_until = 0;
+
+	// Children of the lists being parsed, innermost list on top. Finished lists
+	// are copied into the context, so these only ever grow to the deepest nesting.
+	std::vector<Statement*> m_statement_stack;
+	std::vector<Expression*> m_argument_stack;
+	std::vector<TypedId> m_parameter_stack;
+	std::vector<StatementFrame> m_statement_frames;
+	std::vector<ExpressionFrame> m_expression_frames;
+	std::vector<CallFrame> m_call_frames;
 };
\ No newline at end of file
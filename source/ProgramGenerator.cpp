@@ -0,0 +1,376 @@
+#include "ProgramGenerator.h"
+
+#include <algorithm>
+
+ProgramGenerator::ProgramGenerator(const GeneratorOptions& options)
+	: m_options(options), m_state(options.seed) {}
+
+// splitmix64: unlike the <random> distributions its output is the same
+// with every standard library.
+uint64_t ProgramGenerator::next_random() {
+	uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+
+	return z ^ (z >> 31);
+}
+
+uint32_t ProgramGenerator::random_below(uint32_t bound) {
+	return static_cast<uint32_t>(next_random() % bound);
+}
+
+bool ProgramGenerator::chance(double probability) {
+	return (next_random() >> 11) * (1.0 / 9007199254740992.0) < probability;
+}
+
+const char* ProgramGenerator::keyword(VarType type) {
+	static const char* keywords[] = { "int", "float", "bool" };
+	return keywords[static_cast<int>(type)];
+}
+
+std::string ProgramGenerator::new_name(char prefix) {
+	return prefix + std::to_string(m_name_counter++);
+}
+
+ProgramGenerator::VarType ProgramGenerator::random_type() {
+	return static_cast<VarType>(random_below(3));
+}
+
+std::string ProgramGenerator::generate() {
+	m_out.clear();
+	m_scope.clear();
+	m_functions.clear();
+	m_name_counter = 0;
+
+	while (m_out.size() < m_options.target_size) {
+		if (!m_functions.empty() && chance(0.3))
+			generate_global();
+		else
+			generate_function();
+	}
+
+	return std::move(m_out);
+}
+
+void ProgramGenerator::begin_line() {
+	if (chance(m_options.comment_ratio)) {
+		m_out.append(m_indent, '\t');
+		m_out += "// note " + std::to_string(random_below(1000)) + " about the next line\n";
+	}
+
+	m_out.append(m_indent, '\t');
+}
+
+void ProgramGenerator::end_line() {
+	m_out += '\n';
+
+	if (chance(m_options.blank_line_ratio))
+		m_out += '\n';
+}
+
+void ProgramGenerator::generate_global() {
+	VarType type = random_type();
+	std::string name = new_name('g');
+
+	begin_line();
+	m_out += keyword(type);
+	m_out += ' ' + name + " = ";
+	generate_expression(type, random_below(m_options.expression_size + 1));
+	m_out += ';';
+	end_line();
+
+	m_scope.push_back({ name, type, true });
+}
+
+void ProgramGenerator::generate_function() {
+	Function function{ new_name('f'), random_type(), {} };
+	size_t scope_size = m_scope.size();
+
+	begin_line();
+	m_out += "def " + function.name + '(';
+
+	uint32_t parameter_count = random_below(4);
+	for (uint32_t i = 0; i < parameter_count; i++) {
+		VarType type = random_type();
+		std::string name = new_name('p');
+
+		if (i)
+			m_out += ", ";
+		m_out += keyword(type);
+		m_out += ' ' + name;
+
+		function.parameters.push_back(type);
+		m_scope.push_back({ name, type, true });
+	}
+
+	m_out += ") -> ";
+	m_out += keyword(function.return_type);
+	m_out += ' ';
+	generate_block(0, function);
+	end_line();
+
+	m_scope.resize(scope_size);
+
+	// Registered only now, so that no body can call its own function.
+	m_functions.push_back(std::move(function));
+}
+
+void ProgramGenerator::generate_block(int depth, const Function& function) {
+	size_t scope_size = m_scope.size();
+
+	m_out += "{\n";
+	m_indent++;
+
+	uint32_t count = 1 + random_below(depth == 0 ? 8 : 4);
+	for (uint32_t i = 0; i < count; i++)
+		generate_statement(depth, function);
+
+	if (depth == 0) {
+		begin_line();
+		m_out += "return ";
+		generate_expression(function.return_type, random_below(m_options.expression_size + 1));
+		m_out += ';';
+		end_line();
+	}
+
+	m_indent--;
+	m_out.append(m_indent, '\t');
+	m_out += '}';
+
+	m_scope.resize(scope_size);
+}
+
+void ProgramGenerator::generate_statement(int depth, const Function& function) {
+	uint32_t roll = random_below(100);
+	bool nest = depth < m_options.max_depth;
+
+	if (roll < 35 || m_scope.empty())
+		generate_declaration();
+	else if (roll < 60)
+		generate_assignment();
+	else if (roll < 75 && nest)
+		generate_if(depth, function);
+	else if (roll < 85 && nest)
+		generate_for(depth, function);
+	else if (roll < 92 && nest)
+		generate_while(depth, function);
+	else if (roll < 96 && !m_functions.empty()) {
+		begin_line();
+		generate_call(*pick_function(std::nullopt));
+		m_out += ';';
+		end_line();
+	} else if (nest) {
+		begin_line();
+		generate_block(depth + 1, function);
+		end_line();
+	} else
+		generate_declaration();
+}
+
+void ProgramGenerator::generate_declaration() {
+	VarType type = random_type();
+	std::string name = new_name('v');
+
+	begin_line();
+	m_out += keyword(type);
+	m_out += ' ' + name + " = ";
+	generate_expression(type, random_below(2 * m_options.expression_size + 1));
+	m_out += ';';
+	end_line();
+
+	m_scope.push_back({ name, type, true });
+}
+
+void ProgramGenerator::generate_assignment() {
+	const Variable* target = pick_variable(std::nullopt, true);
+
+	if (!target) {
+		generate_declaration();
+		return;
+	}
+
+	begin_line();
+	m_out += target->name + " = ";
+	generate_expression(target->type, random_below(2 * m_options.expression_size + 1));
+	m_out += ';';
+	end_line();
+}
+
+void ProgramGenerator::generate_if(int depth, const Function& function) {
+	begin_line();
+	m_out += "if (";
+	generate_expression(VarType::BOOL, 1 + random_below(m_options.expression_size + 1));
+	m_out += ") ";
+	generate_block(depth + 1, function);
+	end_line();
+}
+
+void ProgramGenerator::generate_for(int depth, const Function& function) {
+	std::string counter = new_name('i');
+
+	begin_line();
+	m_out += "for (int " + counter + " = 0; " + counter + " < " + std::to_string(1 + random_below(16)) + "; ++" + counter + ") ";
+
+	// The counter is in scope for reading only, so the loop always ends.
+	m_scope.push_back({ counter, VarType::INT, false });
+	generate_block(depth + 1, function);
+	m_scope.pop_back();
+	end_line();
+}
+
+void ProgramGenerator::generate_while(int depth, const Function& function) {
+	std::string counter = new_name('w');
+
+	begin_line();
+	m_out += "int " + counter + " = 0;";
+	end_line();
+
+	begin_line();
+	m_out += "while (" + counter + " < " + std::to_string(1 + random_below(16)) + ") ";
+
+	m_scope.push_back({ counter, VarType::INT, false });
+	m_out += "{\n";
+	m_indent++;
+
+	size_t scope_size = m_scope.size();
+	uint32_t count = 1 + random_below(4);
+	for (uint32_t i = 0; i < count; i++)
+		generate_statement(depth + 1, function);
+	m_scope.resize(scope_size);
+
+	begin_line();
+	m_out += counter + " = " + counter + " + 1;";
+	end_line();
+
+	m_indent--;
+	m_out.append(m_indent, '\t');
+	m_out += '}';
+	end_line();
+}
+
+// The grammar has no parentheses, so an expression is a chain of operands
+// whose operators are picked so that every precedence level keeps its type:
+// arithmetic inside comparisons, comparisons inside '&&' and '||'.
+void ProgramGenerator::generate_expression(VarType type, int operators) {
+	if (type == VarType::BOOL) {
+		int terms = 1 + (operators > 0 ? random_below(operators) : 0);
+
+		for (int i = 0; i < terms; i++) {
+			if (i)
+				m_out += random_below(2) ? " && " : " || ";
+
+			if (chance(0.3))
+				generate_operand(VarType::BOOL);
+			else {
+				static const char* comparisons[] = { " < ", " > ", " <= ", " >= ", " == ", " != " };
+				VarType operand_type = random_below(2) ? VarType::INT : VarType::FLOAT;
+				int operand_operators = operators / terms / 2;
+
+				generate_expression(operand_type, operand_operators);
+				m_out += comparisons[random_below(6)];
+				generate_expression(operand_type, operand_operators);
+			}
+		}
+
+		return;
+	}
+
+	generate_operand(type);
+
+	for (int i = 0; i < operators; i++) {
+		switch (random_below(4)) {
+		case 0:
+			m_out += " + ";
+			break;
+		case 1:
+			m_out += " - ";
+			break;
+		case 2:
+			m_out += " * ";
+			break;
+		default:
+			// Only ever divide by a non-zero literal.
+			m_out += " / ";
+			m_out += type == VarType::INT ? std::to_string(1 + random_below(9)) : std::to_string(1 + random_below(9)) + ".5";
+			continue;
+		}
+
+		generate_operand(type);
+	}
+}
+
+void ProgramGenerator::generate_operand(VarType type) {
+	uint32_t roll = random_below(10);
+
+	if (roll < 5) {
+		if (const Variable* variable = pick_variable(type, false)) {
+			if (type == VarType::INT && variable->assignable && roll == 0 && m_indent > 0)
+				m_out += "++";
+			m_out += variable->name;
+			return;
+		}
+	} else if (roll < 6 && m_indent > 0) {
+		// Calls are only made from inside function bodies, so that globals
+		// never depend on code.
+		if (const Function* function = pick_function(type)) {
+			generate_call(*function);
+			return;
+		}
+	}
+
+	generate_literal(type);
+}
+
+// Both pickers look at a few random candidates instead of searching, which
+// would make generation quadratic in the size of the program. Variables are
+// drawn from the innermost entries of the scope, as real code mostly uses
+// its locals.
+const ProgramGenerator::Variable* ProgramGenerator::pick_variable(std::optional<VarType> type, bool assignable) {
+	uint32_t window = static_cast<uint32_t>(std::min<size_t>(m_scope.size(), 32));
+
+	for (int attempt = 0; window != 0 && attempt < 8; attempt++) {
+		const Variable& variable = m_scope[m_scope.size() - 1 - random_below(window)];
+
+		if ((!type || variable.type == *type) && (!assignable || variable.assignable))
+			return &variable;
+	}
+
+	return nullptr;
+}
+
+const ProgramGenerator::Function* ProgramGenerator::pick_function(std::optional<VarType> return_type) {
+	for (int attempt = 0; !m_functions.empty() && attempt < 8; attempt++) {
+		const Function& function = m_functions[random_below(static_cast<uint32_t>(m_functions.size()))];
+
+		if (!return_type || function.return_type == *return_type)
+			return &function;
+	}
+
+	return nullptr;
+}
+
+void ProgramGenerator::generate_literal(VarType type) {
+	switch (type) {
+	case VarType::INT:
+		m_out += std::to_string(random_below(1000));
+		break;
+	case VarType::FLOAT:
+		m_out += std::to_string(random_below(1000)) + '.' + std::to_string(random_below(100));
+		break;
+	case VarType::BOOL:
+		m_out += random_below(2) ? "true" : "false";
+		break;
+	}
+}
+
+void ProgramGenerator::generate_call(const Function& function) {
+	m_out += function.name + '(';
+
+	for (size_t i = 0; i < function.parameters.size(); i++) {
+		if (i)
+			m_out += ", ";
+		generate_expression(function.parameters[i], random_below(2));
+	}
+
+	m_out += ')';
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct GeneratorOptions {
+	uint64_t seed = 1;
+	// Generation stops after the first top-level statement that reaches it.
+	size_t target_size = 64 * 1024;
+	// Deepest nesting of blocks inside a function body.
+	int max_depth = 3;
+	// Average number of binary operators per expression.
+	int expression_size = 3;
+	// Chance of a comment line before a statement, and of a blank line after one.
+	double comment_ratio = 0.1;
+	double blank_line_ratio = 0.1;
+};
+
+// Emits random programs that follow Grammar/Grammar.txt. Beyond the grammar,
+// every name is declared before use, calls match the callee's parameter
+// count, expressions are well typed, loops are bounded and there is no
+// recursion, so that the output is also good input for the later stages.
+// The same options always give the same program, on every platform.
+class ProgramGenerator {
+public:
+	ProgramGenerator(const GeneratorOptions& options);
+
+	std::string generate();
+
+private:
+	enum class VarType {
+		INT,
+		FLOAT,
+		BOOL
+	};
+
+	struct Variable {
+		std::string name;
+		VarType type;
+		bool assignable;
+	};
+
+	struct Function {
+		std::string name;
+		VarType return_type;
+		std::vector<VarType> parameters;
+	};
+
+	uint64_t next_random();
+	uint32_t random_below(uint32_t bound);
+	bool chance(double probability);
+
+	static const char* keyword(VarType type);
+
+	std::string new_name(char prefix);
+	VarType random_type();
+
+	void generate_global();
+	void generate_function();
+	void generate_block(int depth, const Function& function);
+	void generate_statement(int depth, const Function& function);
+	void generate_declaration();
+	void generate_assignment();
+	void generate_if(int depth, const Function& function);
+	void generate_for(int depth, const Function& function);
+	void generate_while(int depth, const Function& function);
+
+	void generate_expression(VarType type, int operators);
+	void generate_operand(VarType type);
+	void generate_literal(VarType type);
+	void generate_call(const Function& function);
+
+	const Variable* pick_variable(std::optional<VarType> type, bool assignable);
+	const Function* pick_function(std::optional<VarType> return_type);
+
+	void begin_line();
+	void end_line();
+
+private:
+	GeneratorOptions m_options;
+	uint64_t m_state;
+	std::string m_out;
+	int m_indent = 0;
+	uint32_t m_name_counter = 0;
+
+	std::vector<Variable> m_scope;
+	std::vector<Function> m_functions;
+};
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include "ScanKernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCAN_KERNELS_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SCAN_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SCAN_TARGET(isa)
+#endif
+
+static int count_trailing_zeros(unsigned mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+static const char* scalar_skip_white_space(const char* p, const char* end) {
+	while (p != end && is_white_space_char(*p))
+		p++;
+
+	return p;
+}
+
+static const char* scalar_skip_name(const char* p, const char* end) {
+	while (p != end && is_name_char(*p))
+		p++;
+
+	return p;
+}
+
+static const char* scalar_skip_digits(const char* p, const char* end) {
+	while (p != end && is_digit_char(*p))
+		p++;
+
+	return p;
+}
+
+static const char* scalar_skip_line(const char* p, const char* end) {
+	while (p != end && *p != '\n')
+		p++;
+
+	return p;
+}
+
+static size_t scalar_count_newlines(const char* p, const char* end) {
+	size_t count = 0;
+	for (; p != end; p++)
+		count += *p == '\n';
+
+	return count;
+}
+
+static uint32_t* scalar_find_line_starts(const char* p, const char* end, const char* base, uint32_t* out) {
+	for (; p != end; p++) {
+		if (*p == '\n')
+			*out++ = static_cast<uint32_t>(p + 1 - base);
+	}
+
+	return out;
+}
+
+#ifdef SCAN_KERNELS_X86
+
+// Byte-wise "lo <= c <= hi" for both vector widths: shift the range down to
+// zero and compare with an unsigned minimum.
+#define IN_RANGE_128(c, lo, hi) \
+	_mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8((c), _mm_set1_epi8(lo)), _mm_set1_epi8((hi) - (lo))), _mm_sub_epi8((c), _mm_set1_epi8(lo)))
+#define IN_RANGE_256(c, lo, hi) \
+	_mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8((c), _mm256_set1_epi8(lo)), _mm256_set1_epi8((hi) - (lo))), _mm256_sub_epi8((c), _mm256_set1_epi8(lo)))
+
+// A byte lane of the newline counters below overflows after this many blocks.
+static constexpr int MAX_COUNTED_BLOCKS = 255;
+
+SCAN_TARGET("sse2")
+static const char* sse2_skip_white_space(const char* p, const char* end) {
+	while (end - p >= 16) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i space = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), IN_RANGE_128(c, '\t', '\r'));
+		unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(space)) & 0xFFFF;
+
+		if (stop)
+			return p + count_trailing_zeros(stop);
+
+		p += 16;
+	}
+
+	return scalar_skip_white_space(p, end);
+}
+
+SCAN_TARGET("sse2")
+static const char* sse2_skip_name(const char* p, const char* end) {
+	while (end - p >= 16) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i name = _mm_or_si128(
+			_mm_or_si128(IN_RANGE_128(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 'z'), IN_RANGE_128(c, '0', '9')),
+			_mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+		unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(name)) & 0xFFFF;
+
+		if (stop)
+			return p + count_trailing_zeros(stop);
+
+		p += 16;
+	}
+
+	return scalar_skip_name(p, end);
+}
+
+SCAN_TARGET("sse2")
+static const char* sse2_skip_digits(const char* p, const char* end) {
+	while (end - p >= 16) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		unsigned stop = ~static_cast<unsigned>(_mm_movemask_epi8(IN_RANGE_128(c, '0', '9'))) & 0xFFFF;
+
+		if (stop)
+			return p + count_trailing_zeros(stop);
+
+		p += 16;
+	}
+
+	return scalar_skip_digits(p, end);
+}
+
+SCAN_TARGET("sse2")
+static const char* sse2_skip_line(const char* p, const char* end) {
+	while (end - p >= 16) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		unsigned stop = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n'))));
+
+		if (stop)
+			return p + count_trailing_zeros(stop);
+
+		p += 16;
+	}
+
+	return scalar_skip_line(p, end);
+}
+
+// Each matching byte of cmpeq is -1, so subtracting the comparisons counts
+// newlines per byte lane; sad against zero then sums the lanes.
+SCAN_TARGET("sse2")
+static size_t sse2_count_newlines(const char* p, const char* end) {
+	size_t count = 0;
+
+	while (end - p >= 16) {
+		__m128i counts = _mm_setzero_si128();
+
+		for (int i = 0; i < MAX_COUNTED_BLOCKS && end - p >= 16; i++, p += 16) {
+			__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(c, _mm_set1_epi8('\n')));
+		}
+
+		alignas(16) uint64_t sums[2];
+		_mm_store_si128(reinterpret_cast<__m128i*>(sums), _mm_sad_epu8(counts, _mm_setzero_si128()));
+		count += sums[0] + sums[1];
+	}
+
+	return count + scalar_count_newlines(p, end);
+}
+
+SCAN_TARGET("sse2")
+static uint32_t* sse2_find_line_starts(const char* p, const char* end, const char* base, uint32_t* out) {
+	while (end - p >= 16) {
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		unsigned newlines = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n'))));
+
+		for (; newlines; newlines &= newlines - 1)
+			*out++ = static_cast<uint32_t>(p + count_trailing_zeros(newlines) + 1 - base);
+
+		p += 16;
+	}
+
+	return scalar_find_line_starts(p, end, base, out);
+}
+
+SCAN_TARGET("avx2")
+static const char* avx2_skip_white_space(const char* p, const char* end) {
+	while (end - p >= 32) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), IN_RANGE_256(c, '\t', '\r'));
+		unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(space));
+
+		if (stop)
+			return p + count_trailing_zeros(stop);
+
+		p += 32;
+	}
+
+	return sse2_skip_white_space(p, end);
+}
+
+SCAN_TARGET("avx2")
+static const char* avx2_skip_name(const char* p, const char* end) {
+	while (end - p >= 32) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		__m256i name = _mm256_or_si256(
+			_mm256_or_si256(IN_RANGE_256(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z'), IN_RANGE_256(c, '0', '9')),
+			_mm256_cmpeq_epi8(c, _mm256_set1_epi8('_')));
+		unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(name));
+
+		if (stop)
+			return p + count_trailing_zeros(stop);
+
+		p += 32;
+	}
+
+	return sse2_skip_name(p, end);
+}
+
+SCAN_TARGET("avx2")
+static const char* avx2_skip_digits(const char* p, const char* end) {
+	while (end - p >= 32) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		unsigned stop = ~static_cast<unsigned>(_mm256_movemask_epi8(IN_RANGE_256(c, '0', '9')));
+
+		if (stop)
+			return p + count_trailing_zeros(stop);
+
+		p += 32;
+	}
+
+	return sse2_skip_digits(p, end);
+}
+
+SCAN_TARGET("avx2")
+static const char* avx2_skip_line(const char* p, const char* end) {
+	while (end - p >= 32) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		unsigned stop = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n'))));
+
+		if (stop)
+			return p + count_trailing_zeros(stop);
+
+		p += 32;
+	}
+
+	return sse2_skip_line(p, end);
+}
+
+SCAN_TARGET("avx2")
+static size_t avx2_count_newlines(const char* p, const char* end) {
+	size_t count = 0;
+
+	while (end - p >= 32) {
+		__m256i counts = _mm256_setzero_si256();
+
+		for (int i = 0; i < MAX_COUNTED_BLOCKS && end - p >= 32; i++, p += 32) {
+			__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			counts = _mm256_sub_epi8(counts, _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n')));
+		}
+
+		alignas(32) uint64_t sums[4];
+		_mm256_store_si256(reinterpret_cast<__m256i*>(sums), _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+		count += sums[0] + sums[1] + sums[2] + sums[3];
+	}
+
+	return count + sse2_count_newlines(p, end);
+}
+
+SCAN_TARGET("avx2")
+static uint32_t* avx2_find_line_starts(const char* p, const char* end, const char* base, uint32_t* out) {
+	while (end - p >= 32) {
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		unsigned newlines = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n'))));
+
+		for (; newlines; newlines &= newlines - 1)
+			*out++ = static_cast<uint32_t>(p + count_trailing_zeros(newlines) + 1 - base);
+
+		p += 32;
+	}
+
+	return sse2_find_line_starts(p, end, base, out);
+}
+
+static bool cpu_has_sse2() {
+#if defined(__x86_64__) || defined(_M_X64)
+	return true;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+
+	__cpuidex(info, 7, 0);
+	return os_saves_ymm && (info[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+static const ScanKernels scalar_kernels = {
+	scalar_skip_white_space,
+	scalar_skip_name,
+	scalar_skip_digits,
+	scalar_skip_line,
+	scalar_count_newlines,
+	scalar_find_line_starts
+};
+
+#ifdef SCAN_KERNELS_X86
+static const ScanKernels sse2_kernels = {
+	sse2_skip_white_space,
+	sse2_skip_name,
+	sse2_skip_digits,
+	sse2_skip_line,
+	sse2_count_newlines,
+	sse2_find_line_starts
+};
+
+static const ScanKernels avx2_kernels = {
+	avx2_skip_white_space,
+	avx2_skip_name,
+	avx2_skip_digits,
+	avx2_skip_line,
+	avx2_count_newlines,
+	avx2_find_line_starts
+};
+#endif
+
+bool is_scan_kernel_supported(ScanKernel kernel) {
+	switch (kernel) {
+#ifdef SCAN_KERNELS_X86
+	case ScanKernel::SSE2:
+		return cpu_has_sse2();
+	case ScanKernel::AVX2:
+		return cpu_has_sse2() && cpu_has_avx2();
+#endif
+	case ScanKernel::SCALAR:
+		return true;
+	default:
+		return false;
+	}
+}
+
+ScanKernel best_scan_kernel() {
+	static const ScanKernel best =
+		is_scan_kernel_supported(ScanKernel::AVX2) ? ScanKernel::AVX2 :
+		is_scan_kernel_supported(ScanKernel::SSE2) ? ScanKernel::SSE2 :
+		ScanKernel::SCALAR;
+
+	return best;
+}
+
+const ScanKernels& get_scan_kernels(ScanKernel kernel) {
+	if (!is_scan_kernel_supported(kernel))
+		return scalar_kernels;
+
+	switch (kernel) {
+#ifdef SCAN_KERNELS_X86
+	case ScanKernel::SSE2:
+		return sse2_kernels;
+	case ScanKernel::AVX2:
+		return avx2_kernels;
+#endif
+	default:
+		return scalar_kernels;
+	}
+}
\ No newline at end of file
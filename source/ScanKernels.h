@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels that skip whole runs of one character class. Each of them returns a
+// pointer to the first byte that is not part of the run, never going past end.
+// The buffer must be terminated by a '\0' at end (see SourceBuffer).
+//
+// The newline kernels, which LineTable builds on, read the whole range.
+
+inline bool is_white_space_char(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+inline bool is_letter_char(char c) {
+	return static_cast<unsigned char>((c | 0x20) - 'a') <= 'z' - 'a';
+}
+
+inline bool is_digit_char(char c) {
+	return static_cast<unsigned char>(c - '0') <= 9;
+}
+
+inline bool is_name_char(char c) {
+	return is_letter_char(c) || is_digit_char(c) || c == '_';
+}
+
+enum class ScanKernel {
+	SCALAR = 0,
+	SSE2,
+	AVX2
+};
+
+struct ScanKernels {
+	const char* (*skip_white_space)(const char* p, const char* end);
+	const char* (*skip_name)(const char* p, const char* end);
+	const char* (*skip_digits)(const char* p, const char* end);
+	const char* (*skip_line)(const char* p, const char* end);
+
+	size_t (*count_newlines)(const char* p, const char* end);
+	// Writes the offset from base just past each newline to out, returning
+	// the end of what it wrote.
+	uint32_t* (*find_line_starts)(const char* p, const char* end, const char* base, uint32_t* out);
+};
+
+ScanKernel best_scan_kernel();
+bool is_scan_kernel_supported(ScanKernel kernel);
+const ScanKernels& get_scan_kernels(ScanKernel kernel);
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "SourceBuffer.h"
+#include "Trace.h"
+
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SOURCE_BUFFER_MMAP 1
+#endif
+
+SourceBuffer::SourceBuffer(const std::filesystem::path& input_file) {
+	TraceScope trace("read", "io");
+
+	// A file too big to map is too big to read.
+	m_open = map_file(input_file) || (m_error.empty() && read_file(input_file));
+
+	if (!m_open) {
+		if (m_error.empty())
+			m_error = "cannot open file";
+		assign({});
+	}
+
+	trace.add_arg("bytes", static_cast<int64_t>(m_size));
+	trace.add_arg("mapped", m_mapped);
+	if (trace.active())
+		trace.set_detail(input_file.string());
+}
+
+SourceBuffer::SourceBuffer(std::string_view text) {
+	m_open = fits(text.size());
+	assign(m_open ? text : std::string_view{});
+}
+
+SourceBuffer::~SourceBuffer() {
+#ifdef SOURCE_BUFFER_MMAP
+	if (m_mapped)
+		munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+const char* SourceBuffer::begin() const {
+	return m_data;
+}
+
+const char* SourceBuffer::end() const {
+	return m_data + m_size;
+}
+
+size_t SourceBuffer::size() const {
+	return m_size;
+}
+
+std::string_view SourceBuffer::text() const {
+	return { m_data, m_size };
+}
+
+SourceRange SourceBuffer::range() const {
+	return { 0, static_cast<uint32_t>(m_size) };
+}
+
+const LineTable& SourceBuffer::lines() const {
+	std::call_once(m_lines_once, [this] { m_lines = std::make_unique<LineTable>(text()); });
+
+	return *m_lines;
+}
+
+bool SourceBuffer::is_open() const {
+	return m_open;
+}
+
+bool SourceBuffer::is_mapped() const {
+	return m_mapped;
+}
+
+const std::string& SourceBuffer::error() const {
+	return m_error;
+}
+
+bool SourceBuffer::map_file(const std::filesystem::path& input_file) {
+#ifdef SOURCE_BUFFER_MMAP
+	int fd = open(input_file.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0 || !fits(static_cast<size_t>(st.st_size))) {
+		close(fd);
+		return false;
+	}
+
+	// The kernel zero-fills the tail of the last page, which gives us the sentinel
+	// for free. A file that ends exactly on a page boundary has no such tail.
+	size_t size = static_cast<size_t>(st.st_size);
+	if (size % static_cast<size_t>(sysconf(_SC_PAGESIZE)) == 0) {
+		close(fd);
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	m_data = static_cast<const char*>(data);
+	m_size = size;
+	m_mapped = true;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool SourceBuffer::read_file(const std::filesystem::path& input_file) {
+	std::ifstream file(input_file, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	std::streamoff size = file.tellg();
+	if (size < 0 || !fits(static_cast<size_t>(size)))
+		return false;
+
+	m_storage = std::make_unique<char[]>(static_cast<size_t>(size) + 1);
+	file.seekg(0);
+	file.read(m_storage.get(), size);
+
+	m_size = static_cast<size_t>(file.gcount());
+	m_storage[m_size] = '\0';
+	m_data = m_storage.get();
+
+	return true;
+}
+
+bool SourceBuffer::fits(size_t size) {
+	if (size <= MAX_SIZE)
+		return true;
+
+	m_error = "source is larger than " + std::to_string(MAX_SIZE) + " bytes";
+
+	return false;
+}
+
+void SourceBuffer::assign(std::string_view text) {
+	m_storage = std::make_unique<char[]>(text.size() + 1);
+	std::memcpy(m_storage.get(), text.data(), text.size());
+	m_storage[text.size()] = '\0';
+
+	m_data = m_storage.get();
+	m_size = text.size();
+}
\ No newline at end of file
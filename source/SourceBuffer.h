@@ -0,0 +1,62 @@
+#pragma once
+
+#include "LineTable.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+// Slice of a SourceBuffer. Offsets are the whole buffer's, so a range can be
+// tokenized on its own and still report the positions of a whole-file pass.
+struct SourceRange {
+	uint32_t begin = 0;
+	uint32_t end = 0;
+};
+
+// Whole source file in one contiguous block. The byte at end() is always '\0',
+// so the tokenizer can walk the text with raw pointers without bounds checks.
+// Tokens and diagnostics locate text by 32-bit offsets, so a source bigger
+// than MAX_SIZE is not opened.
+class SourceBuffer {
+public:
+	static constexpr size_t MAX_SIZE = UINT32_MAX;
+
+	SourceBuffer(const std::filesystem::path& input_file);
+	SourceBuffer(std::string_view text);
+	~SourceBuffer();
+
+	SourceBuffer(const SourceBuffer&) = delete;
+	SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+	const char* begin() const;
+	const char* end() const;
+	size_t size() const;
+	std::string_view text() const;
+	SourceRange range() const;
+	// Built on first use, on whichever thread asks first.
+	const LineTable& lines() const;
+
+	bool is_open() const;
+	bool is_mapped() const;
+	// Why the source is not open.
+	const std::string& error() const;
+
+private:
+	bool map_file(const std::filesystem::path& input_file);
+	bool read_file(const std::filesystem::path& input_file);
+	bool fits(size_t size);
+	void assign(std::string_view text);
+
+private:
+	std::unique_ptr<char[]> m_storage;
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_open = false;
+	bool m_mapped = false;
+	std::string m_error;
+	mutable std::once_flag m_lines_once;
+	mutable std::unique_ptr<LineTable> m_lines;
+};
\ No newline at end of file
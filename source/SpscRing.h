@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between exactly one producer and one consumer
+// thread. Slots are filled and read in place, so big elements are never
+// copied: the producer writes into write_slot() and publishes it with push(),
+// the consumer reads front() and hands the slot back with pop(). Each side
+// keeps its own copy of the other side's index and only reloads it when the
+// ring looks full or empty, so the indices' cache lines rarely bounce.
+template<typename T, size_t Capacity>
+class SpscRing {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity has to be a power of two");
+
+public:
+	// Producer side. nullptr while the ring is full.
+	T* write_slot() {
+		size_t tail = m_tail.load(std::memory_order_relaxed);
+
+		if (tail - m_cached_head == Capacity) {
+			m_cached_head = m_head.load(std::memory_order_acquire);
+			if (tail - m_cached_head == Capacity)
+				return nullptr;
+		}
+
+		return &m_slots[tail & (Capacity - 1)];
+	}
+
+	void push() {
+		m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	// Consumer side. nullptr while the ring is empty.
+	T* front() {
+		size_t head = m_head.load(std::memory_order_relaxed);
+
+		if (head == m_cached_tail) {
+			m_cached_tail = m_tail.load(std::memory_order_acquire);
+			if (head == m_cached_tail)
+				return nullptr;
+		}
+
+		return &m_slots[head & (Capacity - 1)];
+	}
+
+	void pop() {
+		m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+private:
+	static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	// Written by the consumer.
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head = 0;
+	size_t m_cached_tail = 0;
+
+	// Written by the producer.
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail = 0;
+	size_t m_cached_head = 0;
+
+	alignas(CACHE_LINE_SIZE) T m_slots[Capacity];
+};
\ No newline at end of file
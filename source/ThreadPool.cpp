@@ -0,0 +1,143 @@
+#include "ThreadPool.h"
+
+static thread_local const ThreadPool* tls_pool = nullptr;
+static thread_local unsigned tls_worker = 0;
+
+ThreadPool::ThreadPool(unsigned thread_count) {
+	if (thread_count == 0)
+		thread_count = 1;
+
+	for (unsigned i = 0; i < thread_count; i++)
+		m_workers.push_back(std::make_unique<Worker>());
+
+	for (unsigned i = 0; i < thread_count; i++)
+		m_threads.emplace_back(&ThreadPool::run, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(m_mutex);
+		m_stop = true;
+	}
+	m_work_available.notify_all();
+
+	for (std::thread& thread : m_threads)
+		thread.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	// Tasks submitted from inside the pool stay with their worker, everything
+	// else is dealt out round-robin so that stealing starts from a balanced state.
+	unsigned index = current_worker();
+	if (index == thread_count())
+		index = m_next_worker++ % thread_count();
+
+	{
+		std::lock_guard lock(m_workers[index]->mutex);
+		m_workers[index]->tasks.push_back(std::move(task));
+	}
+
+	{
+		std::lock_guard lock(m_mutex);
+		m_queued++;
+		m_unfinished++;
+	}
+	m_work_available.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock lock(m_mutex);
+	m_all_done.wait(lock, [this] { return m_unfinished == 0; });
+}
+
+unsigned ThreadPool::thread_count() const {
+	return static_cast<unsigned>(m_workers.size());
+}
+
+unsigned ThreadPool::current_worker() const {
+	return tls_pool == this ? tls_worker : thread_count();
+}
+
+bool ThreadPool::run_pending_task() {
+	{
+		std::lock_guard lock(m_mutex);
+
+		if (m_queued == 0)
+			return false;
+
+		m_queued--;
+	}
+
+	run_task(current_worker());
+
+	return true;
+}
+
+void ThreadPool::run(unsigned index) {
+	tls_pool = this;
+	tls_worker = index;
+
+	while (true) {
+		{
+			std::unique_lock lock(m_mutex);
+			m_work_available.wait(lock, [this] { return m_stop || m_queued > 0; });
+
+			if (m_queued == 0)
+				return;
+
+			m_queued--;
+		}
+
+		run_task(index);
+	}
+}
+
+void ThreadPool::run_task(unsigned index) {
+	std::function<void()> task;
+
+	// The caller took one task off m_queued, so some deque holds at least one.
+	while (!pop_task(index, task) && !steal_task(index, task))
+		std::this_thread::yield();
+
+	task();
+
+	std::lock_guard lock(m_mutex);
+	if (--m_unfinished == 0)
+		m_all_done.notify_all();
+}
+
+bool ThreadPool::pop_task(unsigned index, std::function<void()>& task) {
+	if (index == thread_count())
+		return false;
+
+	Worker& worker = *m_workers[index];
+	std::lock_guard lock(worker.mutex);
+
+	if (worker.tasks.empty())
+		return false;
+
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+
+	return true;
+}
+
+bool ThreadPool::steal_task(unsigned thief, std::function<void()>& task) {
+	for (unsigned i = 1; i <= thread_count(); i++) {
+		unsigned index = (thief + i) % (thread_count() + 1);
+		if (index == thief || index == thread_count())
+			continue;
+
+		Worker& victim = *m_workers[index];
+		std::lock_guard lock(victim.mutex);
+
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+
+			return true;
+		}
+	}
+
+	return false;
+}
\ No newline at end of file
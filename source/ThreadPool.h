@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque. A worker takes new work
+// from the back of its own deque and, once that is empty, steals the oldest
+// task from the front of another worker's deque.
+class ThreadPool {
+public:
+	ThreadPool(unsigned thread_count = std::thread::hardware_concurrency());
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> task);
+	void wait();
+
+	// Runs one queued task on the calling thread, if there is one. Lets a task
+	// wait for tasks it submitted itself without tying up its worker.
+	bool run_pending_task();
+
+	unsigned thread_count() const;
+
+	// Index of the calling worker thread, or thread_count() outside the pool.
+	unsigned current_worker() const;
+
+private:
+	struct Worker {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void run(unsigned index);
+	void run_task(unsigned index);
+	bool pop_task(unsigned index, std::function<void()>& task);
+	bool steal_task(unsigned thief, std::function<void()>& task);
+
+private:
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_work_available;
+	std::condition_variable m_all_done;
+	size_t m_queued = 0;
+	size_t m_unfinished = 0;
+	bool m_stop = false;
+
+	std::atomic<unsigned> m_next_worker = 0;
+};
\ No newline at end of file
@@ -1,7 +1,7 @@
 #pragma once
 
-#include <string>
-#include <variant>
+#include <cstdint>
+#include <string_view>
 
 enum class TokenKind {
 	EOS = 0,
@@ -13,6 +13,17 @@ enum class TokenKind {
 	INT,
 	FLOAT,
 
+	KW_DEF,
+	KW_IF,
+	KW_FOR,
+	KW_WHILE,
+	KW_RETURN,
+	KW_TRUE,
+	KW_FALSE,
+	KW_INT,
+	KW_FLOAT,
+	KW_BOOL,
+
 	COMA,
 	SEMICOLON,
 	ARROW,
@@ -44,26 +55,50 @@ enum class TokenKind {
 	RIGHT_BRACE
 };
 
-struct Position {
-	int line;
-	int column;
-};
-
+// A token is only its kind and where its text is in the source; LineTable has
+// the line and column of the offset when a diagnostic needs them.
 class Token {
 public:
 	Token(TokenKind kind=TokenKind::INVALID);
 
 	void set_type(TokenKind kind);
-	void set_lexeme(std::string lexeme);
-	void set_position(Position pos);
+	void set_lexeme(uint32_t offset, uint32_t length);
 	
 	TokenKind kind() const;
-	Position pos() const;
-	std::string& lexeme();
-	const std::string& lexeme() const;
+	uint32_t offset() const;
+	uint32_t length() const;
+	std::string_view lexeme(std::string_view source) const;
 	
 private:
-	std::string m_lexeme;
-	Position m_pos = { -1, -1 };
+	uint32_t m_offset = 0;
+	uint32_t m_length = 0;
 	TokenKind m_kind;
-};
\ No newline at end of file
+};
+
+inline Token::Token(TokenKind kind)
+	: m_kind(kind) {}
+
+inline void Token::set_type(TokenKind kind) {
+	m_kind = kind;
+}
+
+inline void Token::set_lexeme(uint32_t offset, uint32_t length) {
+	m_offset = offset;
+	m_length = length;
+}
+
+inline TokenKind Token::kind() const {
+	return m_kind;
+}
+
+inline uint32_t Token::offset() const {
+	return m_offset;
+}
+
+inline uint32_t Token::length() const {
+	return m_length;
+}
+
+inline std::string_view Token::lexeme(std::string_view source) const {
+	return source.substr(m_offset, m_length);
+}
\ No newline at end of file
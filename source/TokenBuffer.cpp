@@ -0,0 +1,47 @@
+#include "TokenBuffer.h"
+#include "Trace.h"
+
+#include <climits>
+
+// Generated programs average about four bytes of source per token; reserving
+// for more than that saves growing the arrays, which costs more than trimming
+// them once at the end.
+static constexpr size_t BYTES_PER_TOKEN_ESTIMATE = 3;
+
+static_assert(static_cast<size_t>(TokenKind::RIGHT_BRACE) <= UCHAR_MAX, "TokenKind outgrew the byte TokenBuffer stores it in");
+
+TokenBuffer::TokenBuffer(const SourceBuffer& source, SourceRange range) {
+	TraceScope trace("lex", "parser");
+	Tokenizer tokenizer(source, range);
+
+	size_t estimate = (range.end - range.begin) / BYTES_PER_TOKEN_ESTIMATE + 1;
+	m_kinds.reserve(estimate);
+	m_offsets.reserve(estimate);
+	m_lengths.reserve(estimate);
+
+	while (true) {
+		const Token& token = tokenizer.current();
+
+		m_kinds.push_back(static_cast<uint8_t>(token.kind()));
+		m_offsets.push_back(token.offset());
+		m_lengths.push_back(token.length());
+
+		if (token.kind() == TokenKind::EOS)
+			break;
+
+		tokenizer.next();
+	}
+
+	m_kinds.shrink_to_fit();
+	m_offsets.shrink_to_fit();
+	m_lengths.shrink_to_fit();
+
+	trace.add_arg("tokens", m_kinds.size());
+	trace.add_arg("bytes", memory_usage());
+	trace.add_duration_arg("lex_us", tokenizer.scan_ticks());
+}
+
+size_t TokenBuffer::memory_usage() const {
+	return m_kinds.capacity() * sizeof(uint8_t) + m_offsets.capacity() * sizeof(uint32_t) +
+		m_lengths.capacity() * sizeof(uint32_t);
+}
\ No newline at end of file
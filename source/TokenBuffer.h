@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Tokenizer.h"
+
+#include <vector>
+
+// Every token of a source range, scanned up front and kept as parallel
+// arrays: a byte of kind and a 32-bit offset and length per token, 9 bytes
+// where a Token takes 12. Any token can be looked at by index, which is what
+// TokenStream's peek() and rewind() are built on; the parser itself needs no
+// more than one token of lookahead.
+class TokenBuffer {
+public:
+	TokenBuffer(const SourceBuffer& source, SourceRange range);
+
+	// Number of tokens, the EOS token at the end included.
+	size_t size() const;
+
+	// Indices past the end all refer to the EOS token.
+	TokenKind kind(size_t index) const;
+	uint32_t offset(size_t index) const;
+	uint32_t length(size_t index) const;
+
+	// Bytes allocated for the tokens.
+	size_t memory_usage() const;
+
+private:
+	size_t clamp(size_t index) const;
+
+private:
+	std::vector<uint8_t> m_kinds;
+	std::vector<uint32_t> m_offsets;
+	std::vector<uint32_t> m_lengths;
+};
+
+inline size_t TokenBuffer::size() const {
+	return m_kinds.size();
+}
+
+inline size_t TokenBuffer::clamp(size_t index) const {
+	return index < m_kinds.size() ? index : m_kinds.size() - 1;
+}
+
+inline TokenKind TokenBuffer::kind(size_t index) const {
+	return static_cast<TokenKind>(m_kinds[clamp(index)]);
+}
+
+inline uint32_t TokenBuffer::offset(size_t index) const {
+	return m_offsets[clamp(index)];
+}
+
+inline uint32_t TokenBuffer::length(size_t index) const {
+	return m_lengths[clamp(index)];
+}
\ No newline at end of file
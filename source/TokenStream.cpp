@@ -0,0 +1,151 @@
+#include "TokenStream.h"
+#include "SpscRing.h"
+#include "Trace.h"
+
+#include <atomic>
+#include <thread>
+
+// Big enough that the threads only touch the ring's indices once every few
+// hundred tokens, small enough that the parser gets its first batch quickly
+// and the batches in flight (about 100 KB) stay in L2.
+static constexpr uint32_t TOKEN_BATCH_SIZE = 512;
+static constexpr size_t TOKEN_BATCH_COUNT = 16;
+
+struct TokenBatch {
+	uint32_t count = 0;
+	// Ends with the EOS token.
+	bool last = false;
+	Token tokens[TOKEN_BATCH_SIZE];
+};
+
+struct TokenPipeline {
+	SpscRing<TokenBatch, TOKEN_BATCH_COUNT> ring;
+	// Set when the consumer goes away before the last batch.
+	std::atomic<bool> stopped = false;
+	// Whether the consumer is reading the last batch.
+	bool finished = false;
+	std::thread producer;
+};
+
+// Runs on the producer thread until it has pushed the last batch or the
+// consumer stops it.
+static void produce(Tokenizer& tokenizer, TokenPipeline& pipeline) {
+	TraceScope trace("lex", "parser");
+	uint64_t full_waits = 0;
+	bool last = false;
+
+	while (!last && !pipeline.stopped.load(std::memory_order_relaxed)) {
+		TokenBatch* batch = pipeline.ring.write_slot();
+
+		if (!batch) {
+			full_waits++;
+			std::this_thread::yield();
+			continue;
+		}
+
+		uint32_t count = 0;
+		while (count < TOKEN_BATCH_SIZE && !last) {
+			batch->tokens[count++] = tokenizer.current();
+
+			last = tokenizer.current().kind() == TokenKind::EOS;
+			if (!last)
+				tokenizer.next();
+		}
+
+		batch->count = count;
+		batch->last = last;
+		pipeline.ring.push();
+	}
+
+	trace.add_arg("tokens", tokenizer.token_count());
+	trace.add_arg("full_waits", full_waits);
+	trace.add_duration_arg("lex_us", tokenizer.scan_ticks());
+}
+
+TokenStream::TokenStream(const SourceBuffer& source, SourceRange range, Lexing lexing)
+	: m_previous_end(range.begin)
+{
+	if (lexing == Lexing::BUFFERED) {
+		m_buffer = std::make_unique<TokenBuffer>(source, range);
+		m_token = &m_buffered;
+		load_buffered();
+		return;
+	}
+
+	m_tokenizer.emplace(source, range);
+	m_token = &m_tokenizer->current();
+
+	if (lexing == Lexing::INLINE)
+		return;
+
+	// The Tokenizer belongs to the producer from here on.
+	m_pipeline = std::make_unique<TokenPipeline>();
+	m_pipeline->producer = std::thread(produce, std::ref(*m_tokenizer), std::ref(*m_pipeline));
+
+	next_batch();
+}
+
+TokenStream::~TokenStream() {
+	if (!m_pipeline)
+		return;
+
+	m_pipeline->stopped.store(true, std::memory_order_relaxed);
+	m_pipeline->producer.join();
+}
+
+Token TokenStream::peek(size_t n) const {
+	Token token;
+	token.set_type(m_buffer->kind(m_index + n));
+	token.set_lexeme(m_buffer->offset(m_index + n), m_buffer->length(m_index + n));
+	return token;
+}
+
+TokenMark TokenStream::mark() const {
+	return { m_index, m_previous_end };
+}
+
+void TokenStream::rewind(TokenMark mark) {
+	m_index = mark.index;
+	m_previous_end = mark.previous_end;
+	load_buffered();
+}
+
+uint32_t TokenStream::previous_end() const {
+	return m_pipeline || m_buffer ? m_previous_end : m_tokenizer->previous_end();
+}
+
+uint64_t TokenStream::token_count() const {
+	if (m_buffer)
+		return m_index + 1;
+	if (!m_pipeline)
+		return m_tokenizer->token_count();
+
+	return m_consumed + static_cast<uint64_t>(m_token - m_batch_begin) + 1;
+}
+
+uint64_t TokenStream::scan_ticks() const {
+	return m_pipeline || m_buffer ? 0 : m_tokenizer->scan_ticks();
+}
+
+void TokenStream::next_batch() {
+	TokenPipeline& pipeline = *m_pipeline;
+
+	// Past the end of the last batch, the EOS token stays current.
+	if (pipeline.finished) {
+		m_token = m_batch_end - 1;
+		return;
+	}
+
+	if (m_batch_begin) {
+		m_consumed += static_cast<uint64_t>(m_batch_end - m_batch_begin);
+		pipeline.ring.pop();
+	}
+
+	TokenBatch* batch;
+	while (!(batch = pipeline.ring.front()))
+		std::this_thread::yield();
+
+	m_batch_begin = m_token = batch->tokens;
+	m_batch_end = batch->tokens + batch->count;
+	pipeline.finished = batch->last;
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "TokenBuffer.h"
+
+#include <memory>
+#include <optional>
+
+// Where the parser's tokens come from.
+enum class Lexing {
+	// Scanned one at a time on the parsing thread, as the parser asks for them.
+	INLINE,
+	// Scanned ahead on a thread of their own and handed over in batches.
+	PIPELINED,
+	// Scanned all at once into a TokenBuffer before parsing starts.
+	BUFFERED
+};
+
+struct TokenPipeline;
+
+// A position in a buffered TokenStream to rewind to.
+struct TokenMark {
+	size_t index;
+	uint32_t previous_end;
+};
+
+// Tokens for the Parser. Inline, it is a Tokenizer. Buffered, it walks a
+// TokenBuffer by index. Pipelined, a producer thread runs the Tokenizer and
+// fills batches of tokens in a lock-free ring, and next() only steps through
+// the current batch, so the parser works on one core while the tokenizer
+// works on another. The producer waits while the ring is full and the parser
+// while it is empty; the last batch ends with the EOS token, which next()
+// then returns forever, as the Tokenizer does.
+//
+// Starting the thread and handing tokens over between cores only pays off on
+// inputs of at least some tens of kilobytes, and only with a spare core.
+// Buffering keeps a copy of every token, about 9 bytes each, in exchange for
+// a tighter loop over the source, and lets a parser look any number of tokens
+// ahead and backtrack, as both are only an index into the buffer.
+class TokenStream {
+public:
+	TokenStream(const SourceBuffer& source, SourceRange range, Lexing lexing);
+	// Stops the producer if the parser gave up before the end of the input.
+	~TokenStream();
+
+	TokenStream(const TokenStream&) = delete;
+	TokenStream& operator=(const TokenStream&) = delete;
+
+	Token& current();
+	void next();
+
+	// Whether the tokens are buffered; only then can peek(), mark() and
+	// rewind() be used.
+	bool buffered() const;
+
+	// The token n after the current one, the EOS token past the end.
+	Token peek(size_t n) const;
+
+	// Where the stream is, and a return to it; the marks stay valid for the
+	// life of the stream.
+	TokenMark mark() const;
+	void rewind(TokenMark mark);
+
+	// Offset just past the token before the current one.
+	uint32_t previous_end() const;
+
+	// Tokens handed to the parser so far, and the time the tokenizer took for
+	// them on this thread; pipelined, that time is traced by the producer.
+	uint64_t token_count() const;
+	uint64_t scan_ticks() const;
+
+private:
+	void next_batch();
+	void load_buffered();
+
+private:
+	// Not built when buffered, as the TokenBuffer scans with one of its own.
+	std::optional<Tokenizer> m_tokenizer;
+	std::unique_ptr<TokenPipeline> m_pipeline;
+	std::unique_ptr<TokenBuffer> m_buffer;
+
+	// The current token: the Tokenizer's, one in the batch being read or a
+	// copy of the one at m_index in the buffer.
+	Token* m_token = nullptr;
+	Token m_buffered;
+	size_t m_index = 0;
+	Token* m_batch_begin = nullptr;
+	Token* m_batch_end = nullptr;
+	uint32_t m_previous_end = 0;
+	// Tokens in the batches before the current one.
+	uint64_t m_consumed = 0;
+};
+
+inline Token& TokenStream::current() {
+	return *m_token;
+}
+
+inline void TokenStream::next() {
+	if (m_buffer) {
+		m_previous_end = m_buffered.offset() + m_buffered.length();
+
+		// The EOS token at the end stays current.
+		if (m_index + 1 < m_buffer->size())
+			m_index++;
+
+		load_buffered();
+		return;
+	}
+
+	if (!m_pipeline) {
+		m_tokenizer->next();
+		return;
+	}
+
+	m_previous_end = m_token->offset() + m_token->length();
+
+	if (++m_token == m_batch_end)
+		next_batch();
+}
+
+inline bool TokenStream::buffered() const {
+	return m_buffer != nullptr;
+}
+
+inline void TokenStream::load_buffered() {
+	m_buffered.set_type(m_buffer->kind(m_index));
+	m_buffered.set_lexeme(m_buffer->offset(m_index), m_buffer->length(m_index));
+}
\ No newline at end of file
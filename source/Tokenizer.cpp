@@ -1,216 +1,271 @@
 #include "Tokenizer.h"
+#include "Trace.h"
 
-Tokenizer::Tokenizer(const std::filesystem::path& input_file)
-	: m_stream(input_file)
+#include <array>
+
+struct Keyword {
+	std::string_view name;
+	TokenKind kind = TokenKind::NAME;
+};
+
+static constexpr Keyword keywords[] = {
+	{ "def", TokenKind::KW_DEF },
+	{ "if", TokenKind::KW_IF },
+	{ "for", TokenKind::KW_FOR },
+	{ "while", TokenKind::KW_WHILE },
+	{ "return", TokenKind::KW_RETURN },
+	{ "true", TokenKind::KW_TRUE },
+	{ "false", TokenKind::KW_FALSE },
+	{ "int", TokenKind::KW_INT },
+	{ "float", TokenKind::KW_FLOAT },
+	{ "bool", TokenKind::KW_BOOL }
+};
+
+static constexpr size_t keyword_hash(std::string_view name) {
+	return (static_cast<unsigned char>(name.front()) + static_cast<unsigned char>(name.back()) + name.size()) & 31;
+}
+
+static constexpr std::array<Keyword, 32> make_keyword_table() {
+	std::array<Keyword, 32> table = {};
+
+	for (const Keyword& keyword : keywords)
+		table[keyword_hash(keyword.name)] = keyword;
+
+	return table;
+}
+
+static constexpr std::array<Keyword, 32> keyword_table = make_keyword_table();
+
+static constexpr bool is_keyword_hash_perfect() {
+	for (const Keyword& keyword : keywords) {
+		if (keyword_table[keyword_hash(keyword.name)].kind != keyword.kind)
+			return false;
+	}
+
+	return true;
+}
+
+static_assert(is_keyword_hash_perfect(), "Keywords collide in keyword_hash, pick another hash");
+
+Tokenizer::Tokenizer(const SourceBuffer& source, ScanKernel kernel)
+	: Tokenizer(source, source.range(), kernel) {}
+
+Tokenizer::Tokenizer(const SourceBuffer& source, SourceRange range, ScanKernel kernel)
+	: m_scan(get_scan_kernels(kernel)), m_begin(source.begin()), m_cursor(source.begin() + range.begin), m_end(source.begin() + range.end),
+	m_previous_end(range.begin), m_timed(Trace::enabled())
 {
 	scan_next_token();
+	m_token_count++;
 }
 
 Token& Tokenizer::current() {
 	return m_token;
 }
 
+uint32_t Tokenizer::previous_end() const {
+	return m_previous_end;
+}
+
+uint64_t Tokenizer::token_count() const {
+	return m_token_count;
+}
+
+uint64_t Tokenizer::scan_ticks() const {
+	return m_scan_ticks;
+}
+
 Token& Tokenizer::next() {
-	scan_next_token();
+	m_previous_end = m_token.offset() + m_token.length();
+
+	if (m_timed && m_token_count % SCAN_SAMPLE_PERIOD == 0) {
+		uint64_t begin = Trace::ticks();
+		scan_next_token();
+		m_scan_ticks += (Trace::ticks() - begin) * SCAN_SAMPLE_PERIOD;
+	} else
+		scan_next_token();
+
+	m_token_count++;
 	return m_token;
 }
 
 void Tokenizer::scan_next_token() {
-	Position pos = { m_stream.line(), m_stream.column() };
+	const char* start;
+	TokenKind kind;
 	
 	do {
+		start = m_cursor;
+
 		if (is_eof())
-			m_token.set_type(TokenKind::EOS);
+			kind = TokenKind::EOS;
 		else if (is_white_space())
-			m_token = scan_white_space();
+			kind = scan_white_space();
 		else if (is_name_start())
-			m_token = scan_name();
+			kind = scan_name();
 		else if (is_number_start())
-			m_token = scan_number();
+			kind = scan_number();
 		else
-			m_token = scan_operator_or_punctuation_mark();
-	} while (m_token.kind() == TokenKind::WHITE_SPACE ||
-			 m_token.kind() == TokenKind::COMMENT ||
-			 m_token.kind() == TokenKind::INVALID);
-
-	if (m_token.kind() == TokenKind::INVALID) {
-		Position new_pos = { m_stream.line(), m_stream.column() };
-
-		// TODO Error messages
-		// 
-		// error(pos, new_pos, "Invlaid characters");
-		// For now it just skips all the invlaid characters
-	}
+			kind = scan_operator_or_punctuation_mark();
+	} while (kind == TokenKind::WHITE_SPACE ||
+			 kind == TokenKind::COMMENT ||
+			 kind == TokenKind::INVALID);
+
+	// TODO Error messages
+	// For now it just skips all the invlaid characters
 
-	m_token.set_position(pos);
+	m_token.set_type(kind);
+	m_token.set_lexeme(static_cast<uint32_t>(start - m_begin), static_cast<uint32_t>(m_cursor - start));
 }
 
 bool Tokenizer::is_eof() const {
-	return m_stream.current() == EOF;
+	return m_cursor == m_end;
 }
 
 bool Tokenizer::is_name_start() const {
-	return std::isalpha(m_stream.current());
+	return is_letter_char(*m_cursor);
 }
 
 bool Tokenizer::is_number_start() const {
-	return std::isdigit(m_stream.current());
+	return is_digit_char(*m_cursor);
 }
 
 bool Tokenizer::is_white_space() const {
-	return std::isspace(m_stream.current());
+	return is_white_space_char(*m_cursor);
 }
-	
-Token Tokenizer::scan_white_space() {
-	while (is_white_space())
-		m_stream.next();
 
-	return Token(TokenKind::WHITE_SPACE);
-}
+TokenKind Tokenizer::scan_white_space() {
+	m_cursor = m_scan.skip_white_space(m_cursor, m_end);
 
-Token Tokenizer::scan_name() {
-	Token token(TokenKind::NAME);
-	std::string name;
+	return TokenKind::WHITE_SPACE;
+}
 
-	while (std::isalnum(m_stream.current()) || m_stream.current() == '_') {
-		name += m_stream.current();
-		m_stream.next();
-	}
+TokenKind Tokenizer::scan_name() {
+	const char* start = m_cursor;
+	m_cursor = m_scan.skip_name(m_cursor, m_end);
 
-	token.set_lexeme(std::move(name));
+	std::string_view name(start, m_cursor - start);
+	const Keyword& keyword = keyword_table[keyword_hash(name)];
 
-	return token;
+	return keyword.name == name ? keyword.kind : TokenKind::NAME;
 }
 
-Token Tokenizer::scan_number() {
-	Token token;
-	std::string lexeme;
-
-	while (std::isdigit(m_stream.current())) {
-		lexeme += m_stream.current();
-		m_stream.next();
-		token.set_type(TokenKind::INT);
-	}
+TokenKind Tokenizer::scan_number() {
+	m_cursor = m_scan.skip_digits(m_cursor, m_end);
 	
-	if (m_stream.current() == '.') {
-		if (!std::isdigit(m_stream.next())) {
-			token.set_type(TokenKind::INVALID);
-			return token;
-		}
-
-		while (std::isdigit(m_stream.current())) {
-			lexeme += m_stream.current();
-			m_stream.next();
-		}
-
-		token.set_type(TokenKind::FLOAT);
-	}
+	if (*m_cursor == '.') {
+		if (!is_digit_char(*++m_cursor))
+			return TokenKind::INVALID;
 
-	token.set_lexeme(std::move(lexeme));
+		m_cursor = m_scan.skip_digits(m_cursor, m_end);
 
-	return token;
+		return TokenKind::FLOAT;
+	}
+
+	return TokenKind::INT;
 }
 
-Token Tokenizer::scan_operator_or_punctuation_mark() {
-	Token token;
+TokenKind Tokenizer::scan_operator_or_punctuation_mark() {
+	TokenKind kind;
 
-	switch (m_stream.current()) {
+	switch (*m_cursor) {
 	case '/':
-		if (m_stream.next() == '/') {
-			char c = m_stream.next();
-			while (c != '\n' && c != EOF) {
-				c = m_stream.next();
-			}
-			token.set_type(TokenKind::COMMENT);
-			m_stream.next();
+		if (*++m_cursor == '/') {
+			m_cursor = m_scan.skip_line(m_cursor, m_end);
+			kind = TokenKind::COMMENT;
 		} else
-			token.set_type(TokenKind::SLASH);
+			kind = TokenKind::SLASH;
 		break;
 	case '=':
-		if (m_stream.next() == '=') {
-			m_stream.next();
-			token.set_type(TokenKind::EQUAL_EQUAL);
+		if (*++m_cursor == '=') {
+			m_cursor++;
+			kind = TokenKind::EQUAL_EQUAL;
 		} else
-			token.set_type(TokenKind::EQUAL);
+			kind = TokenKind::EQUAL;
 		break;
 	case '!':
-		if (m_stream.next() == '=') {
-			m_stream.next();
-			token.set_type(TokenKind::NOT_EQUAL);
+		if (*++m_cursor == '=') {
+			m_cursor++;
+			kind = TokenKind::NOT_EQUAL;
 		} else
-			token.set_type(TokenKind::LOGICAL_NOT);
+			kind = TokenKind::LOGICAL_NOT;
 		break;
 	case '+':
-		if (m_stream.next() == '+') {
-			m_stream.next();
-			token.set_type(TokenKind::PLUS_PLUS);
+		if (*++m_cursor == '+') {
+			m_cursor++;
+			kind = TokenKind::PLUS_PLUS;
 		} else
-			token.set_type(TokenKind::PLUS);
+			kind = TokenKind::PLUS;
 		break;
 	case '-':
-		m_stream.next();
-		if (m_stream.current() == '-') {
-			m_stream.next();
-			token.set_type(TokenKind::MINUS_MINUS);
-		} else if (m_stream.current() == '>') {
-			m_stream.next();
-			token.set_type(TokenKind::ARROW);
+		m_cursor++;
+		if (*m_cursor == '-') {
+			m_cursor++;
+			kind = TokenKind::MINUS_MINUS;
+		} else if (*m_cursor == '>') {
+			m_cursor++;
+			kind = TokenKind::ARROW;
 		} else
-			token.set_type(TokenKind::MINUS);
+			kind = TokenKind::MINUS;
 		break;
 	case '*':
-		token.set_type(TokenKind::STAR);
-		m_stream.next();
+		kind = TokenKind::STAR;
+		m_cursor++;
 		break;
 	case '<':
-		if (m_stream.next() == '=') {
-			m_stream.next();
-			token.set_type(TokenKind::LESS_EQUAL);
+		if (*++m_cursor == '=') {
+			m_cursor++;
+			kind = TokenKind::LESS_EQUAL;
 		} else
-			token.set_type(TokenKind::LESS);
+			kind = TokenKind::LESS;
 		break;
 	case '>':
-		if (m_stream.next() == '=') {
-			m_stream.next();
-			token.set_type(TokenKind::GREATER_EQUAL);
+		if (*++m_cursor == '=') {
+			m_cursor++;
+			kind = TokenKind::GREATER_EQUAL;
 		} else
-			token.set_type(TokenKind::GREATER);
+			kind = TokenKind::GREATER;
 		break;
 	case '(':
-		m_stream.next();
-		token.set_type(TokenKind::LEFT_PAREN);
+		m_cursor++;
+		kind = TokenKind::LEFT_PAREN;
 		break;
 	case ')':
-		m_stream.next();
-		token.set_type(TokenKind::RIGHT_PAREN);
+		m_cursor++;
+		kind = TokenKind::RIGHT_PAREN;
 		break;
 	case '&':
-		if (m_stream.next() == '&') {
-			m_stream.next();
-			token.set_type(TokenKind::LOGICAL_AND);
+		if (*++m_cursor == '&') {
+			m_cursor++;
+			kind = TokenKind::LOGICAL_AND;
 		} else
-			token.set_type(TokenKind::INVALID);
+			kind = TokenKind::INVALID;
+		break;
 	case '|':
-		if (m_stream.next() == '|') {
-			m_stream.next();
-			token.set_type(TokenKind::LOGICAL_OR);
+		if (*++m_cursor == '|') {
+			m_cursor++;
+			kind = TokenKind::LOGICAL_OR;
 		} else
-			token.set_type(TokenKind::INVALID);
+			kind = TokenKind::INVALID;
+		break;
+	case ',':
+		m_cursor++;
+		kind = TokenKind::COMA;
+		break;
 	case ';':
-		m_stream.next();
-		token.set_type(TokenKind::SEMICOLON);
+		m_cursor++;
+		kind = TokenKind::SEMICOLON;
 		break;
 	case '{':
-		m_stream.next();
-		token.set_type(TokenKind::LEFT_BRACE);
+		m_cursor++;
+		kind = TokenKind::LEFT_BRACE;
 		break;
 	case '}':
-		m_stream.next();
-		token.set_type(TokenKind::RIGHT_BRACE);
+		m_cursor++;
+		kind = TokenKind::RIGHT_BRACE;
 		break;
 	default:
-		token.set_type(TokenKind::INVALID);
+		m_cursor++;
+		kind = TokenKind::INVALID;
 	}
 
-	return token;
+	return kind;
 }
\ No newline at end of file
@@ -1,18 +1,29 @@
 #pragma once
 
-#include <filesystem>
-
-#include "FileStream.h"
+#include "ScanKernels.h"
+#include "SourceBuffer.h"
 #include "Token.h"
 
 class Tokenizer {
 public:
-	Tokenizer(const std::filesystem::path& input_file);
+	Tokenizer(const SourceBuffer& source, ScanKernel kernel = best_scan_kernel());
+	Tokenizer(const SourceBuffer& source, SourceRange range, ScanKernel kernel = best_scan_kernel());
 
 	Token& next();
 	Token& current();
+
+	// Offset just past the token before the current one.
+	uint32_t previous_end() const;
+
+	// Tokens scanned so far, and the time spent scanning them. The time is
+	// only taken while tracing, in Trace::ticks(), and then only sampled: reading
+	// the clock costs about as much as scanning a token.
+	uint64_t token_count() const;
+	uint64_t scan_ticks() const;
 	
 private:
+	static constexpr uint64_t SCAN_SAMPLE_PERIOD = 16;
+
 	void scan_next_token();
 
 	bool is_eof() const;
@@ -20,12 +31,20 @@ private:
 	bool is_number_start() const;
 	bool is_white_space() const;
 	
-	Token scan_white_space();
-	Token scan_name();
-	Token scan_number();
-	Token scan_operator_or_punctuation_mark();
+	TokenKind scan_white_space();
+	TokenKind scan_name();
+	TokenKind scan_number();
+	TokenKind scan_operator_or_punctuation_mark();
 
 private:
-	FileStream m_stream;
+	const ScanKernels& m_scan;
+	const char* m_begin;
+	const char* m_cursor;
+	const char* m_end;
+	uint32_t m_previous_end;
 	Token m_token;
+
+	bool m_timed;
+	uint64_t m_token_count = 0;
+	uint64_t m_scan_ticks = 0;
 };
\ No newline at end of file
@@ -0,0 +1,130 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct TraceEvent {
+	const char* name;
+	const char* category;
+	uint64_t begin;
+	uint64_t end;
+	Trace::Arg args[4];
+	size_t arg_count;
+	std::string detail;
+};
+
+// Owned here rather than by the thread, so that the events of threads that
+// have already finished are still around for write().
+struct TraceBuffer {
+	uint32_t thread_id;
+	std::vector<TraceEvent> events;
+};
+
+static std::mutex buffers_mutex;
+static std::vector<std::unique_ptr<TraceBuffer>> buffers;
+static thread_local TraceBuffer* thread_buffer = nullptr;
+
+static uint64_t start_ticks;
+static std::chrono::steady_clock::time_point start_time;
+
+static TraceBuffer& get_thread_buffer() {
+	if (!thread_buffer) {
+		std::lock_guard lock(buffers_mutex);
+
+		buffers.push_back(std::make_unique<TraceBuffer>());
+		thread_buffer = buffers.back().get();
+		thread_buffer->thread_id = static_cast<uint32_t>(buffers.size());
+	}
+
+	return *thread_buffer;
+}
+
+void append_json_string(std::string& out, std::string_view text) {
+	static constexpr char digits[] = "0123456789abcdef";
+
+	out += '"';
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			out += "\\u00";
+			out += digits[c >> 4];
+			out += digits[c & 15];
+		} else
+			out += c;
+	}
+	out += '"';
+}
+
+void Trace::start() {
+	start_ticks = ticks();
+	start_time = std::chrono::steady_clock::now();
+
+	s_enabled = true;
+}
+
+void Trace::complete(const char* name, const char* category, uint64_t begin, uint64_t end, const Arg* args, size_t arg_count, std::string detail) {
+	TraceEvent event{ name, category, begin, end, {}, std::min<size_t>(arg_count, 4), std::move(detail) };
+	std::copy(args, args + event.arg_count, event.args);
+
+	get_thread_buffer().events.push_back(std::move(event));
+}
+
+// Expects all recording threads to be done, e.g. their pool joined.
+bool Trace::write(const std::filesystem::path& path) {
+	s_enabled = false;
+
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start_time;
+	double ticks_per_us = elapsed.count() > 0 ? (ticks() - start_ticks) / elapsed.count() : 1;
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+		return false;
+
+	auto timestamp = [&](uint64_t value) {
+		return value > start_ticks ? (value - start_ticks) / ticks_per_us : 0.0;
+	};
+
+	std::lock_guard lock(buffers_mutex);
+	const char* separator = "\n";
+
+	out << std::fixed;
+	out.precision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	for (const auto& buffer : buffers) {
+		out << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->thread_id
+			<< ",\"args\":{\"name\":\"thread " << buffer->thread_id << "\"}}";
+		separator = ",\n";
+
+		for (const TraceEvent& event : buffer->events) {
+			out << separator << "{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\""
+				<< ",\"pid\":1,\"tid\":" << buffer->thread_id << ",\"ts\":" << timestamp(event.begin) << ",\"dur\":" << (event.end - event.begin) / ticks_per_us
+				<< ",\"args\":{";
+			for (size_t i = 0; i < event.arg_count; i++) {
+				out << (i ? "," : "") << '"' << event.args[i].name << "\":";
+
+				if (event.args[i].duration)
+					out << event.args[i].value / ticks_per_us;
+				else
+					out << event.args[i].value;
+			}
+
+			if (!event.detail.empty()) {
+				std::string detail;
+				append_json_string(detail, event.detail);
+				out << (event.arg_count ? "," : "") << "\"detail\":" << detail;
+			}
+
+			out << "}}";
+		}
+	}
+
+	out << "\n]}\n";
+
+	return static_cast<bool>(out.flush());
+}
\ No newline at end of file
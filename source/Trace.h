@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRACE_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Appends text as a quoted JSON string. Also used for toyc's JSON diagnostics.
+void append_json_string(std::string& out, std::string_view text);
+
+// Chrome trace-event recorder (chrome://tracing, ui.perfetto.dev). Events go
+// to a buffer of the recording thread and are only merged by write(). While
+// tracing is off, every probe is a single relaxed load and a branch.
+class Trace {
+public:
+	static void start();
+	static bool enabled();
+
+	// Stops recording and writes every event recorded so far as JSON.
+	static bool write(const std::filesystem::path& path);
+
+	// Cheapest clock available: the time stamp counter on x86, nanoseconds
+	// elsewhere. write() converts ticks to microseconds.
+	static uint64_t ticks();
+
+	struct Arg {
+		const char* name = nullptr;
+		int64_t value = 0;
+		// Written in microseconds rather than as a plain number of ticks.
+		bool duration = false;
+	};
+
+	// name and category have to be string literals, detail is copied.
+	static void complete(const char* name, const char* category, uint64_t begin, uint64_t end, const Arg* args, size_t arg_count, std::string detail = {});
+
+private:
+	static inline std::atomic<bool> s_enabled = false;
+};
+
+// Records one complete event from construction to destruction.
+class TraceScope {
+public:
+	TraceScope(const char* name, const char* category);
+	~TraceScope();
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+	bool active() const;
+
+	void set_name(const char* name);
+	void set_detail(std::string detail);
+	void add_arg(const char* name, int64_t value);
+	void add_duration_arg(const char* name, uint64_t ticks);
+
+private:
+	static constexpr size_t MAX_ARGS = 4;
+
+	const char* m_name;
+	const char* m_category;
+	uint64_t m_begin = 0;
+	bool m_active;
+	std::string m_detail;
+	Trace::Arg m_args[MAX_ARGS];
+	size_t m_arg_count = 0;
+};
+
+inline bool Trace::enabled() {
+	return s_enabled.load(std::memory_order_relaxed);
+}
+
+inline uint64_t Trace::ticks() {
+#ifdef TRACE_TSC
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline TraceScope::TraceScope(const char* name, const char* category)
+	: m_name(name), m_category(category), m_active(Trace::enabled()) {
+	if (m_active)
+		m_begin = Trace::ticks();
+}
+
+inline TraceScope::~TraceScope() {
+	if (m_active)
+		Trace::complete(m_name, m_category, m_begin, Trace::ticks(), m_args, m_arg_count, std::move(m_detail));
+}
+
+inline bool TraceScope::active() const {
+	return m_active;
+}
+
+inline void TraceScope::set_name(const char* name) {
+	m_name = name;
+}
+
+inline void TraceScope::set_detail(std::string detail) {
+	if (m_active)
+		m_detail = std::move(detail);
+}
+
+inline void TraceScope::add_arg(const char* name, int64_t value) {
+	if (m_active && m_arg_count < MAX_ARGS)
+		m_args[m_arg_count++] = { name, value };
+}
+
+inline void TraceScope::add_duration_arg(const char* name, uint64_t ticks) {
+	if (m_active && m_arg_count < MAX_ARGS)
+		m_args[m_arg_count++] = { name, static_cast<int64_t>(ticks), true };
+}
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "TypeChecker.h"
+
+static bool is_arithmetic(BinaryOp op) {
+	return op == BinaryOp::PLUS || op == BinaryOp::MINUS || op == BinaryOp::MULTIPLY || op == BinaryOp::DIVIDE;
+}
+
+TypeChecker::TypeChecker(AstContext& context)
+	: m_context(context) {}
+
+TranslationUnit* TypeChecker::check(TranslationUnit& unit, const NameResolver& resolver) {
+	m_resolver = &resolver;
+	m_errors.clear();
+	m_cast_count = 0;
+	m_function = nullptr;
+
+	size_t base = m_statements.size();
+	bool changed = check_statements(unit.statements());
+
+	TranslationUnit* checked = &unit;
+	if (changed)
+		checked = m_context.create<TranslationUnit>(m_context.make_list(m_statements.data() + base, m_statements.size() - base));
+	m_statements.resize(base);
+
+	return m_errors.empty() ? checked : nullptr;
+}
+
+const std::vector<Diagnostic>& TypeChecker::errors() const {
+	return m_errors;
+}
+
+size_t TypeChecker::cast_count() const {
+	return m_cast_count;
+}
+
+// The tree has no positions, so errors name the function they are in instead.
+void TypeChecker::error(std::string message) {
+	if (m_function)
+		message += " in function '" + std::string(m_function->id()) + '\'';
+
+	m_errors.push_back({ {}, std::move(message) });
+}
+
+Statement* TypeChecker::check_statement(Statement* stmt) {
+	if (!stmt)
+		return nullptr;
+
+	switch (stmt->kind()) {
+	case NodeKind::COMPOUND_STATEMENT: {
+		auto compound = static_cast<CompoundStatement*>(stmt);
+		size_t base = m_statements.size();
+
+		if (check_statements(compound->statements()))
+			stmt = m_context.create<CompoundStatement>(m_context.make_list(m_statements.data() + base, m_statements.size() - base));
+		m_statements.resize(base);
+
+		return stmt;
+	}
+	case NodeKind::VARIABLE_DECLARATION:
+		return check_variable_declaration(static_cast<VariableDeclaration*>(stmt));
+	case NodeKind::FUNCTION_DECLARATION:
+		return check_function(static_cast<FunctionDeclaration*>(stmt));
+	case NodeKind::IF_STATEMENT: {
+		auto if_stmt = static_cast<IfStatement*>(stmt);
+		Expression* condition = check_operand(if_stmt->condition(), Type::BOOL);
+		Statement* body = check_statement(if_stmt->statement());
+
+		if (condition == if_stmt->condition() && body == if_stmt->statement())
+			return stmt;
+
+		return m_context.create<IfStatement>(condition, body);
+	}
+	case NodeKind::FOR_STATEMENT: {
+		auto for_stmt = static_cast<ForStatement*>(stmt);
+		VariableDeclaration* declaration = for_stmt->variable_declaration() ? check_variable_declaration(for_stmt->variable_declaration()) : nullptr;
+		Expression* condition = for_stmt->condition_expr() ? check_operand(for_stmt->condition_expr(), Type::BOOL) : nullptr;
+		Expression* loop = for_stmt->loop_expr() ? check_expression(for_stmt->loop_expr()) : nullptr;
+		Statement* body = check_statement(for_stmt->statement());
+
+		if (declaration == for_stmt->variable_declaration() && condition == for_stmt->condition_expr() &&
+			loop == for_stmt->loop_expr() && body == for_stmt->statement())
+			return stmt;
+
+		return m_context.create<ForStatement>(declaration, condition, loop, body);
+	}
+	case NodeKind::WHILE_STATEMENT: {
+		auto while_stmt = static_cast<WhileStatement*>(stmt);
+		Expression* condition = check_operand(while_stmt->condition_expr(), Type::BOOL);
+		Statement* body = check_statement(while_stmt->statement());
+
+		if (condition == while_stmt->condition_expr() && body == while_stmt->statement())
+			return stmt;
+
+		return m_context.create<WhileStatement>(condition, body);
+	}
+	case NodeKind::RETURN_STATEMENT:
+		return check_return_statement(static_cast<ReturnStatement*>(stmt));
+	default:
+		// A call to a function without a return type is fine on its own.
+		return check_expression(static_cast<Expression*>(stmt));
+	}
+}
+
+// Appends the checked statements to m_statements; returns whether any of
+// them changed.
+bool TypeChecker::check_statements(AstList<Statement*> stmts) {
+	bool changed = false;
+
+	for (Statement* stmt : stmts) {
+		Statement* checked = check_statement(stmt);
+
+		m_statements.push_back(checked);
+		changed |= checked != stmt;
+	}
+
+	return changed;
+}
+
+FunctionDeclaration* TypeChecker::check_function(FunctionDeclaration* declaration) {
+	const FunctionDeclaration* function = m_function;
+	m_function = declaration;
+
+	CompoundStatement* body = declaration->statement();
+	size_t base = m_statements.size();
+
+	if (body && check_statements(body->statements()))
+		body = m_context.create<CompoundStatement>(m_context.make_list(m_statements.data() + base, m_statements.size() - base));
+	m_statements.resize(base);
+
+	m_function = function;
+
+	if (body == declaration->statement())
+		return declaration;
+
+	auto checked = m_context.create<FunctionDeclaration>(declaration->return_type(), declaration->id(), declaration->parameters(), body);
+	checked->set_index(declaration->index());
+
+	return checked;
+}
+
+VariableDeclaration* TypeChecker::check_variable_declaration(VariableDeclaration* declaration) {
+	if (!declaration->initial_value())
+		return declaration;
+
+	Expression* initial_value = check_operand(declaration->initial_value(), declaration->type());
+	if (initial_value == declaration->initial_value())
+		return declaration;
+
+	auto checked = m_context.create<VariableDeclaration>(declaration->type(), declaration->id(), initial_value);
+	checked->bind(declaration->binding());
+	if (declaration->assigned())
+		checked->set_assigned();
+
+	return checked;
+}
+
+Statement* TypeChecker::check_return_statement(ReturnStatement* stmt) {
+	Expression* value = stmt->return_expr();
+
+	if (!m_function) {
+		error("'return' outside of a function");
+		return stmt;
+	}
+
+	Type return_type = m_function->return_type();
+
+	if (!value) {
+		if (return_type != Type::VOID)
+			error("'return' without a value");
+		return stmt;
+	}
+
+	if (return_type == Type::VOID) {
+		error("'return' with a value in a function without a return type");
+		return stmt;
+	}
+
+	value = check_operand(value, return_type);
+
+	return value == stmt->return_expr() ? stmt : m_context.create<ReturnStatement>(value);
+}
+
+Expression* TypeChecker::check_expression(Expression* expr) {
+	if (!expr) {
+		error("Expected expression");
+		return nullptr;
+	}
+
+	switch (expr->kind()) {
+	case NodeKind::ID_ATOM: {
+		auto id = static_cast<IdAtom*>(expr);
+		id->set_type(id->binding().type);
+		return expr;
+	}
+	case NodeKind::FUNC_CALL_ATOM:
+		return check_call(static_cast<FuncCallAtom*>(expr));
+	case NodeKind::UNARY_EXPRESSION:
+		return check_unary_expression(static_cast<UnaryExpression*>(expr));
+	case NodeKind::BINARY_EXPRESSION: {
+		auto binary = static_cast<BinaryExpression*>(expr);
+		if (binary->op() == BinaryOp::ASSIGN)
+			return check_binary_expression(binary, nullptr);
+
+		// Left to right down a chain of left operands, see push_left_chain().
+		size_t base = m_chain.size();
+		Expression* left = check_expression(push_left_chain(binary, m_chain));
+
+		while (m_chain.size() > base) {
+			binary = m_chain.back();
+			m_chain.pop_back();
+			left = check_binary_expression(binary, left);
+		}
+
+		return left;
+	}
+	default:
+		// Literals are typed when they are created.
+		return expr;
+	}
+}
+
+// left is the checked left operand, or nullptr for '=', whose left side is
+// checked here.
+Expression* TypeChecker::check_binary_expression(BinaryExpression* expr, Expression* left) {
+	Expression* right;
+	Type type;
+
+	switch (expr->op()) {
+	case BinaryOp::ASSIGN: {
+		if (!expr->left() || expr->left()->kind() != NodeKind::ID_ATOM) {
+			error("Left side of '=' is not a variable");
+			return nullptr;
+		}
+
+		left = check_expression(expr->left());
+		type = left->type();
+		right = check_operand(expr->right(), type);
+		break;
+	}
+	case BinaryOp::COMA:
+		right = check_expression(expr->right());
+		type = right ? right->type() : Type::VOID;
+		break;
+	case BinaryOp::LOGICAL_OR:
+	case BinaryOp::LOGICAL_AND:
+		left = cast(left, Type::BOOL);
+		right = check_operand(expr->right(), Type::BOOL);
+		type = Type::BOOL;
+		break;
+	default: {
+		right = check_expression(expr->right());
+
+		// bool operands are compared and computed with as ints.
+		bool floating = (left && left->type() == Type::FLOAT) || (right && right->type() == Type::FLOAT);
+		Type operand_type = floating ? Type::FLOAT : Type::INT;
+
+		left = cast(left, operand_type);
+		right = cast(right, operand_type);
+		type = is_arithmetic(expr->op()) ? operand_type : Type::BOOL;
+		break;
+	}
+	}
+
+	if (left != expr->left() || right != expr->right())
+		expr = m_context.create<BinaryExpression>(expr->op(), left, right);
+	expr->set_type(type);
+
+	return expr;
+}
+
+Expression* TypeChecker::check_unary_expression(UnaryExpression* expr) {
+	// A cast already has the type it converts to.
+	if (expr->op() == UnaryOp::CAST) {
+		Expression* operand = check_expression(expr->expr());
+		if (operand == expr->expr())
+			return expr;
+
+		auto checked = m_context.create<UnaryExpression>(UnaryOp::CAST, operand);
+		checked->set_type(expr->type());
+		return checked;
+	}
+
+	const char* name = expr->op() == UnaryOp::PRE_INCREMENT ? "'++'" : "'--'";
+
+	if (!expr->expr() || expr->expr()->kind() != NodeKind::ID_ATOM) {
+		error(std::string("Operand of ") + name + " is not a variable");
+		return nullptr;
+	}
+
+	Type type = check_expression(expr->expr())->type();
+
+	if (type != Type::INT && type != Type::FLOAT)
+		error(std::string("Operand of ") + name + " is not an int or float variable");
+
+	expr->set_type(type);
+
+	return expr;
+}
+
+Expression* TypeChecker::check_call(FuncCallAtom* call) {
+	const FunctionDeclaration& callee = *m_resolver->functions()[call->binding().slot];
+	AstList<TypedId> parameters = callee.parameters();
+
+	if (call->arguments().size() != parameters.size()) {
+		error("Function '" + std::string(call->id()) + "' takes " + std::to_string(parameters.size()) +
+			(parameters.size() == 1 ? " argument, " : " arguments, ") + std::to_string(call->arguments().size()) + " given");
+		call->set_type(callee.return_type());
+		return call;
+	}
+
+	size_t base = m_expressions.size();
+	bool changed = false;
+
+	for (uint32_t i = 0; i < parameters.size(); i++) {
+		Expression* argument = check_operand(call->arguments()[i], parameters[i].type);
+
+		m_expressions.push_back(argument);
+		changed |= argument != call->arguments()[i];
+	}
+
+	if (changed) {
+		auto checked = m_context.create<FuncCallAtom>(call->id(), m_context.make_list(m_expressions.data() + base, m_expressions.size() - base));
+		checked->bind(call->binding());
+		call = checked;
+	}
+	m_expressions.resize(base);
+
+	call->set_type(callee.return_type());
+
+	return call;
+}
+
+Expression* TypeChecker::check_operand(Expression* expr, Type type) {
+	return cast(check_expression(expr), type);
+}
+
+Expression* TypeChecker::cast(Expression* expr, Type type) {
+	if (!expr || expr->type() == type)
+		return expr;
+
+	if (expr->type() == Type::VOID) {
+		error("Function without a return type used as a value");
+		return expr;
+	}
+
+	auto cast = m_context.create<UnaryExpression>(UnaryOp::CAST, expr);
+	cast->set_type(type);
+	m_cast_count++;
+
+	return cast;
+}
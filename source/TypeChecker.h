@@ -0,0 +1,65 @@
+#pragma once
+
+#include "AstContext.h"
+#include "NameResolver.h"
+
+#include <vector>
+
+// Gives every expression of a resolved TranslationUnit its type and turns
+// every implicit conversion into a CAST node, so that the operands of an
+// operator, the arguments of a call and the value of an assignment, a
+// declaration or a return already have the type they are used as. Mixed
+// operands convert as in C: an arithmetic or comparison operator works on
+// floats if either operand is one and on ints otherwise, so bools become
+// ints, and conditions and the operands of '&&' and '||' become bools.
+//
+// Calls are checked against the callee's parameters and returns against the
+// function's return type. Like ConstantFolder, nodes that get a cast below
+// them are rebuilt in the context and the others are shared with the input.
+class TypeChecker {
+public:
+	TypeChecker(AstContext& context);
+
+	// Returns the typed unit, or nullptr with the reasons in errors() when an
+	// expression is used with a type it cannot have.
+	TranslationUnit* check(TranslationUnit& unit, const NameResolver& resolver);
+
+	const std::vector<Diagnostic>& errors() const;
+
+	// Casts that the last check() inserted.
+	size_t cast_count() const;
+
+private:
+	void error(std::string message);
+
+	Statement* check_statement(Statement* stmt);
+	bool check_statements(AstList<Statement*> stmts);
+	FunctionDeclaration* check_function(FunctionDeclaration* declaration);
+	VariableDeclaration* check_variable_declaration(VariableDeclaration* declaration);
+	Statement* check_return_statement(ReturnStatement* stmt);
+
+	// An expression whose error has been reported checks to nullptr, which
+	// cast() passes on, so the error does not cascade to its users.
+	Expression* check_expression(Expression* expr);
+	Expression* check_binary_expression(BinaryExpression* expr, Expression* left);
+	Expression* check_unary_expression(UnaryExpression* expr);
+	Expression* check_call(FuncCallAtom* call);
+	// Checks the expression and casts it to the type it is used as.
+	Expression* check_operand(Expression* expr, Type type);
+	Expression* cast(Expression* expr, Type type);
+
+private:
+	AstContext& m_context;
+	const NameResolver* m_resolver = nullptr;
+	std::vector<Diagnostic> m_errors;
+	size_t m_cast_count = 0;
+
+	// Children of the nodes being rebuilt, shared by all levels of the tree.
+	std::vector<Statement*> m_statements;
+	std::vector<Expression*> m_expressions;
+	// Operators of the chains being checked, see push_left_chain().
+	std::vector<BinaryExpression*> m_chain;
+
+	// nullptr in top-level code.
+	const FunctionDeclaration* m_function = nullptr;
+};
@@ -0,0 +1,258 @@
+#include "VirtualMachine.h"
+
+#include <algorithm>
+
+// GCC and Clang get a jump to the next handler at the end of every handler,
+// which predicts much better than the single jump of a switch; MSVC has no
+// computed goto and gets the switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define TOY_COMPUTED_GOTO 1
+#endif
+
+// int arithmetic wraps around instead of being undefined.
+static int32_t wrap(uint32_t value) {
+	return static_cast<int32_t>(value);
+}
+
+VirtualMachine::VirtualMachine(const BytecodeProgram& program, size_t stack_size)
+	: m_program(program), m_stack(stack_size), m_globals(program.global_count) {}
+
+bool VirtualMachine::run() {
+	std::fill(m_globals.begin(), m_globals.end(), Value{});
+	m_result = {};
+
+	Value ignored;
+	if (!execute(m_program.functions[m_program.entry], m_stack.data(), ignored))
+		return false;
+
+	if (m_program.main >= 0)
+		return execute(m_program.functions[m_program.main], m_stack.data(), m_result);
+
+	return true;
+}
+
+bool VirtualMachine::call(uint32_t function, const std::vector<Value>& arguments, Value& result) {
+	const BytecodeFunction& callee = m_program.functions[function];
+
+	if (arguments.size() != callee.parameters.size()) {
+		m_error = "wrong number of arguments for function '" + callee.name + '\'';
+		return false;
+	}
+
+	std::copy(arguments.begin(), arguments.end(), m_stack.begin());
+
+	return execute(callee, m_stack.data(), result);
+}
+
+Value VirtualMachine::result() const {
+	return m_result;
+}
+
+const std::string& VirtualMachine::error() const {
+	return m_error;
+}
+
+bool VirtualMachine::runtime_error(const BytecodeFunction& function, const char* message) {
+	m_error = std::string(message) + " in function '" + function.name + '\'';
+	m_frames.clear();
+
+	return false;
+}
+
+bool VirtualMachine::execute(const BytecodeFunction& entry, Value* r, Value& result) {
+	const BytecodeFunction* functions = m_program.functions.data();
+	const BytecodeFunction* function = &entry;
+	Value* globals = m_globals.data();
+	const Value* constants = m_program.constants.data();
+	const Value* stack_end = m_stack.data() + m_stack.size();
+	const Instruction* code = entry.code.data();
+	const Instruction* pc = code;
+	Instruction ins;
+
+	m_error.clear();
+	m_frames.clear();
+
+	if (r + entry.register_count > stack_end)
+		return runtime_error(entry, "stack overflow");
+
+#ifdef TOY_COMPUTED_GOTO
+	static const void* const handlers[] = {
+#define X(name) &&do_##name,
+		TOY_OPCODES(X)
+#undef X
+	};
+
+#define VM_CASE(name) do_##name:
+#define VM_NEXT() do { ins = *pc++; goto *handlers[static_cast<uint8_t>(ins.op)]; } while (false)
+
+	VM_NEXT();
+#else
+#define VM_CASE(name) case Opcode::name:
+#define VM_NEXT() continue
+
+	for (;;) {
+		ins = *pc++;
+
+		switch (ins.op) {
+#endif
+
+	VM_CASE(MOVE)
+		r[ins.a] = r[ins.b];
+		VM_NEXT();
+	VM_CASE(LOAD_INT)
+		r[ins.a].i = static_cast<int32_t>(ins.imm());
+		VM_NEXT();
+	VM_CASE(LOAD_CONST)
+		r[ins.a] = constants[ins.imm()];
+		VM_NEXT();
+	VM_CASE(LOAD_GLOBAL)
+		r[ins.a] = globals[ins.imm()];
+		VM_NEXT();
+	VM_CASE(STORE_GLOBAL)
+		globals[ins.imm()] = r[ins.a];
+		VM_NEXT();
+
+	VM_CASE(ADD_I)
+		r[ins.a].i = wrap(static_cast<uint32_t>(r[ins.b].i) + static_cast<uint32_t>(r[ins.c].i));
+		VM_NEXT();
+	VM_CASE(SUB_I)
+		r[ins.a].i = wrap(static_cast<uint32_t>(r[ins.b].i) - static_cast<uint32_t>(r[ins.c].i));
+		VM_NEXT();
+	VM_CASE(MUL_I)
+		r[ins.a].i = wrap(static_cast<uint32_t>(r[ins.b].i) * static_cast<uint32_t>(r[ins.c].i));
+		VM_NEXT();
+	VM_CASE(DIV_I) {
+		int32_t divisor = r[ins.c].i;
+
+		if (divisor == 0)
+			return runtime_error(*function, "division by zero");
+
+		// INT_MIN / -1 overflows like the other operators.
+		if (divisor == -1)
+			r[ins.a].i = wrap(0u - static_cast<uint32_t>(r[ins.b].i));
+		else
+			r[ins.a].i = r[ins.b].i / divisor;
+		VM_NEXT();
+	}
+
+	VM_CASE(ADD_F)
+		r[ins.a].f = r[ins.b].f + r[ins.c].f;
+		VM_NEXT();
+	VM_CASE(SUB_F)
+		r[ins.a].f = r[ins.b].f - r[ins.c].f;
+		VM_NEXT();
+	VM_CASE(MUL_F)
+		r[ins.a].f = r[ins.b].f * r[ins.c].f;
+		VM_NEXT();
+	VM_CASE(DIV_F)
+		r[ins.a].f = r[ins.b].f / r[ins.c].f;
+		VM_NEXT();
+
+	VM_CASE(EQ_I)
+		r[ins.a].i = r[ins.b].i == r[ins.c].i;
+		VM_NEXT();
+	VM_CASE(NE_I)
+		r[ins.a].i = r[ins.b].i != r[ins.c].i;
+		VM_NEXT();
+	VM_CASE(LT_I)
+		r[ins.a].i = r[ins.b].i < r[ins.c].i;
+		VM_NEXT();
+	VM_CASE(LE_I)
+		r[ins.a].i = r[ins.b].i <= r[ins.c].i;
+		VM_NEXT();
+	VM_CASE(EQ_F)
+		r[ins.a].i = r[ins.b].f == r[ins.c].f;
+		VM_NEXT();
+	VM_CASE(NE_F)
+		r[ins.a].i = r[ins.b].f != r[ins.c].f;
+		VM_NEXT();
+	VM_CASE(LT_F)
+		r[ins.a].i = r[ins.b].f < r[ins.c].f;
+		VM_NEXT();
+	VM_CASE(LE_F)
+		r[ins.a].i = r[ins.b].f <= r[ins.c].f;
+		VM_NEXT();
+
+	VM_CASE(INC_I)
+		r[ins.a].i = wrap(static_cast<uint32_t>(r[ins.a].i) + 1);
+		VM_NEXT();
+	VM_CASE(DEC_I)
+		r[ins.a].i = wrap(static_cast<uint32_t>(r[ins.a].i) - 1);
+		VM_NEXT();
+	VM_CASE(INC_F)
+		r[ins.a].f += 1;
+		VM_NEXT();
+	VM_CASE(DEC_F)
+		r[ins.a].f -= 1;
+		VM_NEXT();
+
+	VM_CASE(INT_TO_FLOAT)
+		r[ins.a].f = static_cast<float>(r[ins.b].i);
+		VM_NEXT();
+	VM_CASE(FLOAT_TO_INT)
+		r[ins.a].i = float_to_int(r[ins.b].f);
+		VM_NEXT();
+	VM_CASE(INT_TO_BOOL)
+		r[ins.a].i = r[ins.b].i != 0;
+		VM_NEXT();
+	VM_CASE(FLOAT_TO_BOOL)
+		r[ins.a].i = r[ins.b].f != 0;
+		VM_NEXT();
+
+	VM_CASE(JUMP)
+		pc = code + ins.imm();
+		VM_NEXT();
+	VM_CASE(JUMP_IF_FALSE)
+		if (!r[ins.a].i)
+			pc = code + ins.imm();
+		VM_NEXT();
+	VM_CASE(JUMP_IF_TRUE)
+		if (r[ins.a].i)
+			pc = code + ins.imm();
+		VM_NEXT();
+
+	VM_CASE(CALL) {
+		const BytecodeFunction& callee = functions[ins.imm()];
+		Value* registers = r + ins.a;
+
+		if (registers + callee.register_count > stack_end)
+			return runtime_error(callee, "stack overflow");
+
+		m_frames.push_back({ pc, r, function });
+
+		function = &callee;
+		code = callee.code.data();
+		pc = code;
+		r = registers;
+		VM_NEXT();
+	}
+	VM_CASE(RETURN_VOID)
+		ins.a = 0;
+		goto return_from_call;
+	VM_CASE(RETURN)
+	return_from_call: {
+		// The callee's first register is the caller's result register.
+		r[0] = r[ins.a];
+
+		if (m_frames.empty()) {
+			result = r[0];
+			return true;
+		}
+
+		const Frame& frame = m_frames.back();
+		pc = frame.pc;
+		r = frame.registers;
+		function = frame.function;
+		code = function->code.data();
+		m_frames.pop_back();
+		VM_NEXT();
+	}
+
+#ifndef TOY_COMPUTED_GOTO
+		}
+	}
+#endif
+
+#undef VM_CASE
+#undef VM_NEXT
+}
\ No newline at end of file
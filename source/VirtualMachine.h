@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Bytecode.h"
+
+#include <string>
+#include <vector>
+
+// Runs a BytecodeProgram. All frames share one register stack: a call's
+// arguments are already where the callee's first registers go.
+class VirtualMachine {
+public:
+	static constexpr size_t DEFAULT_STACK_SIZE = 1024 * 1024;
+
+	VirtualMachine(const BytecodeProgram& program, size_t stack_size = DEFAULT_STACK_SIZE);
+
+	// Runs the top-level statements, then main() if there is one. Returns
+	// false on a runtime error, described by error().
+	bool run();
+
+	// Calls a function with arguments of its parameter types.
+	bool call(uint32_t function, const std::vector<Value>& arguments, Value& result);
+
+	// What main() returned, zero without a main().
+	Value result() const;
+	const std::string& error() const;
+
+private:
+	struct Frame {
+		const Instruction* pc;
+		Value* registers;
+		const BytecodeFunction* function;
+	};
+
+	bool execute(const BytecodeFunction& function, Value* registers, Value& result);
+	bool runtime_error(const BytecodeFunction& function, const char* message);
+
+private:
+	const BytecodeProgram& m_program;
+	std::vector<Value> m_stack;
+	std::vector<Value> m_globals;
+	std::vector<Frame> m_frames;
+	Value m_result{};
+	std::string m_error;
+};
\ No newline at end of file
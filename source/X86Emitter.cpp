@@ -0,0 +1,287 @@
+#include "X86Emitter.h"
+
+#include <cstring>
+
+static uint8_t code(Register reg) {
+	return static_cast<uint8_t>(reg);
+}
+
+static uint8_t code(Xmm reg) {
+	return static_cast<uint8_t>(reg);
+}
+
+X86Emitter::Label X86Emitter::create_label() {
+	m_labels.push_back(UINT32_MAX);
+	return static_cast<Label>(m_labels.size() - 1);
+}
+
+void X86Emitter::bind(Label label) {
+	m_labels[label] = size();
+}
+
+uint32_t X86Emitter::offset(Label label) const {
+	return m_labels[label];
+}
+
+uint32_t X86Emitter::size() const {
+	return static_cast<uint32_t>(m_code.size());
+}
+
+std::vector<uint8_t> X86Emitter::finish() {
+	for (const Fixup& fixup : m_fixups) {
+		int32_t relative = static_cast<int32_t>(m_labels[fixup.target] - (fixup.position + 4));
+		std::memcpy(m_code.data() + fixup.position, &relative, sizeof(relative));
+	}
+
+	m_fixups.clear();
+
+	return std::move(m_code);
+}
+
+void X86Emitter::byte(uint8_t value) {
+	m_code.push_back(value);
+}
+
+void X86Emitter::dword(uint32_t value) {
+	for (int i = 0; i < 4; i++)
+		byte(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// Without a REX prefix, byte registers 4 to 7 are AH to BH instead of SPL to DIL.
+void X86Emitter::rex(bool wide, uint8_t reg, uint8_t base, bool force) {
+	uint8_t value = 0x40 | (wide ? 8 : 0) | ((reg >> 3) & 1) << 2 | ((base >> 3) & 1);
+
+	if (value != 0x40 || force)
+		byte(value);
+}
+
+void X86Emitter::modrm(uint8_t reg, Memory memory) {
+	uint8_t base = code(memory.base);
+
+	byte(0x80 | (reg & 7) << 3 | (base & 7));
+	// RSP and R12 as a base need a SIB byte.
+	if ((base & 7) == 4)
+		byte(0x24);
+	dword(static_cast<uint32_t>(memory.disp));
+}
+
+void X86Emitter::modrm(uint8_t reg, uint8_t rm) {
+	byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+void X86Emitter::op_memory(uint8_t prefix, bool wide, uint32_t opcode, int opcode_size, uint8_t reg, Memory memory) {
+	if (prefix)
+		byte(prefix);
+	rex(wide, reg, code(memory.base));
+	for (int i = opcode_size - 1; i >= 0; i--)
+		byte(static_cast<uint8_t>(opcode >> (8 * i)));
+	modrm(reg, memory);
+}
+
+void X86Emitter::op_register(uint8_t prefix, bool wide, uint32_t opcode, int opcode_size, uint8_t reg, uint8_t rm, bool force_rex) {
+	if (prefix)
+		byte(prefix);
+	rex(wide, reg, rm, force_rex);
+	for (int i = opcode_size - 1; i >= 0; i--)
+		byte(static_cast<uint8_t>(opcode >> (8 * i)));
+	modrm(reg, rm);
+}
+
+void X86Emitter::branch(uint32_t opcode, int opcode_size, Label target) {
+	for (int i = opcode_size - 1; i >= 0; i--)
+		byte(static_cast<uint8_t>(opcode >> (8 * i)));
+
+	m_fixups.push_back({ size(), target });
+	dword(0);
+}
+
+void X86Emitter::mov(Register dst, Memory src) {
+	op_memory(0, false, 0x8B, 1, code(dst), src);
+}
+
+void X86Emitter::mov(Memory dst, Register src) {
+	op_memory(0, false, 0x89, 1, code(src), dst);
+}
+
+void X86Emitter::mov(Memory dst, int32_t imm) {
+	op_memory(0, false, 0xC7, 1, 0, dst);
+	dword(static_cast<uint32_t>(imm));
+}
+
+void X86Emitter::mov(Register dst, Register src) {
+	op_register(0, false, 0x89, 1, code(src), code(dst));
+}
+
+void X86Emitter::mov(Register dst, int32_t imm) {
+	rex(false, 0, code(dst));
+	byte(0xB8 + (code(dst) & 7));
+	dword(static_cast<uint32_t>(imm));
+}
+
+void X86Emitter::mov64(Register dst, uint64_t imm) {
+	rex(true, 0, code(dst));
+	byte(0xB8 + (code(dst) & 7));
+	dword(static_cast<uint32_t>(imm));
+	dword(static_cast<uint32_t>(imm >> 32));
+}
+
+void X86Emitter::mov64(Register dst, Register src) {
+	op_register(0, true, 0x89, 1, code(src), code(dst));
+}
+
+void X86Emitter::mov64(Memory dst, Register src) {
+	op_memory(0, true, 0x89, 1, code(src), dst);
+}
+
+void X86Emitter::movzx_byte(Register dst, Register src) {
+	op_register(0, false, 0x0FB6, 2, code(dst), code(src), code(src) >= 4);
+}
+
+void X86Emitter::movzx_byte(Register dst, Memory src) {
+	op_memory(0, false, 0x0FB6, 2, code(dst), src);
+}
+
+void X86Emitter::lea64(Register dst, Memory src) {
+	op_memory(0, true, 0x8D, 1, code(dst), src);
+}
+
+void X86Emitter::add(Register dst, Memory src) {
+	op_memory(0, false, 0x03, 1, code(dst), src);
+}
+
+void X86Emitter::sub(Register dst, Memory src) {
+	op_memory(0, false, 0x2B, 1, code(dst), src);
+}
+
+void X86Emitter::imul(Register dst, Memory src) {
+	op_memory(0, false, 0x0FAF, 2, code(dst), src);
+}
+
+void X86Emitter::cmp(Register dst, Memory src) {
+	op_memory(0, false, 0x3B, 1, code(dst), src);
+}
+
+void X86Emitter::cmp(Register dst, int32_t imm) {
+	op_register(0, false, 0x81, 1, 7, code(dst));
+	dword(static_cast<uint32_t>(imm));
+}
+
+void X86Emitter::cmp64(Register dst, Memory src) {
+	op_memory(0, true, 0x3B, 1, code(dst), src);
+}
+
+void X86Emitter::test(Register a, Register b) {
+	op_register(0, false, 0x85, 1, code(b), code(a));
+}
+
+void X86Emitter::or_byte(Register dst, Register src) {
+	op_register(0, false, 0x08, 1, code(src), code(dst), code(src) >= 4 || code(dst) >= 4);
+}
+
+void X86Emitter::and_byte(Register dst, Register src) {
+	op_register(0, false, 0x20, 1, code(src), code(dst), code(src) >= 4 || code(dst) >= 4);
+}
+
+void X86Emitter::neg(Register dst) {
+	op_register(0, false, 0xF7, 1, 3, code(dst));
+}
+
+void X86Emitter::dec(Register dst) {
+	op_register(0, false, 0xFF, 1, 1, code(dst));
+}
+
+void X86Emitter::cdq() {
+	byte(0x99);
+}
+
+void X86Emitter::idiv(Register divisor) {
+	op_register(0, false, 0xF7, 1, 7, code(divisor));
+}
+
+void X86Emitter::setcc(Condition condition, Register dst) {
+	op_register(0, false, 0x0F90 + static_cast<uint32_t>(condition), 2, 0, code(dst), code(dst) >= 4);
+}
+
+void X86Emitter::add64(Register dst, int32_t imm) {
+	op_register(0, true, 0x81, 1, 0, code(dst));
+	dword(static_cast<uint32_t>(imm));
+}
+
+void X86Emitter::sub64(Register dst, int32_t imm) {
+	op_register(0, true, 0x81, 1, 5, code(dst));
+	dword(static_cast<uint32_t>(imm));
+}
+
+void X86Emitter::movss(Xmm dst, Memory src) {
+	op_memory(0xF3, false, 0x0F10, 2, code(dst), src);
+}
+
+void X86Emitter::movss(Memory dst, Xmm src) {
+	op_memory(0xF3, false, 0x0F11, 2, code(src), dst);
+}
+
+void X86Emitter::addss(Xmm dst, Memory src) {
+	op_memory(0xF3, false, 0x0F58, 2, code(dst), src);
+}
+
+void X86Emitter::subss(Xmm dst, Memory src) {
+	op_memory(0xF3, false, 0x0F5C, 2, code(dst), src);
+}
+
+void X86Emitter::mulss(Xmm dst, Memory src) {
+	op_memory(0xF3, false, 0x0F59, 2, code(dst), src);
+}
+
+void X86Emitter::divss(Xmm dst, Memory src) {
+	op_memory(0xF3, false, 0x0F5E, 2, code(dst), src);
+}
+
+void X86Emitter::ucomiss(Xmm a, Memory b) {
+	op_memory(0, false, 0x0F2E, 2, code(a), b);
+}
+
+void X86Emitter::ucomiss(Xmm a, Xmm b) {
+	op_register(0, false, 0x0F2E, 2, code(a), code(b));
+}
+
+void X86Emitter::xorps(Xmm dst, Xmm src) {
+	op_register(0, false, 0x0F57, 2, code(dst), code(src));
+}
+
+void X86Emitter::cvtsi2ss(Xmm dst, Memory src) {
+	op_memory(0xF3, false, 0x0F2A, 2, code(dst), src);
+}
+
+void X86Emitter::cvttss2si(Register dst, Xmm src) {
+	op_register(0xF3, false, 0x0F2C, 2, code(dst), code(src));
+}
+
+void X86Emitter::push(Register reg) {
+	rex(false, 0, code(reg));
+	byte(0x50 + (code(reg) & 7));
+}
+
+void X86Emitter::pop(Register reg) {
+	rex(false, 0, code(reg));
+	byte(0x58 + (code(reg) & 7));
+}
+
+void X86Emitter::jump(Label target) {
+	branch(0xE9, 1, target);
+}
+
+void X86Emitter::jump_if(Condition condition, Label target) {
+	branch(0x0F80 + static_cast<uint32_t>(condition), 2, target);
+}
+
+void X86Emitter::call(Label target) {
+	branch(0xE8, 1, target);
+}
+
+void X86Emitter::call(Register target) {
+	op_register(0, false, 0xFF, 1, 2, code(target));
+}
+
+void X86Emitter::ret() {
+	byte(0xC3);
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum class Register : uint8_t {
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum class Xmm : uint8_t {
+	XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7
+};
+
+// Condition codes, in the order of their encodings.
+enum class Condition : uint8_t {
+	OVERFLOW, NO_OVERFLOW, BELOW, ABOVE_EQUAL, EQUAL, NOT_EQUAL, BELOW_EQUAL, ABOVE,
+	SIGN, NO_SIGN, PARITY, NO_PARITY, LESS, GREATER_EQUAL, LESS_EQUAL, GREATER
+};
+
+// [base + disp]
+struct Memory {
+	Register base;
+	int32_t disp = 0;
+};
+
+// Encodes the x86-64 instructions the JIT needs into a byte buffer. Operands
+// are 32-bit unless the name says otherwise, and memory operands always take a
+// 32-bit displacement. Jumps and calls go to labels, which are patched by
+// finish().
+class X86Emitter {
+public:
+	using Label = uint32_t;
+
+	Label create_label();
+	void bind(Label label);
+	// Offset of a bound label in the code.
+	uint32_t offset(Label label) const;
+	uint32_t size() const;
+
+	// Resolves jumps and calls and hands over the code.
+	std::vector<uint8_t> finish();
+
+	void mov(Register dst, Memory src);
+	void mov(Memory dst, Register src);
+	void mov(Memory dst, int32_t imm);
+	void mov(Register dst, Register src);
+	void mov(Register dst, int32_t imm);
+	void mov64(Register dst, uint64_t imm);
+	void mov64(Register dst, Register src);
+	void mov64(Memory dst, Register src);
+	void movzx_byte(Register dst, Register src);
+	void movzx_byte(Register dst, Memory src);
+	void lea64(Register dst, Memory src);
+
+	void add(Register dst, Memory src);
+	void sub(Register dst, Memory src);
+	void imul(Register dst, Memory src);
+	void cmp(Register dst, Memory src);
+	void cmp(Register dst, int32_t imm);
+	void cmp64(Register dst, Memory src);
+	void test(Register a, Register b);
+	void or_byte(Register dst, Register src);
+	void and_byte(Register dst, Register src);
+	void neg(Register dst);
+	void dec(Register dst);
+	void cdq();
+	void idiv(Register divisor);
+	void setcc(Condition condition, Register dst);
+	void add64(Register dst, int32_t imm);
+	void sub64(Register dst, int32_t imm);
+
+	void movss(Xmm dst, Memory src);
+	void movss(Memory dst, Xmm src);
+	void addss(Xmm dst, Memory src);
+	void subss(Xmm dst, Memory src);
+	void mulss(Xmm dst, Memory src);
+	void divss(Xmm dst, Memory src);
+	void ucomiss(Xmm a, Memory b);
+	void ucomiss(Xmm a, Xmm b);
+	void xorps(Xmm dst, Xmm src);
+	void cvtsi2ss(Xmm dst, Memory src);
+	void cvttss2si(Register dst, Xmm src);
+
+	void push(Register reg);
+	void pop(Register reg);
+	void jump(Label target);
+	void jump_if(Condition condition, Label target);
+	void call(Label target);
+	void call(Register target);
+	void ret();
+
+private:
+	struct Fixup {
+		// Where the rel32 is, relative to the end of the instruction.
+		uint32_t position;
+		Label target;
+	};
+
+	void byte(uint8_t value);
+	void dword(uint32_t value);
+	void rex(bool wide, uint8_t reg, uint8_t base, bool force = false);
+	void modrm(uint8_t reg, Memory memory);
+	void modrm(uint8_t reg, uint8_t rm);
+	// Opcode bytes of up to three, after an optional prefix and REX.
+	void op_memory(uint8_t prefix, bool wide, uint32_t opcode, int opcode_size, uint8_t reg, Memory memory);
+	void op_register(uint8_t prefix, bool wide, uint32_t opcode, int opcode_size, uint8_t reg, uint8_t rm, bool force_rex = false);
+	void branch(uint32_t opcode, int opcode_size, Label target);
+
+private:
+	std::vector<uint8_t> m_code;
+	// Offsets of bound labels, UINT32_MAX until bound.
+	std::vector<uint32_t> m_labels;
+	std::vector<Fixup> m_fixups;
+};
\ No newline at end of file
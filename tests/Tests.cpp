@@ -0,0 +1,847 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AstCache.h"
+#include "BytecodeCompiler.h"
+#include "ConstantFolder.h"
+#include "FlatAst.h"
+#include "IncrementalParser.h"
+#include "IrBuilder.h"
+#include "IrPasses.h"
+#include "Jit.h"
+#include "NameResolver.h"
+#include "ParallelParser.h"
+#include "ProgramGenerator.h"
+#include "ScanKernels.h"
+#include "SourceBuffer.h"
+#include "TokenStream.h"
+#include "Tokenizer.h"
+#include "TypeChecker.h"
+#include "VirtualMachine.h"
+
+// A failed check prints what went wrong and fails its test, which goes on to
+// report the rest; a test only stops early where going on makes no sense.
+struct TestContext {
+	std::string name;
+	size_t failures = 0;
+
+	void check(bool condition, const std::string& message) {
+		if (condition)
+			return;
+
+		// A broken kernel fails thousands of inputs the same way.
+		if (failures < 10)
+			std::cerr << "  " << name << ": " << message << '\n';
+		failures++;
+	}
+};
+
+struct Test {
+	const char* name;
+	void (*run)(TestContext& test);
+};
+
+static std::string escape(std::string_view text) {
+	static const char digits[] = "0123456789abcdef";
+	std::string out;
+
+	for (char c : text) {
+		unsigned char byte = static_cast<unsigned char>(c);
+
+		if (byte >= 0x20 && byte < 0x7f && c != '\\')
+			out += c;
+		else
+			out += std::string("\\x") + digits[byte >> 4] + digits[byte & 15];
+	}
+
+	return out;
+}
+
+// Text made of runs of every character class the kernels tell apart, UTF-8
+// and stray high bytes among them, with runs long enough to cross several
+// vectors and to end at every offset within one.
+static std::string random_scan_input(std::mt19937_64& random) {
+	static const char* const pieces[] = {
+		" ", "\t", "\n", "\r\n", "\v\f", "_", "a", "Z", "z9", "0", "7", "3.25", "//", "/", "+", "{", "}", "(", ";",
+		"\xc3\xa9", "\xe2\x82\xac", "\x80", "\xff", "\x7f", "\x01", "@", "`", "[", "{|"
+	};
+	static const char run_chars[] = { ' ', '\n', '\t', 'x', '_', '5', '/', '\xc3' };
+
+	std::string text;
+	size_t pieces_count = random() % 40;
+
+	for (size_t i = 0; i < pieces_count; i++) {
+		if (random() % 4 == 0)
+			text.append(random() % 100, run_chars[random() % sizeof(run_chars)]);
+		else
+			text += pieces[random() % (sizeof(pieces) / sizeof(pieces[0]))];
+	}
+
+	return text;
+}
+
+// The plain loops the kernels replaced, spelled out independently of the
+// classification helpers they share.
+static const char* reference_skip(const char* p, const char* end, bool (*in_run)(unsigned char c)) {
+	while (p != end && in_run(static_cast<unsigned char>(*p)))
+		p++;
+
+	return p;
+}
+
+static void test_scan_kernels(TestContext& test) {
+	auto white_space = [](unsigned char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r'; };
+	auto name = [](unsigned char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; };
+	auto digit = [](unsigned char c) { return c >= '0' && c <= '9'; };
+	auto line = [](unsigned char c) { return c != '\n'; };
+
+	std::mt19937_64 random(2);
+
+	for (int input = 0; input < 4000; input++) {
+		std::string text = random_scan_input(random);
+		SourceBuffer source{ std::string_view(text) };
+		const char* end = source.end();
+
+		std::vector<uint32_t> line_starts;
+		for (size_t i = 0; i < text.size(); i++) {
+			if (text[i] == '\n')
+				line_starts.push_back(static_cast<uint32_t>(i + 1));
+		}
+
+		for (ScanKernel kernel : { ScanKernel::SCALAR, ScanKernel::SSE2, ScanKernel::AVX2 }) {
+			if (!is_scan_kernel_supported(kernel))
+				continue;
+
+			const ScanKernels& scan = get_scan_kernels(kernel);
+			std::string where = "kernel " + std::to_string(static_cast<int>(kernel)) + " on \"" + escape(text) + "\" at ";
+
+			for (const char* p = source.begin(); p <= end; p++) {
+				size_t offset = p - source.begin();
+
+				test.check(scan.skip_white_space(p, end) == reference_skip(p, end, white_space), "skip_white_space, " + where + std::to_string(offset));
+				test.check(scan.skip_name(p, end) == reference_skip(p, end, name), "skip_name, " + where + std::to_string(offset));
+				test.check(scan.skip_digits(p, end) == reference_skip(p, end, digit), "skip_digits, " + where + std::to_string(offset));
+				test.check(scan.skip_line(p, end) == reference_skip(p, end, line), "skip_line, " + where + std::to_string(offset));
+			}
+
+			std::vector<uint32_t> starts(text.size() + 1);
+			starts.resize(scan.find_line_starts(source.begin(), end, source.begin(), starts.data()) - starts.data());
+
+			test.check(scan.count_newlines(source.begin(), end) == line_starts.size(), "count_newlines, " + where + '0');
+			test.check(starts == line_starts, "find_line_starts, " + where + '0');
+		}
+
+		// Whole token streams, so that the way the Tokenizer combines the
+		// kernels is covered too.
+		std::vector<std::string> streams;
+		for (ScanKernel kernel : { ScanKernel::SCALAR, ScanKernel::SSE2, ScanKernel::AVX2 }) {
+			if (!is_scan_kernel_supported(kernel))
+				continue;
+
+			Tokenizer tokenizer(source, kernel);
+			std::string stream;
+
+			for (;; tokenizer.next()) {
+				const Token& token = tokenizer.current();
+				stream += std::to_string(static_cast<int>(token.kind())) + ':' + std::to_string(token.offset()) + ':' +
+					std::to_string(token.length()) + ' ';
+
+				if (token.kind() == TokenKind::EOS)
+					break;
+			}
+
+			streams.push_back(std::move(stream));
+		}
+
+		for (const std::string& stream : streams)
+			test.check(stream == streams[0], "token streams differ between kernels on \"" + escape(text) + '"');
+	}
+}
+
+// Pieces of programs, many of them only half of a construct, so that edits
+// make and break statements and split tokens.
+static const char* const PROGRAM_FRAGMENTS[] = {
+	"int ", "float ", "bool ", "x", "y1", "f", "1", "25", "2.5", "true", "return ", "if ", "while ", "for ", "def ",
+	"->", "(", ")", "{", "}", ";", ",", "=", "+", "*", "<", "==", "&&", "++", "!", " ", "\n", "// note\n", "x = 1;\n",
+	"def f(int a) -> int { return a; }\n", "while (x < 3) x++;\n"
+};
+
+static std::string random_fragments(std::mt19937_64& random, size_t count) {
+	std::string text;
+
+	for (size_t i = 0; i < count; i++)
+		text += PROGRAM_FRAGMENTS[random() % (sizeof(PROGRAM_FRAGMENTS) / sizeof(PROGRAM_FRAGMENTS[0]))];
+
+	return text;
+}
+
+static std::string format_diagnostics(const std::vector<Diagnostic>& diagnostics) {
+	std::string text;
+
+	for (const Diagnostic& diagnostic : diagnostics)
+		text += std::to_string(diagnostic.pos.line) + ':' + std::to_string(diagnostic.pos.column) + ' ' + diagnostic.message + "; ";
+
+	return text;
+}
+
+// Whether every int and float literal of the unit is the constant it indexes
+// in the pool.
+static bool literals_match_pool(const TranslationUnit& unit, const ConstantPool& pool) {
+	std::vector<const Statement*> stack(unit.statements().begin(), unit.statements().end());
+
+	while (!stack.empty()) {
+		const Statement* node = stack.back();
+		stack.pop_back();
+		if (!node)
+			continue;
+
+		switch (node->kind()) {
+		case NodeKind::COMPOUND_STATEMENT:
+			for (const Statement* statement : static_cast<const CompoundStatement*>(node)->statements())
+				stack.push_back(statement);
+			break;
+		case NodeKind::VARIABLE_DECLARATION:
+			stack.push_back(static_cast<const VariableDeclaration*>(node)->initial_value());
+			break;
+		case NodeKind::FUNCTION_DECLARATION:
+			stack.push_back(static_cast<const FunctionDeclaration*>(node)->statement());
+			break;
+		case NodeKind::IF_STATEMENT:
+			stack.push_back(static_cast<const IfStatement*>(node)->condition());
+			stack.push_back(static_cast<const IfStatement*>(node)->statement());
+			break;
+		case NodeKind::FOR_STATEMENT: {
+			const ForStatement* loop = static_cast<const ForStatement*>(node);
+			stack.insert(stack.end(), { loop->variable_declaration(), loop->condition_expr(), loop->loop_expr(), loop->statement() });
+			break;
+		}
+		case NodeKind::WHILE_STATEMENT:
+			stack.push_back(static_cast<const WhileStatement*>(node)->condition_expr());
+			stack.push_back(static_cast<const WhileStatement*>(node)->statement());
+			break;
+		case NodeKind::RETURN_STATEMENT:
+			stack.push_back(static_cast<const ReturnStatement*>(node)->return_expr());
+			break;
+		case NodeKind::BINARY_EXPRESSION:
+			stack.push_back(static_cast<const BinaryExpression*>(node)->left());
+			stack.push_back(static_cast<const BinaryExpression*>(node)->right());
+			break;
+		case NodeKind::UNARY_EXPRESSION:
+			stack.push_back(static_cast<const UnaryExpression*>(node)->expr());
+			break;
+		case NodeKind::FUNC_CALL_ATOM:
+			for (const Expression* argument : static_cast<const FuncCallAtom*>(node)->arguments())
+				stack.push_back(argument);
+			break;
+		case NodeKind::INT_LITERAL: {
+			const IntLiteral* literal = static_cast<const IntLiteral*>(node);
+			if (literal->constant() >= pool.size() || pool.type(literal->constant()) != Type::INT ||
+				pool.bits(literal->constant()) != static_cast<uint32_t>(literal->integer()))
+				return false;
+			break;
+		}
+		case NodeKind::FLOAT_LITERAL: {
+			const FloatLiteral* literal = static_cast<const FloatLiteral*>(node);
+			float value = literal->floating();
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			if (literal->constant() >= pool.size() || pool.type(literal->constant()) != Type::FLOAT || pool.bits(literal->constant()) != bits)
+				return false;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	return true;
+}
+
+// Applies random batches of edits to the text and checks the incremental
+// parse against a fresh one after each of them.
+static void check_incremental_edits(TestContext& test, std::string text, std::mt19937_64& random, int applies) {
+	IncrementalParser incremental(text);
+
+	for (int i = 0; i <= applies; i++) {
+		if (i > 0) {
+			std::vector<TextEdit> edits(1 + random() % 3);
+
+			for (TextEdit& edit : edits) {
+				edit.offset = static_cast<uint32_t>(random() % (text.size() + 1));
+				edit.removed = static_cast<uint32_t>(std::min<size_t>(random() % 6, text.size() - edit.offset));
+				edit.inserted = random() % 3 ? random_fragments(random, 1) : "";
+
+				text.replace(edit.offset, edit.removed, edit.inserted);
+			}
+
+			incremental.apply(edits);
+		}
+
+		SourceBuffer source{ std::string_view(text) };
+		AstContext context;
+		Parser parser(source, context);
+		// As IncrementalParser does, which has to parse all of the text.
+		parser.set_error_limit(0);
+		TranslationUnit* unit = parser.parse();
+
+		if (!ast_equal(*incremental.unit(), *unit)) {
+			test.check(false, "incremental and fresh trees differ after apply " + std::to_string(i) + " on \"" + escape(text) + '"');
+			return;
+		}
+
+		// Reused statements' literals were numbered by the pass that parsed them.
+		if (!literals_match_pool(*incremental.unit(), incremental.context().constants())) {
+			test.check(false, "literals do not index the unit's constants after apply " + std::to_string(i) + " on \"" + escape(text) + '"');
+			return;
+		}
+
+		if (format_diagnostics(incremental.diagnostics()) != format_diagnostics(parser.diagnostics())) {
+			test.check(false, "incremental and fresh diagnostics differ after apply " + std::to_string(i) + " on \"" + escape(text) +
+				"\": " + format_diagnostics(incremental.diagnostics()) + "against " + format_diagnostics(parser.diagnostics()));
+			return;
+		}
+	}
+}
+
+static void test_incremental_parser(TestContext& test) {
+	// The first diagnostic of a reparsed statement is at the position of the
+	// last one of the statement before, which a fresh parse reports once.
+	IncrementalParser incremental("true), -> intreturn ");
+	incremental.apply({ { 9, 2, "" } });
+
+	SourceBuffer source{ std::string_view("true), ->ntreturn ") };
+	AstContext context;
+	Parser parser(source, context);
+	parser.parse();
+	test.check(format_diagnostics(incremental.diagnostics()) == format_diagnostics(parser.diagnostics()),
+		"diagnostics of an edit that joins two statements' errors: " + format_diagnostics(incremental.diagnostics()) + "against " +
+		format_diagnostics(parser.diagnostics()));
+
+	for (uint64_t seed = 0; seed < 6; seed++) {
+		std::mt19937_64 random(seed);
+		check_incremental_edits(test, random_fragments(random, 10 + random() % 40), random, 3000);
+	}
+
+	// A valid program, which the edits take apart and put together again.
+	GeneratorOptions options;
+	options.target_size = 2048;
+	std::mt19937_64 random(6);
+	check_incremental_edits(test, ProgramGenerator(options).generate(), random, 1000);
+}
+
+// Takes a program through the backend as toyc --run does, with or without
+// folding, and gives the AST nodes the folder eliminated. With a module, it
+// also builds the IR and runs the default passes on it, as toyc --jit does.
+static bool compile_program(const std::string& text, bool fold, BytecodeProgram& program, size_t& eliminated_nodes, IrModule* module = nullptr) {
+	SourceBuffer source{ std::string_view(text) };
+	AstContext context;
+	Parser parser(source, context);
+	TranslationUnit* unit = parser.parse();
+	NameResolver resolver;
+
+	if (!parser.diagnostics().empty() || !resolver.resolve(*unit))
+		return false;
+
+	TypeChecker checker(context);
+	unit = checker.check(*unit, resolver);
+	if (!unit)
+		return false;
+
+	eliminated_nodes = 0;
+	if (fold) {
+		ConstantFolder folder(context);
+		unit = folder.fold(*unit);
+		eliminated_nodes = folder.stats().eliminated_nodes;
+	}
+
+	BytecodeCompiler compiler;
+	if (!compiler.compile(*unit, resolver, context.constants()))
+		return false;
+
+	program = compiler.program();
+	if (!module)
+		return true;
+
+	*module = IrBuilder().build(*unit, resolver);
+	for (std::string_view name : { "dce", "gvn", "licm", "gvn", "dce" }) {
+		IrPass pass = find_ir_pass(name);
+		for (IrFunction& function : module->functions)
+			pass(function);
+	}
+
+	for (const IrFunction& function : module->functions) {
+		if (!verify_ir(*module, function).empty())
+			return false;
+	}
+
+	return true;
+}
+
+static std::string describe_run(const std::string& error, bool ran, Type type, Value value) {
+	if (!ran)
+		return "error: " + error;
+	if (type == Type::VOID)
+		return "returned";
+
+	return "returned " + (type == Type::FLOAT ? std::to_string(value.f) : std::to_string(value.i));
+}
+
+// Small values, so that generated loops bounded by them end soon.
+static std::vector<Value> random_arguments(std::mt19937_64& random, const std::vector<Type>& parameters) {
+	std::vector<Value> arguments;
+	for (Type type : parameters) {
+		Value argument;
+		if (type == Type::FLOAT)
+			argument.f = static_cast<float>(static_cast<int>(random() % 2001) - 1000) / 8;
+		else
+			argument.i = type == Type::BOOL ? static_cast<int32_t>(random() % 2) : static_cast<int32_t>(random() % 2001) - 1000;
+		arguments.push_back(argument);
+	}
+
+	return arguments;
+}
+
+struct FoldCase {
+	const char* program;
+	// What main() gives folded and unfolded alike.
+	const char* result;
+	size_t eliminated_nodes;
+};
+
+static const FoldCase FOLD_CASES[] = {
+	// int arithmetic wraps, as in the VM.
+	{ "def main() -> int { return 2147483647 + 1; }", "returned -2147483648", 2 },
+	{ "def main() -> int { return 0 - 2147483647 - 2; }", "returned 2147483647", 4 },
+	{ "def main() -> int { return 65536 * 65536; }", "returned 0", 2 },
+	{ "def main() -> int { int m = 0 - 2147483647 - 1; int n = 0 - 1; return m / n; }", "returned -2147483648", 8 },
+	{ "def main() -> int { int n = 0 - 7; return n / 2; }", "returned -3", 4 },
+	// Division by zero is left for the VM to report.
+	{ "def main() -> int { return 1 / 0; }", "error: division by zero in function 'main'", 0 },
+	{ "def main() -> int { int z = 0; return 7 / z; }", "error: division by zero in function 'main'", 0 },
+	// Conversions saturate and truncate.
+	{ "def main() -> int { int i = 30000000000.0; return i; }", "returned 2147483647", 1 },
+	{ "def main() -> int { int i = 0.0 - 30000000000.0; return i; }", "returned -2147483648", 3 },
+	{ "def main() -> int { float f = 7 / 2.0; int i = f * 2; return i; }", "returned 7", 7 },
+	{ "def main() -> int { return 1 / 2 * 2.0 + 0.5; }", "returned 0", 8 },
+	// && and || keep the operands that may have side effects.
+	{ "int g = 0; def bump() -> bool { ++g; return true; } def main() -> int { bool b = false && bump(); b = bump() && false; return g; }",
+		"returned 1", 2 },
+	{ "int g = 0; def bump() -> bool { ++g; return true; } def main() -> int { bool b = true || bump(); b = bump() || true; return g; }",
+		"returned 1", 2 },
+	// Branches on constants.
+	{ "def main() -> int { int r = 1; if (1 > 2) r = 2; return r; }", "returned 1", 7 },
+	{ "def main() -> int { int r = 1; if (2 > 1) r = 3; return r; }", "returned 3", 4 },
+	{ "def main() -> int { int r = 5; while (false) r = 0; return r; }", "returned 5", 5 },
+	// Variables that are assigned keep their reads, the others do not.
+	{ "def main() -> int { int a = 2; int b = 3; b = b + 1; return a * 10 + b; }", "returned 24", 2 },
+	// A function can read a global before its initializer ran.
+	{ "int x = early(); int g = 3; def early() -> int { return g; } def main() -> int { return x + g; }", "returned 3", 0 },
+	{ "int g = 3; int h = g * 2; def main() -> int { return h; }", "returned 6", 2 },
+};
+
+// Runs each case folded and unfolded, then calls every function of generated
+// programs with a few sets of arguments both ways, which all have to give the
+// same results.
+static void test_constant_folder(TestContext& test) {
+	for (const FoldCase& fold_case : FOLD_CASES) {
+		std::string where = " of \"" + std::string(fold_case.program) + '"';
+		std::string results[2];
+
+		for (bool fold : { false, true }) {
+			BytecodeProgram program;
+			size_t eliminated_nodes;
+			if (!compile_program(fold_case.program, fold, program, eliminated_nodes)) {
+				test.check(false, "compile failed" + where);
+				continue;
+			}
+
+			VirtualMachine vm(program);
+			bool ran = vm.run();
+			results[fold] = describe_run(vm.error(), ran, Type::INT, vm.result());
+
+			if (fold)
+				test.check(eliminated_nodes == fold_case.eliminated_nodes,
+					"eliminated " + std::to_string(eliminated_nodes) + " nodes instead of " + std::to_string(fold_case.eliminated_nodes) + where);
+		}
+
+		test.check(results[0] == fold_case.result, "unfolded, " + results[0] + " instead of " + fold_case.result + where);
+		test.check(results[1] == fold_case.result, "folded, " + results[1] + " instead of " + fold_case.result + where);
+	}
+
+	// Later functions call earlier ones in loops, so the time a call takes
+	// grows about exponentially with the size of the program.
+	for (uint64_t seed = 1; seed <= 24; seed++) {
+		GeneratorOptions options;
+		options.seed = seed;
+		options.target_size = 2048;
+		std::string text = ProgramGenerator(options).generate();
+
+		BytecodeProgram programs[2];
+		size_t eliminated_nodes;
+		if (!compile_program(text, false, programs[0], eliminated_nodes) || !compile_program(text, true, programs[1], eliminated_nodes)) {
+			test.check(false, "generated program " + std::to_string(seed) + " does not compile");
+			continue;
+		}
+
+		test.check(eliminated_nodes != 0, "nothing folded in generated program " + std::to_string(seed));
+
+		VirtualMachine unfolded(programs[0]);
+		VirtualMachine folded(programs[1]);
+		test.check(unfolded.run() && folded.run(), "top-level code of generated program " + std::to_string(seed) + " failed");
+
+		std::mt19937_64 random(seed);
+		for (uint32_t function = 0; function < programs[0].functions.size(); function++) {
+			const BytecodeFunction& callee = programs[0].functions[function];
+
+			for (int set = 0; set < 3; set++) {
+				std::vector<Value> arguments = random_arguments(random, callee.parameters);
+
+				Value results[2];
+				bool ran[2] = { unfolded.call(function, arguments, results[0]), folded.call(function, arguments, results[1]) };
+
+				std::string expected = describe_run(unfolded.error(), ran[0], callee.return_type, results[0]);
+				std::string actual = describe_run(folded.error(), ran[1], callee.return_type, results[1]);
+				test.check(actual == expected, callee.name + " of generated program " + std::to_string(seed) + ", folded, " + actual + " instead of " + expected);
+			}
+		}
+	}
+}
+
+// Calls every function of generated programs with a few sets of arguments on
+// the VM and on the JIT, which have to give the same results. Generated
+// functions have many values that are only live for a while, so most of the
+// JIT's stack slots are shared.
+static void test_jit(TestContext& test) {
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(_WIN32)
+	for (uint64_t seed = 1; seed <= 24; seed++) {
+		GeneratorOptions options;
+		options.seed = seed;
+		options.target_size = 2048;
+		std::string text = ProgramGenerator(options).generate();
+		std::string where = " of generated program " + std::to_string(seed);
+
+		BytecodeProgram program;
+		IrModule module;
+		size_t eliminated_nodes;
+		if (!compile_program(text, true, program, eliminated_nodes, &module)) {
+			test.check(false, "compile failed" + where);
+			continue;
+		}
+
+		VirtualMachine vm(program);
+		Jit jit;
+		if (!jit.compile(module)) {
+			test.check(false, "JIT compile failed" + where + ": " + jit.error());
+			continue;
+		}
+
+		bool ran[2] = { vm.run(), jit.run() };
+		test.check(ran[0] == ran[1], "top-level code" + where + " ran on only one of the VM and the JIT");
+
+		std::mt19937_64 random(seed);
+		for (uint32_t function = 0; function < program.functions.size(); function++) {
+			const BytecodeFunction& callee = program.functions[function];
+
+			for (int set = 0; set < 3; set++) {
+				std::vector<Value> arguments = random_arguments(random, callee.parameters);
+
+				Value results[2];
+				bool called[2] = { vm.call(function, arguments, results[0]), jit.call(function, arguments, results[1]) };
+
+				std::string expected = describe_run(vm.error(), called[0], callee.return_type, results[0]);
+				std::string actual = describe_run(jit.error(), called[1], callee.return_type, results[1]);
+				test.check(actual == expected, callee.name + where + ", JIT " + actual + " instead of " + expected);
+			}
+		}
+	}
+#else
+	(void)test;
+#endif
+}
+
+// Looks ahead of and rewinds a buffered TokenStream to random positions,
+// which has to give the tokens, and the ends of the ones before them, that
+// walking an inline stream in order gives.
+static void test_token_stream(TestContext& test) {
+	std::mt19937_64 random(8);
+
+	for (int i = 0; i < 50; i++) {
+		std::string text = random_fragments(random, random() % 60);
+		SourceBuffer source{ std::string_view(text) };
+
+		struct Step {
+			TokenKind kind;
+			uint32_t offset;
+			uint32_t length;
+			uint32_t previous_end;
+		};
+		std::vector<Step> steps;
+
+		TokenStream walk(source, source.range(), Lexing::INLINE);
+		test.check(!walk.buffered(), "inline stream claims to be buffered");
+		for (;; walk.next()) {
+			const Token& token = walk.current();
+			steps.push_back({ token.kind(), token.offset(), token.length(), walk.previous_end() });
+
+			if (token.kind() == TokenKind::EOS)
+				break;
+		}
+
+		TokenStream stream(source, source.range(), Lexing::BUFFERED);
+		test.check(stream.buffered(), "buffered stream claims not to be");
+		std::vector<TokenMark> marks;
+		size_t position = 0;
+		std::string where = " on \"" + escape(text) + '"';
+
+		for (int action = 0; action < 200; action++) {
+			const Token& token = stream.current();
+			const Step& step = steps[position];
+			if (token.kind() != step.kind || token.offset() != step.offset || token.length() != step.length ||
+				stream.previous_end() != step.previous_end || stream.token_count() != position + 1) {
+				test.check(false, "token " + std::to_string(position) + " differs" + where);
+				break;
+			}
+
+			size_t n = random() % 8;
+			const Step& ahead = steps[std::min(position + n, steps.size() - 1)];
+			Token peeked = stream.peek(n);
+			test.check(peeked.kind() == ahead.kind && peeked.offset() == ahead.offset && peeked.length() == ahead.length,
+				"peek(" + std::to_string(n) + ") at token " + std::to_string(position) + " differs" + where);
+
+			switch (random() % 4) {
+			case 0:
+				marks.push_back(stream.mark());
+				break;
+			case 1:
+				if (!marks.empty()) {
+					TokenMark mark = marks[random() % marks.size()];
+					stream.rewind(mark);
+					position = mark.index;
+				}
+				break;
+			default:
+				// The steps above stop at EOS, where a next() still moves previous_end().
+				if (position + 1 < steps.size()) {
+					stream.next();
+					position++;
+				}
+				break;
+			}
+		}
+	}
+}
+
+// Stores parses of programs with and without errors and loads them back,
+// which has to give the fresh parse's tree and diagnostics, under the limits
+// they were stored with only.
+// Parses programs with a number of errors under limits below, at and above
+// it: only a limit that drops an error adds the note that parsing stopped.
+static void test_diagnostics(TestContext& test) {
+	for (size_t errors = 0; errors <= 4; errors++) {
+		std::string text;
+		for (size_t i = 0; i < errors; i++)
+			text += "int a" + std::to_string(i) + " = 1 + ;\n";
+		text += "int b = 2;\n";
+		SourceBuffer source{ std::string_view(text) };
+
+		for (size_t error_limit = 0; error_limit <= 5; error_limit++) {
+			AstContext context;
+			Parser parser(source, context);
+			parser.set_error_limit(error_limit);
+			parser.parse();
+			std::vector<Diagnostic> diagnostics = parser.diagnostics();
+			std::string where = " with error limit " + std::to_string(error_limit) + " on \"" + escape(text) + '"';
+
+			bool dropped = error_limit != 0 && errors > error_limit;
+			size_t kept = dropped ? error_limit : errors;
+			test.check(diagnostics.size() == kept + dropped, std::to_string(diagnostics.size()) + " diagnostics" + where);
+			test.check(dropped == (!diagnostics.empty() && diagnostics.back().message.rfind("Too many errors", 0) == 0),
+				"note on stopping " + std::string(dropped ? "missing" : "without a dropped error") + where);
+
+			// Past the end, only the note is left.
+			test.check(parser.diagnostics(kept + 3).size() == size_t(dropped), "diagnostics past the end" + where);
+		}
+	}
+}
+
+static bool flat_ast_equal(const FlatAst& a, const FlatAst& b) {
+	if (a.size() != b.size() || a.name_count() != b.name_count() || a.top_level_count() != b.top_level_count())
+		return false;
+
+	for (NodeHandle node = 0; node < a.size(); node++) {
+		if (a.kind(node) != b.kind(node) || a.tag(node) != b.tag(node) || a.lhs(node) != b.lhs(node) || a.rhs(node) != b.rhs(node))
+			return false;
+	}
+
+	for (uint32_t name = 0; name < a.name_count(); name++) {
+		if (a.name(name) != b.name(name))
+			return false;
+	}
+
+	for (uint32_t i = 0; i < a.top_level_count(); i++) {
+		if (a.top_level(i) != b.top_level(i))
+			return false;
+	}
+
+	return true;
+}
+
+// Parses programs big enough to be split into several ranges on a pool, with
+// every way of lexing, and compares the flattened tree and the diagnostics
+// with those of a serial parse. Errors in some ranges make the file be parsed
+// again, with the limit of the serial parse.
+static void test_parallel_parser(TestContext& test) {
+	ThreadPool pool(4);
+	GeneratorOptions options;
+	options.target_size = 512 * 1024;
+	std::string program = ProgramGenerator(options).generate();
+
+	std::vector<std::string> texts = { program };
+	// An error after the first and after the last few top-level statements.
+	std::string broken = program;
+	broken.insert(broken.rfind(";\n", broken.size() - 4096) + 2, "int late = 1 + ;\n");
+	broken.insert(broken.find(";\n", 4096) + 2, "int early = * 2;\n");
+	texts.push_back(broken);
+
+	for (const std::string& text : texts) {
+		SourceBuffer source{ std::string_view(text) };
+		bool has_errors = &text != &texts.front();
+		test.check(split_top_level_statements(source, 64 * 1024).size() > 1, "program is not split into ranges");
+
+		for (const auto& [lexing, lexing_name] : { std::pair(Lexing::INLINE, "inline"), std::pair(Lexing::BUFFERED, "buffered"), std::pair(Lexing::PIPELINED, "pipelined") }) {
+			for (size_t error_limit : { size_t(1), DiagnosticEngine::DEFAULT_ERROR_LIMIT }) {
+				std::string where = " with " + std::string(lexing_name) + " lexing and error limit " + std::to_string(error_limit) +
+					(has_errors ? " on the program with errors" : " on the program");
+
+				AstContext serial_context;
+				Parser parser(source, serial_context, lexing);
+				parser.set_error_limit(error_limit);
+				TranslationUnit* serial = parser.parse();
+
+				AstContext parallel_context;
+				std::vector<Diagnostic> diagnostics;
+				TranslationUnit* parallel = parse_in_parallel(source, parallel_context, pool, lexing, error_limit, Parser::DEFAULT_NESTING_LIMIT, diagnostics);
+
+				test.check(parser.diagnostics().empty() != has_errors, "serial parse" + where + (has_errors ? " has no errors" : " has errors"));
+				test.check(flat_ast_equal(flatten(*parallel), flatten(*serial)), "parallel and serial trees differ" + where);
+				test.check(format_diagnostics(diagnostics) == format_diagnostics(parser.diagnostics()),
+					"parallel and serial diagnostics differ" + where + ": " + format_diagnostics(diagnostics) + "against " + format_diagnostics(parser.diagnostics()));
+			}
+		}
+	}
+}
+
+static void test_ast_cache(TestContext& test) {
+	std::filesystem::path directory = std::filesystem::temp_directory_path() / ("toyc-tests-" + std::to_string(std::random_device()()));
+	std::mt19937_64 random(7);
+	std::vector<std::string> texts;
+
+	GeneratorOptions options;
+	options.target_size = 2048;
+	texts.push_back(ProgramGenerator(options).generate());
+	for (int i = 0; i < 20; i++)
+		texts.push_back(random_fragments(random, 10 + random() % 60));
+
+	for (const std::string& text : texts) {
+		SourceBuffer source{ std::string_view(text) };
+
+		for (size_t error_limit : { size_t(0), size_t(1), DiagnosticEngine::DEFAULT_ERROR_LIMIT }) {
+			AstCache cache(directory);
+			cache.set_error_limit(error_limit);
+
+			AstContext context;
+			Parser parser(source, context);
+			parser.set_error_limit(error_limit);
+			TranslationUnit* unit = parser.parse();
+			test.check(cache.store(source, *unit, parser.diagnostics()), "store failed on \"" + escape(text) + '"');
+
+			AstContext loaded_context;
+			std::vector<Diagnostic> diagnostics;
+			TranslationUnit* loaded = cache.load(source, loaded_context, diagnostics);
+			std::string where = " with error limit " + std::to_string(error_limit) + " on \"" + escape(text) + '"';
+
+			if (!loaded) {
+				test.check(false, "load missed" + where);
+				continue;
+			}
+
+			test.check(ast_equal(*unit, *loaded), "loaded tree differs" + where);
+			test.check(format_diagnostics(diagnostics) == format_diagnostics(parser.diagnostics()),
+				"loaded diagnostics differ" + where + ": " + format_diagnostics(diagnostics) + "against " + format_diagnostics(parser.diagnostics()));
+		}
+
+		// Stored under each limit above, but not under this one.
+		AstCache cache(directory);
+		cache.set_error_limit(2);
+		AstContext context;
+		std::vector<Diagnostic> diagnostics;
+		test.check(!cache.load(source, context, diagnostics), "entry of another error limit loaded on \"" + escape(text) + '"');
+	}
+
+	std::error_code ec;
+	std::filesystem::remove_all(directory, ec);
+}
+
+static const Test TESTS[] = {
+	{ "scan_kernels", test_scan_kernels },
+	{ "incremental_parser", test_incremental_parser },
+	{ "diagnostics", test_diagnostics },
+	{ "parallel_parser", test_parallel_parser },
+	{ "ast_cache", test_ast_cache },
+	{ "token_stream", test_token_stream },
+	{ "constant_folder", test_constant_folder },
+	{ "jit", test_jit }
+};
+
+static void print_usage() {
+	std::cout <<
+		"Usage: toyc-tests [<test>...]\n"
+		"\n"
+		"Runs the named tests, or all of them, and exits with 1 if any failed.\n"
+		"\n"
+		"Tests:\n";
+
+	for (const Test& test : TESTS)
+		std::cout << "  " << test.name << '\n';
+}
+
+int main(int argc, char** argv) {
+	std::vector<std::string_view> selected(argv + 1, argv + argc);
+
+	for (std::string_view arg : selected) {
+		if (arg == "-h" || arg == "--help") {
+			print_usage();
+			return 0;
+		}
+
+		bool known = false;
+		for (const Test& test : TESTS)
+			known |= arg == test.name;
+
+		if (!known) {
+			std::cerr << "error: unknown test '" << arg << "'\n";
+			return 1;
+		}
+	}
+
+	size_t failed = 0;
+
+	for (const Test& test : TESTS) {
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), test.name) == selected.end())
+			continue;
+
+		TestContext context{ test.name };
+		test.run(context);
+
+		std::cout << test.name << ": " << (context.failures ? std::to_string(context.failures) + " failed checks" : "ok") << '\n';
+		failed += context.failures != 0;
+	}
+
+	return failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,187 @@
+#!/bin/sh
+# Runs toyc-tests, then toyc itself on the inputs next to this script.
+#
+# Usage: tests/run_tests.sh [--update] [<directory with toyc and toyc-tests>]
+#
+# --update rewrites the golden files in tests/golden from toyc's output
+# instead of comparing with them.
+
+update=0
+if [ "$1" = "--update" ]; then
+	update=1
+	shift
+fi
+
+bin=$(cd "${1:-.}" && pwd)
+tests=$(cd "$(dirname "$0")" && pwd)
+scratch=$(mktemp -d)
+trap 'rm -rf "$scratch"' EXIT
+failed=0
+
+fail() {
+	echo "$1: FAILED"
+	failed=1
+}
+
+# Compares a file of toyc's output with tests/golden/<name>.
+compare_golden() {
+	if [ $update -eq 1 ]; then
+		cp "$2" "$tests/golden/$1"
+	elif diff -u "$tests/golden/$1" "$2"; then
+		echo "golden $1: ok"
+	else
+		fail "golden $1"
+	fi
+}
+
+# Runs toyc in tests/, so that the output names the inputs as they are named
+# there, and compares what it prints with tests/golden/<name>.
+golden() {
+	name=$1
+	shift
+	(cd "$tests" && "$bin/toyc" "$@") > "$scratch/$name" 2>&1
+	compare_golden "$name" "$scratch/$name"
+}
+
+"$bin/toyc-tests" || failed=1
+
+golden fib.ir --dump-ir fib.program
+golden input.ir --dump-ir input.program
+golden nested_loops.ir --dump-ir nested_loops.program
+# Each pass on its own, against the IR that no pass has touched.
+golden ir_passes.none.ir --dump-ir --ir-passes= ir_passes.program
+for pass in dce gvn licm; do
+	golden ir_passes.$pass.ir --dump-ir --ir-passes=$pass ir_passes.program
+done
+golden syntax_errors.txt syntax_errors.program
+# Every way of lexing feeds the parser the same tokens.
+if [ $update -eq 0 ]; then
+	for lexing in buffered pipelined; do
+		golden syntax_errors.txt --lexing=$lexing syntax_errors.program
+	done
+fi
+golden syntax_errors.json --diagnostics=json syntax_errors.program
+golden name_errors.json --run --diagnostics=json name_errors.program
+golden type_errors.json --run --diagnostics=json type_errors.program
+
+# Times vary from run to run, and whether the file could be mapped from
+# platform to platform; the events and everything else they carry may not.
+(cd "$tests" && "$bin/toyc" -j 1 --run --jit --trace="$scratch/trace.json" fib.program) > /dev/null
+sed -E 's/"(ts|dur|[a-z_]*_us|mapped)":[0-9.]+/"\1":0/g' "$scratch/trace.json" > "$scratch/fib.trace.json"
+compare_golden fib.trace.json "$scratch/fib.trace.json"
+
+# Runs toyc on an input made up here and checks its exit status, and that
+# what it prints has a line matching the pattern.
+expect() {
+	name=$1
+	status=$2
+	pattern=$3
+	shift 3
+	"$bin/toyc" "$@" > "$scratch/$name.out" 2>&1
+	if [ $? -ne "$status" ] || ! grep -q -- "$pattern" "$scratch/$name.out"; then
+		fail "$name"
+	else
+		echo "$name: ok"
+	fi
+}
+
+# The VM and JIT cases check themselves and return the number of the first
+# that fails, on both backends; the samples compute known values.
+expect vm_cases 0 "main() returned 0 in" --run "$tests/vm_cases.program"
+expect vm_cases_jit 0 "main() returned 0 in" --run --jit "$tests/vm_cases.program"
+expect jit_cases 0 "main() returned 0 in" --run --jit "$tests/jit_cases.program"
+expect jit_cases_vm 0 "main() returned 0 in" --run "$tests/jit_cases.program"
+expect fib_run 0 "main() returned 832040 in" --run "$tests/fib.program"
+expect fib_jit 0 "main() returned 832040 in" --run --jit "$tests/fib.program"
+expect nested_loops_run 0 "main() returned 8945988 in" --run "$tests/nested_loops.program"
+expect nested_loops_jit 0 "main() returned 8945988 in" --run --jit "$tests/nested_loops.program"
+
+# Runtime errors stop the program and name the function they happened in.
+printf 'def divide(int a, int b) -> int {\n\treturn a / b;\n}\n\ndef main() -> int {\n\treturn divide(1, 0);\n}\n' > "$scratch/division.program"
+expect division_by_zero 1 "runtime error: division by zero in function 'divide'" --run "$scratch/division.program"
+expect division_by_zero_jit 1 "runtime error: division by zero in function 'divide'" --run --jit "$scratch/division.program"
+printf 'def forever(int n) -> int {\n\treturn forever(n + 1) + 1;\n}\n\ndef main() -> int {\n\treturn forever(0);\n}\n' > "$scratch/recursion.program"
+expect stack_overflow 1 "runtime error: stack overflow in function 'forever'" --run "$scratch/recursion.program"
+expect stack_overflow_jit 1 "runtime error: stack overflow in function 'forever'" --run --jit "$scratch/recursion.program"
+
+# 200000 ifs in one function, each merging n into a new value: every value
+# with a slot of its own overflows the JIT's stack, while those that are dead
+# share slots.
+awk 'BEGIN {
+	printf "def main() -> int {\n\tint n = 0;\n\tint x = 3;\n\tx = x + 1;\n"
+	for (i = 0; i < 200000; i++)
+		printf "\tif (x > %d)\n\t\tn = n + 1;\n", i % 7
+	printf "\treturn n;\n}\n"
+}' > "$scratch/ifs.program"
+expect ifs 0 "returned 114287" --run "$scratch/ifs.program"
+expect ifs_jit 0 "returned 114287" --run --jit "$scratch/ifs.program"
+
+# Offsets are 32-bit, so a bigger file is refused rather than misread. The
+# file is sparse and costs no disk space.
+truncate -s 4294967296 "$scratch/huge.program"
+expect huge_file 1 "error: source is larger than 4294967295 bytes" "$scratch/huge.program"
+
+# Chains of a million operators are not nesting, and every pass walks them
+# without recursing; reading a after the blocks of the '&&' chain walks back
+# through all of them.
+awk 'BEGIN {
+	printf "def main() -> int {\n\tint a = 1;\n\tbool t = true;\n\tif (t"
+	for (i = 1; i < 1000000; i++)
+		printf " && t"
+	printf ")\n\t\treturn a"
+	for (i = 1; i < 1000000; i++)
+		printf " + a"
+	printf ";\n\treturn 0;\n}\n"
+}' > "$scratch/chains.program"
+expect chains 0 "returned 1000000" --run "$scratch/chains.program"
+expect chains_jit 0 "returned 1000000" --run --jit "$scratch/chains.program"
+expect chains_no_fold 0 "returned 1000000" --run --no-fold "$scratch/chains.program"
+expect chains_ir 0 "^function main" --dump-ir --no-fold "$scratch/chains.program"
+
+# Every loop header has a phi for each variable in scope, and all but a few
+# of them are trivial; removing them must not be quadratic in the phis.
+awk 'BEGIN {
+	printf "def main() -> int {\n\tint n = 0;\n"
+	for (i = 0; i < 900; i++)
+		printf "for (int i%d = 0; i%d < 1; ++i%d) ", i, i, i
+	printf "n = n + 1;\n\treturn n;\n}\n"
+}' > "$scratch/loops.program"
+expect loops 0 "returned 1" --run "$scratch/loops.program"
+expect loops_jit 0 "returned 1" --run --jit "$scratch/loops.program"
+
+# Nested a million deep, which only stops parsing at the nesting limit.
+awk 'BEGIN {
+	printf "def main() -> int "
+	for (i = 0; i < 1000000; i++)
+		printf "{"
+	printf "return 1;"
+	for (i = 0; i < 1000000; i++)
+		printf "}"
+	printf "\n"
+}' > "$scratch/blocks.program"
+awk 'BEGIN {
+	printf "def f(int x) -> int { return x; }\nint a = "
+	for (i = 0; i < 1000000; i++)
+		printf "f("
+	printf "1"
+	for (i = 0; i < 1000000; i++)
+		printf ")"
+	printf ";\n"
+}' > "$scratch/calls.program"
+expect blocks 1 "Nested deeper than 1000 levels" "$scratch/blocks.program"
+expect calls 1 "Nested deeper than 1000 levels" "$scratch/calls.program"
+
+# Without the limit, the cache stores and loads trees of any depth.
+for input in blocks calls chains; do
+	expect ${input}_cache_store 0 "(0 with errors, 0 from cache)" --stats --nesting-limit=0 --cache-dir="$scratch/cache" "$scratch/$input.program"
+	expect ${input}_cache_load 0 "(0 with errors, 1 from cache)" --stats --nesting-limit=0 --cache-dir="$scratch/cache" "$scratch/$input.program"
+done
+# An entry stored without the limit is not one for a parse with it.
+expect blocks_cache_limit 1 "Nested deeper than 1000 levels" --run --cache-dir="$scratch/cache" "$scratch/blocks.program"
+
+if [ $failed -ne 0 ]; then
+	echo "FAILED"
+	exit 1
+fi
+
+echo "all tests passed"